@@ -17,6 +17,14 @@ CONFIG_SHELL_COLORPROMPT	?= y
 ######################################
 CONFIG_SHFS_OPENBYNAME		?= y
 CONFIG_SHFS_CACHEINFO		?= y
+# Build an in-memory cuckoo index for file lookups on mount
+CONFIG_SHFS_BTABLE_INDEX	?= y
+# Persist objects of AUTO links to the fill area of the volume
+#  (volume has to be formatted with shfs-mkfs --fill-area)
+CONFIG_SHFS_FILL		?= y
+# Second-level chunk cache on a separate device (e.g., SSD), passed with -l
+#  Chunks evicted from RAM are written back asynchronously
+CONFIG_SHFS_L2CACHE		?= n
 
 # Enable statistic capabilities of SHFS
 #  If this option is disabled, STATS_HTTP is disabled as well
@@ -48,6 +56,13 @@ CONFIG_SHFS_STATS_HTTP_DPCR	?= 6
 CONFIG_HTTP_INFO		?= y
 # Consider
 CONFIG_HTTP_URL_CUTARGS		?= y
+# Parse plain GET requests with a vectorized fast path (falls back to http_parser)
+CONFIG_HTTP_FASTPARSE		?= y
+# Per-session egress pacing of file responses (token bucket, http-pacing cmd)
+CONFIG_HTTP_PACING		?= y
+# Closed-loop HTTP load generator (http-bench cmd, -B option)
+#  Client and server share the stack: requires a loopback netif (Linux: CONFIG_LOOPIF)
+CONFIG_HTTP_BENCH		?= n
 # Provide a performance test file on hash digest 0x0
 CONFIG_HTTP_TESTFILE		?= n
 
@@ -61,6 +76,8 @@ CONFIG_CTLDIR_NOCHMOD		?= y
 ## Misc
 ######################################
 CONFIG_TESTSUITE		?= n
+# Latency histograms at hot-path tracepoints (tp-dump, tp-reset)
+CONFIG_TRACEPOINTS		?= y
 
 ######################################
 ## Debugging options
@@ -10,7 +10,10 @@ MCCFLAGS-$(CONFIG_MINICACHE_DEBUG_PRINT)	+= -DCONFIG_DEBUG_PRINT
 MCCFLAGS-$(CONFIG_MINICACHE_TRACE_BOOTTIME)	+= -DTRACE_BOOTTIME
 
 MCOBJS						= ring.o \
+						  mpring.o \
 						  mempool.o \
+						  mtmempool.o \
+						  slabmempool.o \
 						  hexdump.o \
 						  debug.o \
 						  htable.o \
@@ -63,6 +66,19 @@ endif
 ######################################
 MCCFLAGS-$(CONFIG_SHFS_OPENBYNAME)	+= -DSHFS_OPENBYNAME
 MCCFLAGS-$(CONFIG_SHFS_CACHEINFO)	+= -DSHFS_CACHE_INFO
+MCCFLAGS-$(CONFIG_SHFS_BTABLE_INDEX)	+= -DSHFS_BTABLE_INDEX
+MCCFLAGS-$(CONFIG_SHFS_FILL)		+= -DSHFS_FILL
+MCOBJS-$(CONFIG_SHFS_FILL)		+= shfs_fill.o
+MCCFLAGS-$(CONFIG_SHFS_L2CACHE)	+= -DSHFS_L2CACHE
+MCOBJS-$(CONFIG_SHFS_L2CACHE)		+= shfs_l2cache.o
+ifeq ($(CONFIG_SHFS_L2CACHE),y)
+ifneq ($(CONFIG_SHFS_L2CACHE_ADMIT_HITS),)
+MCCFLAGS				+= -DSHFS_L2CACHE_ADMIT_HITS=$(CONFIG_SHFS_L2CACHE_ADMIT_HITS)
+endif
+ifneq ($(CONFIG_SHFS_L2CACHE_WB_MBPS),)
+MCCFLAGS				+= -DSHFS_L2CACHE_WB_MBPS=$(CONFIG_SHFS_L2CACHE_WB_MBPS)
+endif
+endif
 MCCFLAGS-$(CONFIG_SHFS_DEBUG)		+= -DSHFS_DEBUG
 MCCFLAGS-$(CONFIG_SHFS_CACHE_DEBUG)	+= -DSHFS_CACHE_DEBUG
 MCCFLAGS-$(CONFIG_SHFS_CACHE_DISABLE)	+= -DSHFS_CACHE_DISABLE
@@ -100,6 +116,11 @@ MCCFLAGS-$(CONFIG_HTTP_TESTFILES)	+= -DHTTP_TESTFILES
 MCCFLAGS-$(CONFIG_HTTP_INFO)		+= -DHTTP_INFO
 MCCFLAGS-$(CONFIG_HTTP_URL_CUTARGS)	+= -DHTTP_URL_CUTARGS
 MCCFLAGS-$(CONFIG_HTTP_LINK_MEMCPY)	+= -DHTTP_LINK_MEMCPY
+MCCFLAGS-$(CONFIG_HTTP_FASTPARSE)	+= -DHTTP_FASTPARSE
+MCOBJS-$(CONFIG_HTTP_FASTPARSE)		+= http_fastparse.o
+MCCFLAGS-$(CONFIG_HTTP_PACING)		+= -DHTTP_PACING
+MCCFLAGS-$(CONFIG_HTTP_BENCH)		+= -DHTTP_BENCH
+MCOBJS-$(CONFIG_HTTP_BENCH)		+= http_bench.o
 
 MCCFLAGS-$(CONFIG_HTTP_DEBUG)		+= -DHTTP_DEBUG
 MCCFLAGS-$(CONFIG_HTTP_DEBUG_SESSIONSTATES) += -DHTTP_DEBUG_SESSIONSTATES
@@ -110,6 +131,8 @@ MCCFLAGS-$(CONFIG_HTTP_DEBUG_PRINTACCESS) += -DHTTP_DEBUG_PRINTACCESS
 ######################################
 MCCFLAGS-$(CONFIG_TESTSUITE)		+= -DTESTSUITE
 MCOBJS-$(CONFIG_TESTSUITE)		+= testsuite.o
+MCCFLAGS-$(CONFIG_TRACEPOINTS)		+= -DTRACEPOINTS
+MCOBJS-$(CONFIG_TRACEPOINTS)		+= tracepoint.o
 
 ######################################
 MCOBJS					+= $(MCOBJS-y)
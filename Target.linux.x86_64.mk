@@ -89,8 +89,21 @@ CXXFLAGS+=-std=gnu++11 $(common)
 LDFLAGS+=$(autodepend)
 else
 CONFIG_PTH_THREADS?=n
-CONFIG_SHELL?=n
+CONFIG_SHELL?=y # shell commands are issued via the control socket
+CONFIG_XDPIF?=n
+CONFIG_LOOPIF?=n
+CONFIG_RAMBLK?=n
+CONFIG_MMAPBLK?=n
+ifeq ($(CONFIG_LOOPIF),y)
+CONFIG_EVLOOP:=n # nothing to wait for: packets are looped back by polling
+else
+CONFIG_EVLOOP?=y
+endif
+ifneq ($(CONFIG_XDPIF),y)
+ifneq ($(CONFIG_LOOPIF),y)
 CONFIG_NETMAP?=y
+endif
+endif
 
 CONFIG_SHFS_CACHE_READAHEAD		?= 8
 CONFIG_SHFS_CACHE_POOL_NB_BUFFERS	?= 8192
@@ -99,8 +112,20 @@ endif
 
 ifeq ($(CONFIG_SHELL),y)
 ifneq ($(CONFIG_PTH_THREADS),y)
+ifeq ($(CONFIG_OSVAPP),y)
 $(warning "Shell is not available without threads support")
 CONFIG_SHELL:=n
+else
+# no shell sessions without threads: commands are issued via a Unix socket
+CONFIG_CTLSOCK:=y
+endif
+endif
+endif
+
+ifeq ($(CONFIG_EVLOOP),y)
+ifeq ($(CONFIG_PTH_THREADS),y)
+$(warning "Event loop is not available with threads support")
+CONFIG_EVLOOP:=n
 endif
 endif
 
@@ -113,8 +138,10 @@ endif
 ###########################################################################
 
 CONFIG_CTLDIR = n # ctldir is not supported on linuxapp
-CONFIG_SHFS_STATS = n # no stats
+ifneq ($(CONFIG_SHELL),y)
+CONFIG_SHFS_STATS = n # stats tools require the shell
 CONFIG_TESTSUITE = n # no testuite
+endif
 
 CONFIG_MINICACHE_MINDER_PRINT ?= n
 
@@ -169,6 +196,9 @@ CFLAGS+=-g -D$(TARGET) $(MCCFLAGS) \
 # -ansi
 # -std=c89
 LDFLAGS+=-pthread #-lutil
+ifeq ($(CONFIG_TESTSUITE),y)
+LDFLAGS+=-lm # ioperf-rand: pow()
+endif
 ARFLAGS=rs
 
 ifeq ($(CONFIG_PTH_THREADS),y)
@@ -242,6 +272,13 @@ SNMPDIRS=$(LWIPDIR)/core/snmp
 ARCHDIRS=$(LWIPARCH)/netif
 #ARCHFILES=$(wildcard $(LWIPARCH)/*.c) # $(LWIPARCH)/netif/sio.c $(LWIPARCH)/netif/fifo.c)
 # lwIP device driver
+ifeq ($(CONFIG_LOOPIF),y)
+ARCHFILES+=$(wildcard $(LWIPARCH)/netif/loopif.c)
+CFLAGS+=-DCONFIG_LOOPIF
+# max. number of packets in flight (power of 2)
+CONFIG_LOOPIF_QUEUE_LEN ?= 4096
+CFLAGS+=-DCONFIG_LOOPIF_QUEUE_LEN=$(CONFIG_LOOPIF_QUEUE_LEN)
+else
 ifeq ($(CONFIG_PCAPIF),y)
 ARCHFILES+=$(wildcard $(LWIPARCH)/netif/pcapif.c)
 CFLAGS+=-DCONFIG_PCAPIF
@@ -252,15 +289,51 @@ ARCHFILES+=$(wildcard $(LWIPARCH)/netif/osv-net.c)
 ARCHFILESXX+=$(wildcard $(LWIPARCH)/netif/osv-net-io.cc)
 CFLAGS+=-DCONFIG_OSVNET
 else
+ifeq ($(CONFIG_XDPIF),y)
+ARCHFILES+=$(wildcard $(LWIPARCH)/netif/xdpif.c)
+CFLAGS+=-DCONFIG_XDPIF
+LDFLAGS+=-lxdp -lbpf
+# interface and queue the AF_XDP socket is bound to
+CONFIG_XDPIF_IFNAME ?= veth1
+CONFIG_XDPIF_QUEUE ?= 0
+# descriptors per ring (power of 2), UMEM frames and max. frames per poll
+CONFIG_XDPIF_RING_SIZE ?= 2048
+CONFIG_XDPIF_NUM_FRAMES ?= 8192
+CONFIG_XDPIF_RX_BATCH ?= 64
+CFLAGS+=-DCONFIG_XDPIF_IFNAME=\"$(CONFIG_XDPIF_IFNAME)\"
+CFLAGS+=-DCONFIG_XDPIF_QUEUE=$(CONFIG_XDPIF_QUEUE)
+CFLAGS+=-DCONFIG_XDPIF_RING_SIZE=$(CONFIG_XDPIF_RING_SIZE)
+CFLAGS+=-DCONFIG_XDPIF_NUM_FRAMES=$(CONFIG_XDPIF_NUM_FRAMES)
+CFLAGS+=-DCONFIG_XDPIF_RX_BATCH=$(CONFIG_XDPIF_RX_BATCH)
+else
 ifeq ($(CONFIG_NETMAP),y)
 ARCHFILES+=$(wildcard $(LWIPARCH)/netif/netmapif.c)
 CFLAGS+=-DCONFIG_NETMAP -I$(NETMAP_INCLUDES)
+# spare netmap buffers for zero-copy receive (0 copies every frame)
+CONFIG_NETMAP_EXTRA_BUFS ?= 1024
+CFLAGS+=-DCONFIG_NETMAP_EXTRA_BUFS=$(CONFIG_NETMAP_EXTRA_BUFS)
+# TCP super-segments are segmented in software right before the TX ring
+CONFIG_LWIP_GSO ?= y
 else
 ARCHFILES+=$(wildcard $(LWIPARCH)/netif/tapif.c)
 CFLAGS+=-DCONFIG_TAPIF
+# virtio-net headers: TCP checksum offload on TX (with CONFIG_LWIP_CHECKSUM_NOGEN),
+# checksum offload and GRO on RX (with CONFIG_LWIP_CHECKSUM_NOCHECK)
+CONFIG_TAPIF_VNET_HDR ?= y
+# number of TAP queues (IFF_MULTI_QUEUE if > 1) and max. frames per queue and poll
+CONFIG_TAPIF_NUM_QUEUES ?= 1
+CONFIG_TAPIF_RX_BATCH ?= 32
+CFLAGS-$(CONFIG_TAPIF_VNET_HDR)+=-DCONFIG_TAPIF_VNET_HDR
+CFLAGS+=-DCONFIG_TAPIF_NUM_QUEUES=$(CONFIG_TAPIF_NUM_QUEUES)
+CFLAGS+=-DCONFIG_TAPIF_RX_BATCH=$(CONFIG_TAPIF_RX_BATCH)
+# TCP super-segments are handed to the kernel for segmentation (requires vnet headers)
+CONFIG_LWIP_GSO ?= $(CONFIG_TAPIF_VNET_HDR)
+endif
 endif
 endif
 endif
+endif
+CFLAGS-$(CONFIG_LWIP_GSO)+=-DCONFIG_LWIP_GSO
 
 APPDIRS=target/$(TARGET)/blkdev
 ifeq ($(CONFIG_OSVBLK),y)
@@ -268,9 +341,38 @@ APPFILES+=target/$(TARGET)/blkdev/osv-blk.c
 APPFILESXX+=target/$(TARGET)/blkdev/osv-blk-bio.cc
 CFLAGS+=-DCONFIG_OSVBLK
 else
+# in-memory devices: the image is loaded into (huge page) memory (RAMBLK)
+# or mapped from the file (MMAPBLK), the chunk cache aliases device memory
+ifeq ($(CONFIG_RAMBLK),y)
+APPFILES+=target/$(TARGET)/blkdev/mem-blk.c
+CFLAGS+=-DCONFIG_RAMBLK
+else
+ifeq ($(CONFIG_MMAPBLK),y)
+APPFILES+=target/$(TARGET)/blkdev/mem-blk.c
+CFLAGS+=-DCONFIG_MMAPBLK
+else
 APPFILES+=target/$(TARGET)/blkdev/paio-blk.c
 LDFLAGS+=-lrt
 endif
+endif
+endif
+
+# main loop: epoll-based with adaptive busy-polling (otherwise: pure busy-polling)
+ifeq ($(CONFIG_EVLOOP),y)
+# time without any activity until the loop goes to sleep
+CONFIG_EVLOOP_BUSYPOLL_US ?= 50
+APPFILES+=target/$(TARGET)/evloop.c
+CFLAGS+=-DCONFIG_EVLOOP
+CFLAGS+=-DCONFIG_EVLOOP_BUSYPOLL_US=$(CONFIG_EVLOOP_BUSYPOLL_US)
+endif
+
+# shell access without threads
+ifeq ($(CONFIG_CTLSOCK),y)
+CONFIG_CTLSOCK_PATH ?= /tmp/minicache.sock
+APPFILES+=target/$(TARGET)/ctlsock.c
+CFLAGS+=-DCONFIG_CTLSOCK
+CFLAGS+=-DCONFIG_CTLSOCK_PATH=\"$(CONFIG_CTLSOCK_PATH)\"
+endif
 
 # APPFILES: Applications.
 APPDIRS+=:.:target/$(TARGET)
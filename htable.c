@@ -67,6 +67,9 @@
        __typeof__ (b) __b = (b); \
        __a > __b ? __a : __b; })
 #endif
+#ifndef POWER_OF_2
+  #define POWER_OF_2(x)   ((0 != x) && (0 == (x & (x-1))))
+#endif
 
 static inline size_t align_up(size_t size, size_t align)
 {
@@ -113,10 +116,12 @@ struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen,
 	printf("htable (%lu B) @ %p\n", ht_size);
 #endif
 	ht->nb_bkts = nb_bkts;
+	ht->bkt_mask = POWER_OF_2(nb_bkts) ? (nb_bkts - 1) : HTABLE_BKT_NOMASK;
 	ht->el_per_bkt = el_per_bkt;
 	ht->hlen = hlen;
 	ht->head = NULL;
 	ht->tail = NULL;
+	ht->idx = NULL;
 
 	/* allocate buckets */
 	for (i = 0; i < nb_bkts; ++i) {
@@ -164,6 +169,9 @@ void free_htable(struct htable *ht)
 {
 	uint32_t i;
 
+#ifdef HTABLE_IDX
+	htable_idx_detach(ht);
+#endif
 	for (i = 0; i < ht->nb_bkts; ++i) {
 		if (ht->b[i]) {
 			target_free(ht->b[i]);
@@ -171,3 +179,220 @@ void free_htable(struct htable *ht)
 	}
 	target_free(ht);
 }
+
+#ifdef HTABLE_IDX
+static inline uint32_t _htable_idx_rand(struct htable_idx *idx)
+{
+	/* xorshift32 */
+	idx->rnd ^= idx->rnd << 13;
+	idx->rnd ^= idx->rnd >> 17;
+	idx->rnd ^= idx->rnd << 5;
+	return idx->rnd;
+}
+
+static inline int _htable_idx_bkt_put(struct htable_idx_bkt *b, uint16_t tag, struct htable_el *el)
+{
+	register uint32_t i;
+
+	for (i = 0; i < HTABLE_IDX_BKT_SLOTS; ++i) {
+		if (b->tag[i] == 0) {
+			b->tag[i] = tag;
+			b->el[i] = el;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Inserts an element reference into the index
+ *  Returns -1 if the element could not be placed within HTABLE_IDX_MAX_KICKS
+ *  displacements. In this case *el_out returns the element reference that
+ *  was kicked out last and that is not part of the index anymore
+ */
+static int _htable_idx_insert(struct htable_idx *idx, uint8_t hlen,
+			      struct htable_el *el, struct htable_el **el_out)
+{
+	struct htable_el *el_victim;
+	uint16_t tag, tag_victim;
+	uint64_t x;
+	uint32_t i, s, n;
+
+	x   = _htable_idx_hash(*el->h, hlen);
+	tag = _htable_idx_tag(x);
+	i   = _htable_idx_bkt_no(x, idx->mask);
+	if (_htable_idx_bkt_put(&idx->bkt[i], tag, el) == 0)
+		goto out;
+	i   = _htable_idx_alt_bkt_no(i, tag, idx->mask);
+	if (_htable_idx_bkt_put(&idx->bkt[i], tag, el) == 0)
+		goto out;
+
+	/* both buckets are full: displace random victims */
+	for (n = 0; n < HTABLE_IDX_MAX_KICKS; ++n) {
+		s = _htable_idx_rand(idx) % HTABLE_IDX_BKT_SLOTS;
+		tag_victim = idx->bkt[i].tag[s];
+		el_victim  = idx->bkt[i].el[s];
+		idx->bkt[i].tag[s] = tag;
+		idx->bkt[i].el[s]  = el;
+
+		tag = tag_victim;
+		el  = el_victim;
+		i   = _htable_idx_alt_bkt_no(i, tag, idx->mask);
+		if (_htable_idx_bkt_put(&idx->bkt[i], tag, el) == 0)
+			goto out;
+	}
+	*el_out = el;
+	return -1;
+
+ out:
+	++idx->nb_els;
+	return 0;
+}
+
+static struct htable_idx *_htable_idx_alloc(uint32_t nb_bkts)
+{
+	struct htable_idx *idx;
+
+	idx = target_malloc(MIN_ALIGN, sizeof(*idx));
+	if (!idx) {
+		errno = ENOMEM;
+		goto err_out;
+	}
+	/* target_malloc() does not guarantee the alignment on all targets:
+	 * align index buckets to cache lines by ourselves */
+	idx->bkt_area = target_malloc(HTABLE_IDX_BKT_ALIGN,
+				      sizeof(struct htable_idx_bkt) * nb_bkts + HTABLE_IDX_BKT_ALIGN);
+	if (!idx->bkt_area) {
+		errno = ENOMEM;
+		goto err_free_idx;
+	}
+	idx->bkt = (struct htable_idx_bkt *) align_up((uintptr_t) idx->bkt_area, HTABLE_IDX_BKT_ALIGN);
+	memset(idx->bkt, 0, sizeof(struct htable_idx_bkt) * nb_bkts);
+	idx->nb_bkts = nb_bkts;
+	idx->mask    = nb_bkts - 1;
+	idx->nb_els  = 0;
+	idx->rnd     = 0x9E3779B9;
+	return idx;
+
+ err_free_idx:
+	target_free(idx);
+ err_out:
+	return NULL;
+}
+
+static void _htable_idx_free(struct htable_idx *idx)
+{
+	target_free(idx->bkt_area);
+	target_free(idx);
+}
+
+/*
+ * (Re-)builds the index from the element list of the table,
+ * the number of index buckets is doubled until all elements fit
+ */
+static struct htable_idx *_htable_idx_build(struct htable *ht, uint32_t nb_bkts)
+{
+	struct htable_idx *idx;
+	struct htable_el *el, *el_out;
+
+	for (; nb_bkts != 0; nb_bkts <<= 1) {
+		idx = _htable_idx_alloc(nb_bkts);
+		if (!idx)
+			return NULL;
+		foreach_htable_el(ht, el) {
+			if (_htable_idx_insert(idx, ht->hlen, el, &el_out) < 0)
+				goto retry;
+		}
+		return idx;
+
+	retry:
+#ifdef HTABLE_DEBUG
+		printf("htable index with %u buckets is too small, retrying...\n", nb_bkts);
+#endif
+		_htable_idx_free(idx);
+	}
+	errno = ENOSPC;
+	return NULL;
+}
+
+int htable_idx_attach(struct htable *ht)
+{
+	uint64_t nb_els;
+	uint32_t nb_bkts;
+
+	htable_idx_detach(ht);
+
+	/* size the index for a fill level of at most ~90%
+	 * when the table is completely filled */
+	nb_els = (uint64_t) ht->nb_bkts * (uint64_t) ht->el_per_bkt;
+	nb_els = (nb_els * 10 + 8) / 9;
+	for (nb_bkts = 1;
+	     (uint64_t) nb_bkts * HTABLE_IDX_BKT_SLOTS < nb_els && nb_bkts < (1u << 31);
+	     nb_bkts <<= 1);
+
+	ht->idx = _htable_idx_build(ht, nb_bkts);
+	if (!ht->idx)
+		return -errno;
+
+#ifdef HTABLE_DEBUG
+	printf("htable index: %lu elements in %u buckets (%lu B)\n",
+	       (unsigned long) ht->idx->nb_els, ht->idx->nb_bkts,
+	       sizeof(struct htable_idx_bkt) * ht->idx->nb_bkts);
+#endif
+	return 0;
+}
+
+void htable_idx_detach(struct htable *ht)
+{
+	if (ht->idx) {
+		_htable_idx_free(ht->idx);
+		ht->idx = NULL;
+	}
+}
+
+void _htable_idx_add(struct htable *ht, struct htable_el *el)
+{
+	struct htable_idx *idx;
+	struct htable_el *el_out;
+
+	if (likely(_htable_idx_insert(ht->idx, ht->hlen, el, &el_out) == 0))
+		return;
+
+	/* index is overloaded: rebuild it with twice the size
+	 * (el is already linked to the element list) */
+	idx = _htable_idx_build(ht, ht->idx->nb_bkts << 1);
+	_htable_idx_free(ht->idx);
+	ht->idx = idx; /* on failure, the table falls back to bucket scans */
+}
+
+void _htable_idx_rm(struct htable *ht, struct htable_el *el)
+{
+	struct htable_idx *idx = ht->idx;
+	uint16_t tag;
+	uint64_t x;
+	uint32_t i, s;
+
+	x   = _htable_idx_hash(*el->h, ht->hlen);
+	tag = _htable_idx_tag(x);
+	i   = _htable_idx_bkt_no(x, idx->mask);
+	for (s = 0; s < HTABLE_IDX_BKT_SLOTS; ++s)
+		if (idx->bkt[i].el[s] == el && idx->bkt[i].tag[s] == tag)
+			goto found;
+	i   = _htable_idx_alt_bkt_no(i, tag, idx->mask);
+	for (s = 0; s < HTABLE_IDX_BKT_SLOTS; ++s)
+		if (idx->bkt[i].el[s] == el && idx->bkt[i].tag[s] == tag)
+			goto found;
+	return; /* not indexed */
+
+ found:
+	idx->bkt[i].tag[s] = 0;
+	idx->bkt[i].el[s]  = NULL;
+	--idx->nb_els;
+}
+
+void _htable_idx_clear(struct htable *ht)
+{
+	memset(ht->idx->bkt, 0, sizeof(struct htable_idx_bkt) * ht->idx->nb_bkts);
+	ht->idx->nb_els = 0;
+}
+#endif /* HTABLE_IDX */
@@ -47,6 +47,13 @@ extern int shfs_errno;
 
 #include "hash.h"
 
+#ifndef __KERNEL__
+#define HTABLE_IDX /* cuckoo index support */
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+#endif
+
 /*
  * HASH TABLE ELEMENT: MEMORY LAYOUT
  *
@@ -108,6 +115,48 @@ struct htable_bkt {
 #define _htable_bkt_el(b, i) ((struct htable_el *) ((uint8_t *) (b)->el + ((b)->el_size * (i))))
 
 
+/*
+ * CUCKOO INDEX: MEMORY LAYOUT
+ *
+ *  bkt[0] ->+----------------------+\
+ *           | tag[0] ... tag[7]    | |  16-bit tags, 0 = empty slot
+ *           +----------------------+  > one cache line
+ *           | el[0]  ... el[5]     | |  references to table elements
+ *  bkt[1] ->+----------------------+/
+ *           |         ...          |
+ *           v                      v
+ *
+ * Tags and element references of a bucket share a single cache line.
+ * There are 8 tag lanes (one SSE2 vector) but only HTABLE_IDX_BKT_SLOTS
+ * of them are used, the remaining lanes stay 0 and never match.
+ *
+ * An index can optionally be attached to a hash table (htable_idx_attach()).
+ * It does not replace the bucket storage (element positions stay the same,
+ * e.g., for SHFS's on-disk layout) but speeds up lookups: An element is
+ * referenced from one of two candidate buckets (bucketized cuckoo hashing
+ * with partial-key displacement: the alternate bucket is derived from the
+ * current bucket and the tag), so that a lookup touches at most two
+ * buckets, regardless of the fill level of the table buckets.
+ */
+#define HTABLE_IDX_BKT_ALIGN 64
+#define HTABLE_IDX_BKT_LANES 8
+#define HTABLE_IDX_BKT_SLOTS 6
+#define HTABLE_IDX_MAX_KICKS 512
+
+struct htable_idx_bkt {
+	uint16_t tag[HTABLE_IDX_BKT_LANES];
+	struct htable_el *el[HTABLE_IDX_BKT_SLOTS];
+} __attribute__((aligned(HTABLE_IDX_BKT_ALIGN)));
+
+struct htable_idx {
+	uint32_t nb_bkts; /* power of 2 */
+	uint32_t mask;
+	uint64_t nb_els;
+	uint32_t rnd; /* random state for displacements */
+	struct htable_idx_bkt *bkt; /* aligned to HTABLE_IDX_BKT_ALIGN */
+	void *bkt_area; /* allocation of bkt */
+};
+
 /*
  * HASH TABLE: MEMORY LAYOUT
  *
@@ -125,19 +174,26 @@ struct htable_bkt {
  */
 struct htable {
 	uint32_t nb_bkts; /* number of buckets */
+	uint32_t bkt_mask; /* nb_bkts - 1 if nb_bkts is a power of 2 */
 	uint32_t el_per_bkt; /* elements per bucket (bucket size) */
 	uint8_t hlen; /* length of hash value */
 
 	struct htable_el *head;
 	struct htable_el *tail;
 
+	struct htable_idx *idx; /* optional lookup index (NULL if not attached) */
+
 	struct htable_bkt *b[0];
 };
 
 /*
- * Retrieve bucket number from hash value
+ * Retrieve bucket key from hash value
+ *
+ * Note: For hash lengths >= 4 bytes, only the first 4 bytes are
+ *  considered (h64 is 32 bits wide). This has to be kept as it is
+ *  because it defines the placement of entries on existing volumes.
  */
-static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint32_t nb_bkts)
+static inline uint32_t _htable_bkt_key(const hash512_t h, uint8_t hlen)
 {
 	register uint16_t h16;
 	register uint32_t h32;
@@ -147,36 +203,60 @@ static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint3
 	case 0:
 		return 0;
 	case 1:
-		return (h[0] % nb_bkts); /* 1 byte */
+		return h[0]; /* 1 byte */
 	case 2:
 		h16 = *((uint16_t *) &h[0]);
-		return (h16 % nb_bkts); /* 2 bytes */
+		return h16; /* 2 bytes */
 	case 3:
 		h32 = *((uint32_t *) &h[0]);
 		h32 &= 0x00FFFFFF;
-		return (h32 % nb_bkts); /* 3 bytes */
+		return h32; /* 3 bytes */
 	case 4:
 		h32 = *((uint32_t *) &h[0]);
-		return (h32 % nb_bkts); /* 4 bytes */
+		return h32; /* 4 bytes */
 	case 5:
 		h64 = *((uint64_t *) &h[0]);
 		h64 &= 0x000000FFFFFFFFFF;
-		return (h64 % nb_bkts); /* 5 bytes */
+		return h64; /* 5 bytes */
 	case 6:
 		h64 = *((uint64_t *) &h[0]);
 		h64 &= 0x0000FFFFFFFFFFFF;
-		return (h64 % nb_bkts); /* 6 bytes */
+		return h64; /* 6 bytes */
 	case 7:
 		h64 = *((uint64_t *) &h[0]);
 		h64 &= 0x00FFFFFFFFFFFFFF;
-		return (h64 % nb_bkts); /* 7 bytes */
+		return h64; /* 7 bytes */
 	default:
 		break;
 	}
 
 	/* just take 8 bytes from hash */
 	h64 = *((uint64_t *) &h[0]);
-	return (h64 % nb_bkts); /* 8 bytes */
+	return h64; /* 8 bytes */
+}
+
+/*
+ * Retrieve bucket number from hash value
+ */
+static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint32_t nb_bkts)
+{
+	return (_htable_bkt_key(h, hlen) % nb_bkts);
+}
+
+/*
+ * Retrieve bucket number of a table from hash value:
+ *  avoids the division when the number of buckets is a power of 2
+ *  (same result as _htable_bkt_no())
+ */
+#define HTABLE_BKT_NOMASK ((uint32_t) -1)
+
+static inline unsigned int _htable_bkt_idx(const struct htable *ht, const hash512_t h)
+{
+	register uint32_t key = _htable_bkt_key(h, ht->hlen);
+
+	if (likely(ht->bkt_mask != HTABLE_BKT_NOMASK))
+		return (key & ht->bkt_mask);
+	return (key % ht->nb_bkts);
 }
 
 /*
@@ -185,6 +265,124 @@ static inline unsigned int _htable_bkt_no(const hash512_t h, uint8_t hlen, uint3
 struct htable *alloc_htable(uint32_t nb_bkts, uint32_t el_per_bkt, uint8_t hlen, size_t el_private_len, size_t align);
 void free_htable(struct htable *ht);
 
+#ifdef HTABLE_IDX
+/*
+ * Folds a hash digest into 64 bits and mixes it (digests might be short)
+ */
+static inline uint64_t _htable_idx_hash(const hash512_t h, uint8_t hlen)
+{
+	uint64_t x = 0, y = 0;
+
+	memcpy(&x, &h[0], hlen < 8 ? hlen : 8);
+	if (hlen > 8) {
+		memcpy(&y, &h[8], hlen < 16 ? hlen - 8 : 8);
+		x ^= (y << 31) | (y >> 33);
+	}
+
+	/* murmur3 finalizer */
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static inline uint16_t _htable_idx_tag(uint64_t x)
+{
+	uint16_t tag = (uint16_t) (x >> 48);
+
+	return tag ? tag : 1; /* 0 marks an empty slot */
+}
+
+#define _htable_idx_bkt_no(x, mask) \
+	((uint32_t) (x) & (mask))
+/* alternate bucket: alt(alt(i)) = i */
+#define _htable_idx_alt_bkt_no(i, tag, mask) \
+	(((i) ^ ((uint32_t) (tag) * 0x5bd1e995)) & (mask))
+
+/*
+ * Returns a bitmask of slots that hold tag
+ *  (two bits per slot, slot = bit position / 2)
+ */
+static inline uint32_t _htable_idx_match(const struct htable_idx_bkt *b, uint16_t tag)
+{
+#if defined __SSE2__
+	__m128i vtag = _mm_set1_epi16((short) tag);
+	__m128i vbkt = _mm_load_si128((const __m128i *) b->tag);
+
+	return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi16(vbkt, vtag));
+#else
+	register uint32_t i, m = 0;
+
+	for (i = 0; i < HTABLE_IDX_BKT_SLOTS; ++i)
+		if (b->tag[i] == tag)
+			m |= (3u << (i << 1));
+	return m;
+#endif
+}
+
+static inline struct htable_el *_htable_idx_lookup_bkt(const struct htable_idx_bkt *b, uint16_t tag,
+						       const hash512_t h, uint8_t hlen)
+{
+	register uint32_t m, i;
+	struct htable_el *el;
+
+	m = _htable_idx_match(b, tag);
+	while (m) {
+		i = ((uint32_t) __builtin_ctz(m)) >> 1;
+		el = b->el[i];
+		if (hash_compare(*el->h, h, hlen) == 0)
+			return el;
+		m &= ~(3u << (i << 1));
+	}
+	return NULL;
+}
+
+static inline struct htable_el *_htable_idx_lookup(const struct htable_idx *idx, const hash512_t h, uint8_t hlen)
+{
+	register uint64_t x;
+	register uint32_t i;
+	register uint16_t tag;
+	struct htable_el *el;
+
+	x   = _htable_idx_hash(h, hlen);
+	tag = _htable_idx_tag(x);
+	i   = _htable_idx_bkt_no(x, idx->mask);
+	el  = _htable_idx_lookup_bkt(&idx->bkt[i], tag, h, hlen);
+	if (el)
+		return el;
+	i   = _htable_idx_alt_bkt_no(i, tag, idx->mask);
+	return _htable_idx_lookup_bkt(&idx->bkt[i], tag, h, hlen);
+}
+
+/*
+ * Builds and attaches a lookup index to a hash table
+ *  Returns 0 on success, a negative error code on failure
+ *  (the table stays usable without an index)
+ */
+int htable_idx_attach(struct htable *ht);
+void htable_idx_detach(struct htable *ht);
+
+/* internal index maintenance, called on element changes */
+void _htable_idx_add(struct htable *ht, struct htable_el *el);
+void _htable_idx_rm(struct htable *ht, struct htable_el *el);
+void _htable_idx_clear(struct htable *ht);
+#define htable_idx_add(ht, el) \
+	do { if ((ht)->idx) _htable_idx_add((ht), (el)); } while (0)
+#define htable_idx_rm(ht, el) \
+	do { if ((ht)->idx) _htable_idx_rm((ht), (el)); } while (0)
+#define htable_idx_clear(ht) \
+	do { if ((ht)->idx) _htable_idx_clear((ht)); } while (0)
+#else /* HTABLE_IDX */
+#define htable_idx_add(ht, el) \
+	do {} while (0)
+#define htable_idx_rm(ht, el) \
+	do {} while (0)
+#define htable_idx_clear(ht) \
+	do {} while (0)
+#endif /* HTABLE_IDX */
+
 /*
  * Picks an element by its total index
  *  Returns NULL if element does not exist
@@ -222,25 +420,122 @@ static inline struct htable_el *htable_lookup(struct htable *ht, const hash512_t
 	register uint32_t i;
 	register uint32_t bkt_idx;
 	struct htable_bkt *b;
+#ifdef HTABLE_IDX
+	struct htable_el *el;
+#endif
 
 	if (unlikely(hash_is_zero(h, ht->hlen))) {
 		errno = EINVAL;
 		goto err_out;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+#ifdef HTABLE_IDX
+	if (ht->idx) {
+		el = _htable_idx_lookup(ht->idx, h, ht->hlen);
+		if (el)
+			return el;
+		goto err_noent;
+	}
+#endif
+
+	bkt_idx = _htable_bkt_idx(ht, h);
 	b = ht->b[bkt_idx];
 	for (i = 0; i < ht->el_per_bkt; ++i) {
 		if (hash_compare(b->h[i], h, ht->hlen) == 0)
 			return _htable_bkt_el(b, i);
 	}
 
+#ifdef HTABLE_IDX
+ err_noent:
+#endif
 	/* no entry found */
 	errno = ENOENT;
  err_out:
 	return NULL;
 }
 
+#define HTABLE_LOOKUP_AHEAD 8 /* lookups in flight of htable_lookup_multiple() */
+#define htable_prefetch(addr) __builtin_prefetch((addr), 0, 3)
+
+/*
+ * Does a lookup for multiple elements by their hash values
+ *  el_out[i] is set to the element of h[i] or to NULL if it does not exist
+ *  Returns the number of found elements
+ *
+ * Lookups are processed in groups of HTABLE_LOOKUP_AHEAD: the buckets
+ * of all lookups of a group are prefetched first so that their memory
+ * accesses overlap instead of being serialized by the comparisons.
+ */
+static inline unsigned int htable_lookup_multiple(struct htable *ht, const hash512_t *h,
+						  struct htable_el **el_out, unsigned int count)
+{
+	register unsigned int i, j, n, found = 0;
+	uint32_t bkt_idx[HTABLE_LOOKUP_AHEAD];
+#ifdef HTABLE_IDX
+	uint32_t alt_idx[HTABLE_LOOKUP_AHEAD];
+	uint16_t tag[HTABLE_LOOKUP_AHEAD];
+	struct htable_idx *idx = ht->idx;
+	uint64_t x;
+#endif
+
+	for (i = 0; i < count; i += n) {
+		n = (count - i) < HTABLE_LOOKUP_AHEAD ? (count - i) : HTABLE_LOOKUP_AHEAD;
+
+#ifdef HTABLE_IDX
+		if (idx) {
+			/* stage 1: compute bucket positions, prefetch both candidate buckets */
+			for (j = 0; j < n; ++j) {
+				x = _htable_idx_hash(h[i + j], ht->hlen);
+				tag[j] = _htable_idx_tag(x);
+				bkt_idx[j] = _htable_idx_bkt_no(x, idx->mask);
+				alt_idx[j] = _htable_idx_alt_bkt_no(bkt_idx[j], tag[j], idx->mask);
+				htable_prefetch(&idx->bkt[bkt_idx[j]]);
+				htable_prefetch(&idx->bkt[alt_idx[j]]);
+			}
+			/* stage 2: compare tags and hash values */
+			for (j = 0; j < n; ++j) {
+				if (unlikely(hash_is_zero(h[i + j], ht->hlen))) {
+					el_out[i + j] = NULL;
+					continue;
+				}
+				el_out[i + j] = _htable_idx_lookup_bkt(&idx->bkt[bkt_idx[j]], tag[j],
+								       h[i + j], ht->hlen);
+				if (!el_out[i + j])
+					el_out[i + j] = _htable_idx_lookup_bkt(&idx->bkt[alt_idx[j]], tag[j],
+									       h[i + j], ht->hlen);
+				if (el_out[i + j])
+					++found;
+			}
+			continue;
+		}
+#endif
+
+		/* stage 1: compute bucket numbers, prefetch bucket hash lists */
+		for (j = 0; j < n; ++j) {
+			bkt_idx[j] = _htable_bkt_idx(ht, h[i + j]);
+			htable_prefetch(ht->b[bkt_idx[j]]->h);
+		}
+		/* stage 2: scan buckets */
+		for (j = 0; j < n; ++j) {
+			register uint32_t e;
+			struct htable_bkt *b = ht->b[bkt_idx[j]];
+
+			el_out[i + j] = NULL;
+			if (unlikely(hash_is_zero(h[i + j], ht->hlen)))
+				continue;
+			for (e = 0; e < ht->el_per_bkt; ++e) {
+				if (hash_compare(b->h[e], h[i + j], ht->hlen) == 0) {
+					el_out[i + j] = _htable_bkt_el(b, e);
+					++found;
+					break;
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
 /*
  * Tries to add an element for a given hash value
  *  and returns it on success (NULL on failure (e.g., bucket is full))
@@ -259,7 +554,7 @@ static inline struct htable_el *htable_add(struct htable *ht, const hash512_t h)
 		goto err_out;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+	bkt_idx = _htable_bkt_idx(ht, h);
 	b = ht->b[bkt_idx];
 	for (i = 0; i < ht->el_per_bkt; ++i) {
 		/* TODO: Check for already existence (preserve unique entries) */
@@ -279,6 +574,7 @@ static inline struct htable_el *htable_add(struct htable *ht, const hash512_t h)
 			el->next = NULL;
 			ht->tail = el;
 
+			htable_idx_add(ht, el);
 			return el;
 		}
 	}
@@ -312,7 +608,7 @@ static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash5
 		return NULL;
 	}
 
-	bkt_idx = _htable_bkt_no(h, ht->hlen, ht->nb_bkts);
+	bkt_idx = _htable_bkt_idx(ht, h);
 	b = ht->b[bkt_idx];
 	for (i = 0; i < ht->el_per_bkt; ++i) {
 		if (hash_compare(b->h[i], h, ht->hlen) == 0) {
@@ -347,6 +643,7 @@ static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash5
 	el->next = NULL;
 	ht->tail = el;
 
+	htable_idx_add(ht, el);
 	if (is_new)
 		*is_new = 1;
 	return el;
@@ -360,6 +657,8 @@ static inline struct htable_el *htable_lookup_add(struct htable *ht, const hash5
  */
 static inline void htable_rm(struct htable *ht, struct htable_el *el)
 {
+	htable_idx_rm(ht, el);
+
 	/* update linked list of elements */
 	if (el->prev)
 		el->prev->next = el->next;
@@ -391,6 +690,7 @@ static inline void htable_clear(struct htable *ht)
 {
 	struct htable_el *el;
 
+	htable_idx_clear(ht);
 	foreach_htable_el(ht, el)
 		hash_clear(*el->h, ht->hlen);
 	ht->head = NULL;
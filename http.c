@@ -42,7 +42,11 @@
 #include "http_data.h"
 #include "http_fio.h"
 #include "http_link.h"
+#include "http_pace.h"
 #include "http.h"
+#ifdef HTTP_FASTPARSE
+#include "http_fastparse.h"
+#endif
 
 struct http_srv *hs = NULL;
 
@@ -55,6 +59,9 @@ static err_t httpsess_poll   (void *argp, struct tcp_pcb *tpcb);
 static err_t httpsess_acknowledge(struct http_sess *hsess, size_t len);
 static int httprecv_req_complete(struct http_parser *parser);
 static int httprecv_hdr_url(struct http_parser *parser, const char *buf, size_t len);
+#ifdef HTTP_FASTPARSE
+static size_t httprecv_fastparse(struct http_sess *hsess, const char *buf, size_t len);
+#endif
 
 static http_parser_settings _http_parser_settings = {
 	.on_message_begin = NULL,
@@ -67,10 +74,28 @@ static http_parser_settings _http_parser_settings = {
 	.on_message_complete = httprecv_req_complete
 };
 
-int init_http(uint16_t nb_sess, uint32_t nb_reqs)
+/* session/request pools could not grow: take memory from the chunk cache */
+static void _http_pool_reclaim(size_t len, void *unused)
+{
+#ifdef SHFS_CACHE_GROW
+	size_t released;
+
+	if (!shfs_mounted)
+		return;
+	released = shfs_cache_reclaim(len);
+	printd("Reclaimed %"PRIu64" B of chunk cache memory for connections\n",
+	       (uint64_t) released);
+#endif
+}
+
+int init_http(uint16_t nb_sess, uint32_t nb_reqs,
+              unsigned int link_timeshift, int link_tsjoin)
 {
 	err_t err;
 	int ret = 0;
+#ifdef HTTP_PACING
+	unsigned int i;
+#endif
 
 	hs = target_malloc(CACHELINE_SIZE, sizeof(*hs));
 	if (!hs) {
@@ -81,16 +106,24 @@ int init_http(uint16_t nb_sess, uint32_t nb_reqs)
 	hs->nb_sess = 0;
 	hs->max_nb_reqs = nb_reqs;
 	hs->nb_reqs = 0;
+	hs->link_timeshift = link_timeshift;
+	hs->link_tsjoin = link_tsjoin;
 
 	/* allocate session pool */
-	hs->sess_pool = alloc_simple_mempool(hs->max_nb_sess, sizeof(struct http_sess));
+	hs->sess_pool = alloc_slabmempool(min((uint32_t) hs->max_nb_sess, HTTP_POOL_SLAB_LEN),
+	                                  hs->max_nb_sess, HTTP_POOL_SLAB_LEN,
+	                                  sizeof(struct http_sess), 0,
+	                                  _http_pool_reclaim, NULL);
 	if (!hs->sess_pool) {
 		ret = -ENOMEM;
 		goto err_free_hs;
 	}
 
 	/* allocate request pool */
-	hs->req_pool = alloc_simple_mempool(hs->max_nb_reqs, sizeof(struct http_req));
+	hs->req_pool = alloc_slabmempool(min(hs->max_nb_reqs, HTTP_POOL_SLAB_LEN),
+	                                 hs->max_nb_reqs, HTTP_POOL_SLAB_LEN,
+	                                 sizeof(struct http_req), 0,
+	                                 _http_pool_reclaim, NULL);
 	if (!hs->req_pool) {
 		ret = -ENOMEM;
 		goto err_free_sesspool;
@@ -122,10 +155,27 @@ int init_http(uint16_t nb_sess, uint32_t nb_reqs)
 
 	/* wait for I/O retry list */
 	dlist_init_head(hs->ioretry_chain);
+	hs->ioretry_policy = HTTP_IORETRY_DEFAULT_POLICY;
+	hs->ioretry_nb_regs = 0;
+	memset(hs->ioretry_stats, 0, sizeof(hs->ioretry_stats));
+
+#ifdef HTTP_PACING
+	/* pacing timer wheel */
+	for (i = 0; i < HTTP_PACE_WHEEL_LEN; ++i)
+		dlist_init_head(hs->pace_wheel[i]);
+	hs->pace_rate = HTTP_PACE_DEFAULT_RATE;
+	hs->pace_tick = _http_pace_tick(target_now_ns());
+	hs->pace_nb_deferred = 0;
+	memset(&hs->pace_stats, 0, sizeof(hs->pace_stats));
+#endif
 
 	printd("HTTP server %p initialized\n", hs);
 #if defined HAVE_SHELL && defined HTTP_INFO
 	shell_register_cmd("http-info", shcmd_http_info);
+	shell_register_cmd("http-ioretry", shcmd_http_ioretry);
+#ifdef HTTP_PACING
+	shell_register_cmd("http-pacing", shcmd_http_pacing);
+#endif
 #endif
 	return 0;
 
@@ -134,9 +184,9 @@ int init_http(uint16_t nb_sess, uint32_t nb_reqs)
  err_exit_link:
 	httplink_exit(hs);
  err_free_reqpool:
-	free_mempool(hs->req_pool);
+	free_slabmempool(hs->req_pool);
  err_free_sesspool:
-	free_mempool(hs->sess_pool);
+	free_slabmempool(hs->sess_pool);
  err_free_hs:
 	target_free(hs);
  err_out:
@@ -155,8 +205,8 @@ void exit_http(void)
 
 	tcp_close(hs->tpcb);
 	httplink_exit(hs);
-	free_mempool(hs->req_pool);
-	free_mempool(hs->sess_pool);
+	free_slabmempool(hs->req_pool);
+	free_slabmempool(hs->sess_pool);
 	target_free(hs);
 	hs = NULL;
 }
@@ -173,33 +223,146 @@ void exit_http(void)
 		(hsess)->keepalive_timer = -1; \
 	} while(0)
 
+/* returns the ordering key of a waiting session, lower is served first */
+static inline uint64_t _httpsess_ioretry_key(struct http_sess *hsess)
+{
+	struct http_req *hreq = hsess->rqueue_head;
+	int msg = (hreq && hreq->state == HRS_RESPONDING_MSG);
+
+	if (unlikely(!hreq))
+		return 0;
+	switch (hs->ioretry_policy) {
+	case HIRP_SRPT:
+		if (hreq->is_stream)
+			return UINT64_MAX;
+		return hreq->rlen - (msg ? hsess->sent : 0);
+	case HIRP_FBP:
+		return (!msg || hsess->sent == 0) ? 0 : 1;
+	default:
+		return 0; /* FIFO */
+	}
+}
+
+static inline struct http_sess *_httpsess_ioretry_next(void)
+{
+	struct http_sess *hsess, *best;
+	uint64_t key, best_key;
+
+	best = dlist_first_el(hs->ioretry_chain, struct http_sess);
+	if (!best || hs->ioretry_policy == HIRP_FIFO)
+		return best;
+
+	best_key = _httpsess_ioretry_key(best);
+	dlist_foreach(hsess, hs->ioretry_chain, ioretry_chain) {
+		key = _httpsess_ioretry_key(hsess);
+		if (key < best_key) { /* ties: earlier registration wins */
+			best = hsess;
+			best_key = key;
+		}
+	}
+	return best;
+}
+
 /* gets called whenever it is worth
- * to retry an failed file I/O operation (with EAGAIN) */
+ * to retry an failed file I/O operation (with EAGAIN)
+ * Sessions are served one by one in the order of the retry policy.
+ * As soon as a session has to wait again, the round is stopped: freed
+ * buffers are handed to the sessions in front instead of letting all
+ * waiting sessions compete for them */
 void http_poll_ioretry(void) {
 	struct http_sess *hsess;
-	struct http_sess *hsess_next;
+	uint64_t nb_regs;
+	uint64_t ts, wait;
 
 	if (unlikely(!hs))
 		return; /* no active http server */
 
-	hsess = dlist_first_el(hs->ioretry_chain, struct http_sess);
-	/* clear head so that a new list is created
-	 * This avoids the the case that within a callback the elements gets
-	 * appanded to the list over an over again */
-	dlist_init_head(hs->ioretry_chain);
-	while (hsess) {
-		hsess_next = dlist_next_el(hsess, ioretry_chain);
-
-		/* "unlink" this element from the list because
-		 * the head is released already -> we need to do a list cleanup */
-		hsess->ioretry_chain.next = NULL;
-		hsess->ioretry_chain.prev = NULL;
+	while ((hsess = _httpsess_ioretry_next()) != NULL) {
+		dlist_unlink(hsess, hs->ioretry_chain, ioretry_chain);
+		ts = hsess->ioretry_ts;
+		nb_regs = hs->ioretry_nb_regs;
 
 		printd("Retrying I/O on session %p\n", hsess);
-		httpsess_respond(hsess); /* can register itself to the new list */
+		httpsess_respond(hsess); /* can register itself again */
+
+		if (hs->ioretry_nb_regs != nb_regs) {
+			/* still no buffers: keep its position and waiting time */
+			dlist_relink_head(hsess, hs->ioretry_chain, ioretry_chain);
+			hsess->ioretry_ts = ts;
+			break;
+		}
+
+		/* note: hsess might be closed already */
+		wait = target_now_ns() - ts;
+		++hs->ioretry_stats[hs->ioretry_policy].nb;
+		hs->ioretry_stats[hs->ioretry_policy].wait_sum += wait;
+		if (wait > hs->ioretry_stats[hs->ioretry_policy].wait_max)
+			hs->ioretry_stats[hs->ioretry_policy].wait_max = wait;
+	}
+}
+
+#ifdef HTTP_PACING
+/* gets called by the main loop: resumes paced sessions
+ * whose timer on the wheel expired */
+void http_poll_pacing(void) {
+	struct http_sess *hsess, *next;
+	uint64_t now_tick, tick;
+
+	if (unlikely(!hs))
+		return; /* no active http server */
+
+	now_tick = _http_pace_tick(target_now_ns());
+	if (now_tick == hs->pace_tick)
+		return;
+
+	tick = hs->pace_tick + 1;
+	if (now_tick - tick >= HTTP_PACE_WHEEL_LEN)
+		tick = now_tick - HTTP_PACE_WHEEL_LEN + 1; /* visit each slot once */
+	hs->pace_tick = now_tick; /* sessions deferred from now on are scheduled
+	                             behind now_tick: never land in a slot that
+	                             is due in this round */
+
+	for (; tick <= now_tick; ++tick) {
+		for (hsess = dlist_first_el(_http_pace_head(tick), struct http_sess);
+		     hsess != NULL;
+		     hsess = next) {
+			next = dlist_next_el(hsess, pace.wheel);
+			if (hsess->pace.expiry > now_tick)
+				continue; /* due in a later turn of the wheel */
+
+			dlist_unlink(hsess, _http_pace_head(tick), pace.wheel);
+			--hs->pace_nb_deferred;
+			++hs->pace_stats.wakeups;
+			printd("Resuming paced session %p\n", hsess);
+			if (hsess->state == HSS_ESTABLISHED && hsess->rqueue_head)
+				httpsess_respond(hsess); /* can defer itself again */
+		}
+	}
+}
+
+uint64_t http_pacing_deadline(void) {
+	uint64_t tick;
+
+	if (unlikely(!hs) || !hs->pace_nb_deferred)
+		return 0;
 
-		hsess = hsess_next; /* next element */
+	/* sessions are parked at most one wheel turn ahead:
+	 * the first non-empty slot holds the next due session */
+	for (tick = hs->pace_tick + 1; tick < hs->pace_tick + HTTP_PACE_WHEEL_LEN; ++tick) {
+		if (!dlist_is_empty(_http_pace_head(tick)))
+			break;
 	}
+	return tick * HTTP_PACE_TICK_NS;
+}
+#endif
+
+int http_poll_busy(void) {
+	if (unlikely(!hs))
+		return 0; /* no active http server */
+
+	if (!dlist_is_empty(hs->ioretry_chain))
+		return 1;
+	return 0;
 }
 
 static inline struct http_req *httpreq_open(struct http_sess *hsess)
@@ -207,7 +370,7 @@ static inline struct http_req *httpreq_open(struct http_sess *hsess)
 	struct mempool_obj *hrobj;
 	struct http_req *hreq;
 
-	hrobj = mempool_pick(hsess->hsrv->req_pool);
+	hrobj = slabmempool_pick(hsess->hsrv->req_pool);
 	if (!hrobj)
 		return NULL;
 	hreq = hrobj->data;
@@ -230,8 +393,14 @@ static inline struct http_req *httpreq_open(struct http_sess *hsess)
 	hreq->rlen = 0;
 	hreq->alen = 0;
 	hreq->is_stream = 0;
+#ifdef HTTP_PACING
+	hreq->pace_rate = hsess->hsrv->pace_rate;
+#endif
 #if defined SHFS_STATS && defined SHFS_STATS_HTTP && defined SHFS_STATS_HTTP_DPC
 	hreq->stats.dpc_i = 0;
+#endif
+#ifdef TRACEPOINTS
+	hreq->tp.firstbyte = 0;
 #endif
 	++hsess->hsrv->nb_reqs;
 	return hreq;
@@ -262,19 +431,34 @@ static inline void httpreq_close(struct http_req *hreq)
 		}
 		shfs_fio_close(hreq->fd);
 	}
+	http_recvhdr_release(&hreq->request.hdr);
 	mempool_put(hreq->pobj);
 	--hsess->hsrv->nb_reqs;
 	printd("Request %p destroyed\n", hreq);
 }
 
+/* returns the unused parsing request object of a session to the pool */
+static inline void httpsess_release_cpreq(struct http_sess *hsess)
+{
+	struct http_req *hreq = hsess->cpreq;
+
+	http_recvhdr_release(&hreq->request.hdr);
+	mempool_put(hreq->pobj);
+	--hsess->hsrv->nb_reqs;
+	hsess->cpreq = NULL;
+	hsess->cpreq_lazy = 1;
+	hsess->parser.data = NULL;
+}
+
 static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 {
 	struct mempool_obj *hsobj;
 	struct http_sess *hsess;
+	tp_start(tp_ts);
 
 	if (err != ERR_OK)
 		goto err_out;
-	hsobj = mempool_pick(hs->sess_pool);
+	hsobj = slabmempool_pick(hs->sess_pool);
 	if (!hsobj) {
 		err = ERR_MEM;
 		goto err_out;
@@ -284,12 +468,11 @@ static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 	hsess->hsrv = hs;
 	hsess->sent_infly = 0;
 
-	/* setup request queue */
-	hsess->cpreq = httpreq_open(hsess);
-	if (!hsess->cpreq) {
-		err = ERR_MEM;
-		goto err_free_hsess;
-	}
+	/* setup request queue: the request object for parsing
+	 * is opened when the first data arrives */
+	hsess->cpreq = NULL;
+	hsess->cpreq_lazy = 1;
+	hsess->keepalive = 0;
 	hsess->rqueue_head = NULL;
 	hsess->rqueue_tail = NULL;
 	hsess->rqueue_len = 0;
@@ -314,7 +497,7 @@ static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 	hsess->tpcb->keep_cnt = 1;
 
 	/* init parser */
-	hsess->parser.data = (void *) &hsess->cpreq->request.hdr;
+	hsess->parser.data = NULL;
 	http_parser_init(&(hsess)->parser, HTTP_REQUEST);
 
 	/* reset HTTP keep alive */
@@ -332,16 +515,20 @@ static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 	hs->hsess_tail = hsess;
 
 	dlist_init_el(hsess, ioretry_chain);
+#ifdef HTTP_PACING
+	dlist_init_el(hsess, pace.wheel);
+	hsess->pace.rate = 0;
+	hsess->pace.expiry = 0;
+#endif
 
 	hsess->state = HSS_ESTABLISHED;
 	++hs->nb_sess;
 	printd("New HTTP session accepted on server %p "
 		"(currently, there are %"PRIu16"/%"PRIu16" open sessions)\n",
 		hs, hs->nb_sess, hs->max_nb_sess);
+	tp_end(TP_HTTP_ACCEPT, tp_ts);
 	return 0;
 
- err_free_hsess:
-	mempool_put(hsobj);
  err_out:
 	printd("Session establishment declined on server %p "
 		"(currently, there are %"PRIu16"/%"PRIu16" open sessions)\n",
@@ -351,7 +538,7 @@ static err_t httpsess_accept(void *argp, struct tcp_pcb *new_tpcb, err_t err)
 
 static err_t httpsess_close(struct http_sess *hsess, enum http_sess_close type)
 {
-	struct http_req *hreq;
+	struct http_req *hreq, *hreq_next;
 	err_t err;
 
 	ASSERT(hsess != NULL);
@@ -375,11 +562,20 @@ static err_t httpsess_close(struct http_sess *hsess, enum http_sess_close type)
 	if (dlist_is_linked(hsess, hs->ioretry_chain, ioretry_chain))
 		printd(" Session is linked to IORetry list, removing it\n");
 	httpsess_unregister_ioretry(hsess);
+#ifdef HTTP_PACING
+	httpsess_pace_cancel(hsess);
+#endif
 
-	for (hreq = hsess->aqueue_head; hreq != NULL; hreq = hreq->next)
+	/* the next pointer is read ahead: closing a request can
+	 * release the pool slab it is stored in */
+	for (hreq = hsess->aqueue_head; hreq != NULL; hreq = hreq_next) {
+		hreq_next = hreq->next;
 		httpreq_close(hreq);
-	for (hreq = hsess->rqueue_head; hreq != NULL; hreq = hreq->next)
+	}
+	for (hreq = hsess->rqueue_head; hreq != NULL; hreq = hreq_next) {
+		hreq_next = hreq->next;
 		httpreq_close(hreq);
+	}
 	if (hsess->cpreq)
 		httpreq_close(hsess->cpreq);
 
@@ -428,6 +624,9 @@ static err_t httpsess_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err
 	unsigned int prev_rqueue_len;
 	size_t plen;
 	err_t ret = ERR_OK;
+#ifdef TRACEPOINTS
+	tp_ts_t tp_ts;
+#endif
 
 	if (unlikely(!p || err != ERR_OK)) {
 		/* receive error: kill connection */
@@ -456,6 +655,18 @@ static err_t httpsess_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err
 		goto out;
 	}
 
+	if (!hsess->cpreq && hsess->cpreq_lazy && hsess->state == HSS_ESTABLISHED) {
+		/* session was idle: open request object for parsing */
+		hsess->cpreq = httpreq_open(hsess);
+		if (unlikely(!hsess->cpreq)) {
+			/* lwIP will pass the pbuf again later */
+			printd("Could not allocate a request object: Deferring data\n");
+			return ERR_MEM;
+		}
+		hsess->cpreq_lazy = 0;
+		hsess->parser.data = (void *) &hsess->cpreq->request.hdr;
+	}
+
 	cpreq = hsess->cpreq;
 	if (unlikely(!cpreq || hsess->state != HSS_ESTABLISHED)) {
 		/* We don't have an object allocated for parsing the requests or
@@ -479,9 +690,23 @@ static err_t httpsess_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err
 		/* feed parser */
 		prev_rqueue_len = hsess->rqueue_len;
 		httpsess_halt_keepalive(hsess);
+		tp_stamp(tp_ts);
 		for (q = p; q != NULL; q = q->next) {
+			if (unlikely(!hsess->cpreq))
+				break; /* last request was parsed, ignore remaining data */
+			http_recvhdr_setpbuf(&hsess->cpreq->request.hdr, q);
+#ifdef HTTP_FASTPARSE
+			plen = httprecv_fastparse(hsess, q->payload, q->len);
+			if (plen == q->len)
+				continue;
+			if (unlikely(!hsess->cpreq))
+				break;
+			plen += http_parser_execute(&hsess->parser, &_http_parser_settings,
+			                            (const char *) q->payload + plen, q->len - plen);
+#else
 			plen = http_parser_execute(&hsess->parser, &_http_parser_settings,
 			                           q->payload, q->len);
+#endif
 			if (unlikely(hsess->parser.upgrade)) {
 				/* protocol upgrade requested */
 				printd("Unsupported HTTP protocol upgrade requested: Dropping connection...\n");
@@ -496,6 +721,12 @@ static err_t httpsess_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err
 				goto out;
 			}
 		}
+		tp_end(TP_HTTP_PARSE, tp_ts);
+
+		/* no bytes of a next request were received: do not keep
+		 * the request object while the session is idle */
+		if (hsess->cpreq && http_parser_is_idle(&hsess->parser))
+			httpsess_release_cpreq(hsess);
 
 		printd("prev_rqueue_len == %u, hsess->rqueue_len = %u\n",
 		        prev_rqueue_len, hsess->rqueue_len);
@@ -686,6 +917,44 @@ static int httprecv_hdr_url(struct http_parser *parser, const char *buf, size_t
 	return 0;
 }
 
+#ifdef HTTP_FASTPARSE
+/*
+ * Feeds plain GET requests that are completely contained at the beginning
+ * of buf through the request callbacks without running http_parser.
+ * Returns the number of consumed bytes, the rest has to be passed to
+ * http_parser. This is only done while http_parser waits for a new message.
+ */
+static size_t httprecv_fastparse(struct http_sess *hsess, const char *buf, size_t len)
+{
+	struct http_parser *parser = &hsess->parser;
+	struct http_fastparse_req freq;
+	size_t rlen, consumed = 0;
+	unsigned int l;
+
+	while (hsess->cpreq && consumed < len && http_parser_is_idle(parser)) {
+		rlen = http_fastparse_req(buf + consumed, len - consumed, &freq);
+		if (!rlen)
+			break; /* fall back to http_parser */
+
+		parser->http_major = freq.http_major;
+		parser->http_minor = freq.http_minor;
+		parser->method = HTTP_GET;
+		parser->flags = freq.flags;
+		parser->content_length = 0;
+		parser->http_errno = HPE_OK;
+
+		httprecv_hdr_url(parser, freq.url, freq.url_len);
+		for (l = 0; l < freq.nb_lines; ++l) {
+			httpparser_recvhdr_field(parser, freq.line[l].field, freq.line[l].field_len);
+			httpparser_recvhdr_value(parser, freq.line[l].value, freq.line[l].value_len);
+		}
+		httprecv_req_complete(parser);
+		consumed += rlen;
+	}
+	return consumed;
+}
+#endif
+
 static int httprecv_req_complete(struct http_parser *parser)
 {
 	struct http_sess *hsess = container_of(parser, struct http_sess, parser);
@@ -718,6 +987,11 @@ static int httprecv_req_complete(struct http_parser *parser)
 			printd("Could not allocate a new request object: "
 			        "Connection will close after serving is finished\n");
 			hsess->keepalive = 0;
+		} else {
+			/* header lines of next request go to the new object */
+			parser->data = (void *) &hsess->cpreq->request.hdr;
+			http_recvhdr_setpbuf(&hsess->cpreq->request.hdr,
+			                     hreq->request.hdr.cur_p);
 		}
 	}
 
@@ -728,15 +1002,44 @@ static int httprecv_req_complete(struct http_parser *parser)
 	hreq->request.http_errno = parser->http_errno;
 	hreq->request.method = parser->method;
 
-	/* finalize request lines by adding terminating '\0' */
-	http_recvhdr_terminate(&hreq->request.hdr);
+	/* finalize request url by adding terminating '\0' */
 	hreq->request.url[hreq->request.url_len++] = '\0';
 	hreq->state = HRS_PREPARING_HDR;
+	tp_stamp(hreq->tp.parsed);
 
 	return 0;
 }
 
-static inline void httpreq_prepare_hdr(struct http_req *hreq)
+#ifdef HTTP_PACING
+/* parses the object bitrate hint from the URL arguments
+ * ("<name>?br=<kbit/s>") and derives the pacing rate from it */
+static inline void _httpreq_parse_pacing(struct http_req *hreq)
+{
+	const char *arg = hreq->request.url_argp + 1; /* skip '?' */
+	unsigned long br;
+	uint64_t rate;
+	char *end;
+
+	while (*arg != '\0') {
+		if (strncmp(arg, HTTP_PACE_URLARG, sizeof(HTTP_PACE_URLARG) - 1) == 0) {
+			br = strtoul(arg + sizeof(HTTP_PACE_URLARG) - 1, &end, 10);
+			if (end == arg + sizeof(HTTP_PACE_URLARG) - 1 ||
+			    (*end != '\0' && *end != '&'))
+				return; /* invalid value: keep default rate */
+			rate = ((uint64_t) br * 125 * HTTP_PACE_BITRATE_FACTOR) / 100; /* kbit/s -> B/s */
+			hreq->pace_rate = (uint32_t) min(rate, (uint64_t) UINT32_MAX);
+			printd("Pacing rate of request %p: %"PRIu32" B/s\n", hreq, hreq->pace_rate);
+			return;
+		}
+		arg = strchr(arg, '&');
+		if (!arg)
+			return;
+		++arg;
+	}
+}
+#endif
+
+static inline void _httpreq_prepare_hdr(struct http_req *hreq)
 {
 	size_t url_offset = 0;
 	size_t nb_slines = 0;
@@ -767,10 +1070,11 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	        hreq->request.url,
 	        hreq->request.http_major,
 	        hreq->request.http_minor);
-	for (l = 0; l < hreq->request.hdr.nb_lines; ++l) {
-		printd("   %s: %s\n",
-		       hreq->request.hdr.line[l].field.b,
-		       hreq->request.hdr.line[l].value.b);
+	for (l = 0; l < HTTP_RHDR_MAX; ++l) {
+		char vbuf[64];
+
+		if (http_recvhdr_get(&hreq->request.hdr, l, vbuf, sizeof(vbuf)) >= 0)
+			printd("   %s: %s\n", _http_rhdr[l], vbuf);
 	}
 #endif
 
@@ -779,6 +1083,12 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	while (hreq->request.url[url_offset] == '/')
 		++url_offset;
 
+#ifdef HTTP_PACING
+	/* per-object pacing rate from bitrate hint (kbit/s) */
+	if (hreq->request.url_argp)
+		_httpreq_parse_pacing(hreq);
+#endif
+
 #ifdef HTTP_URL_CUTARGS
 	/* remove args from URL when there was a filename passed (-> "open by filename") */
 	if (hreq->request.url_argp &&
@@ -937,6 +1247,16 @@ static inline void httpreq_prepare_hdr(struct http_req *hreq)
 	return;
 }
 
+static inline void httpreq_prepare_hdr(struct http_req *hreq)
+{
+	tp_start(tp_ts);
+
+	_httpreq_prepare_hdr(hreq);
+	/* request header values are not needed anymore: release pbufs */
+	http_recvhdr_release(&hreq->request.hdr);
+	tp_end(TP_HTTP_PREPARE_HDR, tp_ts);
+}
+
 static inline void httpreq_build_hdr(struct http_req *hreq)
 {
 	size_t nb_slines = 0;
@@ -947,8 +1267,7 @@ static inline void httpreq_build_hdr(struct http_req *hreq)
 	 * upstream server. All other reponses are already build
 	 * Because of this it might be possible that this function needs
 	 * to be called multiple times until the connection was established */
-	ASSERT(shfs_fio_islink(hreq->fd));
-	ASSERT(shfs_fio_link_type(hreq->fd) != SHFS_LTYPE_REDIRECT);
+	ASSERT(hreq->type == HRT_LINKMSG);
 
 	ret = httpreq_link_build_hdr(hreq);
 	if (ret == -EAGAIN)
@@ -956,6 +1275,7 @@ static inline void httpreq_build_hdr(struct http_req *hreq)
 	if (ret < 0) {
 		httpreq_link_close(hreq);
 		shfs_fio_close(hreq->fd);
+		hreq->fd = NULL;
 		goto err503_hdr; /* an unknown error happend -> send out a 503 error page instead */
 	}
 
@@ -1015,7 +1335,7 @@ static inline void httpreq_finalize_hdr(struct http_req *hreq)
 		       hreq->response.hdr.sline[l].b);
 	}
 	for (l = 0; l < hreq->response.hdr.nb_dlines; ++l) {
-		printd("   %s",
+		printd("   %.*s", (int) hreq->response.hdr.dline[l].len,
 		       hreq->response.hdr.dline[l].b);
 	}
 	printd(" Header length: %lu\n", hreq->response.hdr.total_len);
@@ -1183,6 +1503,12 @@ err_t httpsess_respond(struct http_sess *hsess)
 					 (tcpwrite_fn_t) httpsess_write, (void *) hsess);
 		if (unlikely(err != ERR_OK && err != ERR_MEM))
 			goto err_close;
+#ifdef TRACEPOINTS
+		if (hsess->sent && !hreq->tp.firstbyte) {
+			tp_end(TP_HTTP_FIRSTBYTE, hreq->tp.parsed);
+			hreq->tp.firstbyte = 1;
+		}
+#endif
 
 		if (hsess->sent == hreq->response.hdr_total_len) {
 			/* we are done -> switch to next phase */
@@ -1195,6 +1521,9 @@ err_t httpsess_respond(struct http_sess *hsess)
 	case_HRS_RESPONDING_MSG:
 		hreq->state = HRS_RESPONDING_MSG;
 		hsess->sent = 0;
+#ifdef HTTP_PACING
+		httpsess_pace_start(hsess, hreq->type == HRT_FIOMSG ? hreq->pace_rate : 0);
+#endif
 	case HRS_RESPONDING_MSG:
 		switch(hreq->type) {
 		case HRT_SMSG:
@@ -1335,6 +1664,7 @@ static inline void httpreq_acknowledge(struct http_req *hreq, size_t *len, int *
 		hreq->response.ftr_acked_len += ftr_infly;
 		acked -= ftr_infly;
 	}
+	tp_end(TP_HTTP_LASTACK, hreq->tp.parsed);
 	*len = acked;
 	*isdone = 1;
 }
@@ -1435,7 +1765,12 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 	uint16_t nb_sess, max_nb_sess;
 	uint32_t nb_reqs, max_nb_reqs;
 	uint16_t nb_links, max_nb_links;
+	uint16_t nb_idle_links;
+	uint64_t l_connects, l_reuses, l_dns_hits, l_dns_misses;
 	uint64_t ps_sess, ps_reqs, ps_links;
+	uint64_t fp_sess, fp_req_in, fp_req_out, fp_req_io;
+	uint32_t sl_sess, sl_reqs, slmax_sess, slmax_reqs;
+	uint64_t sl_grows, sl_shrinks;
 	unsigned long pver;
 	size_t fio_nb_buffers = 0;
 	size_t link_nb_buffers = 0;
@@ -1455,6 +1790,11 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 	max_nb_reqs  = hs->max_nb_reqs;
 	nb_links     = hs->nb_links;
 	max_nb_links = hs->max_nb_links;
+	nb_idle_links = hs->nb_idle_links;
+	l_connects   = hs->link_stats.connects;
+	l_reuses     = hs->link_stats.reuses;
+	l_dns_hits   = hs->link_stats.dns_hits;
+	l_dns_misses = hs->link_stats.dns_misses;
 	pver         = http_parser_version();
 	if (shfs_mounted) {
 		fio_nb_buffers = httpreq_fio_nb_buffers(shfs_vol.chunksize);
@@ -1462,20 +1802,39 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 		link_nb_buffers = httpreq_link_nb_buffers(shfs_vol.chunksize);
 		link_bffrlen = shfs_vol.chunksize * link_nb_buffers;
 	}
-	ps_sess  = mempool_size(hs->sess_pool);
-	ps_reqs  = mempool_size(hs->req_pool);
+	ps_sess  = slabmempool_size(hs->sess_pool);
+	ps_reqs  = slabmempool_size(hs->req_pool);
 	ps_links = mempool_size(hs->link_pool);
+	sl_sess    = slabmempool_nb_slabs(hs->sess_pool);
+	slmax_sess = hs->sess_pool->max_nb_slabs;
+	sl_reqs    = slabmempool_nb_slabs(hs->req_pool);
+	slmax_reqs = hs->req_pool->max_nb_slabs;
+	sl_grows   = hs->sess_pool->nb_grows + hs->req_pool->nb_grows;
+	sl_shrinks = hs->sess_pool->nb_shrinks + hs->req_pool->nb_shrinks;
+	fp_sess    = sizeof(struct http_sess) + sizeof(struct tcp_pcb);
+	fp_req_in  = sizeof(((struct http_req *) 0)->request);
+	fp_req_out = sizeof(((struct http_req *) 0)->response);
+	fp_req_io  = sizeof(((struct http_req *) 0)->f) + sizeof(SHFS_FD);
 
 	/* thread switching might happen from here on */
 	fprintf(cio, " Listen port:                           %8"PRIu16"\n", HTTP_LISTEN_PORT);
 	fprintf(cio, " Number of sessions:                   %4"PRIu16"/%4"PRIu16" (%5"PRIu64" B per session, pool size: %6"PRIu64" KiB)\n", nb_sess,  max_nb_sess, (uint64_t) sizeof(struct http_sess), ps_sess / 1024);
 	fprintf(cio, " Number of requests:                   %4"PRIu32"/%4"PRIu32" (%5"PRIu64" B per request, pool size: %6"PRIu64" KiB)\n", nb_reqs,  max_nb_reqs, (uint64_t) sizeof(struct http_req), ps_reqs / 1024);
+	fprintf(cio, " Session/request pool slabs:      %4"PRIu32"/%4"PRIu32", %4"PRIu32"/%4"PRIu32" (grows: %"PRIu64", shrinks: %"PRIu64")\n", sl_sess, slmax_sess, sl_reqs, slmax_reqs, sl_grows, sl_shrinks);
+	fprintf(cio, " Footprint per idle session:           %8"PRIu64" B (session: %"PRIu64" B, TCP PCB: %"PRIu64" B)\n", fp_sess, (uint64_t) sizeof(struct http_sess), (uint64_t) sizeof(struct tcp_pcb));
+	fprintf(cio, " Footprint per active request:         %8"PRIu64" B (request: %"PRIu64" B, response: %"PRIu64" B, I/O: %"PRIu64" B)\n", (uint64_t) sizeof(struct http_req), fp_req_in, fp_req_out, fp_req_io);
 	fprintf(cio, " Number of active uplinks:             %4"PRIu16"/%4"PRIu16" (%5"PRIu64" B per uplink,  pool size: %6"PRIu64" KiB)\n", nb_links, max_nb_links, (uint64_t) sizeof(struct http_req_link_origin), ps_links / 1024);
+	fprintf(cio, " Number of idle uplinks:               %4"PRIu16"/%4"PRIu16"\n", nb_idle_links, (uint16_t) HTTP_LINK_MAXNB_IDLE);
+	fprintf(cio, " Uplink connects/reuses:               %"PRIu64"/%"PRIu64"\n", l_connects, l_reuses);
+	fprintf(cio, " Uplink DNS cache hits/misses:         %"PRIu64"/%"PRIu64"\n", l_dns_hits, l_dns_misses);
 	if (fio_nb_buffers) {
 		fprintf(cio, " File-I/O chunkbuffer chain length:     %8"PRIu64, (uint64_t) fio_nb_buffers);
 		fprintf(cio, " (cur: %5"PRIu64" KiB, max: %"PRIu64" chks)\n", (uint64_t) fio_bffrlen / 1024, HTTPREQ_FIO_MAXNB_BUFFERS);
 		fprintf(cio, " Remote link chunkbuffer chain length:  %8"PRIu64, (uint64_t) link_nb_buffers);
-		fprintf(cio, " (cur: %5"PRIu64" KiB, max: %"PRIu64" chks)\n", (uint64_t) link_bffrlen / 1024, HTTPREQ_LINK_MAXNB_BUFFERS);
+		fprintf(cio, " (cur: %5"PRIu64" KiB, max: %"PRIu64" chks)\n", (uint64_t) link_bffrlen / 1024,
+		        (uint64_t) HTTPREQ_LINK_MAXNB_BUFFERS + (hs->link_timeshift ? HTTP_LINK_TIMESHIFT_MAXNB_BUFFERS : 0));
+		fprintf(cio, " Remote link time-shift window:         %8u s", hs->link_timeshift);
+		fprintf(cio, " (join back: %s)\n", hs->link_tsjoin ? "yes" : "no");
 	}
 	fprintf(cio, " Send buffer:                           %8"PRIu64" KiB", (uint64_t) HTTPREQ_SNDBUF / 1024);
 #ifdef HTTPREQ_LOW_SNDBUF
@@ -1559,4 +1918,115 @@ int shcmd_http_info(FILE *cio, int argc, char *argv[])
 #endif /* HTTP_DEBUG_SESSIONSTATES */
 	return 0;
 }
+
+static const char *_http_ioretry_policy_str[HIRP_MAX] = {
+	"fifo",
+	"srpt",
+	"fbp",
+};
+
+int shcmd_http_ioretry(FILE *cio, int argc, char *argv[])
+{
+	uint64_t nb[HIRP_MAX], wait_sum[HIRP_MAX], wait_max[HIRP_MAX];
+	enum http_ioretry_policy policy;
+	uint32_t nb_waiting = 0;
+	struct http_sess *hsess;
+	unsigned int i;
+
+	if (!hs) {
+		fprintf(cio, "HTTP server is not online\n");
+		return -1;
+	}
+
+	if (argc == 2) {
+		for (i = 0; i < HIRP_MAX; ++i) {
+			if (strcmp(argv[1], _http_ioretry_policy_str[i]) == 0)
+				break;
+		}
+		if (i == HIRP_MAX) {
+			fprintf(cio, "Unknown policy '%s' (available: fifo, srpt, fbp)\n", argv[1]);
+			return -1;
+		}
+		hs->ioretry_policy = (enum http_ioretry_policy) i;
+	} else if (argc > 2) {
+		fprintf(cio, "Usage: %s [[fifo|srpt|fbp]]\n", argv[0]);
+		return -1;
+	}
+
+	/* copy values in order to print them
+	 * (writing to cio can lead to thread switching) */
+	policy = hs->ioretry_policy;
+	dlist_foreach(hsess, hs->ioretry_chain, ioretry_chain)
+		++nb_waiting;
+	for (i = 0; i < HIRP_MAX; ++i) {
+		nb[i]       = hs->ioretry_stats[i].nb;
+		wait_sum[i] = hs->ioretry_stats[i].wait_sum;
+		wait_max[i] = hs->ioretry_stats[i].wait_max;
+	}
+
+	fprintf(cio, " I/O retry policy:          %s\n", _http_ioretry_policy_str[policy]);
+	fprintf(cio, " Waiting sessions:          %"PRIu32"\n", nb_waiting);
+	fprintf(cio, " Policy      served   avg wait (us)   max wait (us)\n");
+	for (i = 0; i < HIRP_MAX; ++i) {
+		fprintf(cio, " %-6s %11"PRIu64" %15"PRIu64" %15"PRIu64"\n",
+		        _http_ioretry_policy_str[i], nb[i],
+		        nb[i] ? (wait_sum[i] / nb[i]) / 1000 : 0,
+		        wait_max[i] / 1000);
+	}
+	return 0;
+}
+
+#ifdef HTTP_PACING
+int shcmd_http_pacing(FILE *cio, int argc, char *argv[])
+{
+	uint64_t reqs, bytes, defers, wakeups;
+	uint32_t nb_deferred = 0;
+	struct http_sess *hsess;
+	unsigned long kbps;
+	uint32_t rate;
+	unsigned int i;
+	char *end;
+
+	if (!hs) {
+		fprintf(cio, "HTTP server is not online\n");
+		return -1;
+	}
+
+	if (argc == 2) {
+		kbps = strtoul(argv[1], &end, 10);
+		if (end == argv[1] || *end != '\0' || kbps > (UINT32_MAX / 125)) {
+			fprintf(cio, "Invalid rate '%s'\n", argv[1]);
+			return -1;
+		}
+		hs->pace_rate = (uint32_t) kbps * 125; /* kbit/s -> B/s */
+	} else if (argc > 2) {
+		fprintf(cio, "Usage: %s [[RATE_KBPS]]\n", argv[0]);
+		return -1;
+	}
+
+	/* copy values in order to print them
+	 * (writing to cio can lead to thread switching) */
+	rate    = hs->pace_rate;
+	reqs    = hs->pace_stats.reqs;
+	bytes   = hs->pace_stats.bytes;
+	defers  = hs->pace_stats.defers;
+	wakeups = hs->pace_stats.wakeups;
+	for (i = 0; i < HTTP_PACE_WHEEL_LEN; ++i)
+		dlist_foreach(hsess, hs->pace_wheel[i], pace.wheel)
+			++nb_deferred;
+
+	if (rate)
+		fprintf(cio, " Default pacing rate:       %"PRIu32" kbit/s\n", rate / 125);
+	else
+		fprintf(cio, " Default pacing rate:       unpaced\n");
+	fprintf(cio, " Per-object rate:           ?%s<kbit/s> x %u%%\n",
+	        HTTP_PACE_URLARG, HTTP_PACE_BITRATE_FACTOR);
+	fprintf(cio, " Deferred sessions:         %"PRIu32"\n", nb_deferred);
+	fprintf(cio, " Paced requests:            %"PRIu64"\n", reqs);
+	fprintf(cio, " Paced bytes:               %"PRIu64"\n", bytes);
+	fprintf(cio, " Deferrals:                 %"PRIu64"\n", defers);
+	fprintf(cio, " Timer wake-ups:            %"PRIu64"\n", wakeups);
+	return 0;
+}
+#endif
 #endif
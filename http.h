@@ -40,13 +40,26 @@
 #include <stdio.h>
 #include <inttypes.h>
 
-int init_http(uint16_t nb_sess, uint32_t nb_reqs);
+int init_http(uint16_t nb_sess, uint32_t nb_reqs,
+              unsigned int link_timeshift, int link_tsjoin);
 void exit_http(void);
 
 void http_poll_ioretry(void);
+#ifdef HTTP_PACING
+void http_poll_pacing(void);
+/* returns the time (ns) when the next paced session is due, 0 if none is parked */
+uint64_t http_pacing_deadline(void);
+#endif
+/* returns 1 while sessions wait for I/O buffers, i.e., when
+ * they have to be polled without waiting for network events */
+int http_poll_busy(void);
 
 #ifdef HTTP_INFO
 int shcmd_http_info(FILE *cio, int argc, char *argv[]);
+int shcmd_http_ioretry(FILE *cio, int argc, char *argv[]);
+#ifdef HTTP_PACING
+int shcmd_http_pacing(FILE *cio, int argc, char *argv[]);
+#endif
 #endif
 
 #endif
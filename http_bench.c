@@ -0,0 +1,701 @@
+/*
+ * Closed-loop HTTP load generator for end-to-end benchmarks
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#include <target/sys.h>
+#include <lwip/tcp.h>
+#include <lwip/netif.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "http_defs.h"
+#include "lathist.h"
+#include "http_bench.h"
+#ifdef HAVE_SHELL
+#include "shell.h"
+#endif
+
+enum http_bench_cstate {
+	HBC_CLOSED = 0,
+	HBC_CONNECTING,
+	HBC_IDLE,
+	HBC_RESP_HDR,
+	HBC_RESP_BODY,
+};
+
+/* trace entry */
+struct http_bench_ent {
+	char path[HTTP_BENCH_PATHLEN];
+	int ranged;
+	uint64_t first;
+	uint64_t last; /* UINT64_MAX: until end of file */
+};
+
+struct http_bench_conn {
+	struct tcp_pcb *tpcb;
+	enum http_bench_cstate state;
+	uint64_t ts_req;
+	uint64_t body_left; /* UINT64_MAX: body ends when the server closes */
+	int close_after;    /* connection is closed after the current response */
+	uint16_t hdr_len;
+	char hdr[HTTP_BENCH_HDRBUF_LEN];
+};
+
+struct http_bench {
+	ip_addr_t server;
+	char host[IP4ADDR_STRLEN_MAX];
+	uint16_t port;
+	int running;
+	int stopped;
+
+	struct http_bench_ent *trace;
+	uint32_t trace_len;
+	uint32_t trace_pos;
+
+	struct http_bench_conn *conn;
+	unsigned int nb_conns;
+	unsigned int nb_open;
+
+	uint64_t nb_reqs;
+	uint64_t issued;
+	uint64_t done;
+	uint64_t ts_start;
+	uint64_t ts_end;
+	uint64_t rx_bytes;   /* response headers and bodies */
+	uint64_t body_bytes;
+	uint64_t status[6];  /* 1xx-5xx, others */
+	uint64_t errors;     /* connection and protocol errors */
+	uint64_t reconnects;
+	struct lathist lat;  /* request sent until response received completely (ns) */
+};
+
+static struct http_bench *hb = NULL;
+
+static int   _hb_conn_open  (struct http_bench_conn *c);
+static err_t _hb_next       (struct http_bench_conn *c);
+static err_t _hb_connected  (void *argp, struct tcp_pcb *tpcb, err_t err);
+static err_t _hb_recv       (void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+static void  _hb_error      (void *argp, err_t err);
+
+/*******************************************************************************
+ * Trace
+ ******************************************************************************/
+/* range: "FIRST-LAST" or "FIRST-" (NULL: no range) */
+static int _hb_trace_ent(struct http_bench_ent *e, const char *path, size_t path_len,
+			 const char *range)
+{
+	if (!path_len || path_len >= sizeof(e->path))
+		return -EINVAL;
+	memcpy(e->path, path, path_len);
+	e->path[path_len] = '\0';
+
+	e->ranged = 0;
+	if (!range || range[0] == '\0')
+		return 0;
+	e->ranged = 1;
+	if (sscanf(range, "%"SCNu64"-%"SCNu64"", &e->first, &e->last) == 2)
+		return (e->last >= e->first) ? 0 : -EINVAL;
+	if (sscanf(range, "%"SCNu64"-", &e->first) == 1 && range[strlen(range) - 1] == '-') {
+		e->last = UINT64_MAX;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+/* trace file: one request per line, "PATH [FIRST-[LAST]]",
+ * empty lines and lines starting with '#' are ignored.
+ * Entries are only counted when trace is NULL */
+static int _hb_trace_load(FILE *cio, const char *fname, struct http_bench_ent *trace, uint32_t max)
+{
+	FILE *fp;
+	char line[HTTP_BENCH_PATHLEN + 64];
+	char *path, *range;
+	size_t path_len;
+	unsigned int lineno = 0;
+	uint32_t count = 0;
+	int ret;
+
+	fp = fopen(fname, "r");
+	if (!fp) {
+		fprintf(cio, "Could not open trace %s: %s\n", fname, strerror(errno));
+		return -errno;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		++lineno;
+		path = line + strspn(line, " \t");
+		path_len = strcspn(path, " \t\r\n");
+		if (!path_len || path[0] == '#')
+			continue;
+		if (count == max) {
+			fprintf(cio, "%s: Too many trace entries (max. %u)\n", fname, max);
+			ret = -ENOSPC;
+			goto out_close;
+		}
+		if (trace) {
+			range = path + path_len;
+			range += strspn(range, " \t");
+			range[strcspn(range, " \t\r\n")] = '\0';
+			if (_hb_trace_ent(&trace[count], path, path_len, range) < 0) {
+				fprintf(cio, "%s:%u: Invalid trace entry\n", fname, lineno);
+				ret = -EINVAL;
+				goto out_close;
+			}
+		}
+		++count;
+	}
+	ret = (int) count;
+
+ out_close:
+	fclose(fp);
+	return ret;
+}
+
+/* trace arguments: "PATH[:FIRST-[LAST]]" or "@FILE" */
+static int _hb_trace_args(FILE *cio, int argc, char *argv[], struct http_bench_ent *trace)
+{
+	char *range;
+	uint32_t count = 0;
+	int i, ret;
+
+	for (i = 0; i < argc; ++i) {
+		if (argv[i][0] == '@') {
+			ret = _hb_trace_load(cio, &argv[i][1], trace ? &trace[count] : NULL,
+					     HTTP_BENCH_MAXTRACE - count);
+			if (ret < 0)
+				return ret;
+			count += ret;
+			continue;
+		}
+		if (count == HTTP_BENCH_MAXTRACE) {
+			fprintf(cio, "Too many trace entries (max. %u)\n", HTTP_BENCH_MAXTRACE);
+			return -ENOSPC;
+		}
+		if (trace) {
+			range = strrchr(argv[i], ':');
+			if (_hb_trace_ent(&trace[count], argv[i],
+					  range ? (size_t) (range - argv[i]) : strlen(argv[i]),
+					  range ? range + 1 : NULL) < 0) {
+				fprintf(cio, "Invalid trace entry: %s\n", argv[i]);
+				return -EINVAL;
+			}
+		}
+		++count;
+	}
+	return (int) count;
+}
+
+/*******************************************************************************
+ * Client connections
+ ******************************************************************************/
+static void _hb_finish(void)
+{
+	hb->ts_end = target_now_ns();
+	hb->running = 0;
+	http_bench_print(stdout, 0);
+}
+
+static void _hb_conn_down(struct http_bench_conn *c)
+{
+	c->tpcb = NULL;
+	c->state = HBC_CLOSED;
+	if (--hb->nb_open == 0)
+		_hb_finish();
+}
+
+static err_t _hb_conn_close(struct http_bench_conn *c)
+{
+	err_t err = ERR_OK;
+
+	tcp_arg(c->tpcb, NULL);
+	tcp_recv(c->tpcb, NULL);
+	tcp_err(c->tpcb, NULL);
+	if (unlikely(tcp_close(c->tpcb) != ERR_OK)) {
+		tcp_abort(c->tpcb);
+		err = ERR_ABRT;
+	}
+	c->tpcb = NULL;
+	return err;
+}
+
+static int _hb_conn_open(struct http_bench_conn *c)
+{
+	err_t err;
+
+	c->tpcb = tcp_new();
+	if (unlikely(!c->tpcb))
+		return -ENOMEM;
+	tcp_arg(c->tpcb, c);
+	tcp_recv(c->tpcb, _hb_recv);
+	tcp_err(c->tpcb, _hb_error);
+	tcp_nagle_disable(c->tpcb);
+	c->state = HBC_CONNECTING;
+	c->close_after = 0;
+	c->hdr_len = 0;
+
+	err = tcp_connect(c->tpcb, &hb->server, hb->port, _hb_connected);
+	if (unlikely(err != ERR_OK)) {
+		_hb_conn_close(c);
+		return -EIO;
+	}
+	return 0;
+}
+
+static err_t _hb_send_req(struct http_bench_conn *c)
+{
+	struct http_bench_ent *e;
+	char buf[HTTP_BENCH_PATHLEN + 128];
+	char range[64];
+	err_t err;
+	int len;
+
+	e = &hb->trace[hb->trace_pos];
+	if (++hb->trace_pos == hb->trace_len)
+		hb->trace_pos = 0;
+
+	range[0] = '\0';
+	if (e->ranged) {
+		if (e->last == UINT64_MAX)
+			snprintf(range, sizeof(range), "Range: bytes=%"PRIu64"-\r\n", e->first);
+		else
+			snprintf(range, sizeof(range), "Range: bytes=%"PRIu64"-%"PRIu64"\r\n",
+				 e->first, e->last);
+	}
+	len = snprintf(buf, sizeof(buf), "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+		       e->path, hb->host, range);
+
+	err = tcp_write(c->tpcb, buf, (uint16_t) len, TCP_WRITE_FLAG_COPY);
+	if (unlikely(err != ERR_OK))
+		return err;
+	tcp_output(c->tpcb);
+
+	c->ts_req = target_now_ns();
+	c->state = HBC_RESP_HDR;
+	c->hdr_len = 0;
+	++hb->issued;
+	return ERR_OK;
+}
+
+/* continues with the next request on a connection, closes it when
+ * there is nothing left to do (reopens it if the server closes it) */
+static err_t _hb_next(struct http_bench_conn *c)
+{
+	err_t err;
+
+	c->state = HBC_IDLE;
+	if (likely(!c->close_after) && hb->issued < hb->nb_reqs && !hb->stopped) {
+		if (likely(_hb_send_req(c) == ERR_OK))
+			return ERR_OK;
+		++hb->errors;
+	}
+
+	err = _hb_conn_close(c);
+	if (c->close_after && hb->issued < hb->nb_reqs && !hb->stopped) {
+		++hb->reconnects;
+		if (likely(_hb_conn_open(c) == 0))
+			return err;
+		++hb->errors;
+	}
+	_hb_conn_down(c);
+	return err;
+}
+
+/* a response was received completely */
+static void _hb_resp_done(struct http_bench_conn *c)
+{
+	lathist_add(&hb->lat, target_now_ns() - c->ts_req);
+	++hb->done;
+}
+
+/* the request of a connection is lost (it is issued again) */
+static void _hb_resp_fail(struct http_bench_conn *c)
+{
+	if (c->state == HBC_RESP_HDR || c->state == HBC_RESP_BODY)
+		--hb->issued;
+	++hb->errors;
+	c->close_after = 1;
+}
+
+static int _hb_parse_hdr(struct http_bench_conn *c)
+{
+	unsigned int code;
+	int have_clen = 0;
+	char *l, *v;
+
+	if (sscanf(c->hdr, "HTTP/%*u.%*u %u", &code) != 1)
+		return -1;
+	++hb->status[(code >= 100 && code < 600) ? (code / 100) - 1 : 5];
+
+	c->body_left = 0;
+	for (l = strstr(c->hdr, "\r\n"); l; l = strstr(l, "\r\n")) {
+		l += 2;
+		if (strncasecmp(l, "Content-Length:", 15) == 0) {
+			c->body_left = strtoull(l + 15, NULL, 10);
+			have_clen = 1;
+		} else if (strncasecmp(l, "Connection:", 11) == 0) {
+			v = l + 11 + strspn(l + 11, " \t");
+			if (strncasecmp(v, "close", 5) == 0)
+				c->close_after = 1;
+		}
+	}
+
+	if (!have_clen && code >= 200 && code != 204 && code != 304) {
+		/* no length: body ends with the connection */
+		c->body_left = UINT64_MAX;
+		c->close_after = 1;
+	}
+	return 0;
+}
+
+static err_t _hb_connected(void *argp, struct tcp_pcb *tpcb, err_t err)
+{
+	struct http_bench_conn *c = argp;
+
+	return _hb_next(c);
+}
+
+static err_t _hb_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
+{
+	struct http_bench_conn *c = argp;
+	uint16_t off, n;
+	char *end;
+	int done;
+
+	if (unlikely(!p || err != ERR_OK)) {
+		/* connection closed by server */
+		if (p)
+			pbuf_free(p);
+		if (c->state == HBC_RESP_BODY && c->body_left == UINT64_MAX)
+			_hb_resp_done(c);
+		else
+			_hb_resp_fail(c);
+		c->close_after = 1;
+		return _hb_next(c);
+	}
+
+	tcp_recved(tpcb, p->tot_len);
+	hb->rx_bytes += p->tot_len;
+	off = 0;
+	while (off < p->tot_len) {
+		done = 0;
+		switch (c->state) {
+		case HBC_RESP_HDR:
+			n = min((uint16_t) (p->tot_len - off),
+			        (uint16_t) (HTTP_BENCH_HDRBUF_LEN - 1 - c->hdr_len));
+			if (unlikely(!n))
+				goto err_proto; /* header too long */
+			pbuf_copy_partial(p, &c->hdr[c->hdr_len], n, off);
+			c->hdr[c->hdr_len + n] = '\0';
+			end = strstr(&c->hdr[c->hdr_len > 3 ? c->hdr_len - 3 : 0], "\r\n\r\n");
+			if (!end) {
+				c->hdr_len += n;
+				off += n;
+				break;
+			}
+			end[2] = '\0'; /* keep CRLF of the last header line */
+			off += (uint16_t) ((end + 4) - &c->hdr[c->hdr_len]);
+			c->hdr_len = (uint16_t) ((end + 4) - c->hdr);
+			if (unlikely(_hb_parse_hdr(c) < 0))
+				goto err_proto;
+			c->state = HBC_RESP_BODY;
+			done = (c->body_left == 0);
+			break;
+
+		case HBC_RESP_BODY:
+			n = p->tot_len - off;
+			if ((uint64_t) n > c->body_left)
+				n = (uint16_t) c->body_left;
+			if (c->body_left != UINT64_MAX)
+				c->body_left -= n;
+			hb->body_bytes += n;
+			off += n;
+			done = (c->body_left == 0);
+			break;
+
+		default:
+			goto err_proto; /* unexpected data */
+		}
+
+		if (done) {
+			_hb_resp_done(c);
+			err = _hb_next(c);
+			if (c->tpcb != tpcb) {
+				/* connection was closed */
+				pbuf_free(p);
+				return err;
+			}
+		}
+	}
+	pbuf_free(p);
+	return ERR_OK;
+
+ err_proto:
+	pbuf_free(p);
+	_hb_resp_fail(c);
+	return _hb_next(c);
+}
+
+static void _hb_error(void *argp, err_t err)
+{
+	struct http_bench_conn *c = argp;
+
+	/* pcb is already freed */
+	if (!c)
+		return;
+	_hb_resp_fail(c);
+	_hb_conn_down(c);
+}
+
+/*******************************************************************************
+ * Interface
+ ******************************************************************************/
+int http_bench_running(void)
+{
+	return (hb && hb->running);
+}
+
+int http_bench_start(FILE *cio, int argc, char *argv[])
+{
+	unsigned int nb_conns;
+	uint64_t nb_reqs;
+	unsigned int i;
+	int ret;
+
+	if (http_bench_running()) {
+		fprintf(cio, "A benchmark is already running\n");
+		return -EBUSY;
+	}
+	if (argc < 4) {
+		fprintf(cio, "Usage: %s [connections] [requests] [path[:first-[last]]|@trace]...\n", argv[0]);
+		return -EINVAL;
+	}
+	if (sscanf(argv[1], "%u", &nb_conns) != 1 ||
+	    nb_conns == 0 || nb_conns > HTTP_BENCH_MAXCONNS) {
+		fprintf(cio, "Invalid number of connections (1-%u)\n", HTTP_BENCH_MAXCONNS);
+		return -EINVAL;
+	}
+	if (sscanf(argv[2], "%"SCNu64"", &nb_reqs) != 1 || nb_reqs == 0) {
+		fprintf(cio, "Could not parse number of requests\n");
+		return -EINVAL;
+	}
+	if (!netif_default || ip_addr_isany(&netif_default->ip_addr)) {
+		fprintf(cio, "No network interface is configured\n");
+		return -ENODEV;
+	}
+
+	/* results of a previous run are dropped */
+	if (hb) {
+		target_free(hb->conn);
+		target_free(hb->trace);
+		target_free(hb);
+	}
+	hb = target_malloc(CACHELINE_SIZE, sizeof(*hb));
+	if (!hb) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	memset(hb, 0, sizeof(*hb));
+	lathist_reset(&hb->lat);
+
+	ret = _hb_trace_args(cio, argc - 3, &argv[3], NULL);
+	if (ret <= 0) {
+		if (ret == 0)
+			fprintf(cio, "Trace is empty\n");
+		ret = -EINVAL;
+		goto err_free_hb;
+	}
+	hb->trace_len = (uint32_t) ret;
+	hb->trace = target_malloc(8, sizeof(*hb->trace) * hb->trace_len);
+	if (!hb->trace) {
+		ret = -ENOMEM;
+		goto err_free_hb;
+	}
+	ret = _hb_trace_args(cio, argc - 3, &argv[3], hb->trace);
+	if (ret < 0)
+		goto err_free_trace;
+
+	hb->nb_conns = nb_conns;
+	hb->conn = target_malloc(CACHELINE_SIZE, sizeof(*hb->conn) * nb_conns);
+	if (!hb->conn) {
+		ret = -ENOMEM;
+		goto err_free_trace;
+	}
+	memset(hb->conn, 0, sizeof(*hb->conn) * nb_conns);
+
+	ip_addr_copy(hb->server, netif_default->ip_addr);
+	ipaddr_ntoa_r(&hb->server, hb->host, sizeof(hb->host));
+	hb->port = HTTP_LISTEN_PORT;
+	hb->nb_reqs = nb_reqs;
+
+	printd("Starting HTTP benchmark: %u connections to %s:%"PRIu16", %"PRIu64" requests\n",
+	       nb_conns, hb->host, hb->port);
+	hb->running = 1;
+	hb->ts_start = target_now_ns();
+	for (i = 0; i < nb_conns; ++i) {
+		if (_hb_conn_open(&hb->conn[i]) < 0) {
+			++hb->errors;
+			continue;
+		}
+		++hb->nb_open;
+	}
+	if (!hb->nb_open) {
+		fprintf(cio, "Could not open any connection\n");
+		hb->running = 0;
+		hb->ts_end = hb->ts_start;
+		return -ENOMEM;
+	}
+	return 0;
+
+ err_free_trace:
+	target_free(hb->trace);
+ err_free_hb:
+	target_free(hb);
+	hb = NULL;
+ err_out:
+	if (ret == -ENOMEM)
+		fprintf(cio, "Could not allocate memory: %s\n", strerror(-ret));
+	return ret;
+}
+
+void http_bench_stop(void)
+{
+	unsigned int i;
+
+	if (!http_bench_running())
+		return;
+
+	hb->stopped = 1;
+	for (i = 0; i < hb->nb_conns; ++i) {
+		if (!hb->conn[i].tpcb)
+			continue;
+		tcp_arg(hb->conn[i].tpcb, NULL);
+		tcp_err(hb->conn[i].tpcb, NULL);
+		tcp_abort(hb->conn[i].tpcb);
+		hb->conn[i].tpcb = NULL;
+		hb->conn[i].state = HBC_CLOSED;
+	}
+	hb->nb_open = 0;
+	_hb_finish();
+}
+
+#define _us_fmt "%"PRIu64".%03"PRIu64" us"
+#define _us_arg(ns) ((ns) / 1000), ((ns) % 1000)
+
+void http_bench_print(FILE *cio, int verbose)
+{
+	uint64_t ns, mbps, body_mbps;
+	unsigned int b;
+
+	if (!hb) {
+		fprintf(cio, "No benchmark was run\n");
+		return;
+	}
+
+	ns = (hb->running ? target_now_ns() : hb->ts_end) - hb->ts_start;
+	if (!ns)
+		ns = 1;
+	mbps = (hb->rx_bytes * 8000) / ns;
+	body_mbps = (hb->body_bytes * 8000) / ns;
+
+	fprintf(cio, "HTTP benchmark (%s): %u connections, %"PRIu64"/%"PRIu64" requests done, %"PRIu32" trace entries\n",
+		hb->running ? "running" : (hb->stopped ? "stopped" : "done"),
+		hb->nb_conns, hb->done, hb->nb_reqs, hb->trace_len);
+	fprintf(cio, " Duration:   %"PRIu64".%06"PRIu64" s\n",
+		ns / 1000000000, (ns / 1000) % 1000000);
+	fprintf(cio, " Throughput: %"PRIu64" req/s, %"PRIu64".%03"PRIu64" Gbit/s (bodies: %"PRIu64".%03"PRIu64" Gbit/s)\n",
+		(hb->done * 1000000000) / ns,
+		mbps / 1000, mbps % 1000, body_mbps / 1000, body_mbps % 1000);
+	fprintf(cio, " Responses:  1xx: %"PRIu64", 2xx: %"PRIu64", 3xx: %"PRIu64", 4xx: %"PRIu64", 5xx: %"PRIu64", other: %"PRIu64"\n",
+		hb->status[0], hb->status[1], hb->status[2], hb->status[3], hb->status[4], hb->status[5]);
+	fprintf(cio, " Errors:     %"PRIu64" (reconnects: %"PRIu64")\n",
+		hb->errors, hb->reconnects);
+	if (!hb->lat.count)
+		return;
+	fprintf(cio, " Latency:    min "_us_fmt", avg "_us_fmt", max "_us_fmt"\n",
+		_us_arg(hb->lat.min), _us_arg(hb->lat.sum / hb->lat.count), _us_arg(hb->lat.max));
+	fprintf(cio, "             p50 "_us_fmt", p90 "_us_fmt", p99 "_us_fmt", p99.9 "_us_fmt"\n",
+		_us_arg(lathist_pct(&hb->lat, 5000)), _us_arg(lathist_pct(&hb->lat, 9000)),
+		_us_arg(lathist_pct(&hb->lat, 9900)), _us_arg(lathist_pct(&hb->lat, 9990)));
+	if (!verbose)
+		return;
+	for (b = 0; b < LATHIST_NB_BKTS; ++b) {
+		if (!hb->lat.bkt[b])
+			continue;
+		fprintf(cio, "  >= %12"PRIu64" ns: %"PRIu64"\n",
+			lathist_bkt_base(b), hb->lat.bkt[b]);
+	}
+}
+
+#ifdef HAVE_SHELL
+int shcmd_http_bench(FILE *cio, int argc, char *argv[])
+{
+	if (argc <= 1 || (argc == 2 && strcmp(argv[1], "-v") == 0)) {
+		http_bench_print(cio, argc == 2);
+		return 0;
+	}
+	if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+		if (!http_bench_running()) {
+			fprintf(cio, "No benchmark is running\n");
+			return -1;
+		}
+		http_bench_stop();
+		return 0;
+	}
+
+	if (http_bench_start(cio, argc, argv) < 0)
+		return -1;
+	fprintf(cio, "Benchmark started, '%s' displays progress and results\n", argv[0]);
+	return 0;
+}
+#endif
+
+int init_http_bench(void)
+{
+	hb = NULL;
+#ifdef HAVE_SHELL
+	shell_register_cmd("http-bench", shcmd_http_bench);
+#endif
+	return 0;
+}
+
+void exit_http_bench(void)
+{
+	http_bench_stop();
+	if (hb) {
+		target_free(hb->conn);
+		target_free(hb->trace);
+		target_free(hb);
+		hb = NULL;
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Closed-loop HTTP load generator for end-to-end benchmarks
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _HTTP_BENCH_H_
+#define _HTTP_BENCH_H_
+
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+ * The load generator opens a number of keep-alive connections to the HTTP
+ * server of this instance (address of the default netif) and replays a
+ * URL/range trace on them: each connection sends the next request of the
+ * trace as soon as the previous response was received completely.
+ * Client and server share the lwIP stack, so the default netif has to loop
+ * packets back (e.g., loopif on the Linux target).
+ */
+#define HTTP_BENCH_MAXCONNS   256
+#define HTTP_BENCH_MAXTRACE   65536
+#define HTTP_BENCH_PATHLEN    128
+#define HTTP_BENCH_HDRBUF_LEN 1024
+
+int init_http_bench(void);
+void exit_http_bench(void);
+
+/* starts a run, arguments: CONNS REQUESTS TRACE...
+ * (see shcmd_http_bench()); the report is printed to stdout when the run is done */
+int http_bench_start(FILE *cio, int argc, char *argv[]);
+/* aborts a running benchmark */
+void http_bench_stop(void);
+/* returns 1 while a benchmark is running */
+int http_bench_running(void);
+void http_bench_print(FILE *cio, int verbose);
+
+int shcmd_http_bench(FILE *cio, int argc, char *argv[]);
+
+#endif /* _HTTP_BENCH_H_ */
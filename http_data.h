@@ -200,6 +200,21 @@ static const char * const _http_dhdr[] = {
 #define HTTP_DHDR_HOST            5 /* host */
 #define HTTP_DHDR_ICYMETADATA     6 /* Icy-metadata */
 
+/* Received header fields that are indexed (see struct http_recv_hdr) */
+static const char __http_rhdr00[] = "Range";
+static const char __http_rhdr01[] = "Content-Type";
+
+static const char * const _http_rhdr[] = {
+	__http_rhdr00, __http_rhdr01
+};
+static const size_t _http_rhdr_len[] = {
+	sizeof(__http_rhdr00) - 1, sizeof(__http_rhdr01) - 1
+};
+
+#define HTTP_RHDR_RANGE           0 /* range */
+#define HTTP_RHDR_MIME            1 /* content-type */
+#define HTTP_RHDR_MAX             2
+
 static const char _http_err404p[] = \
 	"<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
 	"<html><head>\r\n"
@@ -48,6 +48,7 @@
 #include "http_hdr.h"
 
 #include "mempool.h"
+#include "slabmempool.h"
 #if defined SHFS_STATS && defined SHFS_STATS_HTTP
 #include "shfs_stats.h"
 #endif
@@ -57,6 +58,7 @@
 #include "shfs_cache.h"
 #include "shfs_fio.h"
 #include "shfs_tools.h"
+#include "tracepoint.h"
 
 #ifdef HTTP_DEBUG
 #define ENABLE_DEBUG
@@ -77,6 +79,44 @@
 #define HTTP_LINK_RESPONSE_TIMEOUT 10 /* = x sec */
 #define HTTP_LINK_RECEIVE_TIMEOUT  30 /* = x sec */
 
+#define HTTP_LINK_MAXNB_IDLE        8 /* nb of idle keep-alive connections to origin servers */
+#define HTTP_LINK_IDLE_TIMEOUT      3 /* = x * HTTP_POLL_INTERVAL */
+#define HTTP_LINK_DNSCACHE_SIZE    16 /* nb of cached origin host name resolutions */
+#define HTTP_LINK_DNSCACHE_TTL     60 /* = x sec */
+
+/* time-shift window: additional ring buffers of a live relay so that lagging
+ * clients can stay in sync; the ring is extended while it is passed the first
+ * time until it spans the window at the received stream rate */
+#define HTTP_LINK_TIMESHIFT_MAXNB_BUFFERS 256 /* per origin */
+
+/*
+ * Order in which sessions waiting for cache buffers (I/O retry) are served:
+ *  FIFO: order of registration
+ *  SRPT: smallest remaining response bytes first
+ *  FBP:  sessions that did not send any body bytes yet first (then FIFO)
+ */
+enum http_ioretry_policy {
+	HIRP_FIFO = 0,
+	HIRP_SRPT,
+	HIRP_FBP,
+	HIRP_MAX
+};
+#define HTTP_IORETRY_DEFAULT_POLICY HIRP_SRPT
+
+/*
+ * Egress pacing (token bucket per session) of file responses
+ * Rates are in bytes per second, 0 disables pacing
+ */
+#define HTTP_PACE_DEFAULT_RATE      0
+#define HTTP_PACE_URLARG            "br=" /* <name>?br=<object bitrate in kbit/s> */
+#define HTTP_PACE_BITRATE_FACTOR    150   /* pacing rate in % of the object bitrate */
+#define HTTP_PACE_BURST_NS          20000000 /* bucket depth: 20ms of data, */
+#define HTTP_PACE_MIN_BURST         (2 * TCP_MSS) /* but at least two segments */
+#define HTTP_PACE_TICK_NS           1000000 /* timer wheel granularity: 1ms */
+#define HTTP_PACE_WHEEL_LEN         256
+
+#define HTTP_POOL_SLAB_LEN        64U /* sessions/requests per pool slab (first slab is kept) */
+
 #define HTTPHDR_URL_MAXLEN        99 /* MAX: '/' + '?' + 512 bits hash + '\0' */
 #define HTTPURL_ARGS_INDICATOR   '?'
 
@@ -136,9 +176,10 @@ enum http_sess_close {
 
 struct http_srv {
 	struct tcp_pcb *tpcb;
-	struct mempool *sess_pool;
-	struct mempool *req_pool;
+	struct slabmempool *sess_pool; /* grows/shrinks up to max_nb_sess */
+	struct slabmempool *req_pool;  /* grows/shrinks up to max_nb_reqs */
 	struct mempool *link_pool;
+	struct mempool *link_idle_pool;
 
 	uint16_t nb_sess;
 	uint16_t max_nb_sess;
@@ -146,12 +187,43 @@ struct http_srv {
 	uint32_t max_nb_reqs;
 	uint16_t nb_links;
 	uint16_t max_nb_links;
+	uint16_t nb_idle_links;
+	unsigned int link_timeshift; /* time-shift window of live relays (sec) */
+	int link_tsjoin; /* new clients join at oldest join point in window */
 
 	struct http_sess *hsess_head;
 	struct http_sess *hsess_tail;
 
 	struct dlist_head links;
+	struct dlist_head idle_links; /* keep-alive connections to origins */
 	struct dlist_head ioretry_chain;
+	enum http_ioretry_policy ioretry_policy;
+	uint64_t ioretry_nb_regs; /* registrations, used to detect re-registrations */
+	struct {
+		uint64_t nb;       /* served sessions */
+		uint64_t wait_sum; /* ns */
+		uint64_t wait_max; /* ns */
+	} ioretry_stats[HIRP_MAX];
+
+#ifdef HTTP_PACING
+	uint32_t pace_rate; /* global pacing rate (B/s), 0: disabled */
+	uint64_t pace_tick; /* last processed tick of the timer wheel */
+	struct dlist_head pace_wheel[HTTP_PACE_WHEEL_LEN];
+	unsigned int pace_nb_deferred; /* sessions parked on the wheel */
+	struct {
+		uint64_t reqs;    /* paced requests */
+		uint64_t bytes;   /* bytes sent by paced requests */
+		uint64_t defers;  /* times a session had to wait for tokens */
+		uint64_t wakeups; /* times the timer wheel resumed a session */
+	} pace_stats;
+#endif
+
+	struct {
+		uint64_t connects; /* new connections to origins */
+		uint64_t reuses; /* requests on idle keep-alive connections */
+		uint64_t dns_hits;
+		uint64_t dns_misses;
+	} link_stats;
 };
 
 extern struct http_srv *hs;
@@ -162,35 +234,51 @@ enum http_sess_state {
 	HSS_CLOSING
 };
 
+/*
+ * Fields are ordered by access frequency: the first cache lines hold what
+ * is touched on every receive, send and acknowledgement. Idle keep-alive
+ * sessions do not hold a request object (cpreq is NULL, cpreq_lazy is set)
+ */
 struct http_sess {
-	struct http_sess *next;
-	struct http_sess *prev;
-
-	struct mempool_obj *pobj;
-	struct http_srv *hsrv;
 	struct tcp_pcb *tpcb;
 	enum http_sess_state state;
+	unsigned int rqueue_len; /* current number of simultaneous requests */
 	size_t sent_infly;
 	size_t sent;
 
-	struct http_parser parser;
-
-	int keepalive;
-	int keepalive_timer; /* -1 timeout disabled, 0 timeout expired */
-
 	struct http_req *cpreq; /* current request that is parsed */
 	struct http_req *rqueue_head; /* request serve queue of parsed requests */
 	struct http_req *rqueue_tail;
 	struct http_req *aqueue_head; /* acknowledge queue (requests that are done with sending out but not yet acknowledged) */
 	struct http_req *aqueue_tail;
-	unsigned int rqueue_len; /* current number of simultaneous requests */
 
-	int retry_replychain; /* marker for rare cases: reply could not be initiated
-	                       * within recv because of ERR_MEM */
-	int _in_respond;      /* diables recursive httpsess_respond calls DELETEME */
+	int keepalive_timer; /* -1 timeout disabled, 0 timeout expired */
+	uint8_t keepalive;
+	uint8_t cpreq_lazy;       /* cpreq gets opened when the next data arrives */
+	uint8_t retry_replychain; /* marker for rare cases: reply could not be initiated
+	                           * within recv because of ERR_MEM */
+	uint8_t _in_respond;      /* diables recursive httpsess_respond calls DELETEME */
+
+	struct http_parser parser;
+
+	/* cold: session management */
+	struct http_sess *next;
+	struct http_sess *prev;
+	struct mempool_obj *pobj;
+	struct http_srv *hsrv;
 	dlist_el(ioretry_chain);
+	uint64_t ioretry_ts; /* time when session started waiting for I/O retry */
 
-	//struct http_srv *hs;
+#ifdef HTTP_PACING
+	struct {
+		uint32_t rate;   /* B/s of current response, 0: unpaced */
+		uint32_t burst;  /* bucket depth (B) */
+		uint64_t tokens; /* B */
+		uint64_t ts;     /* time of last refill (ns) */
+		uint64_t expiry; /* wake-up tick while linked to timer wheel */
+		dlist_el(wheel);
+	} pace;
+#endif
 };
 
 enum http_req_state {
@@ -244,41 +332,25 @@ struct http_req_link_state {
 	dlist_el(clients);
 };
 
+/*
+ * Fields used while responding come first, the request part is only
+ * needed until the response header is prepared
+ */
 struct http_req {
-	struct mempool_obj *pobj;
 	struct http_sess *hsess;
 	struct http_req *next;
 	enum http_req_state state;
 	enum http_req_type type;
 
-	struct {
-		uint8_t http_major;
-		uint8_t http_minor;
-		uint8_t http_errno;
-		uint8_t method;
-		int keepalive;
-		char url[HTTPHDR_URL_MAXLEN];
-		size_t url_len;
-		int url_overflow;
-		char *url_argp; /* ptr to argument in url */
-		struct http_recv_hdr hdr;
-	} request;
-
-	struct {
-		uint16_t code;
-		struct http_send_hdr hdr;
-		size_t hdr_eoh_off; /* end of header offset */
-		size_t hdr_total_len; /* total length (inclusive EOH line) */
-		size_t hdr_acked_len; /* acked bytes from header */
-		size_t ftr_acked_len; /* acked bytes from footer */
-	} response;
-
 	uint64_t rlen; /* (requested) number of bytes of message body */
 	uint64_t alen; /* (acknowledged) number of bytes (of rlen) */
 	int is_stream; /* is true when final data length is unknown while sending */
 
 	/* Static buffer I/O */
 	const char *smsg;
+#ifdef HTTP_PACING
+	uint32_t pace_rate; /* B/s, 0: unpaced */
+#endif
 
 	SHFS_FD fd;
 	union {
@@ -286,6 +358,30 @@ struct http_req {
 		struct http_req_link_state l;
 	};
 
+	struct {
+		uint16_t code;
+		size_t hdr_eoh_off; /* end of header offset */
+		size_t hdr_total_len; /* total length (inclusive EOH line) */
+		size_t hdr_acked_len; /* acked bytes from header */
+		size_t ftr_acked_len; /* acked bytes from footer */
+		struct http_send_hdr hdr;
+	} response;
+
+	struct {
+		uint8_t http_major;
+		uint8_t http_minor;
+		uint8_t http_errno;
+		uint8_t method;
+		uint8_t keepalive;
+		int url_overflow;
+		size_t url_len;
+		char *url_argp; /* ptr to argument in url */
+		char url[HTTPHDR_URL_MAXLEN];
+		struct http_recv_hdr hdr;
+	} request;
+
+	struct mempool_obj *pobj;
+
 #if defined SHFS_STATS && defined SHFS_STATS_HTTP
 	struct {
 		struct shfs_el_stats *el_stats;
@@ -295,6 +391,13 @@ struct http_req {
 #endif
 	} stats;
 #endif
+
+#ifdef TRACEPOINTS
+	struct {
+		tp_ts_t parsed; /* time when request parsing completed */
+		int firstbyte; /* first byte of response was sent */
+	} tp;
+#endif
 };
 
 #define httpsess_register_ioretry(hsess) \
@@ -305,6 +408,8 @@ struct http_req {
 			dlist_append((hsess), \
 			             hs->ioretry_chain, \
 			             ioretry_chain); \
+			(hsess)->ioretry_ts = target_now_ns(); \
+			++hs->ioretry_nb_regs; \
 		} \
 	} while(0)
 
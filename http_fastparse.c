@@ -0,0 +1,206 @@
+/*
+ * Fast HTTP Server Implementation for SHFS volumes
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <string.h>
+#include <strings.h>
+#include "likely.h"
+#include "http_parser.h"
+#include "http_fastparse.h"
+
+#if defined __SSE4_2__
+#include <nmmintrin.h>
+#elif defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Returns a pointer to the first control character (except HT) in [p, end)
+ * or end if there is none. CR/LF are control characters as well, so this
+ * finds the end of a line and stops at invalid characters at the same time.
+ */
+static inline const char *_http_fp_findctl(const char *p, const char *end)
+{
+#if defined __SSE4_2__
+	static const char ranges[16] __attribute__((aligned(16))) =
+		"\000\010"  /* allow HT */
+		"\012\037"
+		"\177\177"; /* allow SP and up to but not including DEL */
+	__m128i r = _mm_load_si128((const __m128i *) ranges);
+	int i;
+
+	while (end - p >= 16) {
+		i = _mm_cmpestri(r, 6, _mm_loadu_si128((const __m128i *) p), 16,
+				 _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+		if (i != 16)
+			return p + i;
+		p += 16;
+	}
+#elif defined __SSE2__
+	const __m128i vsign = _mm_set1_epi8((char) 0x80);
+	const __m128i vsp   = _mm_set1_epi8((char) (0x20 ^ 0x80));
+	const __m128i vht   = _mm_set1_epi8(0x09);
+	const __m128i vdel  = _mm_set1_epi8(0x7F);
+	__m128i v, m;
+	uint32_t mask;
+
+	while (end - p >= 16) {
+		v = _mm_loadu_si128((const __m128i *) p);
+		/* unsigned v < 0x20 via signed compare of sign-flipped values */
+		m = _mm_cmplt_epi8(_mm_xor_si128(v, vsign), vsp);
+		m = _mm_andnot_si128(_mm_cmpeq_epi8(v, vht), m);
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, vdel));
+		mask = (uint32_t) _mm_movemask_epi8(m);
+		if (mask)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+#endif
+	for (; p < end; ++p) {
+		if (unlikely(((unsigned char) *p < 0x20 && *p != '\t') || *p == 0x7F))
+			return p;
+	}
+	return end;
+}
+
+#define _http_fp_iseol(p, end) \
+	((end) - (p) >= 2 && (p)[0] == '\r' && (p)[1] == '\n')
+
+static inline int _http_fp_isws(char c)
+{
+	return (c == ' ' || c == '\t');
+}
+
+/* checks value of the Connection header (single token only) */
+static inline unsigned int _http_fp_connflags(const char *v, size_t len)
+{
+	if (len == 5 && strncasecmp(v, "close", 5) == 0)
+		return F_CONNECTION_CLOSE;
+	if (len == 10 && strncasecmp(v, "keep-alive", 10) == 0)
+		return F_CONNECTION_KEEP_ALIVE;
+	return 0;
+}
+
+size_t http_fastparse_req(const char *buf, size_t len, struct http_fastparse_req *req)
+{
+	const char *end = buf + len;
+	const char *p, *eol, *colon, *v, *ve;
+	size_t flen;
+
+	/* request line: "GET <url> HTTP/1.x\r\n" */
+	if (len < 16 || memcmp(buf, "GET ", 4) != 0)
+		return 0;
+	p = buf + 4;
+	eol = _http_fp_findctl(p, end);
+	if (!_http_fp_iseol(eol, end) || eol - p < 10)
+		return 0;
+	/* URL must not contain whitespaces */
+	v = eol - 9;
+	if (v[0] != ' ' || memcmp(&v[1], "HTTP/1.", 7) != 0 ||
+	    (v[8] != '0' && v[8] != '1'))
+		return 0;
+	req->url = p;
+	req->url_len = (size_t) (v - p);
+	if (req->url_len == 0 ||
+	    memchr(req->url, ' ', req->url_len) || memchr(req->url, '\t', req->url_len))
+		return 0;
+	req->http_major = 1;
+	req->http_minor = (unsigned short) (v[8] - '0');
+	req->flags = 0;
+	req->nb_lines = 0;
+
+	/* header lines */
+	for (p = eol + 2; ; p = eol + 2) {
+		eol = _http_fp_findctl(p, end);
+		if (!_http_fp_iseol(eol, end))
+			return 0; /* incomplete header or invalid character */
+		if (eol == p)
+			break; /* empty line: end of header */
+		if (unlikely(_http_fp_isws(*p)))
+			return 0; /* folded line */
+		if (unlikely(req->nb_lines == HTTP_FASTPARSE_MAXNB_LINES))
+			return 0;
+
+		colon = memchr(p, ':', (size_t) (eol - p));
+		if (!colon || colon == p)
+			return 0;
+		flen = (size_t) (colon - p);
+		if (memchr(p, ' ', flen) || memchr(p, '\t', flen))
+			return 0;
+		v = colon + 1;
+		while (v < eol && _http_fp_isws(*v))
+			++v;
+		ve = eol;
+		while (ve > v && _http_fp_isws(*(ve - 1)))
+			--ve;
+
+		/* headers that need special treatment are left to http_parser */
+		switch (flen) {
+		case 6:
+			if (strncasecmp(p, "expect", 6) == 0)
+				return 0;
+			break;
+		case 7:
+			if (strncasecmp(p, "upgrade", 7) == 0)
+				return 0;
+			break;
+		case 10:
+			if (strncasecmp(p, "connection", 10) == 0) {
+				req->flags |= _http_fp_connflags(v, (size_t) (ve - v));
+				if (!req->flags)
+					return 0;
+			}
+			break;
+		case 14:
+			if (strncasecmp(p, "content-length", 14) == 0 &&
+			    !(ve - v == 1 && *v == '0'))
+				return 0; /* request has a body */
+			break;
+		case 17:
+			if (strncasecmp(p, "transfer-encoding", 17) == 0)
+				return 0;
+			break;
+		default:
+			break;
+		}
+
+		req->line[req->nb_lines].field = p;
+		req->line[req->nb_lines].field_len = flen;
+		req->line[req->nb_lines].value = v;
+		req->line[req->nb_lines].value_len = (size_t) (ve - v);
+		++req->nb_lines;
+	}
+
+	return (size_t) (eol + 2 - buf);
+}
@@ -0,0 +1,74 @@
+/*
+ * Fast HTTP Server Implementation for SHFS volumes
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _HTTP_FASTPARSE_H_
+#define _HTTP_FASTPARSE_H_
+/*
+ * Fast path for parsing plain GET requests
+ *  A request that is completely contained in a receive buffer is split
+ *  into request line and header lines with vectorized scans. Everything
+ *  else (other methods, bodies, folded or malformed lines, partial
+ *  requests) is left to http_parser.
+ */
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define HTTP_FASTPARSE_MAXNB_LINES 16
+
+struct http_fastparse_req {
+	const char *url;
+	size_t url_len;
+	unsigned short http_major;
+	unsigned short http_minor;
+	unsigned int flags; /* F_CONNECTION_* flags of http_parser */
+
+	unsigned int nb_lines;
+	struct {
+		const char *field;
+		size_t field_len;
+		const char *value;
+		size_t value_len;
+	} line[HTTP_FASTPARSE_MAXNB_LINES];
+};
+
+/*
+ * Parses a GET request at the beginning of buf.
+ * Returns the number of bytes of the request on success,
+ * 0 if the request has to be parsed by http_parser
+ */
+size_t http_fastparse_req(const char *buf, size_t len, struct http_fastparse_req *req);
+
+#endif /* _HTTP_FASTPARSE_H_ */
@@ -39,6 +39,7 @@
 
 #include "http_defs.h"
 #include "http_hdr.h"
+#include "http_pace.h"
 
 #define httpreq_fio_nb_buffers(chunksize)  (max(2,(DIV_ROUND_UP(HTTPREQ_SNDBUF, (size_t) chunksize))))
 
@@ -76,6 +77,9 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 	register size_t chk_off;
 	register unsigned int idx;
 	size_t slen;
+#ifdef HTTP_PACING
+	size_t avail;
+#endif
 	err_t err;
 	int ret;
 
@@ -144,10 +148,27 @@ static inline err_t httpreq_write_fio(struct http_req *hreq, size_t *sent)
 	chk_off = shfs_volchkoff_foff(hreq->fd, foff);
 	left = min(shfs_vol.chunksize - chk_off, hreq->rlen - roff);
 	slen = left;
+#ifdef HTTP_PACING
+	if (hreq->hsess->pace.rate) {
+		/* do not exceed the pacing rate: wait for at least a segment */
+		avail = httpsess_pace_avail(hreq->hsess);
+		if (avail < min(left, (size_t) TCP_MSS)) {
+			printd("[idx=%u] pacing: %u bytes available, deferring session\n", idx, avail);
+			httpsess_pace_defer(hreq->hsess, min(left, (size_t) TCP_MSS));
+			httpsess_flush(hreq->hsess);
+			goto out;
+		}
+		slen = min(left, avail);
+	}
+#endif
 	err  = httpsess_write(hreq->hsess,
 	                      ((uint8_t *) (hreq->f.cce[idx]->buffer)) + chk_off,
 	                      &slen, TCP_WRITE_FLAG_MORE);
 	*sent += slen;
+#ifdef HTTP_PACING
+	if (hreq->hsess->pace.rate)
+		httpsess_pace_consume(hreq->hsess, slen);
+#endif
 	if (unlikely(err != ERR_OK || !slen)) {
 		printd("[idx=%u] sending failed, aborting this round\n", idx);
 		httpsess_flush(hreq->hsess); /* send buffer might be full:
@@ -197,6 +218,7 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 	size_t nb_slines = http_sendhdr_get_nbslines(&hreq->response.hdr);
 	size_t nb_dlines = http_sendhdr_get_nbdlines(&hreq->response.hdr);
 	char strsbuf[64];
+	char rbuf[64];
 	int ret;
 
 	httpreq_fio_init(hreq);
@@ -207,18 +229,17 @@ static inline int httpreq_fio_build_hdr(struct http_req *hreq)
 	hreq->response.code = 200;	/* 200 OK */
 	hreq->f.rfirst = 0;
 	hreq->f.rlast  = hreq->f.fsize - 1;
-	ret = http_recvhdr_findfield(&hreq->request.hdr, "range");
-	if (ret >= 0) {
+	if (http_recvhdr_get(&hreq->request.hdr, HTTP_RHDR_RANGE, rbuf, sizeof(rbuf)) >= 0) {
 		/* Because range requests require different answer codes
 		 * (e.g., 206 OK or 416 EINVAL), we need to check the
 		 * range request here already.
 		 * http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.16 */
 		hreq->response.code = 416;
-		if (strncasecmp("bytes=", hreq->request.hdr.line[ret].value.b, 6) == 0) {
+		if (strncasecmp("bytes=", rbuf, 6) == 0) {
 			uint64_t rfirst;
 			uint64_t rlast;
 
-			ret = sscanf(hreq->request.hdr.line[ret].value.b + 6,
+			ret = sscanf(rbuf + 6,
 			             "%"PRIu64"-%"PRIu64,
 			             &rfirst, &rlast);
 			if (ret == 1) {
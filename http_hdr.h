@@ -40,12 +40,16 @@
 #include <target/sys.h>
 #include <inttypes.h>
 #include <lwip/opt.h>
+#include <lwip/pbuf.h>
 #include "http_parser.h"
 #include "http_data.h"
 
-#define HTTP_RECVHDR_MAXNB_LINES   12
+#define HTTP_RECVHDR_MAXNB_PBUFS   4   /* nb of retained pbufs per received header */
+#define HTTP_RECVHDR_SPILL_LEN     128 /* buffer for values that span pbufs */
+#define HTTP_RECVHDR_FIELD_MAXLEN  16  /* longest indexed field name + 1 */
 #define HTTP_SENDHDR_MAXNB_SLINES  8
 #define HTTP_SENDHDR_MAXNB_DLINES  4
+#define HTTP_SENDHDR_DBUF_LEN      192 /* packed buffer for all dynamic lines of a header */
 #define HTTP_HDR_DLINE_MAXLEN      80
 
 #ifndef min
@@ -59,56 +63,54 @@
 	min(min((a), (b)), (c))
 #endif
 
-struct _hdr_dbuffer {
-	char b[HTTP_HDR_DLINE_MAXLEN];
-	size_t len;
-};
-
-#define _hdr_dbuffer_reset(dbffr) \
-	do { (dbffr)->len = 0; } while(0)
-#define _hdr_dbuffer_terminate(dbffr) \
-	do { \
-		ASSERT((dbffr)->len < HTTP_HDR_DLINE_MAXLEN); \
-		(dbffr)->b[(dbffr)->len++] = '\0'; \
-	} while(0)
-static inline void _hdr_dbuffer_add(struct _hdr_dbuffer *dbffr, const char *src, size_t len)
-{
-	register size_t curpos, maxlen;
-
-	curpos = dbffr->len;
-	maxlen = sizeof(dbffr->b) - 1 - curpos; /* minus 1 to store terminating '\0' later */
-
-	len = maxlen < len ? maxlen : len;
-	memcpy(&dbffr->b[curpos], src, len);
-	dbffr->len += len;
-}
-
 struct _hdr_sbuffer {
 	const char *b;
 	size_t len;
 };
 
-struct _hdr_line {
-	struct _hdr_dbuffer field;
-	struct _hdr_dbuffer value;
+/*
+ * Received headers are not copied: values of the headers listed in
+ * _http_rhdr (see http_data.h) are referenced in the pbufs they were
+ * received in. These pbufs are retained until http_recvhdr_release()
+ * is called. Only values that span two pbufs are copied to a small
+ * spill buffer. All other header lines are just counted.
+ */
+struct _hdr_ref {
+	const char *b; /* NULL: header was not received */
+	size_t len;
 };
 
 struct http_recv_hdr {
-	struct _hdr_line line[HTTP_RECVHDR_MAXNB_LINES];
+	struct _hdr_ref idx[HTTP_RHDR_MAX];
 	uint32_t nb_lines;
 
+	/* line that is currently parsed */
+	char field[HTTP_RECVHDR_FIELD_MAXLEN];
+	size_t field_len;
+	int cur; /* index of value in idx, -1 if it is not indexed */
 	int last_was_value;
-	int overflow; /* more lines in received header than memory available */
+	int overflow; /* a value could not be stored */
+
+	struct pbuf *cur_p; /* pbuf that is currently parsed (set by the caller) */
+	struct pbuf *p[HTTP_RECVHDR_MAXNB_PBUFS];
+	unsigned int nb_p;
+	char spill[HTTP_RECVHDR_SPILL_LEN];
+	size_t spill_len;
 };
 
+/*
+ * Dynamic lines are formatted back-to-back into dbuf instead of being
+ * stored in fixed-size line buffers: dline[] references into it
+ */
 struct http_send_hdr {
 	struct _hdr_sbuffer sline[HTTP_SENDHDR_MAXNB_SLINES];
-	struct _hdr_dbuffer dline[HTTP_SENDHDR_MAXNB_DLINES];
+	struct _hdr_sbuffer dline[HTTP_SENDHDR_MAXNB_DLINES];
 	uint32_t nb_slines;
-	size_t slines_tlen;
 	uint32_t nb_dlines;
+	size_t slines_tlen;
 	size_t dlines_tlen;
 	size_t total_len;
+	char dbuf[HTTP_SENDHDR_DBUF_LEN];
 };
 
 #define http_sendhdr_add_sline(shdr, l, bffr, bffr_len) \
@@ -123,14 +125,23 @@ struct http_send_hdr {
 		register unsigned i = (idx); \
 		http_sendhdr_add_sline((shdr), (l), _http_shdr[i], _http_shdr_len[i]); \
 	} while(0)
+#define _http_sendhdr_dbuf_off(shdr, l) \
+	((l) ? (size_t) ((shdr)->dline[(l) - 1].b - (shdr)->dbuf) + \
+	       (shdr)->dline[(l) - 1].len : 0)
 #define http_sendhdr_add_dline(shdr, l, fmt, ...)	  \
 	do { \
+		register size_t _off = _http_sendhdr_dbuf_off((shdr), *(l)); \
+		register size_t _max = min((size_t) HTTP_HDR_DLINE_MAXLEN, \
+		                           sizeof((shdr)->dbuf) - _off); \
+		register int _len;				\
+								\
 		ASSERT(*(l) < HTTP_SENDHDR_MAXNB_DLINES);	\
-		(shdr)->dline[*(l)].len =			\
-			snprintf((shdr)->dline[*(l)].b,	\
-			         HTTP_HDR_DLINE_MAXLEN,	\
-			         (fmt),			\
-			         ##__VA_ARGS__);		\
+		_len = snprintf(&(shdr)->dbuf[_off], _max,	\
+		                (fmt),				\
+		                ##__VA_ARGS__);		\
+		ASSERT(_len >= 0 && (size_t) _len < _max);	\
+		(shdr)->dline[*(l)].b = &(shdr)->dbuf[_off];	\
+		(shdr)->dline[*(l)].len = min((size_t) _len, _max - 1); \
 		++*(l);					\
 	} while(0)
 #define http_sendhdr_set_nbdlines(shdr, l) \
@@ -232,81 +243,172 @@ static inline err_t http_sendhdr_write(struct http_send_hdr *shdr, size_t *sent,
 	return err;
 }
 
+/* sets the pbuf that is going to be parsed next */
+#define http_recvhdr_setpbuf(rhdr, pbuf) \
+	do { (rhdr)->cur_p = (pbuf); } while(0)
+
 static inline int httpparser_recvhdr_field(struct http_parser *parser, const char *buf, size_t len)
 {
 	struct http_recv_hdr *rhdr = (struct http_recv_hdr *) parser->data;
-	register unsigned l;
 
-	if (unlikely(rhdr->overflow))
-		return 0; /* ignore line */
 	if (rhdr->last_was_value) {
-		if (unlikely(rhdr->nb_lines == HTTP_RECVHDR_MAXNB_LINES)) {
-			/* overflow */
-			rhdr->overflow = 1;
-			return 0;
-		}
-
-		/* switch to next line and reset its buffer */
+		/* new line begins */
 		rhdr->last_was_value = 0;
-		rhdr->line[rhdr->nb_lines].field.len = 0;
-		rhdr->line[rhdr->nb_lines].value.len = 0;
+		rhdr->field_len = 0;
 		++rhdr->nb_lines;
 	}
 
-	l = rhdr->nb_lines - 1;
-	_hdr_dbuffer_add(&rhdr->line[l].field, buf, len);
+	/* field names are only collected as long as they could be indexed */
+	if (rhdr->field_len + len < sizeof(rhdr->field))
+		memcpy(&rhdr->field[rhdr->field_len], buf, len);
+	rhdr->field_len += len;
+	return 0;
+}
+
+/* keeps the pbuf that is currently parsed, returns 0 on success */
+static inline int _http_recvhdr_retain(struct http_recv_hdr *rhdr)
+{
+	if (!rhdr->cur_p)
+		return -1;
+	if (rhdr->nb_p && rhdr->p[rhdr->nb_p - 1] == rhdr->cur_p)
+		return 0; /* retained already */
+	if (unlikely(rhdr->nb_p == HTTP_RECVHDR_MAXNB_PBUFS))
+		return -1;
+	pbuf_ref(rhdr->cur_p);
+	rhdr->p[rhdr->nb_p++] = rhdr->cur_p;
 	return 0;
 }
 
+/* copies src to spill buffer, returns pointer to copy or NULL */
+static inline const char *_http_recvhdr_spill(struct http_recv_hdr *rhdr, const char *src, size_t len)
+{
+	char *dst;
+
+	if (unlikely(rhdr->spill_len + len > sizeof(rhdr->spill)))
+		return NULL;
+	dst = &rhdr->spill[rhdr->spill_len];
+	memcpy(dst, src, len);
+	rhdr->spill_len += len;
+	return dst;
+}
+
 static inline int httpparser_recvhdr_value(struct http_parser *parser, const char *buf, size_t len)
 {
 	struct http_recv_hdr *rhdr = (struct http_recv_hdr *) parser->data;
-	register unsigned l;
+	struct _hdr_ref *ref;
+	register unsigned i;
+	const char *b;
 
-	if (unlikely(rhdr->overflow))
-		return 0; /* ignore line */
-	if (unlikely(!rhdr->last_was_value))
-		rhdr->last_was_value = 1; /* value parsing began */
 	if (unlikely(rhdr->nb_lines == 0))
 		return -EINVAL; /* parsing error */
+	if (!rhdr->last_was_value) {
+		/* value parsing began: lookup field in index */
+		rhdr->last_was_value = 1;
+		rhdr->cur = -1;
+		if (rhdr->field_len < sizeof(rhdr->field)) {
+			for (i = 0; i < HTTP_RHDR_MAX; ++i) {
+				if (rhdr->field_len == _http_rhdr_len[i] &&
+				    strncasecmp(rhdr->field, _http_rhdr[i], rhdr->field_len) == 0) {
+					rhdr->cur = (int) i;
+					rhdr->idx[i].b = NULL; /* last occurrence wins */
+					rhdr->idx[i].len = 0;
+					break;
+				}
+			}
+		}
+	}
+	if (rhdr->cur < 0 || len == 0)
+		return 0; /* not indexed */
+
+	ref = &rhdr->idx[rhdr->cur];
+	if (!ref->b) {
+		/* reference value in received pbuf */
+		if (likely(_http_recvhdr_retain(rhdr) == 0)) {
+			ref->b = buf;
+			ref->len = len;
+			return 0;
+		}
+		b = _http_recvhdr_spill(rhdr, buf, len);
+		if (!b)
+			goto err_overflow;
+		ref->b = b;
+		ref->len = len;
+		return 0;
+	}
+
+	/* value continues in next pbuf: join both parts in spill buffer */
+	if (ref->b + ref->len != &rhdr->spill[rhdr->spill_len]) {
+		b = _http_recvhdr_spill(rhdr, ref->b, ref->len);
+		if (!b)
+			goto err_overflow;
+		ref->b = b;
+	}
+	if (!_http_recvhdr_spill(rhdr, buf, len))
+		goto err_overflow;
+	ref->len += len;
+	return 0;
 
-	l = rhdr->nb_lines - 1;
-	_hdr_dbuffer_add(&rhdr->line[l].value, buf, len);
+ err_overflow:
+	/* value is dropped */
+	rhdr->overflow = 1;
+	ref->b = NULL;
+	ref->len = 0;
+	rhdr->cur = -1;
 	return 0;
 }
 
-static inline void http_recvhdr_terminate(struct http_recv_hdr *rhdr)
+/* returns 1 if header field idx was received */
+#define http_recvhdr_has(rhdr, i) \
+	((rhdr)->idx[(i)].b != NULL)
+
+/*
+ * Copies the value of header field idx as null-terminated string to out.
+ * Returns the length of the value, -1 if the field was not received
+ * (values that do not fit in out are truncated)
+ */
+static inline ssize_t http_recvhdr_get(struct http_recv_hdr *rhdr, unsigned int i, char *out, size_t outlen)
 {
-	/* finalize request_hdr lines by adding terminating '\0' */
-	register unsigned l;
+	size_t len;
 
-	for (l = 0; l < rhdr->nb_lines; ++l) {
-		_hdr_dbuffer_terminate(&rhdr->line[l].field);
-		_hdr_dbuffer_terminate(&rhdr->line[l].value);
-	}
+	if (!rhdr->idx[i].b)
+		return -1;
+	len = min(rhdr->idx[i].len, outlen - 1);
+	memcpy(out, rhdr->idx[i].b, len);
+	out[len] = '\0';
+	return (ssize_t) len;
 }
 
-/* returns the field line number on success, -1 if it was not found */
-static inline int http_recvhdr_findfield(struct http_recv_hdr *rhdr, const char *field)
+/* compares the value of header field idx with str (case insensitive) */
+static inline int http_recvhdr_casecmp(struct http_recv_hdr *rhdr, unsigned int i, const char *str)
 {
-	register unsigned l;
+	size_t len = strlen(str);
 
-	for (l = 0; l < rhdr->nb_lines; ++l) {
-		if (strncasecmp(field, rhdr->line[l].field.b,
-		                rhdr->line[l].field.len) == 0) {
-			return (int) l;
-		}
-	}
-	return -1; /* not found */
+	if (!rhdr->idx[i].b || rhdr->idx[i].len != len)
+		return 1;
+	return strncasecmp(rhdr->idx[i].b, str, len);
 }
 
 #define http_recvhdr_get_nblines(rhdr) \
 	(rhdr)->nb_lines
 #define http_recvhdr_reset(rhdr) \
 	do { \
-		(rhdr)->nb_lines = 0;		\
-		(rhdr)->last_was_value = 1;	\
-		(rhdr)->overflow = 0;		\
+		register unsigned _i;				\
+								\
+		for (_i = 0; _i < HTTP_RHDR_MAX; ++_i)		\
+			(rhdr)->idx[_i].b = NULL;		\
+		(rhdr)->nb_lines = 0;				\
+		(rhdr)->last_was_value = 1;			\
+		(rhdr)->overflow = 0;				\
+		(rhdr)->cur_p = NULL;				\
+		(rhdr)->nb_p = 0;				\
+		(rhdr)->spill_len = 0;				\
+	} while(0)
+/* releases retained pbufs, references to values are invalid afterwards */
+#define http_recvhdr_release(rhdr) \
+	do { \
+		while ((rhdr)->nb_p)				\
+			pbuf_free((rhdr)->p[--(rhdr)->nb_p]);	\
+		http_recvhdr_reset((rhdr));			\
 	} while(0)
 
 #endif /* _HTTP_HDR_H_ */
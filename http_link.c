@@ -34,6 +34,7 @@
  * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
  */
 
+#include <limits.h>
 #include "http_link.h"
 
 static err_t httplink_request(struct http_req_link_origin *o);
@@ -53,26 +54,356 @@ static http_parser_settings _httplink_parser_settings = {
 typedef int (*http_data_cb) (http_parser*, const char *at, size_t length);
 typedef int (*http_cb) (http_parser*);
 
+static void httplink_idle_close(struct http_link_idle *il);
+
 int httplink_init(struct http_srv *hs)
 {
   hs->link_pool = alloc_simple_mempool(HTTP_MAXNB_LINKS, sizeof(struct http_req_link_origin));
   if (!hs->link_pool)
-    return -ENOMEM;
+    goto err_out;
+  hs->link_idle_pool = alloc_simple_mempool(HTTP_LINK_MAXNB_IDLE, sizeof(struct http_link_idle));
+  if (!hs->link_idle_pool)
+    goto err_free_linkpool;
 
   hs->nb_links = 0;
   hs->max_nb_links = HTTP_MAXNB_LINKS;
   dlist_init_head(hs->links);
+  hs->nb_idle_links = 0;
+  dlist_init_head(hs->idle_links);
+  memset(&hs->link_stats, 0, sizeof(hs->link_stats));
 
   return 0;
+
+ err_free_linkpool:
+  free_mempool(hs->link_pool);
+ err_out:
+  return -ENOMEM;
 }
 
 void httplink_exit(struct http_srv *hs)
 {
   BUG_ON(hs->nb_links != 0);
 
+  while (!dlist_is_empty(hs->idle_links))
+    httplink_idle_close(dlist_first_el(hs->idle_links, struct http_link_idle));
+  free_mempool(hs->link_idle_pool);
   free_mempool(hs->link_pool);
 }
 
+/*
+ * Keep-alive connections to origin servers
+ * After an object was received completely, the connection to the origin
+ * is parked on the idle list so that the next request to the same
+ * host:port can skip resolution and TCP handshake
+ */
+static void httplink_idle_release(struct http_link_idle *il)
+{
+	dlist_unlink(il, hs->idle_links, idle);
+	--hs->nb_idle_links;
+	mempool_put(il->pobj);
+}
+
+static void httplink_idle_close(struct http_link_idle *il)
+{
+	printd("Closing idle origin connection %p\n", il);
+	tcp_arg (il->tpcb, NULL);
+	tcp_recv(il->tpcb, NULL);
+	tcp_sent(il->tpcb, NULL);
+	tcp_err (il->tpcb, NULL);
+	tcp_poll(il->tpcb, NULL, 0);
+	if (tcp_close(il->tpcb) != ERR_OK)
+		tcp_abort(il->tpcb);
+	httplink_idle_release(il);
+}
+
+static err_t httplink_idle_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
+{
+	struct http_link_idle *il = (struct http_link_idle *) argp;
+
+	/* any data or FIN on an idle connection ends it */
+	if (p) {
+		tcp_recved(tpcb, p->tot_len);
+		pbuf_free(p);
+	}
+	tcp_arg (tpcb, NULL);
+	tcp_recv(tpcb, NULL);
+	tcp_err (tpcb, NULL);
+	tcp_poll(tpcb, NULL, 0);
+	httplink_idle_release(il);
+	if (tcp_close(tpcb) != ERR_OK) {
+		tcp_abort(tpcb);
+		return ERR_ABRT;
+	}
+	return ERR_OK;
+}
+
+static void httplink_idle_error(void *argp, err_t err)
+{
+	struct http_link_idle *il = (struct http_link_idle *) argp;
+
+	printd("Idle origin connection %p died: %d\n", il, err);
+	httplink_idle_release(il); /* pcb is already freed */
+}
+
+static err_t httplink_idle_poll(void *argp, struct tcp_pcb *tpcb)
+{
+	struct http_link_idle *il = (struct http_link_idle *) argp;
+
+	if (--il->timeout == 0)
+		httplink_idle_close(il);
+	return ERR_OK;
+}
+
+/* parks the connection of an origin on the idle list,
+ * returns 0 on success (o->tpcb is detached then) */
+static int httplink_idle_put(struct http_req_link_origin *o)
+{
+	struct mempool_obj *pobj;
+	struct http_link_idle *il;
+
+	pobj = mempool_pick(hs->link_idle_pool);
+	if (!pobj)
+		return -ENOMEM;
+	il = (struct http_link_idle *) pobj->data;
+	il->pobj = pobj;
+	il->tpcb = o->tpcb;
+	il->rhost = *shfs_fio_link_rhost(o->fd);
+	il->rport = o->rport;
+	il->timeout = HTTP_LINK_IDLE_TIMEOUT;
+
+	tcp_arg (il->tpcb, il);
+	tcp_recv(il->tpcb, httplink_idle_recv);
+	tcp_sent(il->tpcb, NULL);
+	tcp_err (il->tpcb, httplink_idle_error);
+	tcp_poll(il->tpcb, httplink_idle_poll, HTTP_POLL_INTERVAL);
+
+	dlist_init_el(il, idle);
+	dlist_append(il, hs->idle_links, idle);
+	++hs->nb_idle_links;
+	printd("origin %p: Connection parked as idle %p\n", o, il);
+
+	o->tpcb = NULL;
+	o->cstate = HRLOC_ERROR;
+	return 0;
+}
+
+/* resets request and response state so that the request can be (re-)sent */
+static void httplink_reset_request(struct http_req_link_origin *o)
+{
+	http_parser_init(&o->parser, HTTP_RESPONSE);
+	http_recvhdr_release(&o->response.hdr);
+	o->response.mime = NULL;
+	http_sendhdr_reset(&o->request.hdr);
+	o->sent = 0;
+	o->sent_infly = 0;
+	o->request.hdr_total_len = 0;
+	o->request.hdr_acked_len = 0;
+	o->reused = 0;
+}
+
+/* takes an idle connection to the origin's host:port, if there is one */
+int httplink_reuse(struct http_req_link_origin *o)
+{
+	const struct shfs_host *rhost = shfs_fio_link_rhost(o->fd);
+	struct http_link_idle *il;
+
+	dlist_foreach(il, hs->idle_links, idle) {
+		if (il->rport == o->rport &&
+		    shfshost_compare(&il->rhost, rhost) == 0)
+			break;
+	}
+	if (!il)
+		return -ENOENT;
+
+	o->tpcb = il->tpcb;
+	httplink_idle_release(il);
+	ip_addr_copy(o->rip, o->tpcb->remote_ip);
+	httplink_attach(o);
+	o->reused = 1;
+	++hs->link_stats.reuses;
+	printd("origin %p: Reusing idle connection\n", o);
+
+	if (httplink_connected(o, o->tpcb, ERR_OK) != ERR_OK) {
+		/* request could not be sent: connection is closed already */
+		httplink_reset_request(o);
+		return -EIO;
+	}
+	return 0;
+}
+
+/* an idle connection was closed by the origin before it replied:
+ * send the request again on a new connection */
+static void httplink_retry(struct http_req_link_origin *o)
+{
+	printd("origin %p: Reused connection got closed, reconnecting...\n", o);
+	httplink_reset_request(o);
+	o->sstate = HRLOS_CONNECT;
+	httplink_notify_clients(o);
+}
+
+/*
+ * Cache for resolved origin host names
+ * lwIP's DNS table is small and its entries are shared with any other name
+ * lookup, this cache keeps the addresses of origins for HTTP_LINK_DNSCACHE_TTL
+ */
+struct http_link_dnscache_el {
+	struct shfs_host rhost;
+	ip_addr_t rip;
+	uint64_t expiry; /* ns */
+};
+
+static struct http_link_dnscache_el _dnscache[HTTP_LINK_DNSCACHE_SIZE];
+static unsigned int _dnscache_next = 0;
+
+int httplink_dnscache_lookup(const struct shfs_host *h, ip_addr_t *out)
+{
+	uint64_t now;
+	unsigned int i;
+
+	if (h->type != SHFS_HOST_TYPE_NAME)
+		return -EINVAL; /* addresses do not need to be resolved */
+
+	now = target_now_ns();
+	for (i = 0; i < HTTP_LINK_DNSCACHE_SIZE; ++i) {
+		if (_dnscache[i].expiry > now &&
+		    shfshost_compare(&_dnscache[i].rhost, h) == 0) {
+			ip_addr_copy(*out, _dnscache[i].rip);
+			++hs->link_stats.dns_hits;
+			return 0;
+		}
+	}
+	++hs->link_stats.dns_misses;
+	return -ENOENT;
+}
+
+void httplink_dnscache_add(const struct shfs_host *h, const ip_addr_t *ip)
+{
+	struct http_link_dnscache_el *e;
+	unsigned int i;
+
+	if (h->type != SHFS_HOST_TYPE_NAME)
+		return;
+
+	/* update existing entry or replace the next one (round-robin) */
+	for (i = 0; i < HTTP_LINK_DNSCACHE_SIZE; ++i) {
+		if (shfshost_compare(&_dnscache[i].rhost, h) == 0)
+			break;
+	}
+	if (i == HTTP_LINK_DNSCACHE_SIZE) {
+		i = _dnscache_next;
+		_dnscache_next = (_dnscache_next + 1) % HTTP_LINK_DNSCACHE_SIZE;
+	}
+	e = &_dnscache[i];
+	e->rhost = *h;
+	ip_addr_copy(e->rip, *ip);
+	e->expiry = target_now_ns() + (uint64_t) HTTP_LINK_DNSCACHE_TTL * 1000000000ull;
+}
+
+#ifdef SHFS_FILL
+/*
+ * Pull-through fill: each ring buffer is written to the reserved container
+ * as soon as it got filled completely. The entry is turned into a regular
+ * file after the object was received and all writes completed.
+ */
+static void httplink_fill_finish(struct http_req_link_origin *o)
+{
+	int ret;
+
+	switch (o->fill.state) {
+	case HRLOF_FLUSH:
+		ret = shfs_fill_commit(o->fd, o->fill.start, o->response.len, o->response.mime);
+		if (ret < 0) {
+			printd("origin %p: Could not commit fill: %d\n", o, ret);
+			shfs_fill_release(o->fill.start, o->response.len);
+		}
+		break;
+	case HRLOF_FAILED:
+		printd("origin %p: Fill aborted\n", o);
+		shfs_fill_release(o->fill.start, o->response.len);
+		break;
+	default:
+		return;
+	}
+	o->fill.state = HRLOF_NONE;
+}
+
+static inline void httplink_fill_abort(struct http_req_link_origin *o)
+{
+	o->fill.state = HRLOF_FAILED;
+	if (!o->fill.infly)
+		httplink_fill_finish(o);
+}
+
+static void _httplink_fill_cb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
+{
+	struct http_req_link_origin *o = (struct http_req_link_origin *) cookie;
+	unsigned int idx = (unsigned int) (uintptr_t) argp;
+	int ret;
+
+	ret = shfs_aio_finalize(t);
+	o->fill.t[idx] = NULL;
+	--o->fill.infly;
+	if (unlikely(ret < 0)) {
+		printd("origin %p: Could not write buffer %u to fill area: %d\n", o, idx, ret);
+		o->fill.state = HRLOF_FAILED;
+	}
+
+	if (o->fill.infly == 0) {
+		httplink_fill_finish(o);
+		if (o->destroy)
+			httplink_destroy(o);
+	}
+}
+
+/* writes buffer idx that holds the stream data starting at pos (chunk aligned) */
+static inline void httplink_fill_write(struct http_req_link_origin *o, unsigned int idx, size_t pos)
+{
+	SHFS_AIO_TOKEN *t;
+
+	t = shfs_awrite_chunk(o->fill.start + (chk_t) (pos / shfs_vol.chunksize), 1,
+			      o->cce[idx]->buffer, _httplink_fill_cb, o, (void *) (uintptr_t) idx);
+	if (unlikely(!t)) {
+		printd("origin %p: Could not write buffer %u to fill area: %d\n", o, idx, errno);
+		httplink_fill_abort(o);
+		return;
+	}
+	o->fill.t[idx] = t;
+	++o->fill.infly;
+	shfs_aio_submit();
+}
+#endif
+
+/* releases an origin that has no clients anymore */
+void httplink_destroy(struct http_req_link_origin *o)
+{
+	unsigned int i;
+
+#ifdef SHFS_FILL
+	if (o->fill.state == HRLOF_FILL)
+		o->fill.state = HRLOF_FAILED; /* object was not received completely */
+	if (o->fill.infly) {
+		/* buffers are still referenced by fill writes */
+		printd("origin %p: Destruction deferred until fill writes are done\n", o);
+		o->destroy = 1;
+		return;
+	}
+	httplink_fill_finish(o);
+#endif
+
+	for (i = 0; i < o->cce_nb; ++i) {
+		printd("origin %p: release blank cache buffer %u @%p...\n", o, i, o->cce[i]);
+		shfs_cache_release(o->cce[i]);
+	}
+#ifdef SHFS_FILL
+	free(o->fill.t);
+#endif
+	free(o->cce);
+	http_recvhdr_release(&o->response.hdr);
+	shfs_fio_close(o->fd);
+	mempool_put(o->pobj);
+	printd("origin %p destroyed\n", o);
+}
+
 #if LWIP_DNS
 void httpreq_link_dnscb(const char *name, ip_addr_t *ipaddr, void *argp)
 {
@@ -85,6 +416,7 @@ void httpreq_link_dnscb(const char *name, ip_addr_t *ipaddr, void *argp)
 	} else {
 		printd("Name resolution for '%s' was successful\n", name);
 		o->rip.addr = ipaddr->addr;
+		httplink_dnscache_add(shfs_fio_link_rhost(o->fd), &o->rip);
 		o->sstate = HRLOS_CONNECT;
 	}
 
@@ -110,7 +442,7 @@ static inline void httplink_build_reqhdr(struct http_req_link_origin *o)
 	reqlen = snprintf(o->request.req, sizeof(o->request.req),
 			  "GET /%s HTTP/1.1\r\n", strlbuf);
 	http_sendhdr_add_sline(&o->request.hdr, &nb_slines, o->request.req, reqlen);
-	http_sendhdr_add_shdr(&o->request.hdr, &nb_slines, HTTP_SHDR_CONN_CLOSE);
+	/* HTTP/1.1 connections are persistent by default */
 	http_sendhdr_add_shdr(&o->request.hdr, &nb_slines, HTTP_SHDR_USERAGENT);
 	if (shfs_fio_link_rport(o->fd) == 80) {
 		http_sendhdr_add_dline(&o->request.hdr, &nb_dlines,
@@ -136,7 +468,7 @@ static inline void httplink_build_reqhdr(struct http_req_link_origin *o)
 		       o->request.hdr.sline[l].b);
 	}
 	for (l = 0; l < o->request.hdr.nb_dlines; ++l) {
-		printd("   %s",
+		printd("   %.*s", (int) o->request.hdr.dline[l].len,
 		       o->request.hdr.dline[l].b);
 	}
 #endif
@@ -315,6 +647,11 @@ err_t httplink_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 			tcp_recved(tpcb, p->tot_len);
 			pbuf_free(p);
 		}
+		if (o->reused && o->cstate != HRLOC_CONNECTED) {
+			ret = httplink_close(o, p ? HSC_ABORT : HSC_CLOSE);
+			httplink_retry(o);
+			return ret;
+		}
 		return httplink_close(o, HSC_ABORT);
 	}
 
@@ -323,6 +660,7 @@ err_t httplink_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 	case HRLOC_CONNECTED:
 		/* feed parser */
 		for (q = p; q != NULL; q = q->next) {
+			http_recvhdr_setpbuf(&o->response.hdr, q);
 			plen = http_parser_execute(&o->parser, &_httplink_parser_settings,
 			                           q->payload, q->len);
 			if (unlikely(plen != q->len)) {
@@ -332,6 +670,8 @@ err_t httplink_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 				ret = httplink_close(o, HSC_CLOSE);
 				goto out;
 			}
+			if (o->tpcb != tpcb)
+				break; /* connection got closed or parked as idle */
 		}
 
 		/* inform clients that new data has arrived (only when PSH flag is set) */
@@ -356,9 +696,13 @@ err_t httplink_recv(void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 void httplink_error(void *argp, err_t err)
 {
 	struct http_req_link_origin *o = (struct http_req_link_origin *) argp;
+	int retry;
 
 	printd("Killing origin connection %p due to error: %d\n", o, err);
+	retry = (o->reused && o->cstate != HRLOC_CONNECTED);
 	httplink_close(o, HSC_KILL); /* drop connection */
+	if (retry)
+		httplink_retry(o);
 }
 
 err_t httplink_poll(void *argp, struct tcp_pcb *tpcb)
@@ -405,14 +749,7 @@ err_t httplink_poll(void *argp, struct tcp_pcb *tpcb)
 static int httplink_recv_hdrcomplete(http_parser *parser)
 {
 	struct http_req_link_origin *o = container_of(parser, struct http_req_link_origin, parser);
-#ifdef HTTP_DEBUG
-	unsigned l;
-#endif
 	enum lftype lft;
-	int ret;
-
-	/* first we null-terminate all received header fields */
-	http_recvhdr_terminate(&o->response.hdr);
 
 #ifdef HTTP_DEBUG
 	printd("origin %p: Server replied:\n", o);
@@ -420,11 +757,7 @@ static int httplink_recv_hdrcomplete(http_parser *parser)
 	       parser->http_major,
 	       parser->http_minor,
 	       parser->status_code);
-	for (l = 0; l < o->response.hdr.nb_lines; ++l) {
-		printd("   %s: %s\n",
-		       o->response.hdr.line[l].field.b,
-		       o->response.hdr.line[l].value.b);
-	}
+	printd("   (%"PRIu32" header lines)\n", http_recvhdr_get_nblines(&o->response.hdr));
 #endif
 
 	/* did server respond with status code 200? */
@@ -436,9 +769,9 @@ static int httplink_recv_hdrcomplete(http_parser *parser)
 	}
 
 	/* search for mime type in response */
-	ret = http_recvhdr_findfield(&o->response.hdr, _http_dhdr[HTTP_DHDR_MIME]);
-	if (ret >= 0) {
-		o->response.mime = o->response.hdr.line[ret].value.b;
+	if (http_recvhdr_get(&o->response.hdr, HTTP_RHDR_MIME,
+	                     o->response.mime_b, sizeof(o->response.mime_b)) >= 0) {
+		o->response.mime = o->response.mime_b;
 		lft = mime_to_lftype(o->response.mime);
 		if (!lft) {
 			printd("origin %p: MIME type unknown to join parser, use default format\n", o);
@@ -448,16 +781,38 @@ static int httplink_recv_hdrcomplete(http_parser *parser)
 		printd("origin %p: No MIME type detected, use default format for join parser\n", o);
 		lft = HTTPLINK_DEFAULT_FORMAT;
 	}
+	/* header values are not needed anymore: release pbufs */
+	http_recvhdr_release(&o->response.hdr);
 
 	/* init format parser */
 	printd("origin %p: Initialize join parser with format id %d\n", o, lft);
 	init_lformat(&o->lfs, lft, 0);
 
+	/* AUTO links: responses with a known length are objects that are
+	 * delivered from their beginning and that can be persisted */
+	if (shfs_fio_link_type(o->fd) == SHFS_LTYPE_AUTO &&
+	    !(parser->flags & F_CHUNKED) &&
+	    parser->content_length != 0 &&
+	    parser->content_length != ULLONG_MAX) {
+		o->response.len = parser->content_length;
+		printd("origin %p: Object with %"PRIu64" bytes detected\n", o, o->response.len);
+#ifdef SHFS_FILL
+		if (shfs_fill_enabled() &&
+		    shfs_fill_reserve(o->response.len, &o->fill.start) == 0)
+			o->fill.state = HRLOF_FILL;
+#endif
+	}
+
+#ifdef TRACEPOINTS
+	tp_record(TP_HTTP_LINK_SETUP, tp_now() - o->tp_created);
+#endif
+
 	/* switch to connected phase */
 	o->sstate = HRLOS_CONNECTED;
 	o->cstate = HRLOC_CONNECTED;
 	o->to_pos = o->pos;
 	o->timeout = HTTP_LINK_RECEIVE_TIMEOUT;
+	o->ts_end = target_now_ns() + (uint64_t) o->timeshift * 1000000000ull;
 
 	/* we will announce to clients later since
 	 * we might retrieve some data already */
@@ -469,14 +824,84 @@ static int httplink_recv_datacomplete(http_parser *parser)
 {
 	struct http_req_link_origin *o = container_of(parser, struct http_req_link_origin, parser);
 
-	/* switch to end of stream phase */
-	httplink_close(o, HSC_CLOSE);
+	/* switch to end of stream phase: keep connection for next request */
+	if (!http_should_keep_alive(parser) || httplink_idle_put(o) < 0)
+		httplink_close(o, HSC_CLOSE);
 	o->sstate = HRLOS_EOF;
+
+#ifdef SHFS_FILL
+	if (o->fill.state == HRLOF_FILL) {
+		if (o->pos != o->response.len) {
+			httplink_fill_abort(o);
+		} else {
+			/* write out last (partially filled) buffer */
+			if (o->pos % shfs_vol.chunksize)
+				httplink_fill_write(o, o->cce_idx,
+						    o->pos - (o->pos % shfs_vol.chunksize));
+			if (o->fill.state == HRLOF_FILL) {
+				o->fill.state = HRLOF_FLUSH;
+				if (!o->fill.infly)
+					httplink_fill_finish(o);
+			}
+		}
+	}
+#endif
 	httplink_notify_clients(o);
 
 	return 0;
 }
 
+/* grows cce[] (and fill.t[]) for further time-shift buffers */
+static int httplink_grow_ring(struct http_req_link_origin *o)
+{
+	unsigned int len = min(o->cce_len << 1, o->cce_max_idx);
+	struct shfs_cache_entry **cce;
+#ifdef SHFS_FILL
+	SHFS_AIO_TOKEN **t;
+	unsigned int i;
+#endif
+
+	cce = realloc(o->cce, sizeof(*cce) * len);
+	if (unlikely(!cce))
+		return -ENOMEM;
+	o->cce = cce;
+#ifdef SHFS_FILL
+	t = realloc(o->fill.t, sizeof(*t) * len);
+	if (unlikely(!t))
+		return -ENOMEM;
+	o->fill.t = t;
+	for (i = o->cce_len; i < len; ++i)
+		o->fill.t[i] = NULL;
+#endif
+	o->cce_len = len;
+	return 0;
+}
+
+/* returns the index of the buffer that follows idx in the ring: buffers of
+ * the time-shift window are picked when the ring is passed the first time
+ * until the passed data spans the window, so that the ring size follows the
+ * stream rate; the ring is closed earlier if the cache is exhausted */
+static inline unsigned int httplink_next_buffer(struct http_req_link_origin *o, unsigned int idx)
+{
+	++idx;
+	if (idx == o->cce_nb && idx < o->cce_max_idx) {
+		if (target_now_ns() >= o->ts_end) {
+			printd("origin %p: Time-shift window spans %u buffers\n", o, idx);
+			o->cce_max_idx = idx;
+			return 0;
+		}
+		if (unlikely((idx == o->cce_len && httplink_grow_ring(o) < 0) ||
+		             shfs_cache_eblank(&(o->cce[idx])) < 0)) {
+			printd("origin %p: Could not allocate time-shift buffer %u, window is limited\n", o, idx);
+			o->cce_max_idx = idx;
+			return 0;
+		}
+		printd("origin %p: blank cache buffer %u @%p allocated\n", o, idx, o->cce[idx]);
+		++o->cce_nb;
+	}
+	return idx % o->cce_max_idx;
+}
+
 static int httplink_recv_data(http_parser *parser, const char *c, size_t len)
 {
 	struct http_req_link_origin *o = container_of(parser, struct http_req_link_origin, parser);
@@ -494,6 +919,12 @@ static int httplink_recv_data(http_parser *parser, const char *c, size_t len)
 		avail = shfs_vol.chunksize - bffr_off;
 		rlen = min(len, avail);
 
+#ifdef SHFS_FILL
+		/* buffer is reused while its previous content is still written */
+		if (unlikely(o->fill.state == HRLOF_FILL && o->fill.t[idx] != NULL))
+			httplink_fill_abort(o);
+#endif
+
 		printd("Save %"PRIu64" bytes to buffer %u (%p) at offset %"PRIu64" (pos=%"PRIu64")\n",
 		       rlen, idx, o->cce[idx]->buffer, bffr_off, pos);
 		//printh(c, rlen);
@@ -504,10 +935,15 @@ static int httplink_recv_data(http_parser *parser, const char *c, size_t len)
 		len -= rlen;
 		c   += rlen;
 		if (rlen == avail) {
+#ifdef SHFS_FILL
+			if (o->fill.state == HRLOF_FILL)
+				httplink_fill_write(o, idx, pos - shfs_vol.chunksize);
+#endif
 			/* point to next buffer is current is full */
-			idx = (idx + 1) % o->cce_max_idx;
-			if (idx > o->cce_max_idx)
-				o->lower_limit += shfs_vol.chunksize;
+			idx = httplink_next_buffer(o, idx);
+			/* data of the next buffer gets overwritten */
+			if (pos >= (size_t) o->cce_max_idx * shfs_vol.chunksize)
+				o->lower_limit = pos - (size_t) (o->cce_max_idx - 1) * shfs_vol.chunksize;
 		}
 	}
 
@@ -41,6 +41,9 @@
 #include "shfs_fio.h"
 #include "link_format.h"
 #include "hexdump.h"
+#ifdef SHFS_FILL
+#include "shfs_fill.h"
+#endif
 
 #define HTTPLINK_DEFAULT_FORMAT LFT_RAW512
 
@@ -66,10 +69,21 @@ enum http_req_link_origin_cstate {
 	HRLOC_CONNECTED,
 };
 
+#ifdef SHFS_FILL
+/* pull-through fill states */
+enum http_req_link_origin_fstate {
+	HRLOF_NONE = 0, /* no fill */
+	HRLOF_FILL,     /* object is received and written to the fill area */
+	HRLOF_FLUSH,    /* object was received completely, waiting for writes */
+	HRLOF_FAILED    /* fill was aborted, waiting for writes */
+};
+#endif
+
 struct http_req_link_origin {
 	struct tcp_pcb *tpcb;
 	ip_addr_t rip;
 	uint16_t rport;
+	int reused; /* tpcb is a keep-alive connection taken from the idle list */
 
 	SHFS_FD fd;
 
@@ -80,12 +94,16 @@ struct http_req_link_origin {
 
 	/* join management */
 	size_t pos; /* current position in the stream */
-	size_t lower_limit;
+	size_t lower_limit; /* oldest position that is still buffered */
 	struct lfstate lfs;
 
 	unsigned int cce_idx;
-	unsigned int cce_max_idx;
-	struct shfs_cache_entry *cce[HTTPREQ_LINK_MAXNB_BUFFERS];
+	unsigned int cce_max_idx; /* ring size */
+	unsigned int cce_nb; /* allocated buffers, time-shift buffers are picked on demand */
+	unsigned int cce_len; /* length of cce[] (and fill.t[]) */
+	struct shfs_cache_entry **cce;
+	unsigned int timeshift; /* time-shift window (sec) */
+	uint64_t ts_end; /* time-shift buffers are not picked anymore after this time */
 
 	struct http_parser parser;
 	struct {
@@ -98,8 +116,20 @@ struct http_req_link_origin {
 	struct {
 		struct http_recv_hdr hdr;
 		const char *mime;
+		char mime_b[HTTP_HDR_DLINE_MAXLEN]; /* copy of received MIME type */
+		uint64_t len; /* object length, 0 on streams */
 	} response;
 
+#ifdef SHFS_FILL
+	struct {
+		enum http_req_link_origin_fstate state;
+		chk_t start; /* reserved container in fill area */
+		unsigned int infly;
+		SHFS_AIO_TOKEN **t; /* write in progress on buffer */
+	} fill;
+	int destroy; /* destruction is deferred until fill writes are done */
+#endif
+
 	size_t to_pos;
 	uint16_t timeout;
 
@@ -107,17 +137,46 @@ struct http_req_link_origin {
 	dlist_head(clients);
 	uint32_t nb_clients;
 
+#ifdef TRACEPOINTS
+	tp_ts_t tp_created;
+#endif
+
+	struct mempool_obj *pobj;
+};
+
+/* idle keep-alive connection to an origin server */
+struct http_link_idle {
+	struct tcp_pcb *tpcb;
+	struct shfs_host rhost;
+	uint16_t rport;
+	uint16_t timeout;
+
+	dlist_el(idle);
 	struct mempool_obj *pobj;
 };
 
 int   httplink_init   (struct http_srv *hs);
 void  httplink_exit   (struct http_srv *hs);
+void  httplink_destroy(struct http_req_link_origin *o);
 err_t httplink_close  (struct http_req_link_origin *o, enum http_sess_close type);
 err_t httplink_connected(void *argp, struct tcp_pcb * tpcb, err_t err);
 err_t httplink_sent   (void *argp, struct tcp_pcb *tpcb, uint16_t len);
 err_t httplink_recv   (void *argp, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
 void  httplink_error  (void *argp, err_t err);
 err_t httplink_poll   (void *argp, struct tcp_pcb *tpcb);
+int   httplink_reuse  (struct http_req_link_origin *o);
+int   httplink_dnscache_lookup(const struct shfs_host *h, ip_addr_t *out);
+void  httplink_dnscache_add   (const struct shfs_host *h, const ip_addr_t *ip);
+
+static inline void httplink_attach(struct http_req_link_origin *o)
+{
+	tcp_arg(o->tpcb, o);
+	tcp_recv(o->tpcb, httplink_recv); /* recv callback */
+	tcp_sent(o->tpcb, httplink_sent); /* sent ack callback */
+	tcp_err (o->tpcb, httplink_error); /* err callback */
+	tcp_poll(o->tpcb, httplink_poll, HTTP_POLL_INTERVAL); /* poll callback */
+	tcp_setprio(o->tpcb, HTTP_LINK_TCP_PRIO);
+}
 
 static inline void httplink_notify_clients(struct http_req_link_origin *o)
 {
@@ -161,17 +220,29 @@ static inline int httpreq_link_prepare_hdr(struct http_req *hreq)
 	o->fd = shfs_fio_openf(hreq->fd);
 	if (!o->fd)
 		goto err_free_o;
-	o->tpcb = tcp_new();
-	if (!o->tpcb)
+	o->tpcb = NULL; /* connection is set up in httpreq_link_build_hdr() */
+	o->reused = 0;
+	tp_stamp(o->tp_created);
+
+	/* init buffers: the ring is extended by time-shift buffers
+	 * on demand (see httplink_next_buffer()) */
+	o->cce_len = httpreq_link_nb_buffers(shfs_vol.chunksize);
+	o->cce = malloc(sizeof(*o->cce) * o->cce_len);
+	if (!o->cce)
 		goto err_close_fd;
-
-	/* init buffers */
-	o->cce_max_idx = httpreq_link_nb_buffers(shfs_vol.chunksize);
-	for (i = 0; i < o->cce_max_idx; ++i) {
+#ifdef SHFS_FILL
+	o->fill.t = malloc(sizeof(*o->fill.t) * o->cce_len);
+	if (!o->fill.t)
+		goto err_free_cce_a;
+#endif
+	for (i = 0; i < o->cce_len; ++i) {
 		if (shfs_cache_eblank(&(o->cce[i])) < 0)
 			goto err_free_cce;
 		printd("origin %p: blank cache buffer %u @%p allocated\n", o, i, o->cce[i]);
 	}
+	o->cce_nb = o->cce_len;
+	o->timeshift = hs->link_timeshift;
+	o->cce_max_idx = o->cce_nb + (o->timeshift ? HTTP_LINK_TIMESHIFT_MAXNB_BUFFERS : 0);
 	o->cce_idx = 0;
 	o->pos = 0;
 	o->lower_limit = 0;
@@ -192,6 +263,15 @@ static inline int httpreq_link_prepare_hdr(struct http_req *hreq)
 	http_parser_init(&o->parser, HTTP_RESPONSE);
 	http_recvhdr_reset(&o->response.hdr);
 	o->response.mime = NULL;
+	o->response.len = 0;
+
+#ifdef SHFS_FILL
+	o->fill.state = HRLOF_NONE;
+	o->fill.infly = 0;
+	for (i = 0; i < o->cce_len; ++i)
+		o->fill.t[i] = NULL;
+	o->destroy = 0;
+#endif
 
 	/* init state */
 	http_sendhdr_reset(&o->request.hdr);
@@ -202,14 +282,6 @@ static inline int httpreq_link_prepare_hdr(struct http_req *hreq)
 	o->sstate = HRLOS_RESOLVE;
 	o->cstate = HRLOC_ERROR;
 
-	/* set tcp callbacks */
-	tcp_arg(o->tpcb, o);
-	tcp_recv(o->tpcb, httplink_recv); /* recv callback */
-	tcp_sent(o->tpcb, httplink_sent); /* sent ack callback */
-	tcp_err (o->tpcb, httplink_error); /* err callback */
-	tcp_poll(o->tpcb, httplink_poll, HTTP_POLL_INTERVAL); /* poll callback */
-	tcp_setprio(o->tpcb, HTTP_LINK_TCP_PRIO);
-
 	/* add cookie to file descriptor
 	 * (never fails because we checked for NULL already ahead) */
 	shfs_fio_set_cookie(o->fd, o);
@@ -222,6 +294,11 @@ static inline int httpreq_link_prepare_hdr(struct http_req *hreq)
 		printd("origin %p: release blank cache buffer %u @%p...\n", o, i - 1, o->cce[i - 1]);
 		shfs_cache_release(o->cce[i - 1]);
 	}
+#ifdef SHFS_FILL
+	free(o->fill.t);
+ err_free_cce_a:
+#endif
+	free(o->cce);
  err_close_fd:
 	shfs_fio_close(o->fd);
  err_free_o:
@@ -234,6 +311,10 @@ static inline int httpreq_link_prepare_hdr(struct http_req *hreq)
 void httpreq_link_dnscb(const char *name, ip_addr_t *ipaddr, void *argp);
 #endif
 
+/* objects are joined at their beginning (first buffer still has to be there) */
+#define httplink_can_join_obj(o) \
+	((o)->pos <= ((size_t) (o)->cce_max_idx * shfs_vol.chunksize))
+
 static inline int httpreq_link_build_hdr(struct http_req *hreq)
 {
 	//struct http_srv *hs = hreq->hsess->hs;
@@ -246,9 +327,18 @@ static inline int httpreq_link_build_hdr(struct http_req *hreq)
 	/* connection procedure */
 	switch(o->sstate) {
 	case HRLOS_RESOLVE:
+		o->rport = shfs_fio_link_rport(o->fd);
+		/* send request on an idle keep-alive connection to the origin */
+		if (httplink_reuse(o) == 0)
+			return -EAGAIN;
+
 		/* resolv remote host name */
 		printd("Resolving origin host address...\n");
-		o->rport = shfs_fio_link_rport(o->fd);
+		if (httplink_dnscache_lookup(shfs_fio_link_rhost(o->fd), &o->rip) == 0) {
+			printd("Origin host address found in cache\n");
+			o->sstate = HRLOS_CONNECT;
+			goto case_HRLOS_CONNECT;
+		}
 #if LWIP_DNS
 		ret = shfshost2ipaddr(shfs_fio_link_rhost(o->fd), &o->rip, httpreq_link_dnscb, hreq);
 		if (ret >= 1) {
@@ -263,6 +353,7 @@ static inline int httpreq_link_build_hdr(struct http_req *hreq)
 			goto err_out;
 		}
 		printd("Resolution could be done directly\n");
+		httplink_dnscache_add(shfs_fio_link_rhost(o->fd), &o->rip);
 		o->sstate = HRLOS_CONNECT;
 		goto case_HRLOS_CONNECT;
 
@@ -270,14 +361,28 @@ static inline int httpreq_link_build_hdr(struct http_req *hreq)
 	case HRLOS_CONNECT:
 		/* connect to remote */
 		printd("Connecting to origin host...\n");
+		o->tpcb = tcp_new();
+		if (!o->tpcb)
+			goto err_out;
+		httplink_attach(o);
 		o->timeout = HTTP_LINK_CONNECT_TIMEOUT;
 		err = tcp_connect(o->tpcb, &o->rip, o->rport, httplink_connected);
 		if (err != ERR_OK)
 			goto err_out;
+		++hs->link_stats.connects;
 		o->sstate = HRLOS_WAIT;
 		return -EAGAIN;
 
+	case HRLOS_EOF:
+		/* stream has ended already, only objects can be delivered */
+		if (!o->response.len)
+			goto err_late;
 	case HRLOS_CONNECTED:
+		/* objects are delivered from their beginning: joining is only
+		 * possible as long as the first buffer was not overwritten */
+		if (o->response.len && !httplink_can_join_obj(o))
+			goto err_late;
+
 		/* create header for client */
 		nb_slines = http_sendhdr_get_nbslines(&hreq->response.hdr);
 		nb_dlines = http_sendhdr_get_nbdlines(&hreq->response.hdr);
@@ -291,9 +396,24 @@ static inline int httpreq_link_build_hdr(struct http_req *hreq)
 			http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
 					       "%s: %s\r\n", _http_dhdr[HTTP_DHDR_MIME], o->response.mime);
 		hreq->is_stream = 1;
-		/* most recent join point in stream */
-		hreq->l.pos     = hreq->l.acked_pos = lformat_getrjoin(&o->lfs);
-		hreq->l.cce_idx = (hreq->l.pos / shfs_vol.chunksize) % o->cce_max_idx;
+		if (o->response.len) {
+			http_sendhdr_add_dline(&hreq->response.hdr, &nb_dlines,
+					       "%s: %"PRIu64"\r\n", _http_dhdr[HTTP_DHDR_SIZE], o->response.len);
+			hreq->l.pos     = hreq->l.acked_pos = 0;
+			hreq->l.cce_idx = 0;
+		} else {
+			/* most recent join point in stream or the oldest one
+			 * that is still in the time-shift window; the
+			 * buffer at lower_limit is skipped because it is
+			 * overwritten next */
+			if (hs->link_tsjoin)
+				hreq->l.pos = lformat_getjoin_from(&o->lfs, o->lower_limit ?
+								   o->lower_limit + shfs_vol.chunksize : 0);
+			else
+				hreq->l.pos = lformat_getrjoin(&o->lfs);
+			hreq->l.acked_pos = hreq->l.pos;
+			hreq->l.cce_idx = (hreq->l.pos / shfs_vol.chunksize) % o->cce_max_idx;
+		}
 
 		http_sendhdr_set_nbslines(&hreq->response.hdr, nb_slines);
 		http_sendhdr_set_nbdlines(&hreq->response.hdr, nb_dlines);
@@ -312,13 +432,16 @@ static inline int httpreq_link_build_hdr(struct http_req *hreq)
 	printd("Error happened on origin %p, exiting request %p\n", o, hreq);
 	o->sstate = HRLOS_ERROR;
 	return -1;
+
+ err_late: /* will end up in err503_hdr, origin is not affected */
+	printd("Request %p is too late to join origin %p\n", hreq, o);
+	return -1;
 }
 
 static inline void httpreq_link_close(struct http_req *hreq)
 {
 	//struct http_srv *hs = hreq->hsess->hs;
 	struct http_req_link_origin *o = hreq->l.origin;
-	unsigned int i;
 
 	--o->nb_clients;
 	dlist_unlink(hreq, o->clients, l.clients);
@@ -329,13 +452,7 @@ static inline void httpreq_link_close(struct http_req *hreq)
 		dlist_unlink(o, hs->links, links);
 		if (o->tpcb) /* close connection to origin if not done yet */
 			httplink_close(o, HSC_CLOSE);
-		for (i = 0; i < o->cce_max_idx; ++i) {
-			printd("origin %p: release blank cache buffer %u @%p...\n", o, i, o->cce[i]);
-			shfs_cache_release(o->cce[i]);
-		}
-		shfs_fio_close(o->fd);
-		mempool_put(o->pobj);
-		printd("origin %p destroyed\n", o);
+		httplink_destroy(o);
 	}
 }
 
@@ -357,6 +474,10 @@ static inline err_t httpreq_write_link(struct http_req *hreq, size_t *sent)
 	idx        = hreq->l.cce_idx;
 	slen_total = 0;
 
+	/* ring got limited to the buffers that could be allocated */
+	if (unlikely(idx >= o->cce_max_idx))
+		idx = 0;
+
 	/* Are we still within the stream window? */
 	if (unlikely(hreq->l.acked_pos < o->lower_limit)) {
 		printd("Request %p lost sync with origin %p (pos=%"PRIu64" < lower_limit%"PRIu64"). Connection will be dropped...\n",
@@ -404,6 +525,9 @@ static inline err_t httpreq_write_link(struct http_req *hreq, size_t *sent)
 	hreq->l.pos     = pos;
 	*sent          += slen_total;
 
+	if (o->response.len && pos == o->response.len)
+		return ERR_CONN; /* object was sent completely */
+
 	if (unlikely(o->sstate != HRLOS_CONNECTED && err != ERR_OK && err != ERR_MEM))
 		return ERR_CONN; /* this error code is used to signal that we run out of data */
 	return err;
@@ -0,0 +1,127 @@
+/*
+ * Fast HTTP Server Implementation for SHFS volumes
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#ifndef _HTTP_PACE_H_
+#define _HTTP_PACE_H_
+
+#include "http_defs.h"
+
+#ifdef HTTP_PACING
+/*
+ * Per-session egress pacing of file responses (token bucket)
+ *
+ * The bucket is refilled with the rate of the current response and
+ * holds at most HTTP_PACE_BURST_NS worth of data. When a session runs
+ * out of tokens, it is parked on a timer wheel (HTTP_PACE_TICK_NS
+ * granularity) that is served by http_poll_pacing().
+ */
+#define _http_pace_tick(ns)   ((ns) / HTTP_PACE_TICK_NS)
+#define _http_pace_slot(tick) ((tick) % HTTP_PACE_WHEEL_LEN)
+#define _http_pace_head(tick) (hs->pace_wheel[_http_pace_slot((tick))])
+
+#define httpsess_pace_is_deferred(hsess) \
+	dlist_is_linked((hsess), _http_pace_head((hsess)->pace.expiry), pace.wheel)
+
+/* rate in B/s, 0 disables pacing for the current response */
+static inline void httpsess_pace_start(struct http_sess *hsess, uint32_t rate)
+{
+	hsess->pace.rate = rate;
+	if (!rate)
+		return;
+
+	hsess->pace.burst  = max((uint32_t) HTTP_PACE_MIN_BURST,
+	                         (uint32_t) (((uint64_t) rate * HTTP_PACE_BURST_NS) / 1000000000ULL));
+	hsess->pace.tokens = hsess->pace.burst;
+	hsess->pace.ts     = target_now_ns();
+	++hs->pace_stats.reqs;
+}
+
+/* refills the bucket and returns the number of bytes that can be sent now */
+static inline size_t httpsess_pace_avail(struct http_sess *hsess)
+{
+	uint64_t now = target_now_ns();
+	uint64_t dt = now - hsess->pace.ts;
+	uint64_t add;
+
+	if (dt > 1000000000ULL)
+		dt = 1000000000ULL; /* bucket is full anyways, avoids overflow */
+	add = (dt * hsess->pace.rate) / 1000000000ULL;
+	if (add) {
+		hsess->pace.tokens = min(hsess->pace.tokens + add, (uint64_t) hsess->pace.burst);
+		hsess->pace.ts = now;
+	}
+	return (size_t) hsess->pace.tokens;
+}
+
+static inline void httpsess_pace_consume(struct http_sess *hsess, size_t len)
+{
+	hsess->pace.tokens -= min((uint64_t) len, hsess->pace.tokens);
+	hs->pace_stats.bytes += len;
+}
+
+/* parks the session on the timer wheel until 'need' bytes are available
+ * (at most one wheel turn ahead, the session is deferred again if
+ * it still has to wait) */
+static inline void httpsess_pace_defer(struct http_sess *hsess, size_t need)
+{
+	uint64_t wait_ns;
+	uint64_t tick;
+
+	if (httpsess_pace_is_deferred(hsess))
+		return;
+
+	wait_ns = (((uint64_t) need - min((uint64_t) need, hsess->pace.tokens))
+	           * 1000000000ULL) / hsess->pace.rate;
+	tick = _http_pace_tick(target_now_ns() + wait_ns) + 1;
+	if (tick - hs->pace_tick >= HTTP_PACE_WHEEL_LEN)
+		tick = hs->pace_tick + HTTP_PACE_WHEEL_LEN - 1;
+
+	hsess->pace.expiry = tick;
+	dlist_append(hsess, _http_pace_head(tick), pace.wheel);
+	++hs->pace_nb_deferred;
+	++hs->pace_stats.defers;
+}
+
+static inline void httpsess_pace_cancel(struct http_sess *hsess)
+{
+	if (httpsess_pace_is_deferred(hsess)) {
+		dlist_unlink(hsess, _http_pace_head(hsess->pace.expiry), pace.wheel);
+		--hs->pace_nb_deferred;
+	}
+}
+#endif /* HTTP_PACING */
+
+#endif /* _HTTP_PACE_H_ */
@@ -2145,6 +2145,12 @@ http_parser_init (http_parser *parser, enum http_parser_type t)
   parser->http_errno = HPE_OK;
 }
 
+int
+http_parser_is_idle (const http_parser *parser)
+{
+  return parser->state == start_state;
+}
+
 void
 http_parser_settings_init(http_parser_settings *settings)
 {
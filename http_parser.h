@@ -294,6 +294,10 @@ unsigned long http_parser_version(void);
 
 void http_parser_init(http_parser *parser, enum http_parser_type type);
 
+/* Returns 1 if the parser waits for the beginning of a new message
+ * (no partial message was fed), 0 otherwise */
+int http_parser_is_idle(const http_parser *parser);
+
 
 /* Initialize http_parser_settings members to 0
  */
@@ -0,0 +1,126 @@
+/*
+ * Log-linear latency histograms for benchmarks
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _LATHIST_H_
+#define _LATHIST_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Values are sorted into power-of-two ranges that are split into
+ * LATHIST_SUB_BKTS linear sub-buckets, so the relative error of a recorded
+ * value is below 1/LATHIST_SUB_BKTS (same scheme as the tracepoint
+ * histograms, with a finer resolution for percentile reports).
+ */
+#define LATHIST_SUB_BITS 4
+#define LATHIST_SUB_BKTS (1 << LATHIST_SUB_BITS)
+#define LATHIST_NB_BKTS  ((64 - LATHIST_SUB_BITS + 1) * LATHIST_SUB_BKTS)
+
+struct lathist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t bkt[LATHIST_NB_BKTS];
+};
+
+static inline void lathist_reset(struct lathist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = UINT64_MAX;
+}
+
+static inline unsigned int lathist_bkt(uint64_t v)
+{
+	unsigned int shift;
+
+	if (v < LATHIST_SUB_BKTS)
+		return (unsigned int) v;
+	shift = (63 - __builtin_clzll(v)) - LATHIST_SUB_BITS;
+	return ((shift + 1) << LATHIST_SUB_BITS)
+		+ (unsigned int) ((v >> shift) & (LATHIST_SUB_BKTS - 1));
+}
+
+/* smallest value of a bucket */
+static inline uint64_t lathist_bkt_base(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < LATHIST_SUB_BKTS)
+		return b;
+	shift = (b >> LATHIST_SUB_BITS) - 1;
+	return (uint64_t) (LATHIST_SUB_BKTS + (b & (LATHIST_SUB_BKTS - 1))) << shift;
+}
+
+/* center of a bucket */
+static inline uint64_t lathist_bkt_val(unsigned int b)
+{
+	if (b < LATHIST_SUB_BKTS)
+		return b;
+	return lathist_bkt_base(b) + ((1ULL << ((b >> LATHIST_SUB_BITS) - 1)) >> 1);
+}
+
+static inline void lathist_add(struct lathist *h, uint64_t v)
+{
+	++h->bkt[lathist_bkt(v)];
+	++h->count;
+	h->sum += v;
+	if (v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+}
+
+/* pp: percentile in parts per 10000 (e.g., 9990 for p99.9) */
+static inline uint64_t lathist_pct(const struct lathist *h, unsigned int pp)
+{
+	uint64_t target, sum = 0;
+	unsigned int b;
+
+	if (!h->count)
+		return 0;
+	target = (h->count * pp + 9999) / 10000;
+	if (!target)
+		target = 1;
+	for (b = 0; b < LATHIST_NB_BKTS; ++b) {
+		sum += h->bkt[b];
+		if (sum >= target)
+			return lathist_bkt_val(b) < h->max ? lathist_bkt_val(b) : h->max;
+	}
+	return h->max;
+}
+
+#endif /* _LATHIST_H_ */
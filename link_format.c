@@ -33,33 +33,61 @@
  *
  * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
  */
-
+#include <sys/types.h>
+#include <stdint.h>
 #include "link_format.h"
 #include "string.h"
 
-enum lftype mime_to_lftype(const char *mime) {
-	enum lftype ret;
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
 
-	/* TODO: returned type is fixed type for now (independent of mime) */
-	ret = LFT_RAW512;
+/* compares the media type of a MIME string (parameters are ignored) */
+static int _mime_is(const char *mime, const char *type)
+{
+	size_t l = strlen(type);
 
-	if (strcasecmp("audio/mpeg",     mime) == 0 ||
-	    strcasecmp("audio/mpeg3",    mime) == 0 ||
-	    strcasecmp("audio/x-mpeg-3", mime) == 0) {
-		ret = LFT_MP3;
-	}
+	if (strncasecmp(mime, type, l) != 0)
+		return 0;
+	return (mime[l] == '\0' || mime[l] == ';' || mime[l] == ' ');
+}
 
-	return ret;
+enum lftype mime_to_lftype(const char *mime) {
+	if (_mime_is(mime, "audio/mpeg")     ||
+	    _mime_is(mime, "audio/mpeg3")    ||
+	    _mime_is(mime, "audio/x-mpeg-3") ||
+	    _mime_is(mime, "audio/mp3"))
+		return LFT_MP3;
+	if (_mime_is(mime, "audio/aac")      ||
+	    _mime_is(mime, "audio/aacp")     ||
+	    _mime_is(mime, "audio/x-aac"))
+		return LFT_ADTS;
+	if (_mime_is(mime, "video/mp2t")     ||
+	    _mime_is(mime, "video/mpeg")     ||
+	    _mime_is(mime, "audio/mp2t"))
+		return LFT_MPEGTS;
+	if (_mime_is(mime, "video/mp4")      ||
+	    _mime_is(mime, "audio/mp4")      ||
+	    _mime_is(mime, "video/iso.segment"))
+		return LFT_FMP4;
+
+	return LFT_RAW512;
 }
 
 int init_lformat(struct lfstate *lfs, enum lftype type, size_t offset)
 {
-	/* TODO: supported type is fixed for now */
 	if (type == LFT_UNKNOWN)
 		return -EINVAL;
   
 	lfs->type = type;
+	lfs->offset = offset;
 	lfs->pos  = offset;
+	lfs->next = offset;
+	lfs->synced = 0;
+	lfs->need = 0;
+	lfs->hlen = 0;
+	lfs->prefix = (size_t) -1;
+	lfs->keyflags = 0;
 	lfs->joins.num = 0;
 	lfs->joins.head = 0;
 	return 0;
@@ -76,6 +104,303 @@ int init_lformat(struct lfstate *lfs, enum lftype type, size_t offset)
 		(lfs)->joins.offset[(lfs)->joins.head] = (off);				\
 	} while(0)
 
+/* adds a join point on frame formats: the frame at off must have been
+ * predicted by its predecessor (avoids joins on false syncs) */
+static inline void _lformat_add_fjoin(struct lfstate *lfs, size_t off)
+{
+	if (!lfs->synced)
+		return;
+	if (lfs->joins.num && off < lformat_getrjoin(lfs) + LF_JOIN_MINDIST)
+		return;
+	_lformat_add_join(lfs, off);
+}
+
+/* returns pointer to first occurrence of c in b, NULL if there is none */
+static inline const uint8_t *_lformat_scan(const uint8_t *b, size_t len, uint8_t c)
+{
+#if defined __SSE2__
+	__m128i vc = _mm_set1_epi8((char) c);
+	uint32_t m;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (b + i)), vc));
+		if (m)
+			return b + i + __builtin_ctz(m);
+	}
+	for (; i < len; ++i) {
+		if (b[i] == c)
+			return b + i;
+	}
+	return NULL;
+#else
+	return (const uint8_t *) memchr(b, c, len);
+#endif
+}
+
+#define LF_INVALID  (-1) /* no frame header */
+#define LF_NEEDMORE (0)  /* more header bytes are needed (lfs->need is updated) */
+
+/*
+ * Frame header checks
+ * They return the frame length, LF_INVALID or LF_NEEDMORE
+ */
+static const uint16_t _mp3_kbps[5][16] = {
+	{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 }, /* V1 L1 */
+	{ 0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384, 0 }, /* V1 L2 */
+	{ 0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 0 }, /* V1 L3 */
+	{ 0, 32, 48, 56,  64,  80,  96, 112, 128, 144, 160, 176, 192, 224, 256, 0 }, /* V2 L1 */
+	{ 0,  8, 16, 24,  32,  40,  48,  56,  64,  80,  96, 112, 128, 144, 160, 0 }, /* V2 L2/L3 */
+};
+static const uint16_t _mp3_hz[3] = { 44100, 48000, 32000 }; /* V1, /2 on V2, /4 on V2.5 */
+
+static ssize_t _lformat_check_mp3(struct lfstate *lfs, const uint8_t *h)
+{
+	unsigned int ver, layer, bri, sri, pad, tab;
+	uint32_t br, sr;
+
+	if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+		return LF_INVALID;
+	ver   = (h[1] >> 3) & 0x3; /* 0: V2.5, 1: reserved, 2: V2, 3: V1 */
+	layer = (h[1] >> 1) & 0x3; /* 1: L3, 2: L2, 3: L1, 0: reserved */
+	bri   = (h[2] >> 4) & 0xF;
+	sri   = (h[2] >> 2) & 0x3;
+	pad   = (h[2] >> 1) & 0x1;
+	if (ver == 1 || layer == 0 || bri == 0 || bri == 15 || sri == 3)
+		return LF_INVALID;
+
+	if (ver == 3)
+		tab = 3 - layer; /* L1: 0, L2: 1, L3: 2 */
+	else
+		tab = (layer == 3) ? 3 : 4;
+	br = (uint32_t) _mp3_kbps[tab][bri] * 1000;
+	sr = _mp3_hz[sri] >> (ver == 3 ? 0 : (ver == 2 ? 1 : 2));
+
+	_lformat_add_fjoin(lfs, lfs->next);
+	if (layer == 3)
+		return (ssize_t) (((12 * br) / sr + pad) * 4);
+	if (layer == 1 && ver != 3)
+		return (ssize_t) ((72 * br) / sr + pad);
+	return (ssize_t) ((144 * br) / sr + pad);
+}
+
+static ssize_t _lformat_check_adts(struct lfstate *lfs, const uint8_t *h)
+{
+	size_t flen;
+
+	/* 12 bit sync word, layer is always 0 */
+	if (h[0] != 0xFF || (h[1] & 0xF6) != 0xF0)
+		return LF_INVALID;
+	if (((h[2] >> 2) & 0xF) > 12) /* sampling frequency index */
+		return LF_INVALID;
+	flen = ((size_t) (h[3] & 0x3) << 11) | ((size_t) h[4] << 3) | ((size_t) h[5] >> 5);
+	if (flen < 7)
+		return LF_INVALID;
+
+	_lformat_add_fjoin(lfs, lfs->next);
+	return (ssize_t) flen;
+}
+
+#define TS_PACKET_LEN 188
+
+static ssize_t _lformat_check_ts(struct lfstate *lfs, const uint8_t *h)
+{
+	unsigned int pid, pusi, afc, plo;
+	int rai = 0;
+
+	if (h[0] != 0x47)
+		return LF_INVALID;
+	pid  = ((h[1] & 0x1F) << 8) | h[2];
+	pusi = h[1] & 0x40;
+	afc  = (h[3] >> 4) & 0x3;
+	if (afc == 0)
+		return LF_INVALID;
+
+	/* adaptation field: random access indicator marks a keyframe */
+	plo = 4;
+	if (afc & 0x2) {
+		if (h[4] > TS_PACKET_LEN - 5)
+			return LF_INVALID;
+		if (h[4] > 0)
+			rai = h[5] & 0x40;
+		plo += 1 + h[4];
+	}
+	if (rai)
+		lfs->keyflags = 1;
+
+	if (pid == 0 && pusi) {
+		/* PAT: program tables should lead the keyframe */
+		lfs->prefix = lfs->next;
+		return TS_PACKET_LEN;
+	}
+
+	if (!rai && !lfs->keyflags && pusi && (afc & 0x1) &&
+	    plo + 4 <= TS_PACKET_LEN) {
+		/* no random access indicators in this stream:
+		 * fall back to the start of video PES packets */
+		if (lfs->need < plo + 4) {
+			lfs->need = plo + 4;
+			return LF_NEEDMORE;
+		}
+		if (h[plo] == 0x00 && h[plo + 1] == 0x00 && h[plo + 2] == 0x01 &&
+		    (h[plo + 3] & 0xF0) == 0xE0)
+			rai = 1;
+	}
+
+	if (rai) {
+		if (lfs->prefix != (size_t) -1 &&
+		    lfs->next - lfs->prefix <= 64 * TS_PACKET_LEN)
+			_lformat_add_fjoin(lfs, lfs->prefix);
+		else
+			_lformat_add_fjoin(lfs, lfs->next);
+		lfs->prefix = (size_t) -1;
+	}
+	return TS_PACKET_LEN;
+}
+
+static inline int _lformat_isboxtype(const uint8_t *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; ++i) {
+		if (!((t[i] >= 'a' && t[i] <= 'z') ||
+		      (t[i] >= 'A' && t[i] <= 'Z') ||
+		      (t[i] >= '0' && t[i] <= '9') ||
+		      t[i] == ' ' || t[i] == '-'))
+			return 0;
+	}
+	return 1;
+}
+
+static ssize_t _lformat_check_fmp4(struct lfstate *lfs, const uint8_t *h)
+{
+	uint64_t blen;
+	int moof;
+
+	if (!_lformat_isboxtype(&h[4]))
+		return LF_INVALID;
+	moof = (memcmp(&h[4], "moof", 4) == 0);
+	if (!lfs->synced && !moof)
+		return LF_INVALID; /* resync on movie fragments only */
+
+	blen = ((uint64_t) h[0] << 24) | ((uint64_t) h[1] << 16) | ((uint64_t) h[2] << 8) | h[3];
+	if (blen == 1) {
+		/* 64-bit box size */
+		if (lfs->need < 16) {
+			lfs->need = 16;
+			return LF_NEEDMORE;
+		}
+		blen = ((uint64_t) h[8]  << 56) | ((uint64_t) h[9]  << 48) |
+		       ((uint64_t) h[10] << 40) | ((uint64_t) h[11] << 32) |
+		       ((uint64_t) h[12] << 24) | ((uint64_t) h[13] << 16) |
+		       ((uint64_t) h[14] <<  8) | h[15];
+		if (blen < 16)
+			return LF_INVALID;
+	} else if (blen < 8) {
+		return LF_INVALID; /* box extends to end of file or is broken */
+	}
+	if (blen > (uint64_t) (SIZE_MAX >> 1))
+		return LF_INVALID;
+
+	if (moof) {
+		/* a segment type box right ahead leads the fragment */
+		if (lfs->prefix != (size_t) -1)
+			_lformat_add_fjoin(lfs, lfs->prefix);
+		else
+			_lformat_add_fjoin(lfs, lfs->next);
+		lfs->prefix = (size_t) -1;
+	} else {
+		lfs->prefix = (memcmp(&h[4], "styp", 4) == 0) ? lfs->next : (size_t) -1;
+	}
+	return (ssize_t) blen;
+}
+
+/*
+ * Frame parser: follows the frame chain of a stream without copying it.
+ * Header bytes are only copied to lfs->hdr when a header spans two buffers.
+ * When the sync is lost, the next candidate is searched with a (SIMD) scan
+ * for the sync byte.
+ */
+static void _lformat_parse_frames(struct lfstate *lfs, const uint8_t *b, size_t len)
+{
+	const size_t start = lfs->pos - len;
+	const size_t end = lfs->pos;
+	const uint8_t *h;
+	const uint8_t *s;
+	size_t off, clen;
+	unsigned int minhdr;
+	ssize_t flen;
+	uint8_t sbyte;
+	size_t soff;
+
+	switch (lfs->type) {
+	case LFT_MP3:    minhdr = 4;  sbyte = 0xFF; soff = 0; break;
+	case LFT_ADTS:   minhdr = 7;  sbyte = 0xFF; soff = 0; break;
+	case LFT_MPEGTS: minhdr = 6;  sbyte = 0x47; soff = 0; break;
+	case LFT_FMP4:   minhdr = 8;  sbyte = 'm';  soff = 4; break;
+	default:
+		return;
+	}
+
+	for (;;) {
+		if (!lfs->synced && !lfs->hlen) {
+			/* search for next sync candidate */
+			off = (lfs->next > start) ? lfs->next - start : 0;
+			if (off + soff >= len) {
+				lfs->next = end;
+				break;
+			}
+			s = _lformat_scan(b + off + soff, len - off - soff, sbyte);
+			if (!s) {
+				lfs->next = end;
+				break;
+			}
+			lfs->next = start + (size_t) (s - b) - soff;
+		}
+		if (lfs->next >= end)
+			break; /* frame starts in one of the next buffers */
+		if (!lfs->hlen)
+			lfs->need = minhdr;
+
+	check:
+		if (!lfs->hlen && lfs->next + lfs->need <= end) {
+			h = b + (lfs->next - start);
+		} else {
+			/* header spans buffers: collect it */
+			off  = lfs->next + lfs->hlen - start;
+			clen = lfs->need - lfs->hlen;
+			if (clen > len - off)
+				clen = len - off;
+			memcpy(&lfs->hdr[lfs->hlen], b + off, clen);
+			lfs->hlen += clen;
+			if (lfs->hlen < lfs->need)
+				break; /* wait for next buffer */
+			h = lfs->hdr;
+		}
+
+		switch (lfs->type) {
+		case LFT_MP3:    flen = _lformat_check_mp3(lfs, h);  break;
+		case LFT_ADTS:   flen = _lformat_check_adts(lfs, h); break;
+		case LFT_MPEGTS: flen = _lformat_check_ts(lfs, h);   break;
+		default:         flen = _lformat_check_fmp4(lfs, h); break;
+		}
+		if (flen == LF_NEEDMORE)
+			goto check;
+		lfs->hlen = 0;
+
+		if (flen == LF_INVALID) {
+			/* lost sync: continue search after this candidate */
+			lfs->synced = 0;
+			lfs->prefix = (size_t) -1;
+			lfs->next += 1;
+			continue;
+		}
+		lfs->next += (size_t) flen;
+		if (lfs->synced < UINT32_MAX)
+			++lfs->synced;
+	}
+}
+
 int lformat_parse(struct lfstate *lfs, const char *b, size_t len)
 {
 	size_t next;
@@ -92,11 +417,10 @@ int lformat_parse(struct lfstate *lfs, const char *b, size_t len)
 		break;
 
 	case LFT_MP3:
-		next = lformat_getrjoin(lfs) + 81920;
-		while (next < lfs->pos) {
-			_lformat_add_join(lfs, next);
-			next += 81920;
-		}
+	case LFT_ADTS:
+	case LFT_MPEGTS:
+	case LFT_FMP4:
+		_lformat_parse_frames(lfs, (const uint8_t *) b, len);
 		break;
 
 	default: /* unsupported type */
@@ -41,12 +41,17 @@
 #include <inttypes.h>
 #include <errno.h>
 
-#define LF_MAXNB_JOINS 2 /* keep two recent join offsets */
+#define LF_MAXNB_JOINS 16 /* keep 16 recent join offsets (time-shift joins) */
+#define LF_JOIN_MINDIST 16384 /* min. distance of join points on frame formats */
+#define LF_MAXHDRLEN 188 /* max. number of bytes needed to check a frame header */
 
 enum lftype {
 	LFT_UNKNOWN = 0,
 	LFT_RAW512, /* 512B */
-	LFT_MP3, /* 80KB */
+	LFT_MP3, /* MPEG audio frames */
+	LFT_ADTS, /* AAC in ADTS frames */
+	LFT_MPEGTS, /* MPEG transport stream, joins at keyframes */
+	LFT_FMP4, /* fragmented MP4, joins at movie fragments */
 };
 
 struct lfstate {
@@ -56,6 +61,16 @@ struct lfstate {
 	size_t offset;
 	size_t pos;
 
+	/* frame parser: next is the position of the next frame (synced)
+	 * or where the search for a sync point continues (not synced) */
+	size_t next;
+	unsigned int synced; /* number of consecutive frames found */
+	unsigned int need; /* header bytes needed to check frame at next */
+	unsigned int hlen; /* header bytes collected in hdr (header spans buffers) */
+	size_t prefix; /* position of unit that should lead a join (TS PAT, fMP4 styp) */
+	int keyflags; /* TS: random access indicators were seen */
+	uint8_t hdr[LF_MAXHDRLEN];
+
 	/* list of n recent join points */
 	struct {
 		size_t offset[LF_MAXNB_JOINS];
@@ -74,7 +89,7 @@ static inline size_t lformat_getjoin(struct lfstate *lfs, unsigned idx)
 
 	/* index is outside of parser window?
 	 * -> return initial offset */
-	if (idx > lfs->joins.num)
+	if (idx >= lfs->joins.num)
 		return lfs->offset;
 
 	p = (idx > lfs->joins.head) ?
@@ -87,6 +102,21 @@ static inline size_t lformat_getjoin(struct lfstate *lfs, unsigned idx)
   lformat_getjoin((lfs), 0)
 /* oldest join in parser window */
 #define lformat_getojoin(lfs) \
-  lformat_getjoin((lfs), ((lfs)->num ? ((lfs)->num - 1) : 0))
+  lformat_getjoin((lfs), ((lfs)->joins.num ? ((lfs)->joins.num - 1) : 0))
+
+/* oldest join in parser window that is not before min_pos,
+ * the most recent join is returned if there is none */
+static inline size_t lformat_getjoin_from(struct lfstate *lfs, size_t min_pos)
+{
+	unsigned int idx;
+	size_t off;
+
+	for (idx = lfs->joins.num; idx > 1; --idx) {
+		off = lformat_getjoin(lfs, idx - 1);
+		if (off >= min_pos)
+			return off;
+	}
+	return lformat_getrjoin(lfs);
+}
 
 #endif /* _LINK_FORMAT_H_ */
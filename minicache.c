@@ -74,9 +74,22 @@
 #ifdef SHFS_STATS
 #include "shfs_stats.h"
 #endif
+#ifdef SHFS_L2CACHE
+#include "shfs_l2cache.h"
+#endif
 #ifdef TESTSUITE
 #include "testsuite.h"
 #endif
+#include "tracepoint.h"
+#ifdef CONFIG_EVLOOP
+#include <target/evloop.h>
+#endif
+#ifdef CONFIG_CTLSOCK
+#include <target/ctlsock.h>
+#endif
+#ifdef HTTP_BENCH
+#include "http_bench.h"
+#endif
 
 #include "debug.h"
 
@@ -253,6 +266,15 @@ static inline void debug_print(void)
 }
 #endif /* CONFIG_DEBUG_PRINT */
 
+#if defined CONFIG_EVLOOP && defined CONFIG_LWIP_NOTHREADS && !defined CONFIG_LWIP_IPDEV
+/* wraps ethernet_input(): received frames keep the event loop busy-polling */
+static err_t evloop_ethernet_input(struct pbuf *p, struct netif *inp)
+{
+    evloop_mark_active();
+    return ethernet_input(p, inp);
+}
+#endif
+
 #define MAX_NB_STATIC_ARP_ENTRIES 6
 
 /**
@@ -269,14 +291,26 @@ struct mcargs {
     ip4_addr_t      dns1;
 #endif
     unsigned int    nb_http_sess;
+    unsigned int    link_timeshift;
+    int             link_tsjoin;
 
     int             bd_detect;
     unsigned int    nb_bds;
     blkdev_id_t     bd_id[MAX_NB_TRY_BLKDEVS];
     int             stats_bd;
     blkdev_id_t     stats_bd_id;
+#ifdef SHFS_L2CACHE
+    int             l2cache_bd;
+    blkdev_id_t     l2cache_bd_id;
+#endif
 
     int             no_ctldir;
+#ifdef CONFIG_CTLSOCK
+    const char     *ctlsock_path;
+#endif
+#ifdef HTTP_BENCH
+    const char     *bench_args; /* run load generator and halt */
+#endif
 
     unsigned int    startup_delay;
 
@@ -403,26 +437,50 @@ static int parse_args(int argc, char *argv[])
 #endif
     args.nb_bds = 0;
     args.stats_bd = 0; /* disable stats bd */
+#ifdef SHFS_L2CACHE
+    args.l2cache_bd = 0; /* no second-level cache */
+#endif
+#ifdef CONFIG_CTLSOCK
+    args.ctlsock_path = CONFIG_CTLSOCK_PATH;
+#endif
+#ifdef HTTP_BENCH
+    args.bench_args = NULL;
+#endif
 #ifdef CAN_DETECT_BLKDEVS
     args.bd_detect = 1;
 #else
     args.bd_detect = 0;
 #endif
+#ifdef CONFIG_LOOPIF
+    args.dhclient = 0; /* nobody to ask on a loopback device */
+#else
     args.dhclient = 1; /* dhcp as default */
+#endif
     args.startup_delay = 0;
     args.no_ctldir = 0;
     args.nb_http_sess = CONFIG_LWIP_NUM_TCPCON;
+    args.link_timeshift = 0; /* no time-shift window */
+    args.link_tsjoin = 0;
 #if (!MEMP_MEM_MALLOC) && ((CONFIG_LWIP_NUM_TCPCON) < (MEMP_NUM_TCP_PCB))
     #error "MEMP_NUM_TCP_PCB has to be a least CONFIG_LWIP_NUM_TCPCON"
 #endif
     args.nb_sarp_entries = 0;
     while ((opt = getopt(argc, argv,
-                         "s:i:g:b:hc:a:"
+                         "s:i:g:b:hc:a:t:j"
 #if LWIP_DNS
                          "d:e:"
 #endif
 #ifdef SHFS_STATS
                          "x:"
+#endif
+#ifdef SHFS_L2CACHE
+                         "l:"
+#endif
+#ifdef CONFIG_CTLSOCK
+                         "u:"
+#endif
+#ifdef HTTP_BENCH
+                         "B:"
 #endif
                           )) != -1) {
          switch(opt) {
@@ -525,6 +583,26 @@ static int parse_args(int argc, char *argv[])
 	      args.stats_bd = 1; /* enable stats bd */
 	      blkdev_id_cpy(args.stats_bd_id, ibd);
               break;
+#endif
+#ifdef SHFS_L2CACHE
+         case 'l': /* virtual block device for the second-level cache */
+              if (blkdev_id_parse(optarg, &ibd) < 0) {
+	           printk("invalid block device id specified\n");
+	           return -1;
+              }
+	      args.l2cache_bd = 1;
+	      blkdev_id_cpy(args.l2cache_bd_id, ibd);
+              break;
+#endif
+#ifdef CONFIG_CTLSOCK
+         case 'u': /* path of control socket */
+	      args.ctlsock_path = optarg;
+              break;
+#endif
+#ifdef HTTP_BENCH
+         case 'B': /* run HTTP load generator: "CONNS REQUESTS TRACE..." */
+	      args.bench_args = optarg;
+              break;
 #endif
          case 'c': /* number of http connections */
 	      ret = parse_args_setval_int(&ival, optarg);
@@ -535,6 +613,17 @@ static int parse_args(int argc, char *argv[])
 	      }
 	      args.nb_http_sess = ival;
               break;
+         case 't': /* time-shift window of live relays (seconds) */
+	      ret = parse_args_setval_int(&ival, optarg);
+	      if (ret < 0 || ival < 0) {
+		      printk("invalid time-shift window specified\n");
+	           return -1;
+	      }
+	      args.link_timeshift = (unsigned int) ival;
+              break;
+         case 'j': /* join live relays at oldest join point in time-shift window */
+	      args.link_tsjoin = 1;
+              break;
 
          default:
 	      return -1;
@@ -596,6 +685,31 @@ void app_shutdown(unsigned reason)
     }
 }
 
+#ifdef HTTP_BENCH
+/**
+ * HTTP LOAD GENERATOR (-B)
+ */
+#define MAX_NB_BENCH_ARGS 32
+
+static int start_bench(const char *cmdline)
+{
+    char *argv[MAX_NB_BENCH_ARGS];
+    char *buf, *tok;
+    int argc = 0;
+    int ret;
+
+    buf = strdup(cmdline);
+    if (!buf)
+	return -ENOMEM;
+    argv[argc++] = "http-bench";
+    for (tok = strtok(buf, " \t"); tok && argc < MAX_NB_BENCH_ARGS; tok = strtok(NULL, " \t"))
+	argv[argc++] = tok;
+    ret = http_bench_start(stdout, argc, argv); /* trace is copied */
+    free(buf);
+    return ret;
+}
+#endif
+
 /**
  * MAIN
  */
@@ -615,6 +729,31 @@ int main(int argc, char *argv[])
     fd_set poll_wfdset;
     struct timeval poll_to;
 #endif
+#ifdef CONFIG_EVLOOP
+#ifdef target_netif_fds
+    int evl_fds[EVLOOP_MAX_FDS];
+    int evl_nb_fds;
+#endif
+#ifdef CONFIG_LWIP_NOTHREADS
+    struct evloop_timer tmr_tcp;
+    struct evloop_timer tmr_etharp;
+    struct evloop_timer tmr_ipreass;
+#if LWIP_DNS
+    struct evloop_timer tmr_dns;
+#endif
+    struct evloop_timer tmr_dhcp_fine;
+    struct evloop_timer tmr_dhcp_coarse;
+#endif /* CONFIG_LWIP_NOTHREADS */
+#ifdef CONFIG_MINDER_PRINT
+    struct evloop_timer tmr_minder;
+#endif /* CONFIG_MINDER_PRINT */
+#ifdef CONFIG_DEBUG_PRINT
+    struct evloop_timer tmr_debug;
+#endif /* CONFIG_DEBUG_PRINT */
+#ifdef CONFIG_CTLSOCK
+    struct evloop_timer tmr_ctlsock;
+#endif /* CONFIG_CTLSOCK */
+#else /* CONFIG_EVLOOP */
 #if defined CONFIG_LWIP_NOTHREADS || defined CONFIG_MINDER_PRINT
     uint64_t ts_now;
     uint64_t ts_till;
@@ -636,6 +775,10 @@ int main(int argc, char *argv[])
 #ifdef CONFIG_DEBUG_PRINT
     uint64_t ts_debug = 0;
 #endif /* CONFIG_DEBUG_PRINT */
+#ifdef CONFIG_CTLSOCK
+    uint64_t ts_ctlsock = 0;
+#endif /* CONFIG_CTLSOCK */
+#endif /* CONFIG_EVLOOP */
     TT_DECLARE(tt_boot);
     TT_DECLARE(tt_netifadd);
     TT_DECLARE(tt_lwipinit);
@@ -651,6 +794,7 @@ int main(int argc, char *argv[])
 
     TT_START(tt_boot);
     init_debug();
+    init_tracepoints();
 
     /* -----------------------------------
      * banner
@@ -736,6 +880,9 @@ int main(int argc, char *argv[])
 #ifdef CONFIG_LWIP_IPDEV
     niret = netif_add(&netif, &args.ip, &args.mask, &args.gw, NULL,
                       target_netif_init, ip4_input);
+#elif defined CONFIG_EVLOOP
+    niret = netif_add(&netif, &args.ip, &args.mask, &args.gw, NULL,
+                      target_netif_init, evloop_ethernet_input);
 #else
     niret = netif_add(&netif, &args.ip, &args.mask, &args.gw, NULL,
                       target_netif_init, ethernet_input);
@@ -821,6 +968,10 @@ int main(int argc, char *argv[])
      * ----------------------------------- */
     printk("Loading SHFS...\n");
     init_shfs();
+#ifdef SHFS_L2CACHE
+    if (args.l2cache_bd)
+	    shfs_l2cache_set_dev(args.l2cache_bd_id); /* attached on mount */
+#endif
 #ifdef CONFIG_AUTOMOUNT
     if (args.nb_bds) {
 	    printk("Automount cache filesystem...\n");
@@ -837,7 +988,11 @@ int main(int argc, char *argv[])
      * ----------------------------------- */
 #ifdef HAVE_SHELL
     printk("Starting shell...\n");
+#if defined CONFIG_CTLSOCK && !defined CONFIG_PTH_THREADS
+    init_shell(0, 0); /* no sessions without threads: control socket only */
+#else
     init_shell(0, 4); /* no local session + 4 telnet sessions */
+#endif
 #ifdef HAVE_CTLDIR
     register_shell_extras(cd); /* Note: cd might be NULL */
 #else
@@ -847,14 +1002,22 @@ int main(int argc, char *argv[])
     printk("Starting HTTP server (max number of connections: %u)...\n",
            args.nb_http_sess);
     init_http(args.nb_http_sess,
-              args.nb_http_sess << 1); /* nb reqs have to be at least double to
-					* ensure all connections can be used simultaneously */
+              args.nb_http_sess << 1, /* nb reqs have to be at least double to
+				       * ensure all connections can be used simultaneously */
+              args.link_timeshift,
+              args.link_tsjoin);
+#ifdef HTTP_BENCH
+    init_http_bench();
+#endif
 
     /* add custom commands to the shell */
 #ifdef HAVE_SHELL
     shell_register_cmd("halt", shcmd_halt);
     shell_register_cmd("reboot", shcmd_reboot);
     shell_register_cmd("suspend", shcmd_suspend);
+#ifdef CONFIG_EVLOOP
+    shell_register_cmd("evloop", shcmd_evloop);
+#endif
 #ifdef HAVE_CTLDIR
     register_shfs_tools(cd); /* Note: cd might be NULL */
 #else
@@ -884,6 +1047,14 @@ int main(int argc, char *argv[])
 #endif
 #endif /* SHFS_STATS */
 
+#ifdef TRACEPOINTS
+#ifdef HAVE_CTLDIR
+    register_tracepoints(cd); /* Note: cd might be NULL */
+#else
+    register_tracepoints();
+#endif
+#endif
+
     /* -----------------------------------
      * testsuite commands
      * ----------------------------------- */
@@ -895,6 +1066,16 @@ int main(int argc, char *argv[])
 #endif
 #endif
 
+    /* -----------------------------------
+     * control socket
+     * ----------------------------------- */
+#ifdef CONFIG_CTLSOCK
+    printk("Starting control socket at %s...\n", args.ctlsock_path);
+    ret = init_ctlsock(args.ctlsock_path);
+    if (ret < 0)
+	printk("Warning: Could not open control socket: %s\n", strerror(-ret));
+#endif
+
     /* -----------------------------------
      * control dir - phase 2/2
      * ----------------------------------- */
@@ -920,6 +1101,47 @@ int main(int argc, char *argv[])
     ts_to = 0;
 #endif
 
+    /* -----------------------------------
+     * Initialize event loop
+     * ----------------------------------- */
+#ifdef CONFIG_EVLOOP
+    ret = init_evloop();
+    if (ret < 0) {
+	printk("FATAL: Could not initialize event loop: %s\n", strerror(-ret));
+	goto out;
+    }
+#ifdef target_netif_fds
+    evl_nb_fds = target_netif_fds(&netif, evl_fds, EVLOOP_MAX_FDS);
+    for (i = 0; evl_nb_fds > 0 && i < (unsigned int) evl_nb_fds; ++i) {
+	ret = evloop_add_fd(evl_fds[i]);
+	if (ret < 0)
+	    printk("Warning: Could not add netif descriptor %d to event loop: %s\n",
+		   evl_fds[i], strerror(-ret));
+    }
+#endif
+#ifdef CONFIG_LWIP_NOTHREADS
+    evloop_add_timer(&tmr_etharp,  ARP_TMR_INTERVAL, etharp_tmr);
+    evloop_add_timer(&tmr_ipreass, IP_TMR_INTERVAL,  ip_reass_tmr);
+    evloop_add_timer(&tmr_tcp,     TCP_TMR_INTERVAL, tcp_tmr);
+#if LWIP_DNS
+    evloop_add_timer(&tmr_dns,     DNS_TMR_INTERVAL, dns_tmr);
+#endif
+    if (args.dhclient) {
+	evloop_add_timer(&tmr_dhcp_fine,   DHCP_FINE_TIMER_MSECS,   dhcp_fine_tmr);
+	evloop_add_timer(&tmr_dhcp_coarse, DHCP_COARSE_TIMER_MSECS, dhcp_coarse_tmr);
+    }
+#endif /* CONFIG_LWIP_NOTHREADS */
+#ifdef CONFIG_MINDER_PRINT
+    evloop_add_timer(&tmr_minder, MINDER_INTERVAL, minder_print);
+#endif /* CONFIG_MINDER_PRINT */
+#ifdef CONFIG_DEBUG_PRINT
+    evloop_add_timer(&tmr_debug,  DEBUG_INTERVAL,  debug_print);
+#endif /* CONFIG_DEBUG_PRINT */
+#ifdef CONFIG_CTLSOCK
+    evloop_add_timer(&tmr_ctlsock, CTLSOCK_POLL_INTERVAL, ctlsock_poll);
+#endif /* CONFIG_CTLSOCK */
+#endif /* CONFIG_EVLOOP */
+
     /* -----------------------------------
      * Boot banner/time trace output
      * ----------------------------------- */
@@ -951,6 +1173,13 @@ int main(int argc, char *argv[])
 #ifdef CONFIG_MINDER_PRINT
     printk("\n");
 #endif
+#ifdef HTTP_BENCH
+    if (args.bench_args) {
+	printk("Starting HTTP load generator...\n");
+	if (start_bench(args.bench_args) < 0)
+	    shall_shutdown = 1;
+    }
+#endif
 
     /* -----------------------------------
      * Processing loop
@@ -979,6 +1208,16 @@ int main(int argc, char *argv[])
 #if defined CONFIG_LWIP_NOTHREADS || defined CONFIG_MINDER_PRINT
 	}
 #endif
+#elif defined CONFIG_EVLOOP
+	/* busy-poll while there is work in flight, sleep otherwise */
+#ifdef HTTP_PACING
+	evloop_wait(shfs_blkdevs_busy() || http_poll_busy(), http_pacing_deadline());
+#else
+	evloop_wait(shfs_blkdevs_busy() || http_poll_busy(), 0);
+#endif
+	/* timers are executed before the netif is polled so that
+	 * their output is sent out within the same iteration */
+	evloop_run_timers();
 #else
 	schedule(); /* yield CPU */
 #endif
@@ -988,12 +1227,17 @@ int main(int argc, char *argv[])
 
 	/* poll IO retry chain of HTTP */
 	http_poll_ioretry();
+#ifdef HTTP_PACING
+	/* resume paced HTTP sessions */
+	http_poll_pacing();
+#endif
 
 #ifdef CONFIG_LWIP_NOTHREADS
         /* NIC handling loop (single threaded lwip) */
 	target_netif_poll(&netif);
 #endif /* CONFIG_LWIP_NOTHREADS */
 
+#ifndef CONFIG_EVLOOP
 #if defined CONFIG_LWIP_NOTHREADS || defined CONFIG_MINDER_PRINT
         ts_now  = NSEC_TO_MSEC(target_now_ns());
 	ts_till = UINT64_MAX;
@@ -1017,9 +1261,19 @@ int main(int argc, char *argv[])
 #ifdef CONFIG_DEBUG_PRINT
         TIMED(ts_now, ts_till, ts_debug,  DEBUG_INTERVAL,  debug_print());
 #endif /* CONFIG_DEBUG_PRINT */
+#ifdef CONFIG_CTLSOCK
+        TIMED(ts_now, ts_till, ts_ctlsock, CTLSOCK_POLL_INTERVAL, ctlsock_poll());
+#endif /* CONFIG_CTLSOCK */
 #if defined CONFIG_LWIP_NOTHREADS || defined CONFIG_MINDER_PRINT || defined CONFIG_DEBUG_PRINT
         ts_to = ts_till - ts_now;
 #endif
+#endif /* CONFIG_EVLOOP */
+
+#ifdef HTTP_BENCH
+	/* halt when the load generator that was started with -B is done */
+	if (unlikely(args.bench_args && !http_bench_running()))
+	    shall_shutdown = 1;
+#endif
 
         if (unlikely(shall_suspend)) {
             printk("System is going to suspend now\n");
@@ -1049,9 +1303,16 @@ int main(int argc, char *argv[])
 	    printk("Closing stats device...\n");
 	    exit_shfs_stats_export();
     }
+#endif
+#ifdef HTTP_BENCH
+    exit_http_bench();
 #endif
     printk("Stopping HTTP server...\n");
     exit_http();
+#ifdef CONFIG_CTLSOCK
+    printk("Closing control socket...\n");
+    exit_ctlsock();
+#endif
 #ifdef HAVE_SHELL
     printk("Stopping shell...\n");
     exit_shell();
@@ -1059,6 +1320,11 @@ int main(int argc, char *argv[])
     printk("Unmounting cache filesystem...\n");
     umount_shfs(0); /* we cannot enforce unmount but all files should be closed here anyways */
     exit_shfs();
+#ifdef CONFIG_EVLOOP
+    printk("Stopping event loop...\n");
+    evloop_print_stats(stdout);
+    exit_evloop();
+#endif
     printk("Stopping networking...\n");
     netif_set_down(&netif);
     netif_remove(&netif);
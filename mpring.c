@@ -0,0 +1,76 @@
+/*
+ * SMP-safe bounded lock-free ring
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include <errno.h>
+
+#include "mpring.h"
+
+#ifndef POWER_OF_2
+#define POWER_OF_2(x)   (((x)) && (!((x) & ((x) - 1))))
+#endif
+
+#ifndef ALIGN_UP
+#define ALIGN_UP(x, a)  (((x) + (a) - 1) & ~((a) - 1))
+#endif
+
+struct mpring *alloc_mpring(uint32_t size, int flags)
+{
+    struct mpring *r;
+    size_t h_size = ALIGN_UP(sizeof(struct mpring), MPRING_CACHELINE_SIZE);
+
+    ASSERT(size > 1 && POWER_OF_2(size));
+
+    r = target_malloc(MPRING_CACHELINE_SIZE, h_size + (sizeof(void *) * size));
+    if (!r) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->size = size;
+    r->mask = size - 1;
+    r->capacity = size - 1;
+    r->flags = flags;
+    r->prod.head = 0;
+    r->prod.tail = 0;
+    r->cons.head = 0;
+    r->cons.tail = 0;
+    r->ring = (void **) ((uintptr_t) r + h_size);
+    return r;
+}
+
+void free_mpring(struct mpring *r)
+{
+    target_free(r);
+}
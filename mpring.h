@@ -0,0 +1,321 @@
+/*
+ * SMP-safe bounded lock-free ring
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+/*
+ * The head/tail reservation scheme follows DPDK's rte_ring:
+ * producers (consumers) first reserve slots by moving the head index,
+ * copy the elements, and publish them by moving the tail index in
+ * reservation order. Indices are free-running 32-bit counters.
+ *
+ * In contrast to ring.h, this implementation is SMP-safe. Single-
+ * producer/consumer variants avoid the CAS and can be selected at
+ * allocation time (MPRING_F_SP_ENQ, MPRING_F_SC_DEQ) or by calling the
+ * mpring_sp_*()/mpring_sc_*() functions directly.
+ */
+
+#ifndef _MPRING_H_
+#define _MPRING_H_
+
+#include <target/sys.h>
+
+#include <stdint.h>
+#include <errno.h>
+
+#include "likely.h"
+
+#ifndef MPRING_CACHELINE_SIZE
+#define MPRING_CACHELINE_SIZE 64
+#endif
+
+#if defined __x86_64__ || defined __i386__
+#define mpring_relax() __builtin_ia32_pause()
+#else
+#define mpring_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+#define MPRING_F_SP_ENQ 0x1 /* default enqueue is single-producer */
+#define MPRING_F_SC_DEQ 0x2 /* default dequeue is single-consumer */
+
+struct mpring_headtail {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} __attribute__((aligned(MPRING_CACHELINE_SIZE)));
+
+struct mpring {
+    uint32_t size;
+    uint32_t mask;
+    uint32_t capacity;
+    int flags;
+    void **ring;
+
+    /* producer and consumer indices are on separate cache lines */
+    struct mpring_headtail prod;
+    struct mpring_headtail cons;
+};
+
+/* Note: size has to be a power of two. (size - 1) slots are available in the ring */
+struct mpring *alloc_mpring(uint32_t size, int flags);
+void free_mpring(struct mpring *r);
+
+/* number of used slots */
+#define mpring_count(r) \
+    ((uint32_t) (__atomic_load_n(&(r)->prod.tail, __ATOMIC_ACQUIRE) - \
+                 __atomic_load_n(&(r)->cons.tail, __ATOMIC_ACQUIRE)))
+/* number of available slots */
+#define mpring_avail(r) ((r)->capacity - mpring_count(r))
+#define mpring_full(r) (mpring_avail(r) == 0)
+#define mpring_empty(r) (mpring_count(r) == 0)
+
+/*
+ * Internal helpers
+ * fixed != 0: reserve either n slots or none ("bulk")
+ * fixed == 0: reserve as many slots as possible up to n ("burst")
+ * Returns the number of reserved slots
+ */
+static inline uint32_t _mpring_move_prod_head(struct mpring *r, int is_sp, uint32_t n, int fixed,
+                                              uint32_t *old_head, uint32_t *new_head)
+{
+    uint32_t max = n;
+    uint32_t free_entries;
+    int success;
+
+    *old_head = __atomic_load_n(&r->prod.head, __ATOMIC_RELAXED);
+    do {
+        n = max;
+        /* the head (also when reloaded by a failed CAS) must not be read
+         * after the opposite tail, otherwise the subtraction can wrap */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        free_entries = r->capacity + __atomic_load_n(&r->cons.tail, __ATOMIC_ACQUIRE) - *old_head;
+        if (unlikely(n > free_entries))
+            n = fixed ? 0 : free_entries;
+        if (unlikely(n == 0))
+            return 0;
+
+        *new_head = *old_head + n;
+        if (is_sp) {
+            r->prod.head = *new_head;
+            success = 1;
+        } else {
+            success = __atomic_compare_exchange_n(&r->prod.head, old_head, *new_head, 1,
+                                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    } while (unlikely(!success));
+    return n;
+}
+
+static inline uint32_t _mpring_move_cons_head(struct mpring *r, int is_sc, uint32_t n, int fixed,
+                                              uint32_t *old_head, uint32_t *new_head)
+{
+    uint32_t max = n;
+    uint32_t entries;
+    int success;
+
+    *old_head = __atomic_load_n(&r->cons.head, __ATOMIC_RELAXED);
+    do {
+        n = max;
+        /* the head (also when reloaded by a failed CAS) must not be read
+         * after the opposite tail, otherwise the subtraction can wrap */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        entries = __atomic_load_n(&r->prod.tail, __ATOMIC_ACQUIRE) - *old_head;
+        if (unlikely(n > entries))
+            n = fixed ? 0 : entries;
+        if (unlikely(n == 0))
+            return 0;
+
+        *new_head = *old_head + n;
+        if (is_sc) {
+            r->cons.head = *new_head;
+            success = 1;
+        } else {
+            success = __atomic_compare_exchange_n(&r->cons.head, old_head, *new_head, 1,
+                                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    } while (unlikely(!success));
+    return n;
+}
+
+/* publishes reserved slots: waits for preceding reservations */
+static inline void _mpring_update_tail(struct mpring_headtail *ht, uint32_t old_val, uint32_t new_val, int single)
+{
+    if (!single)
+        while (unlikely(__atomic_load_n(&ht->tail, __ATOMIC_RELAXED) != old_val))
+            mpring_relax();
+    __atomic_store_n(&ht->tail, new_val, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t _mpring_do_enqueue(struct mpring *r, void * const elements[], uint32_t n,
+                                          int is_sp, int fixed)
+{
+    uint32_t head, next, idx, i;
+
+    n = _mpring_move_prod_head(r, is_sp, n, fixed, &head, &next);
+    if (unlikely(n == 0))
+        return 0;
+
+    idx = head & r->mask;
+    if (likely(idx + n <= r->size)) {
+        for (i = 0; i < n; ++i)
+            r->ring[idx + i] = elements[i];
+    } else {
+        for (i = 0; idx < r->size; ++i, ++idx)
+            r->ring[idx] = elements[i];
+        for (idx = 0; i < n; ++i, ++idx)
+            r->ring[idx] = elements[i];
+    }
+
+    _mpring_update_tail(&r->prod, head, next, is_sp);
+    return n;
+}
+
+static inline uint32_t _mpring_do_dequeue(struct mpring *r, void *elements[], uint32_t n,
+                                          int is_sc, int fixed)
+{
+    uint32_t head, next, idx, i;
+
+    n = _mpring_move_cons_head(r, is_sc, n, fixed, &head, &next);
+    if (unlikely(n == 0))
+        return 0;
+
+    idx = head & r->mask;
+    if (likely(idx + n <= r->size)) {
+        for (i = 0; i < n; ++i)
+            elements[i] = r->ring[idx + i];
+    } else {
+        for (i = 0; idx < r->size; ++i, ++idx)
+            elements[i] = r->ring[idx];
+        for (idx = 0; i < n; ++i, ++idx)
+            elements[i] = r->ring[idx];
+    }
+
+    _mpring_update_tail(&r->cons, head, next, is_sc);
+    return n;
+}
+
+/*
+ * Bulk enqueue/dequeue: all or nothing
+ * Returns 0 on success, -1 on errors (inspect errno for reason)
+ */
+#define _MPRING_BULK(call) \
+    ({ int _ret = 0; \
+       if (unlikely((call) == 0)) { errno = ENOBUFS; _ret = -1; } \
+       _ret; })
+
+static inline int mpring_mp_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_enqueue(r, elements, count, 0, 1));
+}
+
+static inline int mpring_sp_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_enqueue(r, elements, count, 1, 1));
+}
+
+static inline int mpring_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_enqueue(r, elements, count, r->flags & MPRING_F_SP_ENQ, 1));
+}
+
+static inline int mpring_mc_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_dequeue(r, elements, count, 0, 1));
+}
+
+static inline int mpring_sc_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_dequeue(r, elements, count, 1, 1));
+}
+
+static inline int mpring_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _MPRING_BULK(_mpring_do_dequeue(r, elements, count, r->flags & MPRING_F_SC_DEQ, 1));
+}
+
+/*
+ * Burst enqueue/dequeue: as many as possible
+ * Returns the number of successfully enqueued/dequeued elements
+ */
+static inline uint32_t mpring_mp_try_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _mpring_do_enqueue(r, elements, count, 0, 0);
+}
+
+static inline uint32_t mpring_sp_try_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _mpring_do_enqueue(r, elements, count, 1, 0);
+}
+
+static inline uint32_t mpring_try_enqueue_multiple(struct mpring *r, void * const elements[], uint32_t count)
+{
+    return _mpring_do_enqueue(r, elements, count, r->flags & MPRING_F_SP_ENQ, 0);
+}
+
+static inline uint32_t mpring_mc_try_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _mpring_do_dequeue(r, elements, count, 0, 0);
+}
+
+static inline uint32_t mpring_sc_try_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _mpring_do_dequeue(r, elements, count, 1, 0);
+}
+
+static inline uint32_t mpring_try_dequeue_multiple(struct mpring *r, void *elements[], uint32_t count)
+{
+    return _mpring_do_dequeue(r, elements, count, r->flags & MPRING_F_SC_DEQ, 0);
+}
+
+/*
+ * Single element enqueue
+ * Returns 0 on success, -1 on errors (inspect errno for reason)
+ */
+static inline int mpring_enqueue(struct mpring *r, void *element)
+{
+    return mpring_enqueue_multiple(r, &element, 1);
+}
+
+/*
+ * Single element dequeue
+ * Returns NULL on errors (inspect errno for reason)
+ */
+static inline void *mpring_dequeue(struct mpring *r)
+{
+    void *e;
+
+    if (mpring_dequeue_multiple(r, &e, 1) < 0)
+        return NULL;
+    return e;
+}
+
+#endif /* _MPRING_H_ */
@@ -0,0 +1,366 @@
+/*
+ * Multi-threaded memory pool with per-thread object caches
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include <errno.h>
+
+#include "mtmempool.h"
+
+#ifdef MEMPOOL_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+#define MIN_ALIGN 8
+
+#define MTMP_NIL        ((uint32_t) -1)
+#define MTMP_TAG_INC    (((uint64_t) 1) << 32)
+#define MTMP_TAG_MASK   (~((uint64_t) 0xFFFFFFFF))
+
+#ifndef min
+#define min(a, b) \
+    ({ __typeof__ (a) __a = (a); \
+       __typeof__ (b) __b = (b); \
+       __a < __b ? __a : __b; })
+#endif
+
+#if defined __x86_64__ || defined __i386__
+#define mtmp_relax() __builtin_ia32_pause()
+#else
+#define mtmp_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+static inline size_t align_up(size_t size, size_t align)
+{
+  return (size + align - 1) & ~(align - 1);
+}
+
+#define _mtmp_mag(mp, idx) \
+  ((struct mtmempool_mag *) (((uintptr_t) (mp)->mag_area) + ((size_t) (idx)) * (mp)->mag_stride))
+
+/*
+ * Treiber stack of magazines
+ * The upper 32 bits of a stack head are a modification tag that prevents
+ * ABA on concurrent pop operations. Magazine memory is never released
+ * while the pool exists, so reading m->next of a magazine that was
+ * meanwhile popped by another thread is harmless (the CAS fails).
+ */
+static inline void _mtmp_depot_push(struct mtmempool *mp, uint64_t *head, struct mtmempool_mag *m)
+{
+  uint64_t old, new;
+
+  old = __atomic_load_n(head, __ATOMIC_RELAXED);
+  do {
+    m->next = (uint32_t) old;
+    new = ((old + MTMP_TAG_INC) & MTMP_TAG_MASK) | m->idx;
+  } while (!__atomic_compare_exchange_n(head, &old, new, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static inline struct mtmempool_mag *_mtmp_depot_pop(struct mtmempool *mp, uint64_t *head)
+{
+  struct mtmempool_mag *m;
+  uint64_t old, new;
+  uint32_t idx;
+
+  old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+  do {
+    idx = (uint32_t) old;
+    if (idx == MTMP_NIL)
+      return NULL;
+    m = _mtmp_mag(mp, idx);
+    new = ((old + MTMP_TAG_INC) & MTMP_TAG_MASK) |
+          __atomic_load_n(&m->next, __ATOMIC_RELAXED);
+  } while (!__atomic_compare_exchange_n(head, &old, new, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  return m;
+}
+
+static inline void _mtmp_spill_lock(struct mtmempool *mp)
+{
+  while (__atomic_exchange_n(&mp->spill_lock, 1, __ATOMIC_ACQUIRE))
+    while (__atomic_load_n(&mp->spill_lock, __ATOMIC_RELAXED))
+      mtmp_relax();
+}
+
+static inline void _mtmp_spill_unlock(struct mtmempool *mp)
+{
+  __atomic_store_n(&mp->spill_lock, 0, __ATOMIC_RELEASE);
+}
+
+/* moves all objects of a magazine to the spill area */
+static inline void _mtmp_spill_mag(struct mtmempool *mp, struct mtmempool_mag *m)
+{
+  uint32_t i;
+
+  _mtmp_spill_lock(mp);
+  for (i = 0; i < m->count; ++i)
+    mp->spill[mp->spill_count++] = m->objs[i];
+  _mtmp_spill_unlock(mp);
+  m->count = 0;
+}
+
+/* returns a magazine of a detaching cache to the depot */
+static inline void _mtmp_drop_mag(struct mtmempool *mp, struct mtmempool_mag *m)
+{
+  if (m->count == mp->mag_size) {
+    _mtmp_depot_push(mp, &mp->full_mags, m);
+    return;
+  }
+  if (m->count)
+    _mtmp_spill_mag(mp, m);
+  _mtmp_depot_push(mp, &mp->empty_mags, m);
+}
+
+struct mtmempool *alloc_enhanced_mtmempool(uint32_t nb_objs,
+					   size_t obj_size, size_t obj_data_align, size_t obj_headroom, size_t obj_tailroom, size_t obj_private_len, int sep_obj_data,
+					   void (*obj_init_func)(struct mempool_obj *, void *), void *obj_init_func_argp,
+					   uint32_t mag_size, uint32_t max_caches)
+{
+  struct mtmempool *mp;
+  struct mtmempool_mag *m;
+  uint32_t nb_full, i;
+
+  if (!max_caches) {
+    errno = EINVAL;
+    goto error;
+  }
+  if (!mag_size)
+    mag_size = MTMEMPOOL_DEFAULT_MAG_SIZE;
+
+  mp = target_malloc(MTMEMPOOL_CACHELINE_SIZE, sizeof(*mp));
+  if (!mp) {
+    errno = ENOMEM;
+    goto error;
+  }
+  mp->p = alloc_enhanced_mempool(nb_objs, obj_size, obj_data_align, obj_headroom, obj_tailroom,
+                                 obj_private_len, sep_obj_data,
+                                 obj_init_func, obj_init_func_argp,
+                                 NULL, NULL, NULL, NULL);
+  if (!mp->p)
+    goto error_free_mp; /* errno is set */
+
+  /* Each cache holds two magazines (+1 while exchanging with the depot),
+   * all remaining objects fit into the full magazines of the depot */
+  nb_full        = nb_objs / mag_size;
+  mp->mag_size   = mag_size;
+  mp->nb_mags    = nb_full + 3 * max_caches;
+  mp->mag_stride = align_up(sizeof(struct mtmempool_mag) + mag_size * sizeof(struct mempool_obj *),
+                            MTMEMPOOL_CACHELINE_SIZE);
+  mp->mag_area   = target_malloc(MTMEMPOOL_CACHELINE_SIZE, mp->nb_mags * mp->mag_stride);
+  if (!mp->mag_area) {
+    errno = ENOMEM;
+    goto error_free_p;
+  }
+  mp->spill = target_malloc(MIN_ALIGN, (nb_objs + 1) * sizeof(struct mempool_obj *));
+  if (!mp->spill) {
+    errno = ENOMEM;
+    goto error_free_mags;
+  }
+  mp->max_caches = max_caches;
+  mp->caches = target_malloc(MTMEMPOOL_CACHELINE_SIZE, max_caches * sizeof(struct mtmempool_cache));
+  if (!mp->caches) {
+    errno = ENOMEM;
+    goto error_free_spill;
+  }
+  for (i = 0; i < max_caches; ++i) {
+    mp->caches[i].mp       = mp;
+    mp->caches[i].loaded   = NULL;
+    mp->caches[i].prev     = NULL;
+    mp->caches[i].mag_size = mag_size;
+    mp->caches[i].in_use   = 0;
+  }
+
+  /* distribute objects to depot */
+  mp->full_mags   = MTMP_NIL;
+  mp->empty_mags  = MTMP_NIL;
+  mp->spill_lock  = 0;
+  mp->spill_count = nb_objs - (nb_full * mag_size);
+  if (mp->spill_count)
+    mempool_pick_multiple(mp->p, mp->spill, mp->spill_count);
+  for (i = 0; i < mp->nb_mags; ++i) {
+    m = _mtmp_mag(mp, i);
+    m->idx = i;
+    if (i < nb_full) {
+      mempool_pick_multiple(mp->p, m->objs, mag_size);
+      m->count = mag_size;
+      _mtmp_depot_push(mp, &mp->full_mags, m);
+    } else {
+      m->count = 0;
+      _mtmp_depot_push(mp, &mp->empty_mags, m);
+    }
+  }
+
+  printd("mtmempool @ %p: nb_objs: %"PRIu32", mag_size: %"PRIu32", "
+         "nb_mags: %"PRIu32", max_caches: %"PRIu32"\n",
+         mp, nb_objs, mag_size, mp->nb_mags, max_caches);
+  return mp;
+
+ error_free_spill:
+  target_free(mp->spill);
+ error_free_mags:
+  target_free(mp->mag_area);
+ error_free_p:
+  free_mempool(mp->p);
+ error_free_mp:
+  target_free(mp);
+ error:
+  return NULL;
+}
+
+void free_mtmempool(struct mtmempool *mp)
+{
+  struct mtmempool_mag *m;
+  uint32_t i;
+
+  if (!mp)
+    return;
+
+  for (i = 0; i < mp->max_caches; ++i)
+    BUG_ON(mp->caches[i].in_use); /* cache is still attached */
+
+  /* return all objects to the underlying pool */
+  while ((m = _mtmp_depot_pop(mp, &mp->full_mags)) != NULL)
+    mempool_put_multiple(m->objs, m->count);
+  mempool_put_multiple(mp->spill, mp->spill_count);
+  free_mempool(mp->p); /* will fail with an assertion
+                        * if objects were not put back to the pool already */
+
+  target_free(mp->caches);
+  target_free(mp->spill);
+  target_free(mp->mag_area);
+  target_free(mp);
+}
+
+struct mtmempool_cache *mtmempool_attach(struct mtmempool *mp)
+{
+  struct mtmempool_cache *c;
+  uint32_t i;
+
+  for (i = 0; i < mp->max_caches; ++i) {
+    c = &mp->caches[i];
+    if (!__atomic_exchange_n(&c->in_use, 1, __ATOMIC_ACQUIRE))
+      goto found;
+  }
+  errno = ENOSPC;
+  return NULL;
+
+ found:
+  /* there are always enough empty magazines for a free cache slot */
+  c->loaded = _mtmp_depot_pop(mp, &mp->empty_mags);
+  c->prev   = _mtmp_depot_pop(mp, &mp->empty_mags);
+  BUG_ON(!c->loaded || !c->prev);
+  return c;
+}
+
+void mtmempool_detach(struct mtmempool_cache *c)
+{
+  struct mtmempool *mp = c->mp;
+
+  _mtmp_drop_mag(mp, c->loaded);
+  _mtmp_drop_mag(mp, c->prev);
+  c->loaded = NULL;
+  c->prev   = NULL;
+  __atomic_store_n(&c->in_use, 0, __ATOMIC_RELEASE);
+}
+
+/* called when loaded magazine is empty */
+int _mtmempool_cache_refill(struct mtmempool_cache *c)
+{
+  struct mtmempool *mp = c->mp;
+  struct mtmempool_mag *m;
+  uint32_t n;
+
+  if (c->prev->count) {
+    /* previous magazine has objects: swap */
+    m         = c->prev;
+    c->prev   = c->loaded;
+    c->loaded = m;
+    return 0;
+  }
+
+  m = _mtmp_depot_pop(mp, &mp->full_mags);
+  if (m) {
+    /* exchange empty previous magazine with a full one */
+    _mtmp_depot_push(mp, &mp->empty_mags, c->prev);
+    c->prev   = c->loaded;
+    c->loaded = m;
+    return 0;
+  }
+
+  /* depot has no full magazines: try spill area */
+  if (!__atomic_load_n(&mp->spill_count, __ATOMIC_RELAXED))
+    goto err_nobufs;
+  m = c->loaded;
+  _mtmp_spill_lock(mp);
+  n = min(mp->spill_count, mp->mag_size);
+  for (; m->count < n; ++m->count)
+    m->objs[m->count] = mp->spill[--mp->spill_count];
+  _mtmp_spill_unlock(mp);
+  if (!n)
+    goto err_nobufs;
+  return 0;
+
+ err_nobufs:
+  errno = ENOBUFS;
+  return -1;
+}
+
+/* called when loaded magazine is full */
+void _mtmempool_cache_flush(struct mtmempool_cache *c)
+{
+  struct mtmempool *mp = c->mp;
+  struct mtmempool_mag *m;
+
+  if (!c->prev->count) {
+    /* previous magazine is empty: swap */
+    m         = c->prev;
+    c->prev   = c->loaded;
+    c->loaded = m;
+    return;
+  }
+
+  m = _mtmp_depot_pop(mp, &mp->empty_mags);
+  if (m) {
+    /* exchange full previous magazine with an empty one */
+    _mtmp_depot_push(mp, &mp->full_mags, c->prev);
+    c->prev   = c->loaded;
+    c->loaded = m;
+    return;
+  }
+
+  /* no empty magazines left (transient): move objects to spill area */
+  _mtmp_spill_mag(mp, c->loaded);
+}
@@ -0,0 +1,226 @@
+/*
+ * Multi-threaded memory pool with per-thread object caches
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#ifndef _MTMEMPOOL_H_
+#define _MTMEMPOOL_H_
+
+#include <stdint.h>
+#include <errno.h>
+
+#include "mempool.h"
+#include "likely.h"
+
+#ifndef MTMEMPOOL_CACHELINE_SIZE
+#define MTMEMPOOL_CACHELINE_SIZE 64
+#endif
+#ifndef MTMEMPOOL_DEFAULT_MAG_SIZE
+#define MTMEMPOOL_DEFAULT_MAG_SIZE 32
+#endif
+
+/*
+ * MULTI-THREADED MEMPOOL: OVERVIEW
+ *
+ *   thread 0              thread 1              thread n
+ *  +----------------+    +----------------+    +----------------+
+ *  | cache          |    | cache          |    | cache          |
+ *  |  loaded [mag]  |    |  loaded [mag]  |    |  loaded [mag]  |
+ *  |  prev   [mag]  |    |  prev   [mag]  |    |  prev   [mag]  |
+ *  +-------^--------+    +-------^--------+    +-------^--------+
+ *          |  swap full/empty magazines (lock-free)    |
+ *  +-------v---------------------v---------------------v--------+
+ *  | depot: full magazines  (Treiber stack)                      |
+ *  |        empty magazines (Treiber stack)                      |
+ *  |        spill area for partial magazines (spinlock)          |
+ *  +-------------------------------------------------------------+
+ *  | struct mempool (object memory, never touched after setup)   |
+ *  +-------------------------------------------------------------+
+ *
+ * Objects are regular mempool objects (struct mempool_obj) so that all
+ * helpers of mempool.h (e.g., resize functions) can be used on them.
+ * However, they have to be picked and put only with the functions of
+ * this header; never call mempool_put() on them.
+ *
+ * Each thread attaches its own cache (magazine pair) to the pool and
+ * passes it to pick/put. The fast path does not involve any atomic
+ * operation. A cache must not be shared between threads.
+ *
+ * Magazines are referenced by index so that the depot stacks can be
+ * protected against ABA with a 32-bit tag on a 64-bit CAS.
+ */
+struct mtmempool_mag {
+  uint32_t idx;                  /* own index in magazine table */
+  uint32_t next;                 /* next magazine on depot stack */
+  uint32_t count;                /* number of objects in magazine */
+  struct mempool_obj *objs[];
+};
+
+struct mtmempool_cache {
+  struct mtmempool *mp;
+  struct mtmempool_mag *loaded;
+  struct mtmempool_mag *prev;
+  uint32_t mag_size;
+  int in_use;
+} __attribute__((aligned(MTMEMPOOL_CACHELINE_SIZE)));
+
+struct mtmempool {
+  /* depot stack heads: (tag << 32) | index */
+  uint64_t full_mags  __attribute__((aligned(MTMEMPOOL_CACHELINE_SIZE)));
+  uint64_t empty_mags __attribute__((aligned(MTMEMPOOL_CACHELINE_SIZE)));
+
+  /* spill area for objects not fitting into a full magazine */
+  int spill_lock      __attribute__((aligned(MTMEMPOOL_CACHELINE_SIZE)));
+  uint32_t spill_count;
+  struct mempool_obj **spill;
+
+  struct mempool *p   __attribute__((aligned(MTMEMPOOL_CACHELINE_SIZE)));
+  uint32_t mag_size;
+  uint32_t nb_mags;
+  size_t mag_stride;
+  void *mag_area;
+  uint32_t max_caches;
+  struct mtmempool_cache *caches;
+};
+
+/*
+ * Allocates a memory pool that can be shared by up to max_caches threads.
+ * mag_size defines the number of objects a per-thread magazine can hold
+ * (0 = MTMEMPOOL_DEFAULT_MAG_SIZE). Each thread can keep up to
+ * 2 * mag_size objects in its cache.
+ * Object layout parameters are the same as for alloc_enhanced_mempool().
+ * Returns NULL on failure (errno is set)
+ */
+struct mtmempool *alloc_enhanced_mtmempool(uint32_t nb_objs,
+  size_t obj_size, size_t obj_data_align, size_t obj_headroom, size_t obj_tailroom, size_t obj_private_len, int sep_obj_data,
+  void (*obj_init_func)(struct mempool_obj *, void *), void *obj_init_func_argp,
+  uint32_t mag_size, uint32_t max_caches);
+#define alloc_simple_mtmempool(nb_objs, obj_size, max_caches) \
+  alloc_enhanced_mtmempool((nb_objs), (obj_size), 0, 0, 0, 0, 0, NULL, NULL, 0, (max_caches))
+
+/* Note: all caches have to be detached before */
+void free_mtmempool(struct mtmempool *mp);
+
+/*
+ * Attaches a new per-thread cache to the pool
+ * Returns NULL on failure (errno is set)
+ */
+struct mtmempool_cache *mtmempool_attach(struct mtmempool *mp);
+/* Returns all objects of a cache to the depot and releases the cache */
+void mtmempool_detach(struct mtmempool_cache *c);
+
+/* slow paths: exchange magazines with the depot */
+int _mtmempool_cache_refill(struct mtmempool_cache *c);
+void _mtmempool_cache_flush(struct mtmempool_cache *c);
+
+#define mtmempool_nb_objs(mp) mempool_nb_objs((mp)->p)
+#define mtmempool_size(mp) mempool_size((mp)->p)
+#define mtmempool_cache_count(c) ((c)->loaded->count + (c)->prev->count)
+
+/*
+ * Pick an object from a memory pool via the thread's cache
+ * Returns NULL on failure
+ */
+static inline struct mempool_obj *mtmempool_pick(struct mtmempool_cache *c)
+{
+  struct mempool_obj *obj;
+
+  if (unlikely(c->loaded->count == 0))
+	if (_mtmempool_cache_refill(c) < 0)
+	  return NULL;
+
+  obj = c->loaded->objs[--c->loaded->count];
+  mempool_reset_obj(obj);
+  return obj;
+}
+
+/*
+ * Put an object back to the memory pool via the thread's cache
+ * The object does not need to be picked by the same thread
+ */
+static inline void mtmempool_put(struct mtmempool_cache *c, struct mempool_obj *obj)
+{
+  if (unlikely(c->loaded->count == c->mag_size))
+	_mtmempool_cache_flush(c);
+
+  c->loaded->objs[c->loaded->count++] = obj;
+}
+
+/*
+ * Bulk variants
+ * mtmempool_pick_multiple() either picks all count objects or none
+ * Returns 0 on success, -1 on failure
+ */
+static inline int mtmempool_pick_multiple(struct mtmempool_cache *c, struct mempool_obj *objs[], uint32_t count)
+{
+  struct mtmempool_mag *m;
+  uint32_t i = 0;
+
+  while (i < count) {
+	if (unlikely(c->loaded->count == 0))
+	  if (_mtmempool_cache_refill(c) < 0)
+		goto err_putback;
+
+	m = c->loaded;
+	while (i < count && m->count) {
+	  objs[i] = m->objs[--m->count];
+	  mempool_reset_obj(objs[i]);
+	  ++i;
+	}
+  }
+  return 0;
+
+ err_putback:
+  while (i)
+	mtmempool_put(c, objs[--i]);
+  errno = ENOBUFS;
+  return -1;
+}
+
+static inline void mtmempool_put_multiple(struct mtmempool_cache *c, struct mempool_obj *objs[], uint32_t count)
+{
+  struct mtmempool_mag *m;
+  uint32_t i = 0;
+
+  while (i < count) {
+	if (unlikely(c->loaded->count == c->mag_size))
+	  _mtmempool_cache_flush(c);
+
+	m = c->loaded;
+	while (i < count && m->count < c->mag_size)
+	  m->objs[m->count++] = objs[i++];
+  }
+}
+
+#endif /* _MTMEMPOOL_H_ */
@@ -469,6 +469,13 @@ static int sh_exec(FILE *cio, char *argb, size_t argb_len)
     return ret;
 }
 
+int shell_exec(FILE *cio, char *argb, size_t argb_len)
+{
+    BUG_ON(sh == NULL);
+
+    return sh_exec(cio, argb, argb_len);
+}
+
 /* the shell session thread */
 static void sh_session(void *argp)
 {
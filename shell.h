@@ -50,4 +50,9 @@ void exit_shell(void);
 int shell_register_cmd(const char *cmd, shfunc_ptr_t func);
 void shell_unregister_cmd(const char *cmd);
 
+/* parses and executes a command line outside of a session (e.g., from
+ * a control channel); argb is modified. Returns the command's return
+ * code (SH_CLOSE for exit) */
+int shell_exec(FILE *cio, char *argb, size_t argb_len);
+
 #endif /* _SHELL_H_ */
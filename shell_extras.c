@@ -235,6 +235,18 @@ static int shcmd_mallinfo(FILE *cio, int argc, char *argv[])
 
 #ifdef HAVE_LWIP
 #include <lwip/tcp.h>
+#ifdef CONFIG_TAPIF
+#include <netif/tapif.h>
+#endif
+#ifdef CONFIG_NETMAP
+#include <netif/netmapif.h>
+#endif
+#ifdef CONFIG_XDPIF
+#include <netif/xdpif.h>
+#endif
+#ifdef CONFIG_LOOPIF
+#include <netif/loopif.h>
+#endif
 
 static int shcmd_ifconfig(FILE *cio, int argc, char *argv[])
 {
@@ -242,6 +254,18 @@ static int shcmd_ifconfig(FILE *cio, int argc, char *argv[])
 	struct netif *netif;
 	int is_up;
 	uint8_t flags;
+#ifdef CONFIG_TAPIF
+	struct tapif_stats tstats;
+#endif
+#ifdef CONFIG_NETMAP
+	struct netmapif_stats nstats;
+#endif
+#ifdef CONFIG_XDPIF
+	struct xdpif_stats xstats;
+#endif
+#ifdef CONFIG_LOOPIF
+	struct loopif_stats lstats;
+#endif
 
 	for (netif = netif_list; netif != NULL; netif = netif->next) {
 		is_up = netif_is_up(netif);
@@ -266,7 +290,7 @@ static int shcmd_ifconfig(FILE *cio, int argc, char *argv[])
 			fprintf(cio, "ARP ");
 		if (flags & NETIF_FLAG_ETHERNET)
 			fprintf(cio, "ETHERNET ");
-#ifdef CONFIG_NETFRONT_GSO
+#if defined CONFIG_NETFRONT_GSO || defined CONFIG_LWIP_GSO
 		fprintf(cio, "GSO ");
 #endif
 #if LWIP_CHECKSUM_PARTIAL
@@ -302,6 +326,51 @@ static int shcmd_ifconfig(FILE *cio, int argc, char *argv[])
 			        ip4_addr3(&netif->gw),
 			        ip4_addr4(&netif->gw));
 		}
+#ifdef CONFIG_TAPIF
+		if (tapif_get_stats(netif, &tstats) == 0) {
+			fprintf(cio, "          RX packets:%"PRIu64" bytes:%"PRIu64" merged:%"PRIu64" nomem:%"PRIu64"\n",
+			        tstats.rx_pkts, tstats.rx_bytes, tstats.rx_gro, tstats.rx_nomem);
+			fprintf(cio, "          TX packets:%"PRIu64" bytes:%"PRIu64" csum:%"PRIu64" gso:%"PRIu64" linearized:%"PRIu64" dropped:%"PRIu64"\n",
+			        tstats.tx_pkts, tstats.tx_bytes, tstats.tx_csum, tstats.tx_gso, tstats.tx_linear, tstats.tx_drop);
+			fprintf(cio, "          Polls:%"PRIu64" busy:%"PRIu64" packets/busy poll:%"PRIu64".%02"PRIu64" queues:%u\n",
+			        tstats.polls, tstats.busy_polls,
+			        tstats.busy_polls ? tstats.rx_pkts / tstats.busy_polls : 0,
+			        tstats.busy_polls ? ((tstats.rx_pkts * 100) / tstats.busy_polls) % 100 : 0,
+			        (unsigned int) CONFIG_TAPIF_NUM_QUEUES);
+		}
+#endif
+#ifdef CONFIG_NETMAP
+		if (netmapif_get_stats(netif, &nstats) == 0) {
+			fprintf(cio, "          RX packets:%"PRIu64" zero-copy:%"PRIu64" copied (no spare):%"PRIu64" syncs:%"PRIu64"\n",
+			        nstats.rx_pkts, nstats.rx_zcopy, nstats.rx_nospare, nstats.rx_syncs);
+			fprintf(cio, "          TX packets:%"PRIu64" syncs:%"PRIu64" (%"PRIu64".%02"PRIu64"/packet) ring full:%"PRIu64"\n",
+			        nstats.tx_pkts, nstats.tx_syncs,
+			        nstats.tx_pkts ? nstats.tx_syncs / nstats.tx_pkts : 0,
+			        nstats.tx_pkts ? ((nstats.tx_syncs * 100) / nstats.tx_pkts) % 100 : 0,
+			        nstats.tx_full);
+			fprintf(cio, "          TX super-segments:%"PRIu64" segments:%"PRIu64" (%"PRIu64".%02"PRIu64"/super-segment)\n",
+			        nstats.tx_gso, nstats.tx_gso_segs,
+			        nstats.tx_gso ? nstats.tx_gso_segs / nstats.tx_gso : 0,
+			        nstats.tx_gso ? ((nstats.tx_gso_segs * 100) / nstats.tx_gso) % 100 : 0);
+		}
+#endif
+#ifdef CONFIG_XDPIF
+		if (xdpif_get_stats(netif, &xstats) == 0) {
+			fprintf(cio, "          AF_XDP %s mode\n",
+			        xstats.zerocopy ? "zero-copy" : "copy");
+			fprintf(cio, "          RX packets:%"PRIu64" by reference:%"PRIu64" copied:%"PRIu64" wakeups:%"PRIu64"\n",
+			        xstats.rx_pkts, xstats.rx_zcopy, xstats.rx_copied, xstats.rx_wakeups);
+			fprintf(cio, "          TX packets:%"PRIu64" kicks:%"PRIu64" ring full:%"PRIu64" dropped:%"PRIu64"\n",
+			        xstats.tx_pkts, xstats.tx_kicks, xstats.tx_full, xstats.tx_drop);
+		}
+#endif
+#ifdef CONFIG_LOOPIF
+		if (loopif_get_stats(netif, &lstats) == 0) {
+			fprintf(cio, "          Looped packets:%"PRIu64" bytes:%"PRIu64" dropped:%"PRIu64" max. queue length:%"PRIu32"/%u\n",
+			        lstats.pkts, lstats.bytes, lstats.drop, lstats.maxqlen,
+			        (unsigned int) CONFIG_LOOPIF_QUEUE_LEN);
+		}
+#endif
 	}
 	return 0;
 }
@@ -529,6 +529,8 @@ static void load_vol_hconf(void)
 	shfs_vol.hfunc                        = hdr_config->hfunc;
 	shfs_vol.hlen                         = hdr_config->hlen;
 	shfs_vol.allocator                    = hdr_config->allocator;
+	shfs_vol.fill_ref                     = hdr_config->fill_ref;
+	shfs_vol.fill_len                     = hdr_config->fill_len;
 
 	/* brief configuration check */
 	if (shfs_vol.htable_len == 0)
@@ -625,6 +627,12 @@ static void load_vol_alist(void)
 		if (ret < 0)
 			dief("Could not register an allocator entry for backup hash table: %s\n", strerror(errno));
 	}
+	if (shfs_vol.fill_len) {
+		dprintf(D_L0, "Registering fill area to allocator...\n");
+		ret = shfs_alist_register(shfs_vol.al, shfs_vol.fill_ref, shfs_vol.fill_len);
+		if (ret < 0)
+			dief("Could not register an allocator entry for fill area: %s\n", strerror(errno));
+	}
 
 	dprintf(D_L0, "Registering containers to allocator...\n");
 	foreach_htable_el(shfs_vol.bt, el) {
@@ -632,6 +640,9 @@ static void load_vol_alist(void)
 		hentry = (struct shfs_hentry *)
 			((uint8_t *) shfs_vol.htable_chunk_cache[bentry->hentry_htchunk]
 			 + bentry->hentry_htoffset);
+		if (SHFS_HENTRY_ISLINK(hentry) ||
+		    shfs_is_fill_container(hentry->f_attr.chunk))
+			continue; /* no container or part of fill area */
 		shfs_alist_register(shfs_vol.al,
 		                    hentry->f_attr.chunk,
 		                    DIV_ROUND_UP(hentry->f_attr.offset + hentry->f_attr.len,
@@ -1260,7 +1271,8 @@ static int actn_rmfile(struct token *token)
 		 + bentry->hentry_htoffset);
 
 	/* release container */
-	if (!SHFS_HENTRY_ISLINK(hentry)) {
+	if (!SHFS_HENTRY_ISLINK(hentry) &&
+	    !shfs_is_fill_container(hentry->f_attr.chunk)) {
 		dprintf(D_L0, "Releasing container...\n");
 		ret = shfs_alist_unregister(shfs_vol.al, hentry->f_attr.chunk,
 					    DIV_ROUND_UP(hentry->f_attr.len + hentry->f_attr.offset,
@@ -103,6 +103,10 @@ struct vol_info {
 
 	struct shfs_bentry *def_bentry;
 
+	/* pull-through fill area */
+	chk_t fill_ref;
+	chk_t fill_len;
+
 	/* allocator */
 	uint8_t allocator;
 	struct shfs_alist *al;
@@ -111,4 +115,9 @@ struct vol_info {
 /* chunk_cache_states */
 #define CCS_MODIFIED 0x02
 
+/* containers of pull-through fills are managed by the fill area */
+#define shfs_is_fill_container(chk) \
+	(shfs_vol.fill_len && (chk) >= shfs_vol.fill_ref && \
+	 (chk) < shfs_vol.fill_ref + shfs_vol.fill_len)
+
 #endif /* _SHFS_ADMIN_ */
@@ -52,7 +52,7 @@ int force = 0;
 /******************************************************************************
  * ARGUMENT PARSING                                                           *
  ******************************************************************************/
-const char *short_opts = "h?vVfn:s:cb:e:xF:l:";
+const char *short_opts = "h?vVfn:s:cb:e:xF:l:a:";
 
 static struct option long_opts[] = {
 	{"help",		no_argument,		NULL,	'h'},
@@ -67,6 +67,7 @@ static struct option long_opts[] = {
 	{"erase",		no_argument,		NULL,	'x'},
 	{"hash-function",	required_argument,	NULL,	'F'},
 	{"hash-length",		required_argument,	NULL,	'l'},
+	{"fill-area",		required_argument,	NULL,	'a'},
 	{NULL, 0, NULL, 0} /* end of list */
 };
 
@@ -102,6 +103,10 @@ static void print_usage(char *argv0)
 	printf("                                    sha (default), crc, md5, haval, manual\n");
 	printf("  -l, --hash-length [BYTES]        sets the the hash digest length in bytes\n");
 	printf("                                    at least 1 (8 Bits), at most 64 (512 Bits)\n");
+	printf("\n");
+	printf(" Pull-through fill configuration:\n");
+	printf("  -a, --fill-area [CHUNKS]         reserves CHUNKS at the end of the volume\n");
+	printf("                                    for persisting objects of auto links\n");
 }
 
 static inline void release_args(struct args *args)
@@ -148,6 +153,7 @@ static int parse_args(int argc, char **argv, struct args *args)
 
 	args->hashfunc = SHFUNC_SHA;
 	args->hashlen = 0; /* set to default after parsing */
+	args->fill_len = 0; /* no fill area */
 
 	/*
 	 * Parse options
@@ -233,6 +239,14 @@ static int parse_args(int argc, char **argv, struct args *args)
 			}
 			args->hashlen = (uint8_t) tmp;
 			break;
+		case 'a': /* fill-area */
+			ret = parse_args_setval_int(&tmp, optarg);
+			if (ret < 0 || tmp < 0) {
+				eprintf("Invalid fill area size\n");
+				return -EINVAL;
+			}
+			args->fill_len = (chk_t) tmp;
+			break;
 		default:
 			/* unknown option */
 			return -EINVAL;
@@ -418,6 +432,13 @@ static void mkfs(struct storage *s, struct args *args)
 	mdata_size = metadata_size(hdr_common, hdr_config);
 	if (mdata_size > hdr_common->vol_size)
 		dief("Disk label requires more space than available on members\n");
+	if (args->fill_len) {
+		if (args->fill_len > hdr_common->vol_size - mdata_size)
+			dief("Fill area requires more space than available on members\n");
+		/* fill area is placed at the end of the volume */
+		hdr_config->fill_ref = hdr_common->vol_size - args->fill_len;
+		hdr_config->fill_len = args->fill_len;
+	}
 
 	/*
 	 * Summary
@@ -56,6 +56,8 @@ struct args {
 	uint8_t  hashlen;
 	uint32_t bucket_count;
 	uint32_t entries_per_bucket;
+
+	chk_t    fill_len;
 };
 
 #endif /* _SHFS_MKFS_ */
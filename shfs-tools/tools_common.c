@@ -292,6 +292,10 @@ void print_shfs_hdr_summary(struct shfs_hdr_common *hdr_common,
 	       hdr_config->htable_bak_ref ? "2nd copy enabled" : "No copy");
 	printf("Entry size:         %"PRIu64" Bytes (raw: %zu Bytes)\n", hentry_size, sizeof(struct shfs_hentry));
 	printf("Metadata total:     %"PRIu64" chunks\n", metadata_size(hdr_common, hdr_config));
+	if (hdr_config->fill_len)
+		printf("Fill area:          %"PRIu64" chunks (%"PRIu64" KiB) at chunk %"PRIu64"\n",
+		       hdr_config->fill_len, CHUNKS_TO_BYTES(hdr_config->fill_len, chunksize) / 1024,
+		       hdr_config->fill_ref);
 	printf("Available space:    %"PRIu64" chunks\n", avail_space(hdr_common, hdr_config));
 
 	printf("\n");
@@ -350,5 +354,6 @@ chk_t metadata_size(struct shfs_hdr_common *hdr_common,
 chk_t avail_space(struct shfs_hdr_common *hdr_common,
                   struct shfs_hdr_config *hdr_config)
 {
-	return hdr_common->vol_size - metadata_size(hdr_common, hdr_config);
+	return hdr_common->vol_size - metadata_size(hdr_common, hdr_config)
+		- hdr_config->fill_len;
 }
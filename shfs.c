@@ -56,6 +56,12 @@ int shfs_errno;
 #include "shfs_stats_data.h"
 #include "shfs_stats.h"
 #endif
+#ifdef SHFS_FILL
+#include "shfs_fill.h"
+#endif
+#ifdef SHFS_L2CACHE
+#include "shfs_l2cache.h"
+#endif
 
 #ifdef SHFS_DEBUG
 #define ENABLE_DEBUG
@@ -348,6 +354,59 @@ static int load_vol_cconf(blkdev_id_t bd_id[], unsigned int count)
 	return ret;
 }
 
+#ifdef SHFS_FILL
+/**
+ * Re-opens all members of the mounted volume writable, so that
+ * fills can be written back to the volume. Members are kept
+ * read-only (and fill_rdonly is set) when this is not possible.
+ * A member that cannot be re-opened at all is removed from the
+ * member list and an error is returned.
+ */
+static int shfs_reopen_members_rdwr(void)
+{
+	blkdev_id_t id;
+	struct blkdev *bd;
+	unsigned int i, j;
+	int ret;
+#ifdef SHFS_DEBUG
+	char str_id[64];
+#endif
+
+	shfs_vol.fill_rdonly = 0;
+	for (i = 0; i < shfs_vol.nb_members; i++) {
+		blkdev_id_cpy(id, blkdev_id(shfs_vol.member[i].bd));
+#ifdef SHFS_DEBUG
+		blkdev_id_unparse(id, str_id, sizeof(str_id));
+#endif
+		close_blkdev(shfs_vol.member[i].bd);
+
+		bd = open_blkdev(id, O_RDWR);
+		if (!bd) {
+			printd("Could not open %s writable: %s\n", str_id, strerror(errno));
+			bd = open_blkdev(id, O_RDONLY);
+			if (!bd) {
+				ret = -errno;
+				printd("Could not re-open %s: %s\n", str_id, strerror(-ret));
+				for (j = i + 1; j < shfs_vol.nb_members; j++)
+					shfs_vol.member[j - 1] = shfs_vol.member[j];
+				shfs_vol.nb_members--;
+				return ret;
+			}
+			shfs_vol.fill_rdonly = 1;
+		}
+		shfs_vol.member[i].bd = bd;
+	}
+
+#if defined CONFIG_SELECT_POLL && defined CAN_POLL_BLKDEV
+	shfs_vol.members_maxfd = blkdev_get_fd(shfs_vol.member[0].bd);
+	for (i = 1; i < shfs_vol.nb_members; i++)
+		shfs_vol.members_maxfd = max(shfs_vol.members_maxfd,
+					     blkdev_get_fd(shfs_vol.member[i].bd));
+#endif
+	return 0;
+}
+#endif
+
 /**
  * This function loads the hash configuration from chunk 1
  * (as defined in SHFS)
@@ -381,6 +440,22 @@ static int load_vol_hconf(void)
 	shfs_vol.htable_nb_entries_per_chunk  = SHFS_HENTRIES_PER_CHUNK(shfs_vol.chunksize);
 	shfs_vol.htable_len                   = SHFS_HTABLE_SIZE_CHUNKS(hdr_config, shfs_vol.chunksize);
 	shfs_vol.hlen = hdr_config->hlen;
+#ifdef SHFS_FILL
+	shfs_vol.fill_ref                     = hdr_config->fill_ref;
+	shfs_vol.fill_len                     = hdr_config->fill_len;
+	shfs_vol.fill_rdonly                  = 1;
+	if (shfs_vol.fill_len) {
+		/* fills are written back to the volume: members were opened
+		 * read-only by load_vol_cconf(), upgrade them now */
+		ret = shfs_reopen_members_rdwr();
+		if (ret < 0)
+			goto out_free_chk1;
+	}
+	if (shfs_vol.fill_len && shfs_vol.fill_rdonly) {
+		printd("Volume is not writable, pull-through fill area is disabled\n");
+		shfs_vol.fill_len = 0;
+	}
+#endif
 	ret = 0;
 
 	/* brief configuration check */
@@ -525,6 +600,15 @@ static int load_vol_htable(void)
 			shfs_vol.def_bentry = bentry;
 	}
 
+#ifdef SHFS_BTABLE_INDEX
+	/* build in-memory lookup index (on-disk layout is not affected) */
+	printd("Building btable lookup index...\n");
+	ret = htable_idx_attach(shfs_vol.bt);
+	if (ret < 0)
+		printd("Could not build btable lookup index, "
+		       "falling back to bucket lookups: %d\n", ret);
+#endif
+
 	return 0;
 
  err_cancel_aio:
@@ -599,6 +683,11 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	if (ret < 0)
 		goto err_close_members;
 
+#ifdef SHFS_FILL
+	/* find the first free chunk in the fill area */
+	shfs_fill_init();
+#endif
+
 	printd("Allocating remount chunk buffer...\n");
 	shfs_vol.remount_chunk_buffer = target_malloc(shfs_vol.ioalign, shfs_vol.chunksize);
 	if (!shfs_vol.remount_chunk_buffer)
@@ -610,6 +699,14 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	if (ret < 0)
 		goto err_free_remount_buffer;
 
+#ifdef SHFS_L2CACHE
+	/* second-level cache is optional: the volume is mounted without it on errors */
+	printd("Attaching second-level cache...\n");
+	ret = shfs_l2cache_attach();
+	if (ret < 0)
+		printd("Could not attach second-level cache: %d\n", ret);
+#endif
+
 #ifdef SHFS_STATS
 	printd("Initializing statistics...\n");
 	ret = shfs_init_mstats(shfs_vol.htable_nb_buckets,
@@ -630,6 +727,9 @@ int mount_shfs(blkdev_id_t bd_id[], unsigned int count)
 	goto  err_free_chunkcache;
  err_free_chunkcache:
 	shfs_free_cache();
+#ifdef SHFS_L2CACHE
+	shfs_l2cache_detach();
+#endif
  err_free_remount_buffer:
 	target_free(shfs_vol.remount_chunk_buffer);
  err_free_htable:
@@ -690,6 +790,9 @@ int umount_shfs(int force) {
 		}
 		shfs_free_cache();
 #endif
+#ifdef SHFS_L2CACHE
+		shfs_l2cache_detach(); /* writes back its index */
+#endif
 
 		shfs_mounted = 0;
 		target_free(shfs_vol.remount_chunk_buffer);
@@ -860,6 +963,10 @@ int remount_shfs(void) {
 	/* TODO: Re-read chunk0 and check if volume UUID still matches */
 
 	ret = reload_vol_htable();
+#ifdef SHFS_L2CACHE
+	if (ret >= 0)
+		shfs_l2cache_revalidate();
+#endif
  out:
 	up(&shfs_mount_lock);
 	return ret;
@@ -918,6 +1025,10 @@ SHFS_AIO_TOKEN *shfs_aio_chunk(chk_t start, chk_t len, int write, void *buffer,
 		errno = ENODEV;
 		goto err_out;
 	}
+#ifdef SHFS_L2CACHE
+	if (write && shfs_vol.l2cache_bd)
+		shfs_l2cache_invalidate(start, len); /* cached copies become outdated */
+#endif
 
 	switch (shfs_vol.stripemode) {
 	case SHFS_SM_COMBINED:
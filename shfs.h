@@ -110,8 +110,19 @@ struct vol_info {
 
 	struct shfs_bentry *def_bentry;
 
+#ifdef SHFS_FILL
+	/* pull-through fill area (see shfs_fill.h) */
+	chk_t fill_ref;
+	chk_t fill_len;
+	chk_t fill_next; /* next free chunk in fill area */
+	int fill_rdonly; /* set if members are not opened for writing */
+#endif
+
 	struct mempool *aiotoken_pool; /* token for async I/O */
 	struct shfs_cache *chunkcache; /* chunkcache */
+#ifdef SHFS_L2CACHE
+	struct blkdev *l2cache_bd; /* device of second-level cache (see shfs_l2cache.h) */
+#endif
 
 #ifdef SHFS_STATS
 	struct shfs_mstats mstats;
@@ -138,8 +149,29 @@ static inline void shfs_poll_blkdevs(void) {
 
 	for(i = 0; i < m; ++i)
 		blkdev_poll_req(shfs_vol.member[i].bd);
+#ifdef SHFS_L2CACHE
+	if (m && shfs_vol.l2cache_bd)
+		blkdev_poll_req(shfs_vol.l2cache_bd);
+#endif
 }
 
+#ifdef blkdev_inflight
+/* returns 1 if there are I/O requests in flight on any member */
+static inline int shfs_blkdevs_busy(void) {
+	register unsigned int i;
+	register uint8_t m = shfs_blkdevs_count();
+
+	for(i = 0; i < m; ++i)
+		if (blkdev_inflight(shfs_vol.member[i].bd))
+			return 1;
+#ifdef SHFS_L2CACHE
+	if (m && shfs_vol.l2cache_bd && blkdev_inflight(shfs_vol.l2cache_bd))
+		return 1;
+#endif
+	return 0;
+}
+#endif
+
 #ifdef CAN_POLL_BLKDEV
 #include <sys/select.h>
 
@@ -210,6 +242,10 @@ static inline void shfs_aio_submit(void) {
 
 	for(i = 0; i < m; ++i)
 		blkdev_async_io_submit(shfs_vol.member[i].bd);
+#ifdef SHFS_L2CACHE
+	if (m && shfs_vol.l2cache_bd)
+		blkdev_async_io_submit(shfs_vol.l2cache_bd);
+#endif
 #endif
 }
 
@@ -103,6 +103,25 @@ static inline struct shfs_bentry *shfs_btable_lookup(struct htable *bt, hash512_
 	return NULL;
 }
 
+/**
+ * Does a lookup for multiple bucket entries by their hash values
+ * (see htable_lookup_multiple()): bentry_out[i] is set to NULL if there is
+ * no entry for h[i]. Returns the number of found entries
+ */
+static inline unsigned int shfs_btable_lookup_multiple(struct htable *bt, const hash512_t *h,
+						       struct shfs_bentry **bentry_out, unsigned int count) {
+	struct htable_el *el[HTABLE_LOOKUP_AHEAD];
+	unsigned int i, j, n, found = 0;
+
+	for (i = 0; i < count; i += n) {
+		n = (count - i) < HTABLE_LOOKUP_AHEAD ? (count - i) : HTABLE_LOOKUP_AHEAD;
+		found += htable_lookup_multiple(bt, &h[i], el, n);
+		for (j = 0; j < n; ++j)
+			bentry_out[i + j] = el[j] ? (struct shfs_bentry *) el[j]->private : NULL;
+	}
+	return found;
+}
+
 #ifdef SHFS_OPENBYNAME
 /*
  * Unfortunately, opening by name ends up in an
@@ -186,6 +205,7 @@ static inline struct shfs_bentry *shfs_btable_feed(struct htable *bt, uint64_t e
 
 	/* check if a previous entry was there -> if yes, unlink it */
 	if (!hash_is_zero(b->h[el_idx_bkt], bt->hlen)) {
+		htable_idx_rm(bt, el);
 		if (el->prev)
 			el->prev->next = el->next;
 		else
@@ -213,6 +233,7 @@ static inline struct shfs_bentry *shfs_btable_feed(struct htable *bt, uint64_t e
 			el->next = NULL;
 			bt->tail = el;
 		}
+		htable_idx_add(bt, el);
 	}
 
 	return (struct shfs_bentry *) el->private;
@@ -36,6 +36,9 @@
 #include <target/sys.h>
 
 #include "shfs_cache.h"
+#ifdef SHFS_L2CACHE
+#include "shfs_l2cache.h"
+#endif
 #include "likely.h"
 
 #if (defined SHFS_CACHE_DEBUG || defined SHFS_DEBUG)
@@ -68,6 +71,9 @@ static void _cce_pobj_init(struct mempool_obj *pobj, void *unused)
     cce->pobj = pobj;
     cce->refcount = 0;
     cce->buffer = pobj->data;
+#ifdef SHFS_CACHE_ALIAS
+    cce->data = pobj->data;
+#endif
     cce->invalid = 1; /* buffer is not ready yet */
 
     cce->t = NULL;
@@ -179,6 +185,11 @@ int shfs_alloc_cache(void)
     cc->htmask = htlen - 1;
     cc->nb_entries = 0;
     cc->nb_ref_entries = 0;
+#ifdef SHFS_CACHE_ALIAS
+    /* chunks of striped volumes are not contiguous in device memory */
+    cc->alias = (shfs_vol.nb_members == 1);
+    printd("Aliasing of device memory: %s\n", cc->alias ? "enabled" : "disabled");
+#endif
 
     shfs_vol.chunkcache = cc;
     shfs_cache_stats_reset();
@@ -193,6 +204,18 @@ int shfs_alloc_cache(void)
 #define shfs_cache_htindex(addr) \
 	(((uint32_t) (addr)) & (shfs_vol.chunkcache->htmask))
 
+#ifdef SHFS_L2CACHE
+/* offers a loaded chunk that gets evicted to the second-level cache */
+#define shfs_cache_evict_l2(cce) \
+	do { \
+		if (!(cce)->invalid && (cce)->addr) \
+			shfs_l2cache_admit((cce)->addr, (cce)->buffer, (cce)->hits); \
+	} while (0)
+#else
+#define shfs_cache_evict_l2(cce) \
+	do {} while (0)
+#endif
+
 static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
     struct mempool_obj *cce_obj;
 #ifdef SHFS_CACHE_GROW
@@ -227,6 +250,9 @@ static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
     cce->pobj = NULL;
     cce->refcount = 0;
     cce->buffer = buf;
+#ifdef SHFS_CACHE_ALIAS
+    cce->data = buf;
+#endif
     cce->invalid = 1; /* buffer is not ready yet */
     cce->t = NULL;
     cce->aio_chain.first = NULL;
@@ -241,7 +267,11 @@ static inline struct shfs_cache_entry *shfs_cache_pick_cce(void) {
 #ifdef SHFS_CACHE_GROW
 static inline void shfs_cache_put_cce(struct shfs_cache_entry *cce) {
 	if (!cce->pobj) {
+#ifdef SHFS_CACHE_ALIAS
+		target_free(cce->data);
+#else
 		target_free(cce->buffer);
+#endif
 		target_free(cce);
 	} else {
 		mempool_put(cce->pobj);
@@ -326,6 +356,33 @@ void shfs_flush_cache(void)
     shfs_cache_flush_alist();
 }
 
+#ifdef SHFS_CACHE_GROW
+size_t shfs_cache_reclaim(size_t len)
+{
+    struct shfs_cache_entry *cce, *cce_next;
+    size_t released = 0;
+
+    if (!shfs_vol.chunkcache)
+	    return 0;
+
+    cce = dlist_first_el(shfs_vol.chunkcache->alist, struct shfs_cache_entry);
+    while (cce && released < len) {
+	    cce_next = dlist_next_el(cce, alist);
+	    if (!cce->pobj && !cce->t) {
+		    /* grown buffer that is not in use: give it back */
+		    printd("Reclaiming chunk buffer %llu...\n", cce->addr);
+		    shfs_cache_evict_l2(cce);
+		    shfs_cache_unlink(cce);
+		    shfs_cache_put_cce(cce);
+		    shfs_cache_stat_inc(evict);
+		    released += shfs_vol.chunksize;
+	    }
+	    cce = cce_next;
+    }
+    return released;
+}
+#endif
+
 void shfs_free_cache(void)
 {
     shfs_cache_flush_alist();
@@ -344,6 +401,7 @@ static void _cce_aiocb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
     BUG_ON(cce->refcount == 0 && cce->aio_chain.first);
     BUG_ON(t != cce->t);
 
+    tp_end(TP_SHFS_AIO_COMPLETE, cce->tp_issued);
     ret = shfs_aio_finalize(t);
     cce->t = NULL;
     cce->invalid = (ret < 0) ? 1 : 0;
@@ -409,6 +467,7 @@ static inline struct shfs_cache_entry *shfs_cache_add(chk_t addr)
 
     found:
 	shfs_cache_stat_inc(evict);
+	shfs_cache_evict_l2(cce);
 	/* unlink from hash table */
 	i = shfs_cache_htindex(cce->addr);
 	dlist_unlink(cce, shfs_vol.chunkcache->htable[i].clist, clist);
@@ -421,8 +480,34 @@ static inline struct shfs_cache_entry *shfs_cache_add(chk_t addr)
     }
 
     cce->addr = addr;
+#ifdef SHFS_L2CACHE
+    cce->hits = 0;
+#endif
+#ifdef SHFS_CACHE_ALIAS
+    if (shfs_vol.chunkcache->alias) {
+	/* point to the chunk in device memory: no I/O required,
+	 * the entry is ready immediately */
+	cce->buffer = blkdev_map(shfs_vol.member[0].bd,
+	                         (sector_t) addr * shfs_vol.member[0].sfactor);
+	cce->t = NULL;
+	cce->invalid = 0;
+	shfs_cache_stat_inc(alias);
+
+	i = shfs_cache_htindex(addr);
+	dlist_append(cce, shfs_vol.chunkcache->htable[i].clist, clist);
+	return cce;
+    }
+#endif
+    tp_stamp(cce->tp_issued);
+#ifdef SHFS_L2CACHE
+    /* try the second-level cache before reading from the volume */
+    cce->t = shfs_l2cache_aread(addr, cce->buffer,
+                                _cce_aiocb, cce, NULL);
+    if (!cce->t)
+#endif
     cce->t = shfs_aread_chunk(addr, 1, cce->buffer,
                               _cce_aiocb, cce, NULL);
+    tp_end(TP_SHFS_AIO_SUBMIT, cce->tp_issued);
     if (unlikely(!cce->t)) {
 	    dlist_unlink(cce, shfs_vol.chunkcache->alist, alist);
 	    shfs_cache_put_cce(cce);
@@ -445,6 +530,10 @@ static inline void shfs_cache_readahead(chk_t addr)
 	struct shfs_cache_entry *cce;
 	register chk_t i;
 
+#ifdef SHFS_CACHE_ALIAS
+	if (shfs_vol.chunkcache->alias)
+		return; /* nothing to read: entries alias device memory */
+#endif
 	for (i = 1; i <= SHFS_CACHE_READAHEAD; ++i) {
 		register chk_t addri = addr + i;
 
@@ -514,6 +603,9 @@ int shfs_cache_aread(chk_t addr, shfs_aiocb_t *cb, void *cb_cookie, void *cb_arg
 	++shfs_vol.chunkcache->nb_ref_entries;
     }
     ++cce->refcount;
+#ifdef SHFS_L2CACHE
+    ++cce->hits;
+#endif
 
 #ifndef SHFS_CACHE_DISABLE
 #if (SHFS_CACHE_READAHEAD > 0)
@@ -607,11 +699,16 @@ int shfs_cache_eblank(struct shfs_cache_entry **cce_out)
 
     found:
 	shfs_cache_stat_inc(evict);
+	shfs_cache_evict_l2(cce);
 
 	/* unlink from hash collision table and available list */
 	shfs_cache_unlink(cce);
     }
 
+#ifdef SHFS_CACHE_ALIAS
+    cce->buffer = cce->data; /* blank buffers are written by the caller */
+#endif
+
     /* set refcount */
     cce->refcount = 1;
     ++shfs_vol.chunkcache->nb_ref_entries;
@@ -805,6 +902,10 @@ int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 	fprintf(cio, " Number pre-allocated buffers:       %12"PRIu32" (pool size: %7"PRIu64" KiB)\n",
 	        nb_objs, pool_size / 1024);
 #endif
+#ifdef SHFS_CACHE_ALIAS
+	fprintf(cio, " Aliasing of device memory:              %s\n",
+	        shfs_vol.chunkcache->alias ? " enabled" : "disabled");
+#endif
 #ifdef SHFS_CACHE_GROW
 	fprintf(cio, " Dynamic buffer allocation:               enabled");
 #ifdef SHFS_CACHE_GROW_THRESHOLD
@@ -827,6 +928,13 @@ int shcmd_shfs_cache_info(FILE *cio, int argc, char *argv[])
 	fprintf(cio, "  Out of memory:                     %12"PRIu32"\n", shfs_cache_stat_get(memerr));
 	fprintf(cio, "  Successful I/O:                    %12"PRIu32"\n", shfs_cache_stat_get(iosuc));
 	fprintf(cio, "  Failed I/O:                        %12"PRIu32"\n", shfs_cache_stat_get(ioerr));
+#ifdef SHFS_CACHE_ALIAS
+	fprintf(cio, "  Aliased (no I/O):                  %12"PRIu32"\n", shfs_cache_stat_get(alias));
+#endif
+#endif
+
+#ifdef SHFS_L2CACHE
+	shfs_l2cache_print_info(cio);
 #endif
 
 #ifdef SHFS_CACHE_DEBUG
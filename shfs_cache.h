@@ -42,6 +42,7 @@
 
 #include "dlist.h"
 #include "mempool.h"
+#include "tracepoint.h"
 
 #ifndef SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY
 #define SHFS_CACHE_HTABLE_AVG_LIST_LENGTH_PER_ENTRY 2 /* defines in the end roughly the average maximum number of comparisons
@@ -85,16 +86,28 @@
 #endif
 #endif /* __MINIOS__ &6 HAVE_LIBC */
 
+#if defined blkdev_map && !defined SHFS_CACHE_DISABLE
+#define SHFS_CACHE_ALIAS /* device memory is directly accessible: on single-member
+			  * volumes, entries point to the mapped chunk instead
+			  * of holding a copy of it */
+#endif
+
 struct shfs_cache_entry {
 	struct mempool_obj *pobj;
 
 	chk_t addr;
 	uint32_t refcount;
+#ifdef SHFS_L2CACHE
+	uint32_t hits; /* references since the chunk was loaded (admission to second-level cache) */
+#endif
 
 	dlist_el(alist); /* when part of the avaliable list */
 	dlist_el(clist); /* when part of a collision list */
 
 	void *buffer;
+#ifdef SHFS_CACHE_ALIAS
+	void *data; /* own buffer (buffer points to device memory when aliased) */
+#endif
 	int invalid; /* I/O didn't succeed on this buffer
 		      * or buffer is a blank buffer when addr == 0 */
 
@@ -104,6 +117,10 @@ struct shfs_cache_entry {
 		SHFS_AIO_TOKEN *first;
 		SHFS_AIO_TOKEN *last;
 	} aio_chain;
+
+#ifdef TRACEPOINTS
+	tp_ts_t tp_issued; /* time when I/O was issued */
+#endif
 };
 
 struct shfs_cache_htel {
@@ -116,6 +133,9 @@ struct shfs_cache {
 	uint32_t htmask;
 	uint64_t nb_ref_entries;
 	uint64_t nb_entries;
+#ifdef SHFS_CACHE_ALIAS
+	int alias; /* entries alias device memory */
+#endif
 
 #ifdef SHFS_CACHE_STATS
 	struct {
@@ -128,6 +148,7 @@ struct shfs_cache {
 		uint32_t memerr;
 		uint32_t iosuc;
 		uint32_t ioerr;
+		uint32_t alias;
 	} stats;
 #endif /* SHFS_CACHE_STATS */
 
@@ -158,6 +179,11 @@ struct shfs_cache {
 int shfs_alloc_cache(void);
 void shfs_flush_cache(void); /* releases unreferenced buffers */
 void shfs_free_cache(void);
+#ifdef SHFS_CACHE_GROW
+/* releases up to len bytes of unreferenced heap-allocated (grown) buffers
+ * to the system, least recently used first; returns released bytes */
+size_t shfs_cache_reclaim(size_t len);
+#endif
 #define shfs_cache_ref_count() \
 	(shfs_vol.chunkcache->nb_ref_entries)
 
@@ -165,6 +165,8 @@ struct shfs_hdr_config {
 	uint32_t           htable_bucket_count;
 	uint32_t           htable_entries_per_bucket;
 	uint8_t            allocator;
+	chk_t              fill_ref; /* area for pull-through fills of links, if 0 => none */
+	chk_t              fill_len;
 } __attribute__((packed));
 
 /**
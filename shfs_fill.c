@@ -0,0 +1,245 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#include <target/sys.h>
+#include <errno.h>
+
+#include "shfs_fill.h"
+#include "shfs_btable.h"
+#include "likely.h"
+
+#ifdef SHFS_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+#define _chk_overlap(s0, l0, s1, l1) \
+	(((s0) < ((s1) + (l1))) && ((s1) < ((s0) + (l0))))
+
+/*
+ * Hash table chunk write-back
+ * A chunk is written to the primary hash table first and to the backup
+ * table only after that completed, so that at least one of the copies is
+ * consistent at any time. Commits to a chunk that is currently written
+ * back are merged into a subsequent write-back of that chunk.
+ */
+struct _shfs_fill_wb {
+	chk_t c;
+	int bak;   /* backup table is being written */
+	int again; /* chunk got modified during write-back */
+	struct _shfs_fill_wb *next;
+};
+static struct _shfs_fill_wb *_wb_list = NULL;
+
+void shfs_fill_init(void)
+{
+	struct htable_el *el;
+	struct shfs_bentry *bentry;
+	struct shfs_hentry *hentry;
+	chk_t fill_end;
+	chk_t end;
+
+	shfs_vol.fill_next = shfs_vol.fill_ref;
+	_wb_list = NULL; /* entries of a forced unmount are dropped */
+	if (!shfs_vol.fill_len)
+		return;
+
+	/* brief configuration check: fill area has to be within the volume
+	 * and must not overlap with the label or the hash tables */
+	fill_end = shfs_vol.fill_ref + shfs_vol.fill_len;
+	if (fill_end > shfs_vol.volsize || fill_end < shfs_vol.fill_ref ||
+	    _chk_overlap(shfs_vol.fill_ref, shfs_vol.fill_len, 0, 2) ||
+	    _chk_overlap(shfs_vol.fill_ref, shfs_vol.fill_len,
+	                 shfs_vol.htable_ref, shfs_vol.htable_len) ||
+	    (shfs_vol.htable_bak_ref &&
+	     _chk_overlap(shfs_vol.fill_ref, shfs_vol.fill_len,
+	                  shfs_vol.htable_bak_ref, shfs_vol.htable_len))) {
+		printd("Malformed fill area configuration, pull-through fills are disabled\n");
+		shfs_vol.fill_len = 0;
+		return;
+	}
+
+	/* skip containers of previous fills */
+	foreach_htable_el(shfs_vol.bt, el) {
+		bentry = el->private;
+		hentry = bentry->hentry;
+		if (SHFS_HENTRY_ISLINK(hentry) ||
+		    hentry->f_attr.chunk < shfs_vol.fill_ref ||
+		    hentry->f_attr.chunk >= fill_end)
+			continue;
+
+		end = hentry->f_attr.chunk +
+		      DIV_ROUND_UP(hentry->f_attr.offset + hentry->f_attr.len,
+		                   shfs_vol.chunksize);
+		if (end > shfs_vol.fill_next)
+			shfs_vol.fill_next = min(end, fill_end);
+	}
+	printd("Fill area: %"PRIchk" of %"PRIchk" chunks in use\n",
+	       shfs_vol.fill_next - shfs_vol.fill_ref, shfs_vol.fill_len);
+}
+
+int shfs_fill_reserve(uint64_t len, chk_t *start)
+{
+	chk_t nb_chks;
+
+	nb_chks = DIV_ROUND_UP(len, shfs_vol.chunksize);
+	if (unlikely(nb_chks == 0 ||
+	             (shfs_vol.fill_ref + shfs_vol.fill_len - shfs_vol.fill_next) < nb_chks))
+		return -ENOSPC;
+
+	*start = shfs_vol.fill_next;
+	shfs_vol.fill_next += nb_chks;
+	printd("Reserved %"PRIchk" chunks at %"PRIchk" for fill\n", nb_chks, *start);
+	return 0;
+}
+
+void shfs_fill_release(chk_t start, uint64_t len)
+{
+	chk_t nb_chks;
+
+	nb_chks = DIV_ROUND_UP(len, shfs_vol.chunksize);
+	if (shfs_vol.fill_next == start + nb_chks) {
+		shfs_vol.fill_next = start;
+		printd("Released %"PRIchk" chunks at %"PRIchk" from fill area\n", nb_chks, start);
+	}
+}
+
+static void _shfs_fill_wb_cb(SHFS_AIO_TOKEN *t, void *cookie, void *argp);
+
+static inline int _shfs_fill_wb_issue(struct _shfs_fill_wb *wb)
+{
+	chk_t ref = wb->bak ? shfs_vol.htable_bak_ref : shfs_vol.htable_ref;
+
+	if (unlikely(!shfs_awrite_chunk(ref + wb->c, 1, shfs_vol.htable_chunk_cache[wb->c],
+	                                _shfs_fill_wb_cb, NULL, wb)))
+		return -errno;
+	return 0;
+}
+
+static void _shfs_fill_wb_done(struct _shfs_fill_wb *wb)
+{
+	struct _shfs_fill_wb **pp;
+
+	for (pp = &_wb_list; *pp != wb; pp = &(*pp)->next);
+	*pp = wb->next;
+	free(wb);
+}
+
+static void _shfs_fill_wb_cb(SHFS_AIO_TOKEN *t, void *cookie, void *argp)
+{
+	struct _shfs_fill_wb *wb = argp;
+	int ret;
+
+	ret = shfs_aio_finalize(t);
+	if (unlikely(ret < 0))
+		printd("Could not write back %shash table chunk %"PRIchk": %d\n",
+		       wb->bak ? "backup " : "", wb->c, ret);
+
+	if (!wb->bak && ret >= 0 && shfs_vol.htable_bak_ref) {
+		wb->bak = 1; /* primary is on disk, update backup */
+	} else if (wb->again) {
+		wb->bak = 0;
+		wb->again = 0;
+	} else {
+		_shfs_fill_wb_done(wb);
+		return;
+	}
+
+	ret = _shfs_fill_wb_issue(wb);
+	if (unlikely(ret < 0)) {
+		printd("Could not write back %shash table chunk %"PRIchk": %d\n",
+		       wb->bak ? "backup " : "", wb->c, ret);
+		_shfs_fill_wb_done(wb);
+		return;
+	}
+	shfs_aio_submit();
+}
+
+int shfs_fill_commit(SHFS_FD f, chk_t start, uint64_t len, const char *mime)
+{
+	struct shfs_hentry *hentry = f->hentry;
+	struct shfs_hentry prev;
+	chk_t c = f->hentry_htchunk;
+	struct _shfs_fill_wb *wb;
+	int ret;
+
+	if (!SHFS_HENTRY_ISLINK(hentry))
+		return -EEXIST; /* entry got replaced in the meantime */
+
+	/* update entry in the hash table chunk cache */
+	memcpy(&prev, hentry, sizeof(prev));
+	memset(&hentry->f_attr, 0, sizeof(hentry->f_attr));
+	hentry->f_attr.chunk  = start;
+	hentry->f_attr.offset = 0;
+	hentry->f_attr.len    = len;
+	if (mime) {
+		strncpy(hentry->f_attr.mime, mime, sizeof(hentry->f_attr.mime) - 1);
+		hentry->f_attr.mime[sizeof(hentry->f_attr.mime) - 1] = '\0';
+	}
+	hentry->flags &= ~SHFS_EFLAG_LINK;
+
+	/* write back hash table chunk */
+	for (wb = _wb_list; wb; wb = wb->next) {
+		if (wb->c == c) {
+			wb->again = 1; /* written after current write-back */
+			goto out;
+		}
+	}
+	wb = malloc(sizeof(*wb));
+	if (unlikely(!wb)) {
+		ret = -ENOMEM;
+		goto err_restore;
+	}
+	wb->c     = c;
+	wb->bak   = 0;
+	wb->again = 0;
+	wb->next  = _wb_list;
+	_wb_list  = wb;
+	ret = _shfs_fill_wb_issue(wb);
+	if (unlikely(ret < 0))
+		goto err_free_wb;
+	shfs_aio_submit();
+
+ out:
+	printd("Link entry turned into file (chunk %"PRIchk", %"PRIu64" bytes)\n", start, len);
+	return 0;
+
+ err_free_wb:
+	_shfs_fill_wb_done(wb);
+ err_restore:
+	memcpy(hentry, &prev, sizeof(*hentry));
+	return ret;
+}
@@ -0,0 +1,83 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _SHFS_FILL_H_
+#define _SHFS_FILL_H_
+/*
+ * Pull-through fill
+ *
+ * Objects that are fetched from the origin of an AUTO link can be persisted
+ * to the volume: The object is written to the fill area that is reserved
+ * by shfs-mkfs (see shfs_hdr_config). Afterwards, the hash table entry of
+ * the link is turned into a regular file entry that points to the written
+ * container, so that later requests are served from the volume.
+ *
+ * Containers are allocated in ascending order from the fill area. Chunks of
+ * released or overwritten fills are not reclaimed while the volume is
+ * mounted; the area needs to be cleaned up with the SHFS tools.
+ */
+
+#include "shfs.h"
+#include "shfs_fio.h"
+
+#define shfs_fill_enabled() \
+	(shfs_mounted && shfs_vol.fill_len != 0)
+
+/* called on mount: searches for the first free chunk in the fill area */
+void shfs_fill_init(void);
+
+/*
+ * Reserves a container for an object of len bytes in the fill area
+ * Returns 0 on success and sets *start to the first chunk of the container,
+ * -ENOSPC is returned if the fill area is exhausted
+ */
+int shfs_fill_reserve(uint64_t len, chk_t *start);
+
+/*
+ * Returns the container of an aborted fill
+ * Note: Chunks can only be given back if no other container
+ *       was reserved in the meantime
+ */
+void shfs_fill_release(chk_t start, uint64_t len);
+
+/*
+ * Turns the link entry of f into a regular file that is stored at the
+ * reserved container start. Its hash table chunk is written back to the
+ * volume asynchronously (the backup table after the primary one).
+ * Note: The caller has to ensure that all data was written to the container
+ */
+int shfs_fill_commit(SHFS_FD f, chk_t start, uint64_t len, const char *mime);
+
+#endif /* _SHFS_FILL_H_ */
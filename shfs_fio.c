@@ -40,6 +40,7 @@
 #include "shfs.h"
 #include "shfs_btable.h"
 #include "shfs_cache.h"
+#include "tracepoint.h"
 
 #ifdef SHFS_STATS
 #include "shfs_stats.h"
@@ -84,8 +85,10 @@ struct shfs_bentry *_shfs_lookup_bentry_by_hash(hash512_t h)
 #ifdef SHFS_STATS
 	struct shfs_el_stats *estats;
 #endif
+	tp_start(tp_ts);
 
 	bentry = shfs_btable_lookup(shfs_vol.bt, h);
+	tp_end(TP_SHFS_LOOKUP, tp_ts);
 #ifdef SHFS_STATS
 	if (unlikely(!bentry)) {
 		estats = shfs_stats_from_mstats(h);
@@ -0,0 +1,724 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#include <target/sys.h>
+#include <errno.h>
+
+#include "shfs_l2cache.h"
+#include "shfs_cache.h"
+#include "mempool.h"
+#include "dlist.h"
+#include "likely.h"
+
+#ifdef SHFS_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+#define L2_NIL UINT32_MAX
+#define L2_SCAN 16 /* max. number of busy slots that are skipped on write-back */
+
+struct shfs_l2cache_slot {
+	uint32_t next; /* hash table collision list */
+	uint16_t readers; /* reads in flight */
+	uint8_t writing; /* write-back in flight */
+};
+
+struct shfs_l2cache_rdreq {
+	struct mempool_obj *pobj;
+	SHFS_AIO_TOKEN *t;
+	uint32_t slot;
+	chk_t addr;
+	void *buffer;
+};
+
+struct shfs_l2cache_wbreq {
+	struct mempool_obj *pobj;
+	chk_t addr;
+	uint32_t slot;
+	int stale; /* chunk got written to the volume in the meantime */
+
+	dlist_el(wblist);
+};
+
+struct shfs_l2cache {
+	struct blkdev *bd;
+	sector_t sfactor; /* device sectors per chunk */
+	uint32_t nb_slots;
+	uint32_t nb_used;
+	uint32_t wp; /* next slot to write */
+	chk_t idx_len;
+	chk_t data_ref;
+	uint64_t htsum;
+
+	chk_t *idx; /* index as stored on the device */
+	struct shfs_l2cache_slot *slot;
+	uint32_t *htable;
+	uint32_t htmask;
+	struct shfs_l2cache_hdr *hdr; /* chunk buffer */
+
+	struct mempool *rdpool;
+	struct mempool *wbpool; /* staging buffers */
+	struct dlist_head wblist; /* write-backs in flight */
+	uint64_t wb_tokens; /* write-back budget in bytes */
+	uint64_t wb_ts;
+
+	struct {
+		uint64_t hit;
+		uint64_t miss;
+		uint64_t rderr;
+		uint64_t admit;
+		uint64_t reject;
+		uint64_t present;
+		uint64_t throttle;
+		uint64_t busy;
+		uint64_t written;
+		uint64_t wrerr;
+		uint64_t inval;
+	} stats;
+};
+
+static int l2c_configured = 0;
+static blkdev_id_t l2c_bd_id;
+static struct shfs_l2cache *l2c = NULL;
+
+#define l2c_htindex(addr) \
+	(((uint32_t) (addr)) & l2c->htmask)
+#define l2c_slot_sector(s) \
+	((sector_t) (l2c->data_ref + (chk_t) (s)) * l2c->sfactor)
+#define l2c_stat_inc(name) \
+	do { ++l2c->stats.name; } while (0)
+
+void shfs_l2cache_set_dev(blkdev_id_t bd_id)
+{
+	blkdev_id_cpy(l2c_bd_id, bd_id);
+	l2c_configured = 1;
+}
+
+/* checksum of the volume hash table: detects offline modifications */
+static uint64_t shfs_l2cache_htsum(void)
+{
+	uint64_t sum = 0xcbf29ce484222325ULL;
+	uint64_t *w;
+	size_t i;
+	chk_t c;
+
+	for (c = 0; c < shfs_vol.htable_len; ++c) {
+		w = shfs_vol.htable_chunk_cache[c];
+		if (!w)
+			continue;
+		for (i = 0; i < shfs_vol.chunksize / sizeof(*w); ++i)
+			sum = (sum ^ w[i]) * 0x100000001b3ULL;
+	}
+	return sum;
+}
+
+static inline uint32_t l2c_lookup(chk_t addr)
+{
+	uint32_t s;
+
+	s = l2c->htable[l2c_htindex(addr)];
+	while (s != L2_NIL && l2c->idx[s] != addr)
+		s = l2c->slot[s].next;
+	return s;
+}
+
+static inline void l2c_link(uint32_t s, chk_t addr)
+{
+	register uint32_t i = l2c_htindex(addr);
+
+	l2c->idx[s] = addr;
+	l2c->slot[s].next = l2c->htable[i];
+	l2c->htable[i] = s;
+	++l2c->nb_used;
+}
+
+static inline void l2c_unlink(uint32_t s)
+{
+	uint32_t *p;
+
+	p = &l2c->htable[l2c_htindex(l2c->idx[s])];
+	while (*p != s)
+		p = &l2c->slot[*p].next;
+	*p = l2c->slot[s].next;
+	l2c->idx[s] = 0;
+	--l2c->nb_used;
+}
+
+static void l2c_clear(void)
+{
+	struct shfs_l2cache_wbreq *wb;
+	uint32_t s;
+
+	for (s = 0; s <= l2c->htmask; ++s)
+		l2c->htable[s] = L2_NIL;
+	memset(l2c->idx, 0, l2c->idx_len * shfs_vol.chunksize);
+	l2c->nb_used = 0;
+	dlist_foreach(wb, l2c->wblist, wblist)
+		wb->stale = 1;
+}
+
+/* loads the index from the device, returns 0 if it is unusable */
+static int l2c_load(void)
+{
+	struct shfs_l2cache_hdr *hdr = l2c->hdr;
+	chk_t c;
+	uint32_t s;
+	int ret;
+
+	ret = blkdev_sync_read(l2c->bd, 0, l2c->sfactor, hdr);
+	if (ret < 0)
+		return ret;
+	if (memcmp(hdr->magic, SHFS_L2CACHE_MAGIC, sizeof(SHFS_L2CACHE_MAGIC)) != 0 ||
+	    hdr->version != SHFS_L2CACHE_VERSION ||
+	    hdr->chunksize != shfs_vol.chunksize ||
+	    hdr->nb_slots != l2c->nb_slots) {
+		printd("Second-level cache: device is not formatted for this volume\n");
+		return 0;
+	}
+	if (uuid_compare(hdr->vol_uuid, shfs_vol.uuid) != 0 ||
+	    hdr->vol_htsum != l2c->htsum) {
+		printd("Second-level cache: index belongs to another volume or the volume was modified\n");
+		return 0;
+	}
+	if (!hdr->clean) {
+		printd("Second-level cache: index was not written back (crash?)\n");
+		return 0;
+	}
+
+	for (c = 0; c < l2c->idx_len; ++c) {
+		ret = blkdev_sync_read(l2c->bd, (1 + c) * l2c->sfactor, l2c->sfactor,
+		                       (uint8_t *) l2c->idx + c * shfs_vol.chunksize);
+		if (ret < 0)
+			return ret;
+	}
+	for (s = 0; s < l2c->nb_slots; ++s) {
+		if (l2c->idx[s] == 0)
+			continue;
+		if (l2c->idx[s] >= shfs_vol.volsize ||
+		    l2c_lookup(l2c->idx[s]) != L2_NIL) {
+			l2c->idx[s] = 0; /* invalid or duplicate entry */
+			continue;
+		}
+		l2c_link(s, l2c->idx[s]);
+	}
+	l2c->wp = (uint32_t) (hdr->wp % l2c->nb_slots);
+	return 1;
+}
+
+static int l2c_write_hdr(int clean)
+{
+	struct shfs_l2cache_hdr *hdr = l2c->hdr;
+
+	memset(hdr, 0, shfs_vol.chunksize);
+	memcpy(hdr->magic, SHFS_L2CACHE_MAGIC, sizeof(SHFS_L2CACHE_MAGIC));
+	hdr->version = SHFS_L2CACHE_VERSION;
+	hdr->chunksize = shfs_vol.chunksize;
+	uuid_copy(hdr->vol_uuid, shfs_vol.uuid);
+	hdr->vol_htsum = l2c->htsum;
+	hdr->nb_slots = l2c->nb_slots;
+	hdr->wp = l2c->wp;
+	hdr->clean = (uint8_t) clean;
+	return blkdev_sync_write(l2c->bd, 0, l2c->sfactor, hdr);
+}
+
+static void _l2c_wbreq_init(struct mempool_obj *pobj, void *unused)
+{
+	struct shfs_l2cache_wbreq *wb = pobj->private;
+
+	wb->pobj = pobj;
+}
+
+int shfs_l2cache_attach(void)
+{
+	struct shfs_l2cache *c;
+	uint64_t dev_chks, nb_slots;
+	uint32_t htlen;
+	int ret;
+
+	shfs_vol.l2cache_bd = NULL;
+	if (!l2c_configured)
+		return 0;
+#ifdef SHFS_CACHE_ALIAS
+	if (shfs_vol.chunkcache->alias) {
+		printd("Second-level cache: volume is memory-mapped, cache is not required\n");
+		return 0;
+	}
+#endif
+
+	c = target_malloc(8, sizeof(*c));
+	if (!c) {
+		ret = -ENOMEM;
+		goto err_out;
+	}
+	memset(c, 0, sizeof(*c));
+	c->bd = open_blkdev(l2c_bd_id, O_RDWR | O_EXCL);
+	if (!c->bd) {
+		ret = -errno;
+		goto err_free_c;
+	}
+	if (shfs_vol.chunksize % blkdev_ssize(c->bd)) {
+		printd("Second-level cache: chunk size is not a multiple of device sector size\n");
+		ret = -EINVAL;
+		goto err_close_bd;
+	}
+	c->sfactor = shfs_vol.chunksize / blkdev_ssize(c->bd);
+
+	/* header chunk + 8 bytes of index per slot */
+	dev_chks = blkdev_size(c->bd) / shfs_vol.chunksize;
+	if (dev_chks < 2) {
+		ret = -ENOSPC;
+		goto err_close_bd;
+	}
+	nb_slots = ((dev_chks - 1) * shfs_vol.chunksize) / (shfs_vol.chunksize + sizeof(chk_t));
+	if (nb_slots >= L2_NIL)
+		nb_slots = L2_NIL - 1;
+	c->idx_len = DIV_ROUND_UP(nb_slots * sizeof(chk_t), shfs_vol.chunksize);
+	c->data_ref = 1 + c->idx_len;
+	nb_slots = min(nb_slots, dev_chks - c->data_ref);
+	if (nb_slots < 2 * SHFS_L2CACHE_WB_QUEUE) {
+		printd("Second-level cache: device is too small\n");
+		ret = -ENOSPC;
+		goto err_close_bd;
+	}
+	c->nb_slots = (uint32_t) nb_slots;
+
+	htlen = 1;
+	while (htlen < c->nb_slots && htlen < (1U << 31))
+		htlen <<= 1;
+	c->htmask = htlen - 1;
+
+	c->hdr = target_malloc(blkdev_ioalign(c->bd), shfs_vol.chunksize);
+	c->idx = target_malloc(blkdev_ioalign(c->bd), c->idx_len * shfs_vol.chunksize);
+	c->slot = target_malloc(8, c->nb_slots * sizeof(*c->slot));
+	c->htable = target_malloc(8, htlen * sizeof(*c->htable));
+	if (!c->hdr || !c->idx || !c->slot || !c->htable) {
+		ret = -ENOMEM;
+		goto err_free_mem;
+	}
+	memset(c->slot, 0, c->nb_slots * sizeof(*c->slot));
+
+	c->rdpool = alloc_simple_mempool(MAX_REQUESTS, sizeof(struct shfs_l2cache_rdreq));
+	if (!c->rdpool) {
+		ret = -ENOMEM;
+		goto err_free_mem;
+	}
+	c->wbpool = alloc_enhanced_mempool(SHFS_L2CACHE_WB_QUEUE,
+	                                   shfs_vol.chunksize,
+	                                   blkdev_ioalign(c->bd),
+	                                   0,
+	                                   0,
+	                                   sizeof(struct shfs_l2cache_wbreq),
+	                                   1,
+	                                   _l2c_wbreq_init, NULL,
+	                                   NULL, NULL,
+	                                   NULL, NULL);
+	if (!c->wbpool) {
+		ret = -ENOMEM;
+		goto err_free_rdpool;
+	}
+	dlist_init_head(c->wblist);
+	c->wb_tokens = (uint64_t) SHFS_L2CACHE_WB_QUEUE * shfs_vol.chunksize;
+	c->wb_ts = target_now_ns();
+
+	l2c = c;
+	l2c->htsum = shfs_l2cache_htsum();
+	l2c_clear();
+	ret = l2c_load();
+	if (ret <= 0) {
+		if (ret < 0)
+			printd("Second-level cache: could not read index: %d\n", ret);
+		l2c_clear();
+		l2c->wp = 0;
+	}
+	printd("Second-level cache: %"PRIu32" of %"PRIu32" slots in use\n",
+	       l2c->nb_used, l2c->nb_slots);
+
+	/* the index on the device is outdated as soon as slots get written */
+	ret = l2c_write_hdr(0);
+	if (ret < 0) {
+		printd("Second-level cache: could not write header: %d\n", ret);
+		l2c = NULL;
+		goto err_free_wbpool;
+	}
+
+	shfs_vol.l2cache_bd = c->bd;
+	return 0;
+
+ err_free_wbpool:
+	free_mempool(c->wbpool);
+ err_free_rdpool:
+	free_mempool(c->rdpool);
+ err_free_mem:
+	if (c->htable)
+		target_free(c->htable);
+	if (c->slot)
+		target_free(c->slot);
+	if (c->idx)
+		target_free(c->idx);
+	if (c->hdr)
+		target_free(c->hdr);
+ err_close_bd:
+	close_blkdev(c->bd);
+ err_free_c:
+	target_free(c);
+ err_out:
+	return ret;
+}
+
+void shfs_l2cache_detach(void)
+{
+	chk_t c;
+	int ret = 0;
+
+	if (!l2c)
+		return;
+
+	/* wait for write-backs (reads were completed by the chunk cache) */
+	while (mempool_free_count(l2c->wbpool) < SHFS_L2CACHE_WB_QUEUE ||
+	       mempool_free_count(l2c->rdpool) < MAX_REQUESTS)
+		blkdev_poll_req(l2c->bd);
+
+	/* write back index, the volume hash table might have changed by fills */
+	l2c->htsum = shfs_l2cache_htsum();
+	for (c = 0; c < l2c->idx_len && ret >= 0; ++c)
+		ret = blkdev_sync_write(l2c->bd, (1 + c) * l2c->sfactor, l2c->sfactor,
+		                        (uint8_t *) l2c->idx + c * shfs_vol.chunksize);
+	if (ret >= 0)
+		ret = l2c_write_hdr(1);
+	if (ret < 0)
+		printd("Second-level cache: could not write back index: %d\n", ret);
+
+	shfs_vol.l2cache_bd = NULL;
+	free_mempool(l2c->wbpool);
+	free_mempool(l2c->rdpool);
+	target_free(l2c->htable);
+	target_free(l2c->slot);
+	target_free(l2c->idx);
+	target_free(l2c->hdr);
+	close_blkdev(l2c->bd);
+	target_free(l2c);
+	l2c = NULL;
+}
+
+void shfs_l2cache_revalidate(void)
+{
+	uint64_t htsum;
+
+	if (!l2c)
+		return;
+
+	htsum = shfs_l2cache_htsum();
+	if (htsum != l2c->htsum) {
+		printd("Second-level cache: volume hash table changed, dropping index\n");
+		l2c->stats.inval += l2c->nb_used;
+		l2c_clear();
+		l2c->htsum = htsum;
+	}
+}
+
+/* completes the token of a read that fell back to the volume */
+static void _l2c_fb_cb(SHFS_AIO_TOKEN *vt, void *cookie, void *argp)
+{
+	SHFS_AIO_TOKEN *t = argp;
+
+	t->ret = shfs_aio_finalize(vt);
+	t->infly = 0;
+	if (t->cb)
+		t->cb(t, t->cb_cookie, t->cb_argp);
+}
+
+static void _l2c_rd_cb(int ret, void *argp)
+{
+	struct shfs_l2cache_rdreq *rd = argp;
+	SHFS_AIO_TOKEN *t = rd->t;
+	uint32_t s = rd->slot;
+
+	--l2c->slot[s].readers;
+	if (unlikely(ret < 0)) {
+		printd("Second-level cache: reading slot %"PRIu32" failed: %d\n", s, ret);
+		l2c_stat_inc(rderr);
+		if (l2c->idx[s])
+			l2c_unlink(s);
+
+		/* the cache is just a copy: read the chunk from the
+		 * volume into the same buffer, the token stays pending */
+		if (likely(shfs_aread_chunk(rd->addr, 1, rd->buffer,
+		                            _l2c_fb_cb, NULL, t) != NULL)) {
+			mempool_put(rd->pobj);
+			shfs_aio_submit();
+			return;
+		}
+		printd("Second-level cache: reading chunk %"PRIchk" from volume failed: %d\n",
+		       rd->addr, -errno);
+		t->ret = -errno;
+	}
+	mempool_put(rd->pobj);
+
+	t->infly = 0;
+	if (t->cb)
+		t->cb(t, t->cb_cookie, t->cb_argp);
+}
+
+SHFS_AIO_TOKEN *shfs_l2cache_aread(chk_t addr, void *buffer,
+                                   shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp)
+{
+	struct mempool_obj *robj;
+	struct shfs_l2cache_rdreq *rd;
+	SHFS_AIO_TOKEN *t;
+	uint32_t s;
+	int ret;
+
+	if (!l2c) {
+		errno = ENOENT;
+		return NULL;
+	}
+	s = l2c_lookup(addr);
+	if (s == L2_NIL) {
+		l2c_stat_inc(miss);
+		errno = ENOENT;
+		return NULL;
+	}
+
+	robj = mempool_pick(l2c->rdpool);
+	if (unlikely(!robj)) {
+		errno = EAGAIN;
+		return NULL;
+	}
+	t = shfs_aio_pick_token();
+	if (unlikely(!t)) {
+		mempool_put(robj);
+		errno = EAGAIN;
+		return NULL;
+	}
+	t->cb = cb;
+	t->cb_cookie = cb_cookie;
+	t->cb_argp = cb_argp;
+	t->infly = 1;
+
+	rd = robj->data;
+	rd->pobj = robj;
+	rd->t = t;
+	rd->slot = s;
+	rd->addr = addr;
+	rd->buffer = buffer;
+	ret = blkdev_async_read(l2c->bd, l2c_slot_sector(s), l2c->sfactor,
+	                        buffer, _l2c_rd_cb, rd);
+	if (unlikely(ret < 0)) {
+		t->infly = 0;
+		shfs_aio_put_token(t);
+		mempool_put(robj);
+		errno = -ret;
+		return NULL;
+	}
+	++l2c->slot[s].readers;
+	l2c_stat_inc(hit);
+	return t;
+}
+
+static void _l2c_wb_cb(int ret, void *argp)
+{
+	struct mempool_obj *pobj = argp;
+	struct shfs_l2cache_wbreq *wb = pobj->private;
+	uint32_t s;
+
+	dlist_unlink(wb, l2c->wblist, wblist);
+	l2c->slot[wb->slot].writing = 0;
+	if (unlikely(ret < 0)) {
+		printd("Second-level cache: writing slot %"PRIu32" failed: %d\n", wb->slot, ret);
+		l2c_stat_inc(wrerr);
+	} else if (!wb->stale) {
+		/* replace a copy that was written in the meantime */
+		s = l2c_lookup(wb->addr);
+		if (s != L2_NIL)
+			l2c_unlink(s);
+		l2c_link(wb->slot, wb->addr);
+		l2c_stat_inc(written);
+	}
+	mempool_put(pobj);
+}
+
+/* token bucket: returns 1 if a chunk can be written back now */
+static inline int l2c_wb_budget(void)
+{
+#if SHFS_L2CACHE_WB_MBPS
+	uint64_t now = target_now_ns();
+	uint64_t dt = now - l2c->wb_ts;
+	uint64_t add;
+
+	if (dt > 1000000000ULL)
+		dt = 1000000000ULL; /* bucket is full anyways, avoids overflow */
+	add = (dt * ((uint64_t) SHFS_L2CACHE_WB_MBPS << 20)) / 1000000000ULL;
+	if (add) {
+		l2c->wb_tokens = min(l2c->wb_tokens + add,
+		                     (uint64_t) SHFS_L2CACHE_WB_QUEUE * shfs_vol.chunksize);
+		l2c->wb_ts = now;
+	}
+	return l2c->wb_tokens >= shfs_vol.chunksize;
+#else
+	return 1;
+#endif
+}
+
+void shfs_l2cache_admit(chk_t addr, const void *buffer, uint32_t hits)
+{
+	struct mempool_obj *pobj;
+	struct shfs_l2cache_wbreq *wb;
+	uint32_t s, n;
+	int ret;
+
+	if (!l2c)
+		return;
+	if (hits < SHFS_L2CACHE_ADMIT_HITS) {
+		l2c_stat_inc(reject);
+		return;
+	}
+	if (l2c_lookup(addr) != L2_NIL) {
+		l2c_stat_inc(present);
+		return;
+	}
+	if (!l2c_wb_budget()) {
+		l2c_stat_inc(throttle);
+		return;
+	}
+	pobj = mempool_pick(l2c->wbpool);
+	if (!pobj) {
+		l2c_stat_inc(busy);
+		return;
+	}
+
+	/* next slot in circular order that is not being read or written */
+	for (n = 0; n < L2_SCAN; ++n) {
+		s = l2c->wp;
+		l2c->wp = (s + 1 == l2c->nb_slots) ? 0 : s + 1;
+		if (!l2c->slot[s].readers && !l2c->slot[s].writing)
+			goto found;
+	}
+	mempool_put(pobj);
+	l2c_stat_inc(busy);
+	return;
+
+ found:
+	if (l2c->idx[s])
+		l2c_unlink(s); /* evict previous chunk */
+	wb = pobj->private;
+	wb->addr = addr;
+	wb->slot = s;
+	wb->stale = 0;
+	memcpy(pobj->data, buffer, shfs_vol.chunksize);
+
+	ret = blkdev_async_write(l2c->bd, l2c_slot_sector(s), l2c->sfactor,
+	                         pobj->data, _l2c_wb_cb, pobj);
+	if (unlikely(ret < 0)) {
+		mempool_put(pobj);
+		l2c_stat_inc(busy);
+		return;
+	}
+	l2c->slot[s].writing = 1;
+	dlist_append(wb, l2c->wblist, wblist);
+	blkdev_async_io_submit(l2c->bd);
+#if SHFS_L2CACHE_WB_MBPS
+	l2c->wb_tokens -= shfs_vol.chunksize;
+#endif
+	l2c_stat_inc(admit);
+}
+
+void shfs_l2cache_invalidate(chk_t start, chk_t len)
+{
+	struct shfs_l2cache_wbreq *wb;
+	uint32_t s;
+	chk_t addr;
+
+	if (!l2c)
+		return;
+
+	for (addr = start; addr < start + len; ++addr) {
+		s = l2c_lookup(addr);
+		if (s != L2_NIL) {
+			l2c_unlink(s);
+			l2c_stat_inc(inval);
+		}
+	}
+	dlist_foreach(wb, l2c->wblist, wblist) {
+		if (wb->addr >= start && wb->addr < start + len)
+			wb->stale = 1;
+	}
+}
+
+#ifdef SHFS_CACHE_INFO
+void shfs_l2cache_print_info(FILE *cio)
+{
+	char str[128];
+
+	if (!l2c_configured) {
+		fprintf(cio, " Second-level cache:                     disabled\n");
+		return;
+	}
+	blkdev_id_unparse(l2c_bd_id, str, sizeof(str));
+	fprintf(cio, " Second-level cache device:          %12s (%s)\n",
+	        str, l2c ? "attached" : "not attached");
+	if (!l2c)
+		return;
+
+	fprintf(cio, " Second-level cache slots:           %12"PRIu32" (total: %"PRIu64" KiB)\n",
+	        l2c->nb_slots, ((uint64_t) l2c->nb_slots * shfs_vol.chunksize) / 1024);
+	fprintf(cio, " Second-level cache used slots:      %12"PRIu32"\n",
+	        l2c->nb_used);
+	fprintf(cio, " Admission (min. references in RAM): %12"PRIu32"\n",
+	        (uint32_t) SHFS_L2CACHE_ADMIT_HITS);
+#if SHFS_L2CACHE_WB_MBPS
+	fprintf(cio, " Write-back bandwidth cap:           %12"PRIu32" MiB/s\n",
+	        (uint32_t) SHFS_L2CACHE_WB_MBPS);
+#else
+	fprintf(cio, " Write-back bandwidth cap:              unlimited\n");
+#endif
+	fprintf(cio, " Write-backs in flight:              %12"PRIu32" (max: %"PRIu32")\n",
+	        (uint32_t) (SHFS_L2CACHE_WB_QUEUE - mempool_free_count(l2c->wbpool)),
+	        (uint32_t) SHFS_L2CACHE_WB_QUEUE);
+	fprintf(cio, " Second-level access statistics:\n");
+	fprintf(cio, "  Hits:                              %12"PRIu64"\n", l2c->stats.hit);
+	fprintf(cio, "  Misses (volume reads):             %12"PRIu64"\n", l2c->stats.miss);
+	fprintf(cio, "  Failed reads:                      %12"PRIu64"\n", l2c->stats.rderr);
+	fprintf(cio, "  Admitted:                          %12"PRIu64"\n", l2c->stats.admit);
+	fprintf(cio, "  Rejected (too few references):     %12"PRIu64"\n", l2c->stats.reject);
+	fprintf(cio, "  Rejected (already cached):         %12"PRIu64"\n", l2c->stats.present);
+	fprintf(cio, "  Throttled (bandwidth cap):         %12"PRIu64"\n", l2c->stats.throttle);
+	fprintf(cio, "  Dropped (write-back busy):         %12"PRIu64"\n", l2c->stats.busy);
+	fprintf(cio, "  Written:                           %12"PRIu64"\n", l2c->stats.written);
+	fprintf(cio, "  Failed writes:                     %12"PRIu64"\n", l2c->stats.wrerr);
+	fprintf(cio, "  Invalidated:                       %12"PRIu64"\n", l2c->stats.inval);
+}
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Simple hash filesystem (SHFS)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _SHFS_L2CACHE_H_
+#define _SHFS_L2CACHE_H_
+/*
+ * Second-level chunk cache
+ *
+ * A separate (fast) block device, e.g., an SSD in front of a volume on
+ * spinning disks, holds chunks that were evicted from the RAM chunk cache
+ * (see shfs_cache.h). Evicted chunks are copied to a staging buffer and
+ * written back asynchronously; on a RAM cache miss, the index of the device
+ * is checked before the volume is read.
+ *
+ * Layout of the device (in units of the volume chunk size):
+ *  chunk 0:               header (struct shfs_l2cache_hdr)
+ *  chunk 1..idx_len:      index: volume chunk address per slot (0 = empty)
+ *  chunk idx_len+1..:     slots holding the chunk data
+ * Slots are written in a circular (log-structured) order, so writes to the
+ * device are mostly sequential. Chunks are admitted only when they were
+ * referenced at least SHFS_L2CACHE_ADMIT_HITS times while they were in RAM,
+ * write-backs are limited by SHFS_L2CACHE_WB_MBPS.
+ *
+ * The index is kept in memory while the device is attached and written back
+ * on detach (umount). The header records whether this happened: after a
+ * crash, the index is discarded. The index is bound to the volume UUID and a
+ * checksum of its hash table, so it is discarded as well when the volume was
+ * modified offline. Chunks that are written to the volume while it is
+ * mounted (e.g., pull-through fills) are invalidated.
+ */
+
+#include "shfs.h"
+
+#ifndef SHFS_L2CACHE_ADMIT_HITS
+#define SHFS_L2CACHE_ADMIT_HITS 2 /* minimum number of references in RAM for admission */
+#endif
+
+#ifndef SHFS_L2CACHE_WB_MBPS
+#define SHFS_L2CACHE_WB_MBPS 0 /* write-back bandwidth cap in MiB/s (0 = unlimited) */
+#endif
+
+#ifndef SHFS_L2CACHE_WB_QUEUE
+#define SHFS_L2CACHE_WB_QUEUE 32 /* max. number of write-backs in flight (staging buffers) */
+#endif
+
+#define SHFS_L2CACHE_MAGIC "SHFSL2C"
+#define SHFS_L2CACHE_VERSION 1
+
+struct shfs_l2cache_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t chunksize;
+	uuid_t vol_uuid;
+	uint64_t vol_htsum; /* checksum of volume hash table */
+	uint64_t nb_slots;
+	uint64_t wp; /* next slot to write */
+	uint8_t clean; /* index was written back on detach */
+} __attribute__((packed));
+
+/* sets the device that is attached on (re-)mount */
+void shfs_l2cache_set_dev(blkdev_id_t bd_id);
+
+/*
+ * Called on mount/umount: opens the device and loads (or initializes) the
+ * index, respectively writes back the index and closes the device
+ * Note: Attaching is done after the chunk cache was allocated
+ */
+int shfs_l2cache_attach(void);
+void shfs_l2cache_detach(void);
+
+/* called on remount: drops all entries if the volume hash table changed */
+void shfs_l2cache_revalidate(void);
+
+#define shfs_l2cache_attached() \
+	(shfs_mounted && shfs_vol.l2cache_bd != NULL)
+
+/*
+ * Reads a chunk from the second-level cache
+ * Like shfs_aread_chunk(), a token is returned that completes with the
+ * callback. NULL is returned if the chunk is not cached (errno = ENOENT)
+ * or the request could not be set up (errno = EAGAIN): the volume has to
+ * be read instead. A read that fails on the cache device is re-issued to
+ * the volume, the token completes when that read is done.
+ */
+SHFS_AIO_TOKEN *shfs_l2cache_aread(chk_t addr, void *buffer,
+                                   shfs_aiocb_t *cb, void *cb_cookie, void *cb_argp);
+
+/*
+ * Offers a chunk that is evicted from RAM (referenced hits times) for
+ * admission. The data is copied, buffer can be reused after the call.
+ */
+void shfs_l2cache_admit(chk_t addr, const void *buffer, uint32_t hits);
+
+/* drops cached copies of chunks that are written to the volume */
+void shfs_l2cache_invalidate(chk_t start, chk_t len);
+
+#ifdef SHFS_CACHE_INFO
+/* prints configuration and statistics (part of shfs-cache-info) */
+void shfs_l2cache_print_info(FILE *cio);
+#endif
+
+#endif /* _SHFS_L2CACHE_H_ */
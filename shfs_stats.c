@@ -103,7 +103,7 @@ struct _stats_dev {
 	size_t seek;
 	size_t flushed;
 
-	struct semaphore lock;
+	sem_t lock;
 };
 
 static struct _stats_dev *_stats_dev = NULL;
@@ -381,7 +381,7 @@ int init_shfs_stats_export(blkdev_id_t bd_id)
 {
 	int ret;
 
-	_stats_dev = _xmalloc(sizeof(*_stats_dev), 0);
+	_stats_dev = target_malloc(8, sizeof(*_stats_dev));
 	if (!_stats_dev) {
 		ret = -ENOMEM;
 		goto err_out;
@@ -392,7 +392,7 @@ int init_shfs_stats_export(blkdev_id_t bd_id)
 		ret = -errno;
 		goto err_free_stats_dev;
 	}
-	_stats_dev->buf = _xmalloc(blkdev_ssize(_stats_dev->bd), blkdev_ssize(_stats_dev->bd));
+	_stats_dev->buf = target_malloc(blkdev_ssize(_stats_dev->bd), blkdev_ssize(_stats_dev->bd));
 	if (!_stats_dev->buf) {
 		ret = -ENOMEM;
 		goto err_close_bd;
@@ -405,7 +405,8 @@ int init_shfs_stats_export(blkdev_id_t bd_id)
  err_close_bd:
 	close_blkdev(_stats_dev->bd);
  err_free_stats_dev:
-	xfree(_stats_dev);
+	target_free(_stats_dev);
+	_stats_dev = NULL;
  err_out:
 	return ret;
 }
@@ -415,8 +416,8 @@ void exit_shfs_stats_export(void)
 	if (_stats_dev) {
 		down(&_stats_dev->lock);
 
-		xfree(_stats_dev->buf);
+		target_free(_stats_dev->buf);
 		close_blkdev(_stats_dev->bd);
-		xfree(_stats_dev);
+		target_free(_stats_dev);
 	}
 }
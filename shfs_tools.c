@@ -531,6 +531,20 @@ static int shcmd_shfs_info(FILE *cio, int argc, char *argv[])
 	        shfs_vol.htable_bak_ref ? "2nd copy enabled" : "No copy");
 	fprintf(cio, "Entry size:         %u Bytes (raw: %zu Bytes)\n",
 	        SHFS_HENTRY_SIZE, sizeof(struct shfs_hentry));
+#ifdef SHFS_BTABLE_INDEX
+	if (shfs_vol.bt->idx)
+		fprintf(cio, "Lookup index:       %"PRIu64" entries in %"PRIu32" buckets (%"PRIu32" slots each)\n",
+		        shfs_vol.bt->idx->nb_els, shfs_vol.bt->idx->nb_bkts,
+		        (uint32_t) HTABLE_IDX_BKT_SLOTS);
+	else
+		fprintf(cio, "Lookup index:       disabled\n");
+#endif
+#ifdef SHFS_FILL
+	if (shfs_vol.fill_len)
+		fprintf(cio, "Fill area:          %"PRIchk" chunks at chunk %"PRIchk" (%"PRIchk" in use)\n",
+		        shfs_vol.fill_len, shfs_vol.fill_ref,
+		        shfs_vol.fill_next - shfs_vol.fill_ref);
+#endif
 
 	fprintf(cio, "\n");
 	fprintf(cio, "Member stripe size: %"PRIu32" KiB\n", shfs_vol.stripesize / 1024);
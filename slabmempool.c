@@ -0,0 +1,219 @@
+/*
+ * Elastic memory pool that grows and shrinks in slabs
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include <errno.h>
+
+#include "slabmempool.h"
+
+#ifdef MEMPOOL_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include "debug.h"
+
+#define MIN_ALIGN 8
+
+#ifndef min
+#define min(a, b) \
+    ({ __typeof__ (a) __a = (a); \
+       __typeof__ (b) __b = (b); \
+       __a < __b ? __a : __b; })
+#endif
+
+static void _slabmempool_release(struct slabmempool *sp, struct slabmempool_slab *s)
+{
+  printd("Release slab %"PRIu32" of pool %p (%"PRIu32" objects)\n",
+         s->idx, sp, mempool_nb_objs(s->p));
+  sp->nb_objs      -= mempool_nb_objs(s->p);
+  sp->nb_free_objs -= mempool_nb_objs(s->p);
+  sp->pool_size    -= mempool_size(s->p);
+  --sp->nb_slabs;
+  ++sp->nb_shrinks;
+  free_mempool(s->p);
+  s->p = NULL;
+}
+
+/* called by mempool_put() after the object was put back to its slab */
+static void _slabmempool_put_cb(struct mempool_obj *obj, void *argp)
+{
+  struct slabmempool_slab *s = argp;
+  struct slabmempool *sp = s->sp;
+
+  ++sp->nb_free_objs;
+  if (s->idx < sp->first_free)
+	sp->first_free = s->idx;
+
+  /* release a drained slab while the others still have free objects */
+  if (unlikely(mempool_free_count(s->p) == mempool_nb_objs(s->p)) &&
+      s->idx >= sp->min_nb_slabs &&
+      sp->nb_free_objs - mempool_nb_objs(s->p) >= (sp->slab_len >> 1))
+	_slabmempool_release(sp, s);
+}
+
+static int _slabmempool_alloc_slab(struct slabmempool *sp, uint32_t idx)
+{
+  struct slabmempool_slab *s = &sp->slab[idx];
+  uint32_t nb_objs;
+
+  nb_objs = min(sp->slab_len, sp->max_nb_objs - idx * sp->slab_len);
+  s->p = alloc_enhanced_mempool(nb_objs, sp->obj_size, sp->obj_data_align, 0, 0, 0, 0,
+                                NULL, NULL, NULL, NULL, _slabmempool_put_cb, s);
+  if (!s->p && sp->reclaim_func) {
+	/* ask others to give memory back and retry */
+	sp->reclaim_func(sizeof(struct mempool) +
+	                 nb_objs * (sizeof(struct mempool_obj) + sp->obj_size),
+	                 sp->reclaim_func_argp);
+	s->p = alloc_enhanced_mempool(nb_objs, sp->obj_size, sp->obj_data_align, 0, 0, 0, 0,
+	                              NULL, NULL, NULL, NULL, _slabmempool_put_cb, s);
+  }
+  if (!s->p) {
+	errno = ENOMEM;
+	return -1;
+  }
+
+  printd("Allocated slab %"PRIu32" of pool %p (%"PRIu32" objects)\n",
+         idx, sp, nb_objs);
+  sp->nb_objs      += nb_objs;
+  sp->nb_free_objs += nb_objs;
+  sp->pool_size    += mempool_size(s->p);
+  ++sp->nb_slabs;
+  return 0;
+}
+
+struct slabmempool *alloc_slabmempool(uint32_t min_nb_objs, uint32_t max_nb_objs, uint32_t slab_len,
+				      size_t obj_size, size_t obj_data_align,
+				      void (*reclaim_func)(size_t, void *), void *reclaim_func_argp)
+{
+  struct slabmempool *sp;
+  uint32_t i;
+
+  if (!max_nb_objs || min_nb_objs > max_nb_objs) {
+	errno = EINVAL;
+	goto err_out;
+  }
+  if (!slab_len)
+	slab_len = SLABMEMPOOL_DEFAULT_SLAB_LEN;
+  if ((max_nb_objs + slab_len - 1) / slab_len > SLABMEMPOOL_MAXNB_SLABS)
+	slab_len = (max_nb_objs + SLABMEMPOOL_MAXNB_SLABS - 1) / SLABMEMPOOL_MAXNB_SLABS;
+
+  sp = target_malloc(MIN_ALIGN, sizeof(*sp));
+  if (!sp) {
+	errno = ENOMEM;
+	goto err_out;
+  }
+  sp->slab_len         = slab_len;
+  sp->max_nb_objs      = max_nb_objs;
+  sp->max_nb_slabs     = (max_nb_objs + slab_len - 1) / slab_len;
+  sp->min_nb_slabs     = (min_nb_objs + slab_len - 1) / slab_len;
+  sp->nb_slabs         = 0;
+  sp->first_free       = 0;
+  sp->nb_objs          = 0;
+  sp->nb_free_objs     = 0;
+  sp->obj_size         = obj_size;
+  sp->obj_data_align   = obj_data_align;
+  sp->pool_size        = sizeof(*sp);
+  sp->reclaim_func     = reclaim_func;
+  sp->reclaim_func_argp = reclaim_func_argp;
+  sp->nb_grows         = 0;
+  sp->nb_shrinks       = 0;
+  for (i = 0; i < SLABMEMPOOL_MAXNB_SLABS; ++i) {
+	sp->slab[i].p   = NULL;
+	sp->slab[i].sp  = sp;
+	sp->slab[i].idx = i;
+  }
+
+  /* allocate persistent slabs */
+  for (i = 0; i < sp->min_nb_slabs; ++i) {
+	if (_slabmempool_alloc_slab(sp, i) < 0)
+	  goto err_free_sp;
+  }
+  printd("Elastic pool %p: %"PRIu32"-%"PRIu32" objects, %"PRIu32" objects per slab\n",
+         sp, min_nb_objs, max_nb_objs, slab_len);
+  return sp;
+
+ err_free_sp:
+  free_slabmempool(sp);
+ err_out:
+  return NULL;
+}
+
+void free_slabmempool(struct slabmempool *sp)
+{
+  uint32_t i;
+
+  if (sp) {
+	for (i = 0; i < sp->max_nb_slabs; ++i)
+	  if (sp->slab[i].p)
+		free_mempool(sp->slab[i].p); /* fails with an assertion if objects are still in use */
+	target_free(sp);
+  }
+}
+
+struct mempool_obj *_slabmempool_grow_pick(struct slabmempool *sp)
+{
+  uint32_t i;
+
+  /* find lowest unallocated slab */
+  for (i = 0; i < sp->max_nb_slabs; ++i)
+	if (!sp->slab[i].p)
+	  break;
+  if (i == sp->max_nb_slabs) {
+	errno = ENOMEM; /* pool reached its limit */
+	return NULL;
+  }
+  if (_slabmempool_alloc_slab(sp, i) < 0)
+	return NULL;
+  ++sp->nb_grows;
+
+  sp->first_free = i;
+  --sp->nb_free_objs;
+  return mempool_pick(sp->slab[i].p);
+}
+
+size_t slabmempool_shrink(struct slabmempool *sp)
+{
+  struct mempool *p;
+  size_t released = 0;
+  uint32_t i;
+
+  for (i = sp->min_nb_slabs; i < sp->max_nb_slabs; ++i) {
+	p = sp->slab[i].p;
+	if (p && mempool_free_count(p) == mempool_nb_objs(p)) {
+	  released += mempool_size(p);
+	  _slabmempool_release(sp, &sp->slab[i]);
+	}
+  }
+  return released;
+}
@@ -0,0 +1,159 @@
+/*
+ * Elastic memory pool that grows and shrinks in slabs
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _SLABMEMPOOL_H_
+#define _SLABMEMPOOL_H_
+
+#include <stdint.h>
+#include <errno.h>
+
+#include "mempool.h"
+#include "likely.h"
+
+#ifndef SLABMEMPOOL_DEFAULT_SLAB_LEN
+#define SLABMEMPOOL_DEFAULT_SLAB_LEN 64
+#endif
+#ifndef SLABMEMPOOL_MAXNB_SLABS
+#define SLABMEMPOOL_MAXNB_SLABS 256
+#endif
+
+/*
+ * SLAB MEMPOOL: OVERVIEW
+ *
+ *  +--------+--------+--------+--------+- - - - -+--------+
+ *  | slab 0 | slab 1 |  NULL  | slab 3 |         |  NULL  |  slab table
+ *  +---|----+---|----+--------+---|----+- - - - -+--------+
+ *      v        v                 v
+ *  [mempool] [mempool]        [mempool]     (up to slab_len objects each)
+ *
+ * Slabs are regular memory pools that are allocated on demand when all
+ * allocated slabs are exhausted, up to max_nb_objs objects in total.
+ * Objects are picked from the lowest slab that has free objects so that
+ * higher slabs drain when the load decreases. A slab that becomes
+ * completely free is released again as long as the other slabs still
+ * have some free objects left (hysteresis of half a slab). The first
+ * min_nb_slabs slabs are never released.
+ *
+ * Objects are regular mempool objects: they are put back with
+ * mempool_put(). Only picking has to be done with slabmempool_pick().
+ * mempool_put_multiple() must not be used on them.
+ *
+ * When a slab can not be allocated, the reclaim callback is called
+ * (e.g., to shrink a cache) and the allocation is retried once.
+ */
+struct slabmempool;
+
+struct slabmempool_slab {
+  struct mempool *p;
+  struct slabmempool *sp;
+  uint32_t idx;
+};
+
+struct slabmempool {
+  struct slabmempool_slab slab[SLABMEMPOOL_MAXNB_SLABS];
+  uint32_t max_nb_slabs;
+  uint32_t min_nb_slabs;
+  uint32_t nb_slabs;      /* number of allocated slabs */
+  uint32_t first_free;    /* hint: slabs below this index have no free objects */
+  uint32_t slab_len;      /* objects per slab */
+  uint32_t max_nb_objs;
+  uint32_t nb_objs;       /* objects of allocated slabs */
+  uint32_t nb_free_objs;  /* free objects of allocated slabs */
+  size_t obj_size;
+  size_t obj_data_align;
+  size_t pool_size;       /* memory of allocated slabs */
+  void (*reclaim_func)(size_t, void *);
+  void *reclaim_func_argp;
+
+  uint64_t nb_grows;
+  uint64_t nb_shrinks;
+};
+
+/*
+ * Allocates an elastic memory pool for up to max_nb_objs objects.
+ * slab_len defines the number of objects per slab (0: default); it is
+ * increased automatically when max_nb_objs would need more than
+ * SLABMEMPOOL_MAXNB_SLABS slabs. min_nb_objs objects are allocated
+ * immediately and are kept for the whole pool lifetime.
+ * reclaim_func(len, argp) is called whenever len bytes for a new slab
+ * could not be allocated.
+ * Returns NULL on failure (errno is set)
+ */
+struct slabmempool *alloc_slabmempool(uint32_t min_nb_objs, uint32_t max_nb_objs, uint32_t slab_len,
+  size_t obj_size, size_t obj_data_align,
+  void (*reclaim_func)(size_t, void *), void *reclaim_func_argp);
+#define alloc_simple_slabmempool(min_nb_objs, max_nb_objs, obj_size) \
+  alloc_slabmempool((min_nb_objs), (max_nb_objs), 0, (obj_size), 0, NULL, NULL)
+
+/* Note: all objects have to be put back before */
+void free_slabmempool(struct slabmempool *sp);
+
+/* slow path: allocates a new slab and picks an object from it */
+struct mempool_obj *_slabmempool_grow_pick(struct slabmempool *sp);
+
+/*
+ * Releases all completely free slabs (except the first min_nb_slabs ones)
+ * Returns the number of released bytes
+ */
+size_t slabmempool_shrink(struct slabmempool *sp);
+
+#define slabmempool_nb_objs(sp) ((sp)->nb_objs)
+#define slabmempool_max_nb_objs(sp) ((sp)->max_nb_objs)
+#define slabmempool_free_count(sp) ((sp)->nb_free_objs)
+#define slabmempool_nb_slabs(sp) ((sp)->nb_slabs)
+#define slabmempool_size(sp) ((sp)->pool_size)
+
+/*
+ * Pick an object from an elastic memory pool
+ * Returns NULL on failure
+ */
+static inline struct mempool_obj *slabmempool_pick(struct slabmempool *sp)
+{
+  struct mempool *p;
+  uint32_t i;
+
+  for (i = sp->first_free; i < sp->max_nb_slabs; ++i) {
+	p = sp->slab[i].p;
+	if (p && mempool_free_count(p)) {
+	  sp->first_free = i;
+	  --sp->nb_free_objs;
+	  return mempool_pick(p);
+	}
+  }
+  sp->first_free = sp->max_nb_slabs;
+  return _slabmempool_grow_pick(sp);
+}
+
+#endif /* _SLABMEMPOOL_H_ */
@@ -0,0 +1,332 @@
+/*
+ * Linux in-memory block devices (RAM-disk and mmap-backed)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ */
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <target/blkdev.h>
+
+#ifdef BLKDEV_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <debug.h>
+
+#define MEMBLK_PAGE_SIZE 4096UL
+#define MEMBLK_HUGEPAGE_SIZE (2UL << 20)
+
+#define MEMBLK_ALIGN_UP(v, a) (((v) + ((a) - 1)) & ~((a) - 1))
+
+struct blkdev *_open_bd_list = NULL;
+
+int blkdev_id_parse(const char *id, blkdev_id_t *out)
+{
+  /* get absolute path of file */
+  if (realpath(id, *out) == NULL) {
+    printd("Could not resolve path %s\n", id);
+    return -errno;
+  }
+  return 0;
+}
+
+#ifdef CONFIG_RAMBLK
+/* allocates anonymous memory for the device image: huge pages are
+ * tried first, transparent huge pages are requested as fallback */
+static int _blkdev_alloc_mem(struct blkdev *bd, size_t len)
+{
+  bd->mem_len = MEMBLK_ALIGN_UP(len, MEMBLK_HUGEPAGE_SIZE);
+  bd->mem = mmap(NULL, bd->mem_len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+  if (bd->mem != MAP_FAILED) {
+    bd->mem_huge = 1;
+    return 0;
+  }
+
+  printd("Could not allocate %zu bytes on huge pages: %d. Falling back to regular pages\n",
+         bd->mem_len, errno);
+  bd->mem_huge = 0;
+  bd->mem = mmap(NULL, bd->mem_len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (bd->mem == MAP_FAILED)
+    return -errno;
+#ifdef MADV_HUGEPAGE
+  madvise(bd->mem, bd->mem_len, MADV_HUGEPAGE);
+#endif
+  return 0;
+}
+
+static int _blkdev_load_mem(struct blkdev *bd, size_t len)
+{
+  size_t done = 0;
+  ssize_t rlen;
+
+  while (done < len) {
+    rlen = pread(bd->fd, bd->mem + done, len - done, (off_t) done);
+    if (rlen < 0) {
+      if (errno == EINTR)
+	continue;
+      return -errno;
+    }
+    if (rlen == 0)
+      return -EIO; /* unexpected end of file */
+    done += rlen;
+  }
+  return 0;
+}
+#else /* CONFIG_MMAPBLK */
+static int _blkdev_alloc_mem(struct blkdev *bd, size_t len)
+{
+  int prot = PROT_READ;
+
+  if (bd->mode & (O_WRONLY | O_RDWR))
+    prot |= PROT_WRITE;
+
+  bd->mem_huge = 0;
+  bd->mem_len = MEMBLK_ALIGN_UP(len, MEMBLK_PAGE_SIZE);
+  bd->mem = mmap(NULL, bd->mem_len, prot, MAP_SHARED, bd->fd, 0);
+  if (bd->mem == MAP_FAILED)
+    return -errno;
+  madvise(bd->mem, bd->mem_len, MADV_WILLNEED);
+  return 0;
+}
+#endif /* CONFIG_RAMBLK */
+
+struct blkdev *open_blkdev(blkdev_id_t id, int mode)
+{
+  struct blkdev *bd;
+  size_t len;
+  int err;
+
+  /* search in blkdev list if device is already open */
+  for (bd = _open_bd_list; bd != NULL; bd = bd->_next) {
+    if (blkdev_id_cmp(blkdev_id(bd), id) == 0) {
+      /* found: device is already open,
+       *  now we check if it was/shall be opened
+       *  exclusively and requested permissions
+       *  are available */
+      if (mode & O_EXCL ||
+	  bd->exclusive) {
+	errno = EBUSY;
+	goto err;
+      }
+      if (((mode & O_WRONLY) && !(bd->mode & (O_WRONLY | O_RDWR))) ||
+	  ((mode & O_RDWR) && !(bd->mode & O_RDWR))) {
+	errno = EACCES;
+	goto err;
+      }
+
+      ++bd->refcount;
+      return bd;
+    }
+  }
+
+  /* device is not opened yet */
+  bd = malloc(sizeof(struct blkdev));
+  if (!bd) {
+    errno = ENOMEM;
+    goto err;
+  }
+
+  blkdev_id_cpy(bd->dev, id);
+  bd->mode = mode;
+  /* the device contents have to be readable in any case */
+  bd->fd = open(bd->dev, (mode & (O_RDWR | O_WRONLY)) ? O_RDWR : O_RDONLY);
+  if (bd->fd < 0) {
+    printd("Could not open %s\n", bd->dev);
+    goto err_free_bd;
+  }
+
+  if (fstat(bd->fd, &bd->fd_stat) == -1) {
+    printd("Could not retrieve stats from %s\n", bd->dev);
+    goto err_close_fd;
+  }
+  if (!S_ISBLK(bd->fd_stat.st_mode) && !S_ISREG(bd->fd_stat.st_mode)) {
+    printd("%s is not a block device or a regular file\n", bd->dev);
+    errno = ENOTBLK;
+    goto err_close_fd;
+  }
+
+  /* get device sector size in bytes */
+  bd->ssize = bd->fd_stat.st_blksize;
+  if (bd->ssize < DEFAULT_SSIZE)
+    bd->ssize = DEFAULT_SSIZE;
+  printd("%s has a block size of %"PRIu32" bytes\n", bd->dev, bd->ssize);
+
+  /* get device size in bytes */
+  if (S_ISBLK(bd->fd_stat.st_mode)) {
+    uint64_t size64;
+
+    err = ioctl(bd->fd, BLKGETSIZE64, &size64);
+    if (err) {
+      printd("Could not query device size from %s\n", bd->dev);
+      goto err_close_fd;
+    }
+    bd->size = size64 / bd->ssize;
+  } else {
+    bd->size = ((uint64_t) bd->fd_stat.st_size) / bd->ssize;
+  }
+  len = (size_t) (bd->size * bd->ssize);
+  printd("%s has a size of %"PRIu64" bytes\n", bd->dev, (uint64_t) len);
+  if (len == 0) {
+    errno = EINVAL;
+    goto err_close_fd;
+  }
+
+  err = _blkdev_alloc_mem(bd, len);
+  if (err < 0) {
+    printd("Could not map %s: %d\n", bd->dev, err);
+    errno = -err;
+    goto err_close_fd;
+  }
+#ifdef CONFIG_RAMBLK
+  printd("Loading %s into memory (%s pages)...\n", bd->dev,
+         bd->mem_huge ? "huge" : "regular");
+  err = _blkdev_load_mem(bd, len);
+  if (err < 0) {
+    printd("Could not load %s: %d\n", bd->dev, err);
+    errno = -err;
+    goto err_free_mem;
+  }
+#endif
+
+  bd->reqpool = alloc_simple_mempool(MAX_REQUESTS, sizeof(struct _blkdev_req));
+  if (!bd->reqpool) {
+    errno = ENOMEM;
+    goto err_free_mem;
+  }
+  bd->refcount = 1;
+  bd->exclusive = !!(mode & O_EXCL);
+  bd->reqq_head = NULL;
+  bd->reqq_tail = NULL;
+
+  /* link new element to the head of _open_bd_list */
+  bd->_prev = NULL;
+  bd->_next = _open_bd_list;
+  _open_bd_list = bd;
+  if (bd->_next)
+    bd->_next->_prev = bd;
+  return bd;
+
+ err_free_mem:
+  err = errno;
+  munmap(bd->mem, bd->mem_len);
+  errno = err;
+ err_close_fd:
+  close(bd->fd);
+ err_free_bd:
+  free(bd);
+ err:
+  return NULL;
+}
+
+void close_blkdev(struct blkdev *bd)
+{
+  --bd->refcount;
+  if (bd->refcount == 0) {
+    /* unlink element from _open_bd_list */
+    if (bd->_next)
+      bd->_next->_prev = bd->_prev;
+    if (bd->_prev)
+      bd->_prev->_next = bd->_next;
+    else
+      _open_bd_list = bd->_next;
+
+    /* complete enqueued I/O */
+    while (bd->reqq_head)
+      blkdev_poll_req(bd);
+
+    free_mempool(bd->reqpool);
+    munmap(bd->mem, bd->mem_len);
+    close(bd->fd);
+    free(bd);
+  }
+}
+
+static inline void _blkdev_finalize_req(struct _blkdev_req *req)
+{
+  struct blkdev *bd = req->bd;
+  uint8_t *ptr = blkdev_map(bd, req->sector);
+  size_t len = (size_t) (req->nb_sectors * blkdev_ssize(bd));
+  int ret = 0;
+
+  printd("Finalizing request %p\n", req);
+  if (req->write) {
+    memcpy(ptr, req->buffer, len);
+#ifdef CONFIG_RAMBLK
+    /* write through to the image */
+    if (pwrite(bd->fd, req->buffer, len,
+               (off_t) (req->sector * blkdev_ssize(bd))) != (ssize_t) len)
+      ret = -1;
+#endif
+  } else {
+    memcpy(req->buffer, ptr, len);
+  }
+  if (req->cb)
+    req->cb(ret, req->cb_argp); /* user callback */
+
+  mempool_put(req->p_obj);
+}
+
+void blkdev_poll_req(struct blkdev *bd)
+{
+  struct _blkdev_req *req;
+  struct _blkdev_req *last;
+  int done;
+
+  /* complete requests that were enqueued before this call,
+   * requests that are issued by callbacks are left for the next call */
+  last = bd->reqq_tail;
+  while ((req = bd->reqq_head) != NULL) {
+    bd->reqq_head = req->_next;
+    if (!bd->reqq_head)
+      bd->reqq_tail = NULL;
+    done = (req == last);
+
+    _blkdev_finalize_req(req);
+    if (done)
+      break;
+  }
+}
+
+void _blkdev_sync_io_cb(int ret, void *argp)
+{
+	struct _blkdev_sync_io_sync *iosync = argp;
+
+	iosync->ret = ret;
+	iosync->done = 1;
+}
@@ -0,0 +1,262 @@
+/*
+ * Control socket for the Linux target (shell commands via a Unix socket)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#define _GNU_SOURCE /* accept4() */
+#include <target/sys.h>
+#include <target/ctlsock.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "likely.h"
+#include "shell.h"
+
+struct ctlsock_conn {
+	int fd; /* -1: unused */
+	char *obuf; /* output of last command that is not sent yet */
+	size_t olen;
+	size_t opos;
+	char argb[CTLSOCK_ARGB_LEN];
+	size_t argb_p;
+};
+
+static struct {
+	int fd;
+	struct sockaddr_un addr;
+	struct ctlsock_conn conn[CTLSOCK_MAX_CONNS];
+} cs = { .fd = -1 };
+
+int init_ctlsock(const char *path)
+{
+	unsigned int i;
+	int ret;
+
+	if (strlen(path) >= sizeof(cs.addr.sun_path)) {
+		ret = -ENAMETOOLONG;
+		goto err_out;
+	}
+	memset(&cs.addr, 0, sizeof(cs.addr));
+	cs.addr.sun_family = AF_UNIX;
+	strncpy(cs.addr.sun_path, path, sizeof(cs.addr.sun_path) - 1);
+
+	cs.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (cs.fd < 0) {
+		ret = -errno;
+		goto err_out;
+	}
+	unlink(path); /* remove stale socket of a previous run */
+	if (bind(cs.fd, (struct sockaddr *) &cs.addr, sizeof(cs.addr)) < 0) {
+		ret = -errno;
+		goto err_close_fd;
+	}
+	if (listen(cs.fd, CTLSOCK_MAX_CONNS) < 0) {
+		ret = -errno;
+		goto err_unlink;
+	}
+
+	for (i = 0; i < CTLSOCK_MAX_CONNS; ++i)
+		cs.conn[i].fd = -1;
+	return 0;
+
+ err_unlink:
+	unlink(path);
+ err_close_fd:
+	close(cs.fd);
+	cs.fd = -1;
+ err_out:
+	return ret;
+}
+
+static void _ctlsock_close(struct ctlsock_conn *c)
+{
+	free(c->obuf);
+	c->obuf = NULL;
+	close(c->fd);
+	c->fd = -1;
+}
+
+static void _ctlsock_accept(int fd)
+{
+	unsigned int i;
+
+	for (i = 0; i < CTLSOCK_MAX_CONNS; ++i) {
+		if (cs.conn[i].fd < 0)
+			break;
+	}
+	if (i == CTLSOCK_MAX_CONNS) {
+		close(fd); /* no free connection slot */
+		return;
+	}
+
+	cs.conn[i].fd = fd;
+	cs.conn[i].obuf = NULL;
+	cs.conn[i].argb_p = 0;
+}
+
+/* sends pending output without blocking, returns -1 if the connection was closed */
+static int _ctlsock_send(struct ctlsock_conn *c)
+{
+	ssize_t slen;
+
+	while (c->opos < c->olen) {
+		slen = send(c->fd, &c->obuf[c->opos], c->olen - c->opos,
+		            MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (slen < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0; /* retried on next poll */
+			_ctlsock_close(c);
+			return -1;
+		}
+		c->opos += slen;
+	}
+	free(c->obuf);
+	c->obuf = NULL;
+	return 0;
+}
+
+/* executes each completed line of the input buffer; the output of a command
+ * is collected in memory so that a slow reader cannot block the main loop,
+ * further lines are executed only after it was sent completely
+ * returns -1 if the connection was closed */
+static int _ctlsock_exec(struct ctlsock_conn *c)
+{
+	size_t p, llen;
+	FILE *cio;
+	int ret;
+
+	while (!c->obuf) {
+		for (p = 0; p < c->argb_p; ++p) {
+			if (c->argb[p] == '\n' || c->argb[p] == '\r')
+				break;
+		}
+		if (p == c->argb_p) {
+			if (c->argb_p < sizeof(c->argb) - 1)
+				return 0; /* wait for the rest of the line */
+			/* buffer is full: execute what we have */
+		}
+
+		llen = p;
+		c->argb[llen] = '\0';
+		cio = open_memstream(&c->obuf, &c->olen);
+		if (unlikely(!cio)) {
+			_ctlsock_close(c);
+			return -1;
+		}
+		ret = shell_exec(cio, c->argb, llen + 1);
+		fclose(cio);
+		c->opos = 0;
+		if (_ctlsock_send(c) < 0)
+			return -1;
+		if (ret == SH_CLOSE) {
+			_ctlsock_close(c); /* pending output is dropped */
+			return -1;
+		}
+
+		/* move remaining input to the front of the buffer */
+		if (llen < c->argb_p)
+			++llen; /* skip line delimiter */
+		c->argb_p -= llen;
+		memmove(c->argb, &c->argb[llen], c->argb_p);
+	}
+	return 0;
+}
+
+static void _ctlsock_recv(struct ctlsock_conn *c)
+{
+	ssize_t rlen;
+
+	rlen = recv(c->fd, &c->argb[c->argb_p], sizeof(c->argb) - 1 - c->argb_p, MSG_DONTWAIT);
+	if (rlen < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			_ctlsock_close(c);
+		return;
+	}
+	if (rlen == 0) {
+		/* connection closed by peer */
+		_ctlsock_close(c);
+		return;
+	}
+	c->argb_p += rlen;
+	_ctlsock_exec(c);
+}
+
+static void _ctlsock_poll_conn(struct ctlsock_conn *c)
+{
+	if (c->obuf) {
+		/* reader was slow: no new input is accepted before
+		 * the output of the previous command was sent */
+		if (_ctlsock_send(c) < 0 || c->obuf)
+			return;
+		if (_ctlsock_exec(c) < 0 || c->obuf)
+			return; /* lines that were received meanwhile */
+	}
+	_ctlsock_recv(c);
+}
+
+/* polls for new connections and incoming command lines; called periodically
+ * from the main loop (CTLSOCK_POLL_INTERVAL) to keep the syscalls off the
+ * busy-polling path */
+void ctlsock_poll(void)
+{
+	unsigned int i;
+	int fd;
+
+	fd = accept4(cs.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (unlikely(fd >= 0))
+		_ctlsock_accept(fd);
+
+	for (i = 0; i < CTLSOCK_MAX_CONNS; ++i) {
+		if (cs.conn[i].fd >= 0)
+			_ctlsock_poll_conn(&cs.conn[i]);
+	}
+}
+
+void exit_ctlsock(void)
+{
+	unsigned int i;
+
+	if (cs.fd < 0)
+		return; /* not opened */
+	for (i = 0; i < CTLSOCK_MAX_CONNS; ++i) {
+		if (cs.conn[i].fd >= 0)
+			_ctlsock_close(&cs.conn[i]);
+	}
+	close(cs.fd);
+	unlink(cs.addr.sun_path);
+	cs.fd = -1;
+}
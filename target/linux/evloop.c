@@ -0,0 +1,269 @@
+/*
+ * Event loop for the Linux target (epoll, timer wheel, adaptive busy-polling)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#include <target/sys.h>
+#include <target/evloop.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "likely.h"
+#ifdef HAVE_SHELL
+#include "shell.h"
+#endif
+
+#ifndef min
+#define min(a, b) \
+    ({ __typeof__ (a) __a = (a); \
+       __typeof__ (b) __b = (b); \
+       __a < __b ? __a : __b; })
+#endif
+
+static struct {
+	int epfd;
+	unsigned int nb_fds;
+	uint64_t busypoll_ns;
+	uint64_t idle_since;  /* ns, 0: last iteration was busy */
+	uint64_t activity;    /* last seen value of evloop_activity */
+	uint64_t tick;        /* last processed ms of the timer wheel */
+	struct dlist_head wheel[EVLOOP_WHEEL_LEN];
+	struct evloop_stats stats;
+} evl;
+
+uint64_t evloop_activity = 0;
+
+#define _evloop_ms_now()      (NSEC_TO_MSEC(target_now_ns()))
+#define _evloop_head(ms)      (evl.wheel[(ms) % EVLOOP_WHEEL_LEN])
+
+int init_evloop(void)
+{
+	unsigned int i;
+
+	evl.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (evl.epfd < 0)
+		return -errno;
+	evl.nb_fds = 0;
+	evl.busypoll_ns = CONFIG_EVLOOP_BUSYPOLL_US * 1000ULL;
+	evl.idle_since = 0;
+	evl.activity = evloop_activity;
+	for (i = 0; i < EVLOOP_WHEEL_LEN; ++i)
+		dlist_init_head(evl.wheel[i]);
+	evl.tick = _evloop_ms_now();
+	memset(&evl.stats, 0, sizeof(evl.stats));
+	return 0;
+}
+
+void exit_evloop(void)
+{
+	close(evl.epfd);
+}
+
+int evloop_add_fd(int fd)
+{
+	struct epoll_event ev;
+
+	if (evl.nb_fds == EVLOOP_MAX_FDS)
+		return -ENOSPC;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(evl.epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -errno;
+	++evl.nb_fds;
+	return 0;
+}
+
+/*******************************************************************************
+ * Timer wheel
+ ******************************************************************************/
+void evloop_add_timer(struct evloop_timer *t, uint32_t interval, evloop_tmr_func_t *func)
+{
+	t->interval = interval;
+	t->func = func;
+	t->expiry = evl.tick + 1;
+	dlist_append(t, _evloop_head(t->expiry), wheel);
+}
+
+void evloop_del_timer(struct evloop_timer *t)
+{
+	dlist_unlink(t, _evloop_head(t->expiry), wheel);
+}
+
+/* executes due timers: each slot between the last processed and the
+ * current ms is visited once; timers that are due in a later turn of
+ * the wheel stay in their slot */
+void evloop_run_timers(void)
+{
+	struct evloop_timer *t, *next;
+	uint64_t now, tick;
+
+	now = _evloop_ms_now();
+	if (now == evl.tick)
+		return;
+
+	tick = evl.tick + 1;
+	if (now - tick >= EVLOOP_WHEEL_LEN)
+		tick = now - EVLOOP_WHEEL_LEN + 1; /* visit each slot once */
+	evl.tick = now;
+
+	for (; tick <= now; ++tick) {
+		for (t = dlist_first_el(_evloop_head(tick), struct evloop_timer);
+		     t != NULL;
+		     t = next) {
+			next = dlist_next_el(t, wheel);
+			if (t->expiry > now)
+				continue; /* due in a later turn of the wheel */
+
+			dlist_unlink(t, _evloop_head(tick), wheel);
+			t->expiry += t->interval;
+			if (t->expiry <= now)
+				t->expiry = now + t->interval; /* missed periods are not caught up */
+			dlist_append(t, _evloop_head(t->expiry), wheel);
+
+			++evl.stats.timers;
+			t->func();
+		}
+	}
+}
+
+/* returns the time in ms until the next timer or the deadline (ms, 0: none)
+ * is due (upper bound: EVLOOP_MAX_SLEEP_MS) */
+static int _evloop_next_timeout(uint64_t now, uint64_t deadline)
+{
+	struct evloop_timer *t;
+	uint64_t next = deadline ? deadline : UINT64_MAX;
+	uint64_t tick;
+
+	/* the first slot holding a timer of the current wheel turn determines
+	 * the timeout, timers of later turns are picked up on the way */
+	for (tick = evl.tick + 1; tick <= evl.tick + EVLOOP_WHEEL_LEN; ++tick) {
+		dlist_foreach(t, _evloop_head(tick), wheel) {
+			if (t->expiry < next)
+				next = t->expiry;
+		}
+		if (next <= tick)
+			break;
+	}
+
+	if (next <= now)
+		return 0;
+	return (int) min(next - now, (uint64_t) EVLOOP_MAX_SLEEP_MS);
+}
+
+/*******************************************************************************
+ * Adaptive busy-polling
+ ******************************************************************************/
+void evloop_wait(int busy, uint64_t deadline)
+{
+	struct epoll_event ev[EVLOOP_MAX_EVENTS];
+	uint64_t now, woken;
+	int n;
+
+	++evl.stats.iterations;
+	if (busy || evl.activity != evloop_activity) {
+		evl.activity = evloop_activity;
+		evl.idle_since = 0;
+		++evl.stats.busy;
+		return;
+	}
+
+	now = target_now_ns();
+	if (!evl.idle_since)
+		evl.idle_since = now;
+	if (now - evl.idle_since < evl.busypoll_ns || !evl.nb_fds) {
+		/* keep polling for a while: new requests typically
+		 * follow shortly after the last activity */
+		++evl.stats.spins;
+		return;
+	}
+
+	++evl.stats.sleeps;
+	n = epoll_wait(evl.epfd, ev, EVLOOP_MAX_EVENTS,
+		       _evloop_next_timeout(NSEC_TO_MSEC(now),
+		                            (deadline + 999999ULL) / 1000000ULL)); /* rounded up */
+	woken = target_now_ns();
+	evl.stats.sleep_ns += woken - now;
+	if (n > 0)
+		++evl.stats.wakeups_io;
+	else
+		++evl.stats.wakeups_tmr;
+	evl.idle_since = woken; /* busy-poll window restarts after each wakeup */
+}
+
+void evloop_get_stats(struct evloop_stats *out)
+{
+	memcpy(out, &evl.stats, sizeof(*out));
+}
+
+void evloop_print_stats(FILE *cio)
+{
+	struct evloop_stats s;
+
+	evloop_get_stats(&s);
+	fprintf(cio, " Iterations:           %"PRIu64"\n", s.iterations);
+	fprintf(cio, "  busy:                %"PRIu64"\n", s.busy);
+	fprintf(cio, "  busy-poll spins:     %"PRIu64"\n", s.spins);
+	fprintf(cio, "  sleeps:              %"PRIu64"\n", s.sleeps);
+	fprintf(cio, " Wakeups (I/O/timer):  %"PRIu64"/%"PRIu64"\n", s.wakeups_io, s.wakeups_tmr);
+	fprintf(cio, " Timer callbacks:      %"PRIu64"\n", s.timers);
+	fprintf(cio, " Time slept (ms):      %"PRIu64"\n", s.sleep_ns / 1000000);
+}
+
+#ifdef HAVE_SHELL
+int shcmd_evloop(FILE *cio, int argc, char *argv[])
+{
+	unsigned long us;
+	char *end;
+
+	if (argc == 2) {
+		us = strtoul(argv[1], &end, 10);
+		if (*end != '\0') {
+			fprintf(cio, "Invalid busy-poll time '%s'\n", argv[1]);
+			return -1;
+		}
+		evl.busypoll_ns = (uint64_t) us * 1000ULL;
+	} else if (argc > 2) {
+		fprintf(cio, "Usage: %s [[BUSYPOLL_US]]\n", argv[0]);
+		return -1;
+	}
+
+	fprintf(cio, " Busy-poll window (us): %"PRIu64"\n", evl.busypoll_ns / 1000);
+	fprintf(cio, " Wakeup descriptors:    %u\n", evl.nb_fds);
+	evloop_print_stats(cio);
+	return 0;
+}
+#endif
@@ -0,0 +1,264 @@
+/*
+ * Linux in-memory block devices (RAM-disk and mmap-backed)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ */
+#ifndef _MEM_BLK_H_
+#define _MEM_BLK_H_
+
+/*
+ * Both backends hold the whole device in the address space of the process:
+ *  CONFIG_RAMBLK:  the image is loaded into (huge page backed) anonymous
+ *                  memory on open; writes are written through to the file
+ *  CONFIG_MMAPBLK: the file is mapped shared, pages are faulted in on access
+ *                  (and written back) by the kernel
+ * Requests are queued by blkdev_async_io() and completed with a plain copy
+ * from blkdev_poll_req(), callbacks are never called from the submitter.
+ * blkdev_map() exposes the device memory so that the chunk cache can alias
+ * it instead of copying (see shfs_cache.c).
+ */
+#include <semaphore.h>
+#include <mempool.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define MAX_REQUESTS 1024
+#define DEFAULT_SSIZE 512 /* lower bound for opened files */
+
+typedef char blkdev_id_t[PATH_MAX]; /* device id is a path */
+typedef uint64_t sector_t;
+#define PRIsctr PRIu64
+
+typedef void (blkdev_aiocb_t)(int ret, void *argp);
+
+struct blkdev {
+  blkdev_id_t dev;
+  int fd;
+  int mode;
+  struct stat fd_stat;
+  sector_t size;
+  uint32_t ssize;
+  uint8_t *mem; /* device contents */
+  size_t mem_len; /* length of mapping (rounded up to page size) */
+  int mem_huge; /* mapping is backed by huge pages */
+  struct mempool *reqpool;
+  struct _blkdev_req *reqq_head;
+  struct _blkdev_req *reqq_tail;
+
+  int exclusive;
+  unsigned int refcount;
+
+  struct blkdev *_next;
+  struct blkdev *_prev;
+};
+
+struct _blkdev_req {
+  struct mempool_obj *p_obj; /* reference to dependent memory pool object */
+  struct blkdev *bd;
+  void *buffer;
+  sector_t sector;
+  sector_t nb_sectors;
+  int write;
+  blkdev_aiocb_t *cb;
+  void *cb_argp;
+
+  struct _blkdev_req *_next;
+};
+
+struct blkdev *open_blkdev(blkdev_id_t id, int mode);
+void close_blkdev(struct blkdev *bd);
+#define blkdev_refcount(bd) ((bd)->refcount)
+
+int blkdev_id_parse(const char *id, blkdev_id_t *out);
+#define blkdev_id_unparse(id, out, maxlen) \
+     (snprintf((out), (maxlen), "%s", (id)))
+#define blkdev_id_cmp(id0, id1) \
+     (strncmp((id0), (id1), PATH_MAX))
+#define blkdev_id_cpy(dst, src) \
+     (strncpy((dst), (src), PATH_MAX))
+#define blkdev_id(bd) ((bd)->dev)
+#define blkdev_ioalign(bd) blkdev_ssize((bd))
+
+/**
+ * Retrieve device information
+ */
+#define blkdev_ssize(bd) ((uint32_t) (bd)->ssize)
+#define blkdev_size(bd) ((bd)->size * (sector_t) blkdev_ssize((bd)))
+#define blkdev_avail_req(bd) mempool_free_count((bd)->reqpool)
+
+/**
+ * Direct access: returns the address of a sector in device memory
+ * Note: the memory is only valid as long as the device is open
+ */
+#define blkdev_map(bd, sector) \
+	((void *) ((bd)->mem + ((size_t) (sector) * (size_t) blkdev_ssize((bd)))))
+
+/**
+ * Async I/O
+ */
+#define blkdev_async_io_submit(bd) do {} while(0)
+#define blkdev_async_io_wait_slot(bd) do {} while(0)
+
+static inline int blkdev_async_io_nocheck(struct blkdev *bd, sector_t start, sector_t len,
+                                          int write, void *buffer, blkdev_aiocb_t *cb, void *cb_argp)
+{
+  struct mempool_obj *robj;
+  struct _blkdev_req *req;
+
+  robj = mempool_pick(bd->reqpool);
+  if (unlikely(!robj))
+	return -EAGAIN; /* too many requests on queue */
+
+  req = robj->data;
+  req->p_obj = robj;
+  req->bd = bd;
+  req->buffer = buffer;
+  req->sector = start;
+  req->nb_sectors = len;
+  req->write = write;
+  req->cb = cb;
+  req->cb_argp = cb_argp;
+
+  /* enqueue request to the tail of reqq,
+   * it is completed on the next blkdev_poll_req() */
+  req->_next = NULL;
+  if (bd->reqq_tail)
+	bd->reqq_tail->_next = req;
+  else
+	bd->reqq_head = req;
+  bd->reqq_tail = req;
+  return 0;
+}
+#define blkdev_async_write_nocheck(bd, start, len, buffer, cb, cb_argp) \
+	blkdev_async_io_nocheck((bd), (start), (len), 1, (buffer), (cb), (cb_argp))
+#define blkdev_async_read_nocheck(bd, start, len, buffer, cb, cb_argp) \
+	blkdev_async_io_nocheck((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
+
+static inline int blkdev_async_io(struct blkdev *bd, sector_t start, sector_t len,
+                                  int write, void *buffer, blkdev_aiocb_t *cb, void *cb_argp)
+{
+	if (unlikely(write && !(bd->mode & (O_WRONLY | O_RDWR)))) {
+		/* write access on non-writable device or read access on non-readable device */
+		return -EACCES;
+	}
+	if (unlikely(start + len > bd->size)) {
+		/* out of device bounds */
+		return -EINVAL;
+	}
+
+	return blkdev_async_io_nocheck(bd, start, len, write, buffer, cb, cb_argp);
+}
+#define blkdev_async_write(bd, start, len, buffer, cb, cb_argp)	  \
+	blkdev_async_io((bd), (start), (len), 1, (buffer), (cb), (cb_argp))
+#define blkdev_async_read(bd, start, len, buffer, cb, cb_argp)	  \
+	blkdev_async_io((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
+
+void blkdev_poll_req(struct blkdev *bd);
+/* completions are not signaled: requests in flight have to be polled */
+#define blkdev_inflight(bd) ((bd)->reqq_head != NULL)
+
+/**
+ * Sync I/O
+ */
+void _blkdev_sync_io_cb(int ret, void *argp);
+
+struct _blkdev_sync_io_sync {
+	int done;
+	int ret;
+};
+
+static inline int blkdev_sync_io_nocheck(struct blkdev *bd, sector_t start, sector_t len,
+                                             int write, void *target)
+{
+	struct _blkdev_sync_io_sync iosync;
+	int ret;
+
+	iosync.done = 0;
+	ret = blkdev_async_io_nocheck(bd, start, len, write, target,
+	                              _blkdev_sync_io_cb, &iosync);
+	while (ret == -EAGAIN) {
+		/* try again, queue was full */
+		blkdev_poll_req(bd);
+		ret = blkdev_async_io_nocheck(bd, start, len, write, target,
+		                              _blkdev_sync_io_cb, &iosync);
+	}
+	if (ret < 0)
+		return ret;
+
+	/* requests are completed by polling */
+	while (!iosync.done)
+		blkdev_poll_req(bd);
+
+	return iosync.ret;
+}
+#define blkdev_sync_write_nocheck(bd, start, len, buffer)	  \
+	blkdev_sync_io_nocheck((bd), (start), (len), 1, (buffer))
+#define blkdev_sync_read_nocheck(bd, start, len, buffer)	  \
+	blkdev_sync_io_nocheck((bd), (start), (len), 0, (buffer))
+
+static inline int blkdev_sync_io(struct blkdev *bd, sector_t start, sector_t len,
+                                 int write, void *target)
+{
+	struct _blkdev_sync_io_sync iosync;
+	int ret;
+
+	iosync.done = 0;
+	ret = blkdev_async_io(bd, start, len, write, target,
+	                      _blkdev_sync_io_cb, &iosync);
+	while (ret == -EAGAIN) {
+		/* try again, queue was full */
+		blkdev_poll_req(bd);
+		ret = blkdev_async_io(bd, start, len, write, target,
+		                      _blkdev_sync_io_cb, &iosync);
+	}
+	if (ret < 0)
+		return ret;
+
+	/* requests are completed by polling */
+	while (!iosync.done)
+		blkdev_poll_req(bd);
+
+	return iosync.ret;
+}
+#define blkdev_sync_write(bd, start, len, buffer)	  \
+	blkdev_sync_io((bd), (start), (len), 1, (buffer))
+#define blkdev_sync_read(bd, start, len, buffer)	  \
+	blkdev_sync_io((bd), (start), (len), 0, (buffer))
+
+#endif /* _MEM_BLK_H_ */
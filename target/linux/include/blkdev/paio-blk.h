@@ -190,6 +190,8 @@ static inline int blkdev_async_io(struct blkdev *bd, sector_t start, sector_t le
 	blkdev_async_io((bd), (start), (len), 0, (buffer), (cb), (cb_argp))
 
 void blkdev_poll_req(struct blkdev *bd);
+/* completions are not signaled: requests in flight have to be polled */
+#define blkdev_inflight(bd) ((bd)->reqq_head != NULL)
 
 /**
  * Sync I/O
@@ -59,6 +59,8 @@
 #endif
 #define PBUF_POOL_SIZE CONFIG_LWIP_PBUF_NUM_RX
 #define MEMP_NUM_PBUF CONFIG_LWIP_PBUF_NUM_REF
+/* netifs can pass received buffers by reference (e.g., netmap zero-copy) */
+#define LWIP_SUPPORT_CUSTOM_PBUF 1
 
 /*
  * Thread options
@@ -101,6 +103,9 @@
 #define LWIP_TCP_TIMESTAMPS 0
 #define TCP_OVERSIZE TCP_MSS
 #define LWIP_TCP_KEEPALIVE 1
+#ifdef CONFIG_LWIP_GSO
+#define TCP_GSO 1 /* TCP hands super-segments of up to 64 KiB to the netif, p->gso_size is the MSS */
+#endif
 
 #define MEMP_NUM_TCP_PCB CONFIG_LWIP_NUM_TCPCON /* max num of sim. TCP connections */
 #define MEMP_NUM_TCP_PCB_LISTEN 32 /* max num of sim. TCP listeners */
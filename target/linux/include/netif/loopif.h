@@ -0,0 +1,89 @@
+/*
+ * Loopback networking glue for lwIP
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef __LOOPIF_H__
+#define __LOOPIF_H__
+
+#include <stdint.h>
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+
+/*
+ * Build-time options (see Target.linux.x86_64.mk)
+ *  CONFIG_LOOPIF_QUEUE_LEN  max. number of packets in flight (power of 2)
+ *  CONFIG_LOOPIF_MTU        MTU of the interface
+ */
+#ifndef CONFIG_LOOPIF_QUEUE_LEN
+#define CONFIG_LOOPIF_QUEUE_LEN 4096
+#endif
+#ifndef CONFIG_LOOPIF_MTU
+#define CONFIG_LOOPIF_MTU 1500
+#endif
+
+struct loopif_stats {
+  uint64_t pkts;     /* packets looped back */
+  uint64_t bytes;
+  uint64_t drop;     /* packets dropped because the queue was full or no pbuf was left */
+  uint32_t maxqlen;  /* highest queue fill level seen by loopif_poll() */
+};
+
+/**
+ * Private data of a loopback interface.
+ * Every IP packet that is sent on the interface is queued and
+ * handed back to the stack by the next loopif_poll() call, so that
+ * a client that connects to the address of this interface talks to the
+ * server through the full TCP/IP output and input paths.
+ * No network, device or privileges are required.
+ */
+struct loopif {
+  struct pbuf **_queue; /* ring of CONFIG_LOOPIF_QUEUE_LEN packets */
+  uint32_t _head;
+  uint32_t _tail;
+  struct loopif_stats _stats;
+
+  int _state_is_private;
+};
+
+err_t loopif_init(struct netif *netif);
+
+/* Delivers queued packets to the lwIP stack: has to be called periodically.
+ * Packets that are sent while the queue is processed (e.g., ACKs)
+ * are delivered by the next call. */
+void loopif_poll(struct netif *netif);
+
+/* copies the statistics of a loopback netif, returns -1 if netif is not a loopback device */
+int loopif_get_stats(struct netif *netif, struct loopif_stats *out);
+
+#endif /* __LOOPIF_H__ */
@@ -51,6 +51,20 @@
 #include <sys/poll.h>
 #include <net/netmap_user.h>
 
+struct netmapif_stats {
+    uint64_t rx_pkts;
+    uint64_t rx_zcopy;   /* frames passed by reference to the netmap buffer (copies avoided) */
+    uint64_t rx_nospare; /* frames copied because no spare buffer was left */
+    uint64_t rx_syncs;
+    uint64_t tx_pkts;
+    uint64_t tx_syncs;
+    uint64_t tx_full;    /* TX ring was full on transmit */
+    uint64_t tx_gso;     /* TCP super-segments segmented in software */
+    uint64_t tx_gso_segs;/* wire segments generated from them (included in tx_pkts) */
+};
+
+struct netmapif_rxpbuf;
+
 /**
  * Helper struct to hold private data used to operate the ethernet interface.
  * The user can pre-initialize some values (e.g., providing a mac address,
@@ -71,6 +85,16 @@ struct netmapif {
     struct netmap_if *_nifp;
     struct netmap_ring *_txring;
     int _fd;
+    unsigned int _tx_pending; /* filled TX slots since last TXSYNC */
+    struct netmapif_stats _stats;
+
+    /* zero-copy receive: received buffers are swapped against
+     * spare (extra) netmap buffers and referenced by pbufs */
+    uint32_t *_spare_bufs; /* stack of free spare buffer indices */
+    unsigned int _nb_spare;
+    unsigned int _nb_extra;
+    struct netmapif_rxpbuf *_rxpbufs;
+    struct netmapif_rxpbuf *_rxpbuf_free;
 #ifndef CONFIG_LWIP_NOTHREADS
     volatile int _thread_exit;
     char _thread_name[6];
@@ -94,4 +118,10 @@ void netmapif_poll(struct netif *netif);
 
 err_t netmapif_init(struct netif *netif);
 
+/* copies the statistics of a netmap netif, returns -1 if netif is not a netmap device */
+int netmapif_get_stats(struct netif *netif, struct netmapif_stats *out);
+
+/* stores the file descriptor of a netmap netif to fds, returns -1 if netif is not a netmap device */
+int netmapif_get_fds(struct netif *netif, int *fds, unsigned int max);
+
 #endif /* __NETMAPIF_H__ */
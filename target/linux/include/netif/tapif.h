@@ -32,10 +32,47 @@
 #ifndef LWIP_TAPIF_H
 #define LWIP_TAPIF_H
 
+#include <stdint.h>
 #include "lwip/netif.h"
 
+/*
+ * Build-time options (see Target.linux.x86_64.mk)
+ *  CONFIG_TAPIF_VNET_HDR    exchange virtio-net headers with the kernel
+ *                           (checksum offload, GRO on receive)
+ *  CONFIG_TAPIF_NUM_QUEUES  number of TAP queues (IFF_MULTI_QUEUE if > 1)
+ *  CONFIG_TAPIF_RX_BATCH    max. number of frames drained per queue and poll
+ */
+#ifndef CONFIG_TAPIF_NUM_QUEUES
+#define CONFIG_TAPIF_NUM_QUEUES 1
+#endif
+#ifndef CONFIG_TAPIF_RX_BATCH
+#define CONFIG_TAPIF_RX_BATCH 32
+#endif
+
+struct tapif_stats {
+  uint64_t polls;       /* calls of the receive path */
+  uint64_t busy_polls;  /* polls that received at least one frame */
+  uint64_t rx_pkts;
+  uint64_t rx_bytes;
+  uint64_t rx_gro;      /* frames larger than the MTU (merged by the kernel) */
+  uint64_t rx_nomem;    /* receive stopped because of pbuf pool exhaustion */
+  uint64_t tx_pkts;
+  uint64_t tx_bytes;
+  uint64_t tx_csum;     /* TCP checksums offloaded to the kernel */
+  uint64_t tx_linear;   /* frames that had to be linearized before sending */
+  uint64_t tx_gso;      /* TCP super-segments handed to the kernel for segmentation */
+  uint64_t tx_drop;
+};
+
 err_t tapif_init(struct netif *netif);
 
+/* copies the statistics of a TAP netif, returns -1 if netif is not a TAP device */
+int tapif_get_stats(struct netif *netif, struct tapif_stats *out);
+
+/* stores the file descriptors of the TAP queues (readable on received frames)
+ * to fds and returns their number, returns -1 if netif is not a TAP device */
+int tapif_get_fds(struct netif *netif, int *fds, unsigned int max);
+
 #ifdef CONFIG_LWIP_NOTHREADS
 /* NIC I/O handling: has to be called periodically
  * to get received by the lwIP stack.
@@ -0,0 +1,132 @@
+/*
+ * AF_XDP networking glue for lwIP
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ */
+#ifndef __XDPIF_H__
+#define __XDPIF_H__
+
+#include <stdint.h>
+#include <net/if.h>
+#include "lwip/opt.h"
+#include "lwip/netif.h"
+#include "netif/etharp.h"
+
+#include <xdp/xsk.h>
+
+/*
+ * Build-time options (see Target.linux.x86_64.mk)
+ *  CONFIG_XDPIF_IFNAME      interface the AF_XDP socket is bound to
+ *  CONFIG_XDPIF_QUEUE       queue id of that interface
+ *  CONFIG_XDPIF_RING_SIZE   number of descriptors per ring (power of 2)
+ *  CONFIG_XDPIF_NUM_FRAMES  number of UMEM frames (shared by RX and TX)
+ *  CONFIG_XDPIF_RX_BATCH    max. number of frames received per poll
+ */
+#ifndef CONFIG_XDPIF_IFNAME
+#define CONFIG_XDPIF_IFNAME "veth1"
+#endif
+#ifndef CONFIG_XDPIF_QUEUE
+#define CONFIG_XDPIF_QUEUE 0
+#endif
+#ifndef CONFIG_XDPIF_RING_SIZE
+#define CONFIG_XDPIF_RING_SIZE 2048
+#endif
+#ifndef CONFIG_XDPIF_NUM_FRAMES
+#define CONFIG_XDPIF_NUM_FRAMES (4 * CONFIG_XDPIF_RING_SIZE)
+#endif
+#ifndef CONFIG_XDPIF_RX_BATCH
+#define CONFIG_XDPIF_RX_BATCH 64
+#endif
+
+struct xdpif_stats {
+  uint64_t rx_pkts;
+  uint64_t rx_zcopy;   /* frames passed by reference to the UMEM frame (copies avoided) */
+  uint64_t rx_copied;  /* frames copied because too few UMEM frames were left */
+  uint64_t rx_wakeups; /* fill ring kicks */
+  uint64_t tx_pkts;
+  uint64_t tx_kicks;   /* sendto() calls to start transmission */
+  uint64_t tx_full;    /* no UMEM frame or TX descriptor was left on transmit */
+  uint64_t tx_drop;
+  int zerocopy;        /* socket is bound in zero-copy mode (copy mode otherwise) */
+};
+
+struct xdpif_rxpbuf;
+
+/**
+ * Helper struct to hold private data used to operate the ethernet interface.
+ * The user can pre-initialize ifname, queue and hwaddr. If no xdpif struct is
+ * passed (via netif->state), CONFIG_XDPIF_IFNAME and CONFIG_XDPIF_QUEUE are used.
+ */
+struct xdpif {
+  char ifname[IFNAMSIZ];
+  uint32_t queue;
+  struct eth_addr hwaddr;
+
+  /* the following fields are used internally */
+  void *_umem_area;
+  size_t _umem_size;
+  struct xsk_umem *_umem;
+  struct xsk_socket *_xsk;
+  struct xsk_ring_prod _fq;
+  struct xsk_ring_cons _cq;
+  struct xsk_ring_cons _rx;
+  struct xsk_ring_prod _tx;
+  int _fd;
+
+  /* stack of free UMEM frame addresses: frames are either free,
+   * on the fill/RX ring, on the TX/completion ring, or referenced by a pbuf */
+  uint64_t *_frames;
+  unsigned int _nb_free;
+  unsigned int _nb_rxref;   /* frames referenced by received pbufs */
+  struct xdpif_rxpbuf *_rxpbufs; /* one per frame */
+  unsigned int _tx_pending; /* TX descriptors submitted since the last kick */
+  struct xdpif_stats _stats;
+
+  int _state_is_private;
+  int _hwaddr_is_private;
+};
+
+err_t xdpif_init(struct netif *netif);
+
+/* NIC I/O handling: has to be called periodically
+ * to get received by the lwIP stack. */
+void xdpif_poll(struct netif *netif);
+
+/* copies the statistics of an AF_XDP netif, returns -1 if netif is not an AF_XDP device */
+int xdpif_get_stats(struct netif *netif, struct xdpif_stats *out);
+
+/* stores the file descriptor of the AF_XDP socket to fds, returns -1 if netif is not an AF_XDP device */
+int xdpif_get_fds(struct netif *netif, int *fds, unsigned int max);
+
+#endif /* __XDPIF_H__ */
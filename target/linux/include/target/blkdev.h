@@ -39,6 +39,8 @@
 
 #if defined CONFIG_OSVBLK
 #include <blkdev/osv-blk.h>
+#elif defined CONFIG_RAMBLK || defined CONFIG_MMAPBLK
+#include <blkdev/mem-blk.h>
 #else
 #include <blkdev/paio-blk.h>
 #endif
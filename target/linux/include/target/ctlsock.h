@@ -0,0 +1,60 @@
+/*
+ * Control socket for the Linux target (shell commands via a Unix socket)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _CTLSOCK_H_
+#define _CTLSOCK_H_
+
+/*
+ * Without threads, there are no shell sessions on the Linux target.
+ * Instead, command lines are accepted on a Unix domain stream socket and
+ * executed from within the main loop, one command per line, e.g.:
+ *   echo "stats" | socat - UNIX-CONNECT:/tmp/minicache.sock
+ * The output of a command is buffered and written back to the connection
+ * without blocking; the next line is executed after it was sent.
+ * Note: A command blocks the main loop until it returned.
+ */
+#ifndef CONFIG_CTLSOCK_PATH
+#define CONFIG_CTLSOCK_PATH "/tmp/minicache.sock"
+#endif
+
+#define CTLSOCK_MAX_CONNS 4
+#define CTLSOCK_ARGB_LEN 256
+#define CTLSOCK_POLL_INTERVAL 20 /* ms */
+
+int init_ctlsock(const char *path);
+void exit_ctlsock(void);
+void ctlsock_poll(void);
+
+#endif /* _CTLSOCK_H_ */
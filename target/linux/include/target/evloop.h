@@ -0,0 +1,116 @@
+/*
+ * Event loop for the Linux target (epoll, timer wheel, adaptive busy-polling)
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _EVLOOP_H_
+#define _EVLOOP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "dlist.h"
+
+/*
+ * The main loop polls block devices, the HTTP retry/pacing queues and the
+ * netif on every iteration. evloop_wait() decides at the beginning of each
+ * iteration whether to continue busy-polling or to sleep:
+ *  - as long as there is work in flight (I/O requests, sessions waiting
+ *    for buffers) or frames were received recently, the loop keeps
+ *    busy-polling (low latency)
+ *  - after CONFIG_EVLOOP_BUSYPOLL_US without any activity, it sleeps in
+ *    epoll_wait() on the netif file descriptors until a frame arrives,
+ *    the next timer expires or the passed deadline (e.g., the next paced
+ *    HTTP session) is reached (no CPU usage when idle)
+ * Note: Block device completions cannot wake up the loop (POSIX AIO
+ * without notification), that is why in-flight requests keep it busy.
+ *
+ * Periodic timers (lwIP timers and friends) are kept on a timer wheel
+ * with 1 ms slots, so that the timeout for epoll_wait() is derived from
+ * the next due slot.
+ */
+#ifndef CONFIG_EVLOOP_BUSYPOLL_US
+#define CONFIG_EVLOOP_BUSYPOLL_US 50
+#endif
+
+#define EVLOOP_WHEEL_LEN     1024 /* slots of 1 ms */
+#define EVLOOP_MAX_SLEEP_MS  1000
+#define EVLOOP_MAX_EVENTS    16
+#define EVLOOP_MAX_FDS       16
+
+typedef void (evloop_tmr_func_t)(void);
+
+struct evloop_timer {
+	uint64_t expiry;   /* ms */
+	uint32_t interval; /* ms */
+	evloop_tmr_func_t *func;
+	dlist_el(wheel);
+};
+
+struct evloop_stats {
+	uint64_t iterations;
+	uint64_t busy;        /* iterations with work in flight or recent activity */
+	uint64_t spins;       /* idle iterations within the busy-poll window */
+	uint64_t sleeps;      /* epoll_wait() calls */
+	uint64_t wakeups_io;  /* sleeps ended by a file descriptor event */
+	uint64_t wakeups_tmr; /* sleeps ended by the timeout (next timer) */
+	uint64_t timers;      /* executed timer callbacks */
+	uint64_t sleep_ns;    /* total time spent in epoll_wait() */
+};
+
+/* activity counter, bumped by the netif input path */
+extern uint64_t evloop_activity;
+#define evloop_mark_active() \
+	(++evloop_activity)
+
+int init_evloop(void);
+void exit_evloop(void);
+
+/* registers a file descriptor that wakes up the loop when it is readable */
+int evloop_add_fd(int fd);
+
+/* periodic timer, the first expiry happens on the next loop iteration */
+void evloop_add_timer(struct evloop_timer *t, uint32_t interval, evloop_tmr_func_t *func);
+void evloop_del_timer(struct evloop_timer *t);
+void evloop_run_timers(void);
+
+/* busy: there is work in flight that has to be polled
+ * deadline: time (ns) when the caller has work to do at the latest, 0: none */
+void evloop_wait(int busy, uint64_t deadline);
+
+void evloop_get_stats(struct evloop_stats *out);
+void evloop_print_stats(FILE *cio);
+#ifdef HAVE_SHELL
+int shcmd_evloop(FILE *cio, int argc, char *argv[]);
+#endif
+
+#endif /* _EVLOOP_H_ */
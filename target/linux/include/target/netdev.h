@@ -37,7 +37,15 @@
 #ifndef _NETDEV_H_
 #define _NETDEV_H_
 
-#if defined CONFIG_OSVNET
+#if defined CONFIG_LOOPIF
+#include <netif/loopif.h>
+#define target_netif_init \
+  loopif_init
+#define target_netif_poll \
+  loopif_poll
+#define CONFIG_LWIP_IPDEV
+
+#elif defined CONFIG_OSVNET
 #include <netif/osv-net.h>
 #define target_netif_init \
   osvnetif_init
@@ -50,12 +58,23 @@
 #define target_netif_init \
   pcapif_init
 
+#elif defined CONFIG_XDPIF
+#include <netif/xdpif.h>
+#define target_netif_init \
+  xdpif_init
+#define target_netif_poll \
+  xdpif_poll
+#define target_netif_fds \
+  xdpif_get_fds
+
 #elif defined CONFIG_NETMAP
 #include <netif/netmapif.h>
 #define target_netif_init \
   netmapif_init
 #define target_netif_poll \
   netmapif_poll
+#define target_netif_fds \
+  netmapif_get_fds
 
 #else
 #include <netif/tapif.h>
@@ -63,6 +82,8 @@
   tapif_init
 #define target_netif_poll \
   tapif_poll
+#define target_netif_fds \
+  tapif_get_fds
 
 #endif
 
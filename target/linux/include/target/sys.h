@@ -61,6 +61,9 @@
 #define local_irq_restore(flags) \
   (flags = 1)
 
+#define barrier() \
+  __asm__ __volatile__("": : :"memory")
+
 #define ASSERT(x) assert((x))
 #define BUG_ON(x) assert(!((x)))
 #define printk(...) printf(__VA_ARGS__)
@@ -103,11 +106,13 @@ void app_shutdown(unsigned reason);
 #define exit_thread() \
 	pth_exit(NULL)
 #else
-#define thread (void *)
+/* no threads: spawning fails (e.g., shell sessions),
+ * the main loop is the only execution context */
+#define thread _nothread
 #define schedule() \
 	do {} while (0)
 #define create_thread(name, func, argp) \
-	do {} while (0)
+	((void) (func), (void) (argp), (struct thread *) NULL)
 #define exit_thread() \
 	do {} while (0)
 #endif
@@ -0,0 +1,252 @@
+/*
+ * Loopback networking glue for lwIP
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ * IP-level device that hands every sent packet back to the stack.
+ * It is used for end-to-end benchmarks in a single process (see
+ * http_bench.c): client and server run on the same lwIP instance and
+ * exchange their segments through this interface. Sent packets are
+ * copied because lwIP keeps (and modifies headers of) unacknowledged
+ * segments, and the receive path adjusts the payload pointers.
+ */
+
+#include <netif/loopif.h>
+
+#include <string.h>
+#include "likely.h"
+#include "lwip/def.h"
+#include "lwip/mem.h"
+#include "lwip/pbuf.h"
+#include <lwip/stats.h>
+#include <lwip/snmp.h>
+
+#ifndef CONFIG_LWIP_NOTHREADS
+#error "loopif requires a non-threaded lwIP (CONFIG_LWIP_NOTHREADS)"
+#endif
+#if (CONFIG_LOOPIF_QUEUE_LEN & (CONFIG_LOOPIF_QUEUE_LEN - 1))
+#error "CONFIG_LOOPIF_QUEUE_LEN has to be a power of 2"
+#endif
+
+#define LOOPIF_NPREFIX 'l'
+#define LOOPIF_SPEED 0ul     /* 0 for unknown */
+
+#define loopif_qlen(li)  ((li)->_tail - (li)->_head)
+#define loopif_qslot(i)  ((i) & (CONFIG_LOOPIF_QUEUE_LEN - 1))
+
+/**
+ * Queues a copy of an IP packet for delivery by loopif_poll().
+ * This pbuf can be chained.
+ *
+ * @param netif
+ *  the lwip network interface structure for this loopif
+ * @param p
+ *  the IP packet to send
+ * @return
+ *  ERR_OK when the packet was queued; ERR_MEM otherwise
+ */
+static err_t loopif_output(struct netif *netif, struct pbuf *p,
+                           const ip4_addr_t *ipaddr)
+{
+  struct loopif *li = netif->state;
+  struct pbuf *q;
+
+  if (unlikely(loopif_qlen(li) == CONFIG_LOOPIF_QUEUE_LEN))
+    goto err_drop;
+  q = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_POOL);
+  if (unlikely(!q))
+    goto err_drop;
+  if (unlikely(pbuf_copy(q, p) != ERR_OK)) {
+    pbuf_free(q);
+    goto err_drop;
+  }
+
+  li->_queue[loopif_qslot(li->_tail++)] = q;
+  li->_stats.pkts++;
+  li->_stats.bytes += p->tot_len;
+  LINK_STATS_INC(link.xmit);
+  return ERR_OK;
+
+ err_drop:
+  LWIP_DEBUGF(NETIF_DEBUG, ("loopif_output: %c%c: "
+                            "Packet dropped (queue length: %"U32_F")\n",
+                            netif->name[0], netif->name[1], loopif_qlen(li)));
+  li->_stats.drop++;
+  LINK_STATS_INC(link.memerr);
+  LINK_STATS_INC(link.drop);
+  return ERR_MEM;
+}
+
+void loopif_poll(struct netif *netif)
+{
+  struct loopif *li = netif->state;
+  struct pbuf *p;
+  uint32_t end;
+
+  /* only packets that were queued until now: output that is caused
+   * by the input processing is delivered with the next call */
+  end = li->_tail;
+  if (loopif_qlen(li) > li->_stats.maxqlen)
+    li->_stats.maxqlen = loopif_qlen(li);
+
+  while (li->_head != end) {
+    p = li->_queue[loopif_qslot(li->_head++)];
+    LINK_STATS_INC(link.recv);
+    if (unlikely(netif->input(p, netif) != ERR_OK)) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("loopif_poll: %c%c: "
+                                "Packet dropped\n",
+                                netif->name[0], netif->name[1]));
+      pbuf_free(p);
+    }
+  }
+}
+
+int loopif_get_stats(struct netif *netif, struct loopif_stats *out)
+{
+  struct loopif *li = netif->state;
+
+  if (netif->output != loopif_output)
+    return -1;
+  memcpy(out, &li->_stats, sizeof(*out));
+  return 0;
+}
+
+#if LWIP_NETIF_REMOVE_CALLBACK
+/**
+ * Closes a loopback interface: queued packets are dropped.
+ * This function is called by lwIP on netif_remove().
+ *
+ * @param netif
+ *  the lwip network interface structure for this loopif
+ */
+static void loopif_exit(struct netif *netif)
+{
+  struct loopif *li = netif->state;
+
+  while (li->_head != li->_tail)
+    pbuf_free(li->_queue[loopif_qslot(li->_head++)]);
+  mem_free(li->_queue);
+  li->_queue = NULL;
+
+  if (li->_state_is_private) {
+    mem_free(li);
+    netif->state = NULL;
+  }
+}
+#endif /* LWIP_NETIF_REMOVE_CALLBACK */
+
+/**
+ * Initializes and sets up a loopback interface for lwIP.
+ * This function should be passed as a parameter to netif_add().
+ *
+ * @param netif
+ *  the lwip network interface structure for this loopif
+ * @return
+ *  ERR_OK if the interface was successfully initialized;
+ *  An err_t value otherwise
+ */
+err_t loopif_init(struct netif *netif)
+{
+  struct loopif *li;
+  static uint8_t loopif_id = 0;
+
+  LWIP_ASSERT("netif != NULL", (netif != NULL));
+
+  if (!(netif->state)) {
+    li = mem_calloc(1, sizeof(*li));
+    if (!li) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("loopif_init: "
+                                "Could not allocate \n"));
+      goto err_out;
+    }
+    netif->state = li;
+    li->_state_is_private = 1;
+  } else {
+    li = netif->state;
+    li->_state_is_private = 0;
+  }
+
+  li->_queue = mem_calloc(CONFIG_LOOPIF_QUEUE_LEN, sizeof(*li->_queue));
+  if (!li->_queue) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("loopif_init: "
+                              "Could not allocate packet queue\n"));
+    goto err_free_li;
+  }
+  li->_head = 0;
+  li->_tail = 0;
+  memset(&li->_stats, 0, sizeof(li->_stats));
+
+  /* Interface identifier */
+  netif->name[0] = LOOPIF_NPREFIX;
+  netif->name[1] = '0' + loopif_id;
+  loopif_id++;
+
+  /* We send IP packets directly (no ARP) */
+  netif->output = loopif_output;
+  netif->linkoutput = NULL;
+#if LWIP_NETIF_REMOVE_CALLBACK
+  netif->remove_callback = loopif_exit;
+#endif /* LWIP_NETIF_REMOVE_CALLBACK */
+
+  /* No hardware address support */
+  netif->hwaddr_len = 0;
+
+  /* Initialize the snmp variables and counters inside the struct netif.
+   * The last argument is the link speed, in units of bits per second. */
+  NETIF_INIT_SNMP(netif, snmp_ifType_softwareLoopback, LOOPIF_SPEED);
+
+  /* Device capabilities */
+  netif->flags = NETIF_FLAG_LINK_UP;
+
+  /* Maximum transfer unit */
+  netif->mtu = CONFIG_LOOPIF_MTU;
+  LWIP_DEBUGF(NETIF_DEBUG, ("loopif_init: %c%c: MTU: %u, queue length: %u\n",
+                            netif->name[0], netif->name[1], netif->mtu,
+                            CONFIG_LOOPIF_QUEUE_LEN));
+
+#if LWIP_NETIF_HOSTNAME
+  /* Initialize interface hostname */
+  if (!netif->hostname)
+    netif->hostname = NULL;
+#endif /* LWIP_NETIF_HOSTNAME */
+
+  return ERR_OK;
+
+ err_free_li:
+  if (li->_state_is_private) {
+    mem_free(li);
+    netif->state = NULL;
+  }
+ err_out:
+  return ERR_IF;
+}
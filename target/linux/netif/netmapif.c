@@ -93,10 +93,14 @@
 #endif /* __FreeBSD__ */
 
 #include <stdlib.h>
+#include <string.h>
 #include "likely.h"
 #include "lwip/def.h"
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
+#include "lwip/ip.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/tcp_impl.h"
 #include <lwip/stats.h>
 #include <lwip/snmp.h>
 
@@ -114,6 +118,14 @@
 
 #define NMNETIF_MEMCPY memcpy
 
+/* number of spare netmap buffers that are requested for zero-copy receive */
+#ifndef CONFIG_NETMAP_EXTRA_BUFS
+#define CONFIG_NETMAP_EXTRA_BUFS 1024
+#endif
+#if LWIP_SUPPORT_CUSTOM_PBUF && !ETH_PAD_SIZE && (CONFIG_NETMAP_EXTRA_BUFS > 0)
+#define NMNETIF_ZEROCOPY
+#endif
+
 /**
  * Helper macros
  */
@@ -130,10 +142,30 @@
 #define netmapif_count_pbuf_txslots(nmi, p)	\
   DIV_ROUND_UP(((unsigned int)(p)->tot_len), (nmi)->_txring->nr_buf_size);
 
+#ifdef NMNETIF_ZEROCOPY
+struct netmapif_rxpbuf {
+  struct pbuf_custom pc; /* has to be the first field */
+  struct netmapif *nmi;
+  uint32_t buf_idx;
+  struct netmapif_rxpbuf *next_free;
+};
+#endif
+
 /**
- * Transmit function for pbufs which can handle checksum and segmentation offloading for TCPv4 and TCPv6
+ * Hands all TX slots that were filled since the last call to the NIC
+ * and reclaims completed ones
  */
-static err_t netmapif_output(struct netmapif *nmi, struct pbuf *p, int co_type, int push)
+static inline void netmapif_txsync(struct netmapif *nmi)
+{
+  ioctl(nmi->_fd, NIOCTXSYNC, NULL);
+  ++nmi->_stats.tx_syncs;
+  nmi->_tx_pending = 0;
+}
+
+/**
+ * Copies a pbuf chain to the TX ring (a frame may span multiple slots)
+ */
+static err_t netmapif_output(struct netmapif *nmi, struct pbuf *p)
 {
   unsigned int slots;
   struct netmap_slot *slot;
@@ -143,22 +175,18 @@ static err_t netmapif_output(struct netmapif *nmi, struct pbuf *p, int co_type,
   uint16_t p_off, p_left;
   unsigned int len;
 
-  LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output: %p (%zu bytes, gso=%d, %s%d slots)\n", p, p->tot_len, co_type, push ? "push, " : "", slots));
-
-#ifndef CONFIG_NETFRONT_GSO
   slots = netmapif_count_pbuf_txslots(nmi, p);
-  if (unlikely(co_type != NMNETIF_GSO_TYPE_NONE)) {
-    printf("netmapif_output: FATAL: GSO is not supported");
-    return ERR_IF;
-  }
-#else
-  #error "GSO is not supported yet"
-#endif
+  LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output: %p (%u bytes, %u slots)\n", p, p->tot_len, slots));
 
   /* do we have space? */
   if (unlikely(nm_ring_space(nmi->_txring) < slots)) {
-    LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output: not enough slots left on tx ring\n"));
-    return ERR_MEM;
+    /* push out pending slots and reclaim completed ones */
+    ++nmi->_stats.tx_full;
+    netmapif_txsync(nmi);
+    if (unlikely(nm_ring_space(nmi->_txring) < slots)) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output: not enough slots left on tx ring\n"));
+      return ERR_MEM;
+    }
   }
 
   /* copy payload to netmap ring */
@@ -207,10 +235,125 @@ static err_t netmapif_output(struct netmapif *nmi, struct pbuf *p, int co_type,
 
   nmi->_txring->head = nmi->_txring->cur = cur;
 
-  if (push)
-    ioctl(nmi->_fd, NIOCTXSYNC, NULL);
+  /* TXSYNC is issued once per poll (see netmapif_poll()) */
+  nmi->_tx_pending += slots;
+  ++nmi->_stats.tx_pkts;
+  return ERR_OK;
+}
+
+#if TCP_GSO
+/**
+ * TCP checksum of a segment that is contiguous in memory
+ * (the checksum field has to be zero)
+ */
+static inline u16_t netmapif_tcp_chksum(const struct ip_hdr *iphdr, void *tcphdr, u16_t tcplen)
+{
+  u32_t sum;
+
+  sum  = (u16_t) ~inet_chksum(tcphdr, tcplen);
+  sum += (iphdr->src.addr & 0xFFFF) + (iphdr->src.addr >> 16);
+  sum += (iphdr->dest.addr & 0xFFFF) + (iphdr->dest.addr >> 16);
+  sum += PP_HTONS(IP_PROTO_TCP) + htons(tcplen);
+  sum  = (sum & 0xFFFF) + (sum >> 16);
+  sum  = (sum & 0xFFFF) + (sum >> 16);
+  return (u16_t) ~sum;
+}
+
+/**
+ * Software segmentation of a TCPv4 super-segment: The Ethernet, IP and TCP
+ * headers of the super-segment serve as template that is copied in front
+ * of each MSS-sized payload chunk. Only IP length, IP id, TCP sequence number,
+ * TCP flags and the checksums are patched per segment.
+ * Each segment is written to a single TX slot, so the payload is copied
+ * exactly once.
+ */
+static err_t netmapif_output_tso(struct netmapif *nmi, struct pbuf *p, u16_t ip_hdr_offset, u16_t mss)
+{
+  struct netmap_ring *ring = nmi->_txring;
+  struct netmap_slot *slot;
+  const struct ip_hdr *iphdr;
+  const struct tcp_hdr *tcphdr;
+  struct ip_hdr *s_iphdr;
+  struct tcp_hdr *s_tcphdr;
+  u16_t iphlen, tcphlen, hdr_len;
+  u16_t p_off, seg_len, left;
+  u16_t ipid;
+  u32_t seqno;
+  u16_t flags;
+  unsigned int nb_segs, i;
+  unsigned int cur;
+  void *s_buf;
+
+  /* NOTE: We assume here that all protocol headers are in the first pbuf of a pbuf chain! */
+  iphdr   = (const struct ip_hdr *)((uintptr_t) p->payload + ip_hdr_offset);
+  iphlen  = IPH_HL(iphdr) * 4;
+  tcphdr  = (const struct tcp_hdr *)((uintptr_t) iphdr + iphlen);
+  tcphlen = TCPH_HDRLEN(tcphdr) * 4;
+  hdr_len = ip_hdr_offset + iphlen + tcphlen;
+  if (unlikely(hdr_len > p->len || hdr_len >= p->tot_len)) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output_tso: headers are not in the first pbuf\n"));
+    return ERR_IF;
+  }
+  if (!mss || hdr_len + mss > ring->nr_buf_size)
+    mss = min((u16_t) (NMNETIF_MTU - iphlen - tcphlen), (u16_t) (ring->nr_buf_size - hdr_len));
+
+  left    = p->tot_len - hdr_len;
+  nb_segs = DIV_ROUND_UP((unsigned int) left, (unsigned int) mss);
+  LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output_tso: %p (%u bytes, mss=%u, %u segments)\n", p, p->tot_len, mss, nb_segs));
+
+  /* do we have space? */
+  if (unlikely(nm_ring_space(ring) < nb_segs)) {
+    ++nmi->_stats.tx_full;
+    netmapif_txsync(nmi);
+    if (unlikely(nm_ring_space(ring) < nb_segs)) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_output_tso: not enough slots left on tx ring\n"));
+      return ERR_MEM;
+    }
+  }
+
+  ipid  = ntohs(IPH_ID(iphdr));
+  seqno = ntohl(tcphdr->seqno);
+  flags = TCPH_FLAGS(tcphdr);
+  p_off = hdr_len;
+  cur   = ring->cur;
+  for (i = 0; i < nb_segs; ++i) {
+    seg_len  = min(mss, left);
+    slot     = &ring->slot[cur];
+    s_buf    = NETMAP_BUF(ring, slot->buf_idx);
+    s_iphdr  = (struct ip_hdr *)((uintptr_t) s_buf + ip_hdr_offset);
+    s_tcphdr = (struct tcp_hdr *)((uintptr_t) s_iphdr + iphlen);
+
+    /* header template + payload chunk */
+    NMNETIF_MEMCPY(s_buf, p->payload, hdr_len);
+    pbuf_copy_partial(p, (void *)((uintptr_t) s_buf + hdr_len), seg_len, p_off);
+
+    IPH_LEN_SET(s_iphdr, htons(iphlen + tcphlen + seg_len));
+    IPH_ID_SET(s_iphdr, htons((u16_t) (ipid + i)));
+    IPH_CHKSUM_SET(s_iphdr, 0);
+    IPH_CHKSUM_SET(s_iphdr, inet_chksum(s_iphdr, iphlen));
+    s_tcphdr->seqno = htonl(seqno + (p_off - hdr_len));
+    if (i != nb_segs - 1)
+      TCPH_FLAGS_SET(s_tcphdr, flags & ~(TCP_FIN | TCP_PSH)); /* only the last segment finishes/pushes */
+    s_tcphdr->chksum = 0;
+    s_tcphdr->chksum = netmapif_tcp_chksum(s_iphdr, s_tcphdr, tcphlen + seg_len);
+
+    slot->len   = hdr_len + seg_len;
+    slot->flags = 0;
+    p_off += seg_len;
+    left  -= seg_len;
+    cur    = nm_ring_next(ring, cur);
+  }
+  slot->flags = NS_REPORT;
+  ring->head = ring->cur = cur;
+
+  /* TXSYNC is issued once per poll (see netmapif_poll()) */
+  nmi->_tx_pending += nb_segs;
+  nmi->_stats.tx_pkts += nb_segs;
+  nmi->_stats.tx_gso_segs += nb_segs;
+  ++nmi->_stats.tx_gso;
   return ERR_OK;
 }
+#endif /* TCP_GSO */
 
 /**
  * This function does the actual transmission of a packet. The packet is
@@ -227,16 +370,13 @@ static err_t netmapif_output(struct netmapif *nmi, struct pbuf *p, int co_type,
 static err_t netmapif_transmit(struct netif *netif, struct pbuf *p)
 {
     struct netmapif *nmi = netif->state;
-#if defined CONFIG_NETFRONT_GSO || defined CONFIG_LWIP_BATCHTX
-    s16_t ip_hdr_offset;
+#if TCP_GSO
+    u16_t ip_hdr_offset;
     const struct eth_hdr *ethhdr;
     const struct ip_hdr *iphdr;
-#endif /* defined CONFIG_NETFRONT_GSO || defined CONFIG_LWIP_BATCHTX */
-#ifdef CONFIG_LWIP_BATCHTX
-    const struct tcp_hdr *tcphdr;
-#endif /* CONFIG_LWIP_BATCHTX */
-    int tso = 0;
-    int push = 1;
+    u16_t type;
+#endif /* TCP_GSO */
+    int tso = NMNETIF_GSO_TYPE_NONE;
     err_t err;
 
     LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_transmit: %c%c: "
@@ -244,11 +384,20 @@ static err_t netmapif_transmit(struct netif *netif, struct pbuf *p)
 			      netif->name[0], netif->name[1],
 			      p->tot_len));
 
-#if defined CONFIG_NETFRONT_GSO || defined CONFIG_LWIP_BATCHTX
+#if ETH_PAD_SIZE
+    pbuf_header(p, -ETH_PAD_SIZE); /* drop the padding word */
+#endif
+
+#if TCP_GSO
+    /* super-segments are the only frames that exceed the MTU */
+    if (likely(p->tot_len <= netif->mtu + SIZEOF_ETH_HDR))
+      goto xmit;
+
     /* detect if payload contains a TCP packet */
     /* NOTE: We assume here that all protocol headers are in the first pbuf of a pbuf chain! */
     ip_hdr_offset = SIZEOF_ETH_HDR;
     ethhdr = (struct eth_hdr *) p->payload;
+    type = ethhdr->type;
 #if ETHARP_SUPPORT_VLAN
     if (type == PP_HTONS(ETHTYPE_VLAN)) {
       type = ((struct eth_vlan_hdr*)(((uintptr_t)ethhdr) + SIZEOF_ETH_HDR))->tpid;
@@ -257,48 +406,43 @@ static err_t netmapif_transmit(struct netif *netif, struct pbuf *p)
 #endif /* ETHARP_SUPPORT_VLAN */
     /* TODO: PPP support? */
 
-    switch (ethhdr->type) {
+    switch (type) {
     case PP_HTONS(ETHTYPE_IP):
       iphdr = (struct ip_hdr *)((uintptr_t) p->payload + ip_hdr_offset);
       if (IPH_PROTO(iphdr) != IP_PROTO_TCP) {
 	goto xmit; /* IPv4 but not TCP */
       }
-#ifdef CONFIG_NETFRONT_GSO
-      tso = NMNETIF_GSO_TYPE_TCPV4; /* TCPv4 segmentation and checksum offloading */
-#endif /* CONFIG_NETFRONT_GSO */
-#ifdef CONFIG_LWIP_BATCHTX
-      /* push only when FIN, RST, PSH, or URG flag is set */
-      tcphdr = (struct tcp_hdr *)((uintptr_t) p->payload + ip_hdr_offset + (IPH_HL(iphdr) * 4));
-      push = (TCPH_FLAGS(tcphdr) & (TCP_FIN | TCP_RST | TCP_PSH | TCP_URG));
-#endif /* CONFIG_LWIP_BATCHTX */
+      tso = NMNETIF_GSO_TYPE_TCPV4; /* TCPv4 segmentation */
       break;
 
 #if IPV6_SUPPORT
     case PP_HTONS(ETHTYPE_IPV6):
       if (IP6H_NEXTH((struct ip6_hdr *)((uintptr_t) p->payload + ip_hdr_offset)) != IP6_NEXTH_TCP)
 	goto xmit; /* IPv6 but not TCP */
-#ifdef CONFIG_NETFRONT_GSO
-      tso = NMNETIF_GSO_TYPE_TCPV6; /* TCPv6 segmentation and checksum offloading */
-#endif /* CONFIG_NETFRONT_GSO */
-#ifdef CONFIG_LWIP_BATCHTX
-      /* push only when FIN, RST, PSH, or URG flag is set */
-      #error "TSOv6 is not yet supported. Please add it"
-      tcphdr = NULL;
-      push = (TCPH_FLAGS(tcphdr) & (TCP_FIN | TCP_RST | TCP_PSH | TCP_URG));
-#endif /* CONFIG_LWIP_BATCHTX */
+      tso = NMNETIF_GSO_TYPE_TCPV6; /* TCPv6 segmentation */
       break;
 #endif /* IPV6_SUPPORT */
 
     default:
       break; /* non-IP packet */
     }
-#endif /* defined CONFIG_NETFRONT_GSO || defined CONFIG_LWIP_BATCHTX */
+#endif /* TCP_GSO */
 
  xmit:
-#if ETH_PAD_SIZE
-    pbuf_header(p, -ETH_PAD_SIZE); /* drop the padding word */
-#endif
-    err = netmapif_output(nmi, p, tso, push);
+    switch (tso) {
+    case NMNETIF_GSO_TYPE_NONE:
+      err = netmapif_output(nmi, p);
+      break;
+#if TCP_GSO
+    case NMNETIF_GSO_TYPE_TCPV4:
+      err = netmapif_output_tso(nmi, p, ip_hdr_offset, p->gso_size);
+      break;
+#endif /* TCP_GSO */
+    default:
+      LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_transmit: segmentation type %d is not supported\n", tso));
+      err = ERR_IF;
+      break;
+    }
     if (likely(err == ERR_OK)) {
       LINK_STATS_INC(link.xmit);
     } else {
@@ -415,7 +559,6 @@ netmapif_receive(struct netmap_ring *rxring, unsigned int cur, struct pbuf *p)
 	unsigned int len;
 
 	/* copy payload from netmap ring */
-	cur    = rxring->cur;
 	slot   = &rxring->slot[cur];
 	cur    = nm_ring_next(rxring, cur);
 	s_buf  = NETMAP_BUF(rxring, slot->buf_idx);;
@@ -457,9 +600,125 @@ netmapif_receive(struct netmap_ring *rxring, unsigned int cur, struct pbuf *p)
 
 	}
 }
+#ifdef NMNETIF_ZEROCOPY
+/*
+ * Called by lwIP when a zero-copy pbuf is released:
+ * the netmap buffer becomes a spare buffer again
+ */
+static void netmapif_rxpbuf_free(struct pbuf *p)
+{
+  struct netmapif_rxpbuf *rxp = (struct netmapif_rxpbuf *) p;
+  struct netmapif *nmi = rxp->nmi;
+  SYS_ARCH_DECL_PROTECT(old_level);
+
+  SYS_ARCH_PROTECT(old_level);
+  nmi->_spare_bufs[nmi->_nb_spare++] = rxp->buf_idx;
+  rxp->next_free = nmi->_rxpbuf_free;
+  nmi->_rxpbuf_free = rxp;
+  SYS_ARCH_UNPROTECT(old_level);
+}
+
+/*
+ * Swaps the buffer of a received single-slot frame against a spare one
+ * and returns a pbuf that references the received data.
+ * Returns NULL when no spare buffer is left.
+ */
+static inline struct pbuf *
+netmapif_receive_zcopy(struct netmapif *nmi, struct netmap_ring *rxring,
+		       struct netmap_slot *slot)
+{
+  struct netmapif_rxpbuf *rxp;
+  SYS_ARCH_DECL_PROTECT(old_level);
+
+  SYS_ARCH_PROTECT(old_level);
+  if (unlikely(!nmi->_nb_spare)) {
+    SYS_ARCH_UNPROTECT(old_level);
+    return NULL;
+  }
+  rxp = nmi->_rxpbuf_free; /* there is one free rxpbuf per spare buffer */
+  nmi->_rxpbuf_free = rxp->next_free;
+  rxp->buf_idx  = slot->buf_idx;
+  slot->buf_idx = nmi->_spare_bufs[--nmi->_nb_spare];
+  slot->flags  |= NS_BUF_CHANGED;
+  SYS_ARCH_UNPROTECT(old_level);
+
+  return pbuf_alloced_custom(PBUF_RAW, slot->len, PBUF_REF, &rxp->pc,
+			     NETMAP_BUF(rxring, rxp->buf_idx),
+			     (u16_t) rxring->nr_buf_size);
+}
+
+/*
+ * Takes over the extra buffers that netmap allocated on nm_open()
+ * (linked list starting at ni_bufs_head)
+ */
+static void netmapif_zcopy_init(struct netmapif *nmi)
+{
+  struct netmap_ring *ring = NETMAP_RXRING(nmi->_nifp, nmi->dev->first_rx_ring);
+  unsigned int nb_extra = nmi->dev->req.nr_arg3;
+  uint32_t idx;
+  unsigned int i;
+
+  nmi->_nb_extra = 0;
+  nmi->_nb_spare = 0;
+  nmi->_spare_bufs = NULL;
+  nmi->_rxpbufs = NULL;
+  nmi->_rxpbuf_free = NULL;
+  if (!nb_extra)
+    return; /* no spare buffers: frames are copied */
+
+  nmi->_spare_bufs = mem_malloc(nb_extra * sizeof(*nmi->_spare_bufs));
+  nmi->_rxpbufs = mem_malloc(nb_extra * sizeof(*nmi->_rxpbufs));
+  if (!nmi->_spare_bufs || !nmi->_rxpbufs) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_init: %s: could not allocate zero-copy state, frames are copied\n", nmi->ifname));
+    if (nmi->_spare_bufs)
+      mem_free(nmi->_spare_bufs);
+    if (nmi->_rxpbufs)
+      mem_free(nmi->_rxpbufs);
+    nmi->_spare_bufs = NULL;
+    nmi->_rxpbufs = NULL;
+    return;
+  }
+
+  idx = nmi->_nifp->ni_bufs_head;
+  for (i = 0; i < nb_extra && idx != 0; ++i) {
+    nmi->_spare_bufs[i] = idx;
+    idx = *((uint32_t *) NETMAP_BUF(ring, idx));
+
+    nmi->_rxpbufs[i].pc.custom_free_function = netmapif_rxpbuf_free;
+    nmi->_rxpbufs[i].nmi = nmi;
+    nmi->_rxpbufs[i].next_free = nmi->_rxpbuf_free;
+    nmi->_rxpbuf_free = &nmi->_rxpbufs[i];
+  }
+  nmi->_nifp->ni_bufs_head = 0;
+  nmi->_nb_extra = i;
+  nmi->_nb_spare = i;
+  LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_init: %s: %u spare buffers for zero-copy receive\n",
+			    nmi->ifname, nmi->_nb_extra));
+}
+
+/*
+ * Gives the spare buffers back to netmap.
+ * Returns the number of buffers that are still referenced by pbufs.
+ */
+static unsigned int netmapif_zcopy_exit(struct netmapif *nmi)
+{
+  struct netmap_ring *ring = NETMAP_RXRING(nmi->_nifp, nmi->dev->first_rx_ring);
+  uint32_t idx = 0;
+  unsigned int i;
+
+  for (i = 0; i < nmi->_nb_spare; ++i) {
+    *((uint32_t *) NETMAP_BUF(ring, nmi->_spare_bufs[i])) = idx;
+    idx = nmi->_spare_bufs[i];
+  }
+  nmi->_nifp->ni_bufs_head = idx;
+  return nmi->_nb_extra - nmi->_nb_spare;
+}
+#endif /* NMNETIF_ZEROCOPY */
+
 /*
  * Receive packets from netmap ring and send them to
- * netmapif_input()
+ * netmapif_input(). Afterwards, TX slots that were filled
+ * since the last call are pushed out with a single TXSYNC.
  */
 void netmapif_poll(struct netif *netif)
 {
@@ -472,6 +731,7 @@ void netmapif_poll(struct netif *netif)
 
   /* call receive ioctl (TODO: expose filedescriptor to do rx select/poll outside of this function) */
   ioctl(nmi->_fd, NIOCRXSYNC, NULL);
+  ++nmi->_stats.rx_syncs;
 
   /* query all rx queues */
   for (i = nmi->dev->first_rx_ring; i <= nmi->dev->last_rx_ring; ++i) {
@@ -487,17 +747,30 @@ void netmapif_poll(struct netif *netif)
 				netif->name[0], netif->name[1], i,
 				pkg_len, slots));
 
+      p = NULL;
+#ifdef NMNETIF_ZEROCOPY
+      if (likely(slots == 1)) {
+	/* pass the netmap buffer itself to lwIP */
+	p = netmapif_receive_zcopy(nmi, rxring, &rxring->slot[cur]);
+	if (likely(p != NULL))
+	  ++nmi->_stats.rx_zcopy;
+	else
+	  ++nmi->_stats.rx_nospare;
+      }
+      if (!p) {
+#endif /* NMNETIF_ZEROCOPY */
       if (unlikely((pkg_len) > 0xFFFF - ETH_PAD_SIZE))  {
 	LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_poll: %c%c.r%u: "
 				  "could not receive packet: too big!?\n",
 				  netif->name[0], netif->name[1], i));
-	p = NULL;
       } else {
 	p = pbuf_alloc(PBUF_RAW, (u16_t) (pkg_len + ETH_PAD_SIZE), PBUF_POOL);
 	if (unlikely(!p)) {
 	  LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_poll: %c%c.r%u: "
 				    "could not allocate pbuf, dropping packet\n",
 				    netif->name[0], netif->name[1], i));
+	  LINK_STATS_INC(link.memerr);
+	  LINK_STATS_INC(link.drop);
 	} else {
 	  /* copy received data into pbuf */
 #if ETH_PAD_SIZE
@@ -509,12 +782,63 @@ void netmapif_poll(struct netif *netif)
 #endif /* ETH_PAD_SIZE */
 	}
       }
-      netmapif_input(p, netif);
+#ifdef NMNETIF_ZEROCOPY
+      }
+#endif /* NMNETIF_ZEROCOPY */
+      if (likely(p != NULL)) {
+	++nmi->_stats.rx_pkts;
+	LINK_STATS_INC(link.recv);
+	netmapif_input(p, netif);
+      }
       cur = next;
       tot_slots -= slots;
     }
     rxring->head = rxring->cur = cur;
   }
+
+  /* one TXSYNC for everything that was enqueued since the last poll
+   * (including the responses to the packets received above) */
+  if (nmi->_tx_pending)
+    netmapif_txsync(nmi);
+}
+
+/**
+ * Copies the statistics of a netmap netif
+ *
+ * @param netif
+ *  the lwip network interface structure for this netmapif
+ * @return
+ *  0 on success, -1 if netif is not a netmap device
+ */
+int netmapif_get_stats(struct netif *netif, struct netmapif_stats *out)
+{
+    struct netmapif *nmi = netif->state;
+
+    if (netif->linkoutput != netmapif_transmit)
+	return -1;
+    memcpy(out, &nmi->_stats, sizeof(*out));
+    return 0;
+}
+
+/**
+ * Returns the file descriptor of a netmap netif
+ * (readable when frames were received)
+ *
+ * @param netif
+ *  the lwip network interface structure for this netmapif
+ * @return
+ *  number of stored file descriptors, -1 if netif is not a netmap device
+ */
+int netmapif_get_fds(struct netif *netif, int *fds, unsigned int max)
+{
+    struct netmapif *nmi = netif->state;
+
+    if (netif->linkoutput != netmapif_transmit)
+	return -1;
+    if (!max)
+	return 0;
+    fds[0] = nmi->_fd;
+    return 1;
 }
 
 #ifndef CONFIG_LWIP_NOTHREADS
@@ -551,7 +875,16 @@ static void netmapif_thread(void *argp)
 static void netmapif_exit(struct netif *netif)
 {
     struct netmapif *nmi = netif->state;
+#ifdef NMNETIF_ZEROCOPY
+    unsigned int nb_inuse = 0;
+#endif
 
+    if (nmi->_tx_pending)
+	netmapif_txsync(nmi);
+#ifdef NMNETIF_ZEROCOPY
+    if (nmi->_nb_extra)
+	nb_inuse = netmapif_zcopy_exit(nmi);
+#endif
     nm_close(nmi->dev);
 
 #ifndef CONFIG_LWIP_NOTHREADS
@@ -562,6 +895,18 @@ static void netmapif_exit(struct netif *netif)
     LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_exit: thread was shutdown\n"));
 #endif /* CONFIG_LWIP_NOTHREADS */
 
+#ifdef NMNETIF_ZEROCOPY
+    if (nb_inuse) {
+	/* pbufs that are still referencing netmap buffers will call
+	 * netmapif_rxpbuf_free() later: keep the state */
+	LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_exit: %u buffers still in use\n", nb_inuse));
+	return;
+    }
+    if (nmi->_spare_bufs)
+	mem_free(nmi->_spare_bufs);
+    if (nmi->_rxpbufs)
+	mem_free(nmi->_rxpbufs);
+#endif
     if (nmi->_state_is_private) {
 	mem_free(nmi);
 	netif->state = NULL;
@@ -648,6 +993,7 @@ _sys_gen_hwaddr(struct eth_addr *out)
 err_t netmapif_init(struct netif *netif)
 {
     struct netmapif *nmi;
+    struct nmreq req;
     static uint8_t netmapif_id = 0;
 
     LWIP_ASSERT("netif != NULL", (netif != NULL));
@@ -678,8 +1024,13 @@ err_t netmapif_init(struct netif *netif)
 	  snprintf(nmi->ifname, sizeof(nmi->ifname), "netmap:eth2/x");
 	}
 
-	/* use nmi->ifname to open a specific NIC interface */
-	nmi->dev = nm_open(nmi->ifname, NULL, 0 , NULL);
+	/* use nmi->ifname to open a specific NIC interface,
+	 * request spare buffers for zero-copy receive */
+	memset(&req, 0, sizeof(req));
+#ifdef NMNETIF_ZEROCOPY
+	req.nr_arg3 = CONFIG_NETMAP_EXTRA_BUFS;
+#endif
+	nmi->dev = nm_open(nmi->ifname, &req, 0 , NULL);
 	if (!nmi->dev) {
 	    LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_init: "
 				      "Could not open %s\n", nmi->ifname));
@@ -701,6 +1052,14 @@ err_t netmapif_init(struct netif *netif)
 			      nmi->dev->first_rx_ring, nmi->dev->last_rx_ring));
     nmi->_txring = NETMAP_TXRING(nmi->_nifp, nmi->dev->first_tx_ring);
     LWIP_DEBUGF(NETIF_DEBUG, ("netmapif_init: %s: use tx ring %u\n", nmi->ifname, nmi->dev->first_tx_ring));
+    nmi->_tx_pending = 0;
+    memset(&nmi->_stats, 0, sizeof(nmi->_stats));
+#ifdef NMNETIF_ZEROCOPY
+    netmapif_zcopy_init(nmi);
+#else
+    nmi->_nb_extra = 0;
+    nmi->_nb_spare = 0;
+#endif
 
     /* Interface identifier */
     netif->name[0] = NMNETIF_NPREFIX;
@@ -33,13 +33,16 @@
 #include "netif/tapif.h"
 
 #include <fcntl.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <sys/socket.h>
+#include <sys/select.h>
 
 
 #include "lwip/debug.h"
@@ -50,6 +53,9 @@
 #include "lwip/mem.h"
 #include "lwip/pbuf.h"
 #include "lwip/sys.h"
+#include "lwip/stats.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/tcp_impl.h"
 
 #include "netif/etharp.h"
 #include "lwip/ethip6.h"
@@ -64,17 +70,21 @@
 #include <sys/ioctl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 #define DEVTAP "/dev/net/tun"
+#define DEVNAME "tap0" /* overwritten by the name that the kernel assigns */
 #define NETMASK_ARGS "netmask %d.%d.%d.%d"
-#define IFCONFIG_ARGS "tap0 inet %d.%d.%d.%d " NETMASK_ARGS
+#define IFCONFIG_ARGS "%s inet %d.%d.%d.%d " NETMASK_ARGS
 #elif defined(openbsd)
 #define DEVTAP "/dev/tun0"
+#define DEVNAME "tun0"
 #define NETMASK_ARGS "netmask %d.%d.%d.%d"
-#define IFCONFIG_ARGS "tun0 inet %d.%d.%d.%d " NETMASK_ARGS " link0"
+#define IFCONFIG_ARGS "%s inet %d.%d.%d.%d " NETMASK_ARGS " link0"
 #else /* others */
 #define DEVTAP "/dev/tap0"
+#define DEVNAME "tap0"
 #define NETMASK_ARGS "netmask %d.%d.%d.%d"
-#define IFCONFIG_ARGS "tap0 inet %d.%d.%d.%d " NETMASK_ARGS
+#define IFCONFIG_ARGS "%s inet %d.%d.%d.%d " NETMASK_ARGS
 #endif
 
 #define IFNAME0 't'
@@ -84,14 +94,53 @@
 #define TAPIF_DEBUG LWIP_DBG_OFF
 #endif
 
+/*
+ * virtio-net headers (Linux only):
+ *  TX: TCP checksums are completed by the kernel when lwIP does not
+ *      generate them (CONFIG_LWIP_CHECKSUM_NOGEN)
+ *  RX: the kernel may hand over merged (GRO) frames with partial
+ *      checksums, we only accept them when lwIP does not check checksums
+ *      (CONFIG_LWIP_CHECKSUM_NOCHECK)
+ */
+#if defined(linux) && defined(CONFIG_TAPIF_VNET_HDR)
+#define TAPIF_VNET 1
+#else
+#define TAPIF_VNET 0
+#endif
+#if TAPIF_VNET && !CHECKSUM_CHECK_TCP && !CHECKSUM_CHECK_UDP
+#define TAPIF_RX_OFFLOAD 1
+#else
+#define TAPIF_RX_OFFLOAD 0
+#endif
+
+#define TAPIF_IFNAMSIZ   16
+#define TAPIF_MAXIOV     64 /* max. number of pbufs per frame before linearizing */
+#define TAPIF_MAXFRAME   0xFFFF /* largest frame that fits into a pbuf chain */
+
+struct tapif;
+
+struct tapif_queue {
+  struct netif *netif;
+  int fd;
+};
+
 struct tapif {
   struct eth_addr *ethaddr;
   /* Add whatever per-interface state that is needed here. */
-  int fd;
+  struct tapif_queue q[CONFIG_TAPIF_NUM_QUEUES];
+  unsigned int rxq; /* queue that is drained first on next poll */
+  u16_t rx_len;     /* frame length that is received directly into pbufs */
+  char ifname[TAPIF_IFNAMSIZ];
+  struct tapif_stats stats;
+
+  u8_t tx_buf[TAPIF_MAXFRAME]; /* linearizes highly fragmented pbuf chains */
+#if TAPIF_RX_OFFLOAD
+  u8_t rx_buf[TAPIF_MAXFRAME]; /* receives the tail of merged frames */
+#endif
 };
 
 /* Forward declarations. */
-static void  tapif_input(struct netif *netif);
+static void  tapif_input(struct netif *netif, struct pbuf *p);
 
 #ifndef CONFIG_LWIP_NOTHREADS
 static void tapif_thread(void *data);
@@ -102,7 +151,9 @@ static void
 low_level_init(struct netif *netif)
 {
   struct tapif *tapif;
-  char buf[sizeof(IFCONFIG_ARGS) + sizeof(IFCONFIG_BIN) + 50];
+  char buf[sizeof(IFCONFIG_ARGS) + sizeof(IFCONFIG_BIN) + TAPIF_IFNAMSIZ + 50];
+  unsigned int i;
+  int fd;
 
   tapif = (struct tapif *)netif->state;
 
@@ -117,32 +168,72 @@ low_level_init(struct netif *netif)
   tapif->ethaddr->addr[5] = 0xab;
 
   /* Do whatever else is needed to initialize interface. */
-
-  tapif->fd = open(DEVTAP, O_RDWR);
-  LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_init: fd %d\n", tapif->fd));
-  if(tapif->fd == -1) {
+  strncpy(tapif->ifname, DEVNAME, TAPIF_IFNAMSIZ - 1);
+  tapif->ifname[TAPIF_IFNAMSIZ - 1] = '\0';
+  tapif->rxq = 0;
+  tapif->rx_len = netif->mtu + SIZEOF_ETH_HDR;
+  memset(&tapif->stats, 0, sizeof(tapif->stats));
+
+  /* open one file descriptor per queue, the first one creates the device */
+  for (i = 0; i < CONFIG_TAPIF_NUM_QUEUES; ++i) {
+    fd = open(DEVTAP, O_RDWR);
+    LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_init: queue %u: fd %d\n", i, fd));
+    if(fd == -1) {
 #ifdef linux
-    perror("tapif_init: try running \"modprobe tun\" or rebuilding your kernel with CONFIG_TUN; cannot open "DEVTAP);
+      perror("tapif_init: try running \"modprobe tun\" or rebuilding your kernel with CONFIG_TUN; cannot open "DEVTAP);
 #else
-    perror("tapif_init: cannot open "DEVTAP);
+      perror("tapif_init: cannot open "DEVTAP);
 #endif
-    exit(1);
-  }
+      exit(1);
+    }
 
 #ifdef linux
-  {
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
-    if (ioctl(tapif->fd, TUNSETIFF, (void *) &ifr) < 0) {
-      perror("tapif_init: "DEVTAP" ioctl TUNSETIFF");
+    {
+      struct ifreq ifr;
+      memset(&ifr, 0, sizeof(ifr));
+      ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
+#if TAPIF_VNET
+      ifr.ifr_flags |= IFF_VNET_HDR;
+#endif
+#if CONFIG_TAPIF_NUM_QUEUES > 1
+      ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif
+      if (i > 0)
+        strncpy(ifr.ifr_name, tapif->ifname, IFNAMSIZ - 1); /* attach further queues */
+      if (ioctl(fd, TUNSETIFF, (void *) &ifr) < 0) {
+        perror("tapif_init: "DEVTAP" ioctl TUNSETIFF");
+        exit(1);
+      }
+      if (i == 0) {
+        strncpy(tapif->ifname, ifr.ifr_name, TAPIF_IFNAMSIZ - 1);
+        tapif->ifname[TAPIF_IFNAMSIZ - 1] = '\0';
+      }
+    }
+#if TAPIF_VNET
+    /* offloads that the kernel may use for frames it passes to us */
+    if (ioctl(fd, TUNSETOFFLOAD,
+#if TAPIF_RX_OFFLOAD
+              (unsigned long) (TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6)
+#else
+              (unsigned long) 0
+#endif
+              ) < 0)
+      perror("tapif_init: "DEVTAP" ioctl TUNSETOFFLOAD");
+#endif /* TAPIF_VNET */
+#endif /* Linux */
+
+    /* frames are drained in batches until the queue is empty */
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+      perror("tapif_init: fcntl O_NONBLOCK");
       exit(1);
     }
+    tapif->q[i].netif = netif;
+    tapif->q[i].fd = fd;
   }
-#endif /* Linux */
   netif_set_link_up(netif);
 
   sprintf(buf, IFCONFIG_BIN IFCONFIG_ARGS,
+           tapif->ifname,
            ip4_addr1(&(netif->gw)),
            ip4_addr2(&(netif->gw)),
            ip4_addr3(&(netif->gw)),
@@ -159,10 +250,97 @@ low_level_init(struct netif *netif)
   LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_init: system(\"%s\");\n", buf));
   system(buf);
 #ifndef CONFIG_LWIP_NOTHREADS
-  sys_thread_new("tapif_thread", tapif_thread, netif, DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  for (i = 0; i < CONFIG_TAPIF_NUM_QUEUES; ++i)
+    sys_thread_new("tapif_thread", tapif_thread, &tapif->q[i], DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
 #endif
 
 }
+/*-----------------------------------------------------------------------------------*/
+#if TAPIF_VNET
+/* sum over the TCP pseudo header (not complemented): this is what
+ * the kernel expects in the checksum field for partial checksums */
+static inline u16_t
+tapif_tcp_pseudo_sum(const struct ip_hdr *iphdr, u16_t iphlen)
+{
+  u32_t sum;
+
+  sum  = (iphdr->src.addr & 0xffff) + (iphdr->src.addr >> 16);
+  sum += (iphdr->dest.addr & 0xffff) + (iphdr->dest.addr >> 16);
+  sum += PP_HTONS(IP_PROTO_TCP);
+  sum += htons(ntohs(IPH_LEN(iphdr)) - iphlen);
+  sum  = (sum & 0xffff) + (sum >> 16);
+  sum  = (sum & 0xffff) + (sum >> 16);
+  return (u16_t) sum;
+}
+#endif
+
+/*
+ * Completes offloaded checksums, fills in the virtio-net header
+ * and selects the TX queue by hashing the flow.
+ * NOTE: We assume here that all protocol headers are in the first pbuf of a pbuf chain!
+ */
+static unsigned int
+tapif_tx_prepare(struct tapif *tapif, struct pbuf *p
+#if TAPIF_VNET
+                 , struct virtio_net_hdr *vh
+#endif
+                 )
+{
+  struct eth_hdr *ethhdr = (struct eth_hdr *)p->payload;
+  struct ip_hdr *iphdr;
+  struct tcp_hdr *tcphdr;
+  u16_t iphlen;
+  u32_t hash;
+
+#if TAPIF_VNET
+  memset(vh, 0, sizeof(*vh));
+  vh->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+#endif
+
+  if (ethhdr->type != PP_HTONS(ETHTYPE_IP) ||
+      p->len < SIZEOF_ETH_HDR + IP_HLEN)
+    return 0; /* non-IPv4 packet */
+
+  iphdr = (struct ip_hdr *)((u8_t *)p->payload + SIZEOF_ETH_HDR);
+  iphlen = IPH_HL(iphdr) * 4;
+#if !CHECKSUM_GEN_IP
+  /* the kernel does not fix IP header checksums: generate it here */
+  IPH_CHKSUM_SET(iphdr, 0);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, iphlen));
+#endif
+  hash = iphdr->src.addr ^ iphdr->dest.addr;
+  if (IPH_PROTO(iphdr) != IP_PROTO_TCP ||
+      p->len < SIZEOF_ETH_HDR + iphlen + TCP_HLEN)
+    goto out; /* IPv4 but not TCP */
+
+  tcphdr = (struct tcp_hdr *)((u8_t *)iphdr + iphlen);
+  hash ^= ((u32_t)tcphdr->src << 16) | tcphdr->dest;
+#if TAPIF_VNET
+#if TCP_GSO
+  if (p->tot_len > tapif->rx_len) {
+    /* super-segment: the kernel segments it by gso_size */
+    vh->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+    vh->hdr_len = SIZEOF_ETH_HDR + iphlen + TCPH_HDRLEN(tcphdr) * 4;
+    vh->gso_size = p->gso_size ? p->gso_size : (tapif->rx_len - vh->hdr_len);
+    ++tapif->stats.tx_gso;
+  }
+#endif
+  /* segments always get their checksum from the kernel,
+   * computed from the pseudo header sum of the super-segment */
+  if (!CHECKSUM_GEN_TCP || vh->gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+    vh->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vh->csum_start = SIZEOF_ETH_HDR + iphlen;
+    vh->csum_offset = offsetof(struct tcp_hdr, chksum);
+    tcphdr->chksum = tapif_tcp_pseudo_sum(iphdr, iphlen);
+    ++tapif->stats.tx_csum;
+  }
+#endif
+
+ out:
+  hash ^= hash >> 16;
+  return hash % CONFIG_TAPIF_NUM_QUEUES;
+}
+
 /*-----------------------------------------------------------------------------------*/
 /*
  * low_level_output():
@@ -170,6 +348,8 @@ low_level_init(struct netif *netif)
  * Should do the actual transmission of the packet. The packet is
  * contained in the pbuf that is passed to the function. This pbuf
  * might be chained.
+ * The pbuf chain is handed over to the kernel with a single writev(),
+ * only chains with more than TAPIF_MAXIOV pbufs get linearized first.
  *
  */
 /*-----------------------------------------------------------------------------------*/
@@ -177,35 +357,53 @@ low_level_init(struct netif *netif)
 static err_t
 low_level_output(struct netif *netif, struct pbuf *p)
 {
-  struct pbuf *q;
-  char buf[1514];
-  char *bufptr;
   struct tapif *tapif;
+  struct iovec iov[TAPIF_MAXIOV + 1];
+#if TAPIF_VNET
+  struct virtio_net_hdr vh;
+#endif
+  struct pbuf *q;
+  unsigned int iovcnt = 0;
+  unsigned int qidx;
 
   tapif = (struct tapif *)netif->state;
-#if 0
-    if(((double)rand()/(double)RAND_MAX) < 0.2) {
-    printf("drop output\n");
-    return ERR_OK;
-    }
-#endif
-  /* initiate transfer(); */
 
-  bufptr = &buf[0];
+#if TAPIF_VNET
+  qidx = tapif_tx_prepare(tapif, p, &vh);
+  iov[iovcnt].iov_base = &vh;
+  iov[iovcnt].iov_len = sizeof(vh);
+  ++iovcnt;
+#else
+  qidx = tapif_tx_prepare(tapif, p);
+#endif
 
   for(q = p; q != NULL; q = q->next) {
-    /* Send the data from the pbuf to the interface, one pbuf at a
-       time. The size of the data in each pbuf is kept in the ->len
-       variable. */
-    /* send data from(q->payload, q->len); */
-    memcpy(bufptr, q->payload, q->len);
-    bufptr += q->len;
+    if (iovcnt == TAPIF_MAXIOV + 1) {
+      /* too many fragments: send a linear copy instead */
+      iovcnt = TAPIF_VNET;
+      pbuf_copy_partial(p, tapif->tx_buf, p->tot_len, 0);
+      iov[iovcnt].iov_base = tapif->tx_buf;
+      iov[iovcnt].iov_len = p->tot_len;
+      ++iovcnt;
+      ++tapif->stats.tx_linear;
+      break;
+    }
+    iov[iovcnt].iov_base = q->payload;
+    iov[iovcnt].iov_len = q->len;
+    ++iovcnt;
   }
 
   /* signal that packet should be sent(); */
-  if(write(tapif->fd, buf, p->tot_len) == -1) {
-    perror("tapif: write");
+  if(writev(tapif->q[qidx].fd, iov, iovcnt) == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      perror("tapif: write");
+    ++tapif->stats.tx_drop;
+    LINK_STATS_INC(link.drop);
+    return ERR_IF;
   }
+  ++tapif->stats.tx_pkts;
+  tapif->stats.tx_bytes += p->tot_len;
+  LINK_STATS_INC(link.xmit);
   return ERR_OK;
 }
 /*-----------------------------------------------------------------------------------*/
@@ -214,70 +412,132 @@ low_level_output(struct netif *netif, struct pbuf *p)
  *
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
+ * The frame is read directly into a pbuf chain of the pool. Merged
+ * frames that exceed the MTU are completed from rx_buf.
+ * *more is set to 0 when the queue is drained or when we ran out
+ * of pbufs.
  *
  */
 /*-----------------------------------------------------------------------------------*/
 static struct pbuf *
-low_level_input(struct tapif *tapif)
+low_level_input(struct tapif *tapif, int fd, int *more)
 {
+  struct iovec iov[TAPIF_MAXIOV + 2];
+#if TAPIF_VNET
+  struct virtio_net_hdr vh;
+#endif
   struct pbuf *p, *q;
-  u16_t len;
-  char buf[1514];
-  char *bufptr;
-
-  /* Obtain the size of the packet and put it into the "len"
-     variable. */
-  len = read(tapif->fd, buf, sizeof(buf));
-#if 0
-    if(((double)rand()/(double)RAND_MAX) < 0.2) {
-    printf("drop\n");
+  unsigned int iovcnt = 0;
+  ssize_t len;
+
+  *more = 0;
+
+  /* We allocate a pbuf chain of pbufs from the pool. */
+  p = pbuf_alloc(PBUF_RAW, tapif->rx_len, PBUF_POOL);
+  if (p == NULL) {
+    /* leave the frames queued in the kernel, retry on next poll */
+    ++tapif->stats.rx_nomem;
+    LINK_STATS_INC(link.memerr);
     return NULL;
-    }
+  }
+
+#if TAPIF_VNET
+  iov[iovcnt].iov_base = &vh;
+  iov[iovcnt].iov_len = sizeof(vh);
+  ++iovcnt;
+#endif
+  for(q = p; q != NULL && iovcnt < TAPIF_MAXIOV; q = q->next) {
+    iov[iovcnt].iov_base = q->payload;
+    iov[iovcnt].iov_len = q->len;
+    ++iovcnt;
+  }
+#if TAPIF_RX_OFFLOAD
+  iov[iovcnt].iov_base = tapif->rx_buf;
+  iov[iovcnt].iov_len = TAPIF_MAXFRAME - tapif->rx_len;
+  ++iovcnt;
 #endif
 
-  /* We allocate a pbuf chain of pbufs from the pool. */
-  p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-
-  if(p != NULL) {
-    /* We iterate over the pbuf chain until we have read the entire
-       packet into the pbuf. */
-    bufptr = &buf[0];
-    for(q = p; q != NULL; q = q->next) {
-      /* Read enough bytes to fill this pbuf in the chain. The
-         available data in the pbuf is given by the q->len
-         variable. */
-      /* read data into(q->payload, q->len); */
-      memcpy(q->payload, bufptr, q->len);
-      bufptr += q->len;
+  len = readv(fd, iov, iovcnt);
+  if (len <= 0) {
+    if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      perror("tapif: read");
+    pbuf_free(p);
+    return NULL; /* queue is drained */
+  }
+  *more = 1;
+#if TAPIF_VNET
+  len -= sizeof(vh);
+  if (len <= 0) {
+    pbuf_free(p);
+    return NULL;
+  }
+#endif
+
+  if (len <= tapif->rx_len) {
+    pbuf_realloc(p, (u16_t)len);
+  }
+#if TAPIF_RX_OFFLOAD
+  else {
+    /* merged frame: append its tail */
+    q = pbuf_alloc(PBUF_RAW, (u16_t)(len - tapif->rx_len), PBUF_POOL);
+    if (q == NULL) {
+      pbuf_free(p);
+      *more = 0;
+      ++tapif->stats.rx_nomem;
+      LINK_STATS_INC(link.memerr);
+      LINK_STATS_INC(link.drop);
+      return NULL;
     }
-    /* acknowledge that packet has been read(); */
-  } else {
-    /* drop packet(); */
+    pbuf_take(q, tapif->rx_buf, q->tot_len);
+    pbuf_cat(p, q);
+    ++tapif->stats.rx_gro;
   }
+#endif
 
+  ++tapif->stats.rx_pkts;
+  tapif->stats.rx_bytes += len;
+  LINK_STATS_INC(link.recv);
   return p;
 }
 /*-----------------------------------------------------------------------------------*/
-static inline void
-_tapif_poll(struct netif *netif, struct timeval *timeout)
+/* drains up to CONFIG_TAPIF_RX_BATCH frames from a queue */
+static inline unsigned int
+_tapif_drain(struct tapif_queue *tq)
 {
-  struct tapif *tapif = (struct tapif *)netif->state;
-  fd_set fdset;
-
-  FD_ZERO(&fdset);
-  FD_SET(tapif->fd, &fdset);
+  struct tapif *tapif = (struct tapif *)tq->netif->state;
+  struct pbuf *p;
+  unsigned int i, n = 0;
+  int more = 1;
+
+  for (i = 0; i < CONFIG_TAPIF_RX_BATCH && more; ++i) {
+    p = low_level_input(tapif, tq->fd, &more);
+    if (p != NULL) {
+      tapif_input(tq->netif, p);
+      ++n;
+    }
+  }
 
-  /* Wait for a packet to arrive and handle it */
-  if (select(tapif->fd + 1, &fdset, NULL, NULL, timeout))
-    tapif_input(netif);
+  ++tapif->stats.polls;
+  if (n)
+    ++tapif->stats.busy_polls;
+  return n;
 }
 
 #ifdef CONFIG_LWIP_NOTHREADS
 void
 tapif_poll(struct netif *netif)
 {
-  struct timeval zero = { 0, 0 }; /* do not block */
-  _tapif_poll(netif, &zero);
+  struct tapif *tapif = (struct tapif *)netif->state;
+  unsigned int i, q;
+
+  /* do not block: each queue is drained until it is empty
+   * or the batch limit is reached */
+  q = tapif->rxq;
+  for (i = 0; i < CONFIG_TAPIF_NUM_QUEUES; ++i) {
+    _tapif_drain(&tapif->q[q]);
+    q = (q + 1) % CONFIG_TAPIF_NUM_QUEUES;
+  }
+  tapif->rxq = (tapif->rxq + 1) % CONFIG_TAPIF_NUM_QUEUES; /* fairness */
 }
 
 #else
@@ -285,10 +545,16 @@ tapif_poll(struct netif *netif)
 static void
 tapif_thread(void *arg)
 {
-  struct netif *netif = (struct netif *)arg;
+  struct tapif_queue *tq = (struct tapif_queue *)arg;
+  fd_set fdset;
 
   while(1) {
-    _tapif_poll(netif, NULL);
+    FD_ZERO(&fdset);
+    FD_SET(tq->fd, &fdset);
+
+    /* Wait for packets to arrive and handle them */
+    if (select(tq->fd + 1, &fdset, NULL, NULL, NULL) > 0)
+      _tapif_drain(tq);
   }
 }
 #endif
@@ -297,29 +563,17 @@ tapif_thread(void *arg)
 /*
  * tapif_input():
  *
- * This function should be called when a packet is ready to be read
- * from the interface. It uses the function low_level_input() that
- * should handle the actual reception of bytes from the network
- * interface.
+ * This function should be called when a packet was received
+ * from the interface (see low_level_input()). It passes the
+ * packet to the lwIP stack.
  *
  */
 /*-----------------------------------------------------------------------------------*/
 static void
-tapif_input(struct netif *netif)
+tapif_input(struct netif *netif, struct pbuf *p)
 {
-  struct tapif *tapif;
   struct eth_hdr *ethhdr;
-  struct pbuf *p;
-
 
-  tapif = (struct tapif *)netif->state;
-
-  p = low_level_input(tapif);
-
-  if(p == NULL) {
-    LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_input: low_level_input returned NULL\n"));
-    return;
-  }
   ethhdr = (struct eth_hdr *)p->payload;
 
   switch(htons(ethhdr->type)) {
@@ -347,6 +601,28 @@ tapif_input(struct netif *netif)
   }
 }
 /*-----------------------------------------------------------------------------------*/
+int
+tapif_get_stats(struct netif *netif, struct tapif_stats *out)
+{
+  if (netif->linkoutput != low_level_output)
+    return -1;
+  memcpy(out, &((struct tapif *)netif->state)->stats, sizeof(*out));
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+tapif_get_fds(struct netif *netif, int *fds, unsigned int max)
+{
+  struct tapif *tapif = (struct tapif *)netif->state;
+  unsigned int i;
+
+  if (netif->linkoutput != low_level_output)
+    return -1;
+  for (i = 0; i < CONFIG_TAPIF_NUM_QUEUES && i < max; ++i)
+    fds[i] = tapif->q[i].fd;
+  return (int) i;
+}
+/*-----------------------------------------------------------------------------------*/
 /*
  * tapif_init():
  *
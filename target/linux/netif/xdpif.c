@@ -0,0 +1,696 @@
+/*
+ * AF_XDP networking glue for lwIP
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ *
+ *
+ * AF_XDP sockets exchange frames with the kernel through a UMEM area that
+ * is mapped into this process. Received frames are handed to lwIP by
+ * reference (custom pbufs that point into the UMEM), frames to transmit
+ * are copied into free UMEM frames. The XDP program that redirects the
+ * traffic of the selected queue to the socket is loaded by libxdp.
+ * Zero-copy mode is used when the driver supports it, otherwise (e.g., veth)
+ * the socket is bound in copy mode.
+ */
+
+#include <netif/xdpif.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+#include "likely.h"
+#include "lwip/def.h"
+#include "lwip/mem.h"
+#include "lwip/pbuf.h"
+#include <lwip/stats.h>
+#include <lwip/snmp.h>
+
+#ifndef CONFIG_LWIP_NOTHREADS
+#error "xdpif requires a non-threaded lwIP (CONFIG_LWIP_NOTHREADS)"
+#endif
+
+#define XDPIF_NPREFIX 'x'
+#define XDPIF_SPEED 0ul     /* 0 for unknown */
+#define XDPIF_MTU 1500
+
+#define XDPIF_FRAME_SHIFT 11
+#define XDPIF_FRAME_SIZE  (1 << XDPIF_FRAME_SHIFT) /* smallest frame size that AF_XDP accepts */
+
+/* frames that are kept back from the fill ring for transmission */
+#define XDPIF_TX_RESERVE (CONFIG_XDPIF_RING_SIZE / 2)
+/* max. number of frames that may be referenced by received pbufs,
+ * the remaining ones are needed to keep the fill/RX and TX rings busy */
+#define XDPIF_RX_MAXREF (CONFIG_XDPIF_NUM_FRAMES - (2 * CONFIG_XDPIF_RING_SIZE) - XDPIF_TX_RESERVE)
+
+#if (CONFIG_XDPIF_RING_SIZE & (CONFIG_XDPIF_RING_SIZE - 1))
+#error "CONFIG_XDPIF_RING_SIZE has to be a power of 2"
+#endif
+#if LWIP_SUPPORT_CUSTOM_PBUF && !ETH_PAD_SIZE && (XDPIF_RX_MAXREF > 0)
+#define XDPIF_RXREF
+#endif
+
+#ifndef min
+#define min(a, b)						\
+    ({ __typeof__ (a) __a = (a);				\
+       __typeof__ (b) __b = (b);				\
+       __a < __b ? __a : __b; })
+#endif
+
+#define xdpif_frame_base(addr) ((addr) & ~((uint64_t) XDPIF_FRAME_SIZE - 1))
+#define xdpif_frame_idx(addr)  ((unsigned int) ((addr) >> XDPIF_FRAME_SHIFT))
+
+struct xdpif_rxpbuf {
+  struct pbuf_custom pc; /* has to be the first field */
+  struct xdpif *xi;
+  uint64_t addr;
+};
+
+static int _sys_get_hwaddr(const char *ifname, struct eth_addr *out);
+static void _sys_gen_hwaddr(struct eth_addr *out);
+#if LWIP_NETIF_REMOVE_CALLBACK
+static void xdpif_exit(struct netif *netif);
+#endif
+
+/*
+ * UMEM frame allocator (stack of free frame addresses)
+ */
+static inline uint64_t xdpif_frame_alloc(struct xdpif *xi)
+{
+  return xi->_frames[--xi->_nb_free];
+}
+
+static inline void xdpif_frame_free(struct xdpif *xi, uint64_t addr)
+{
+  xi->_frames[xi->_nb_free++] = xdpif_frame_base(addr);
+}
+
+/*
+ * Reclaims the frames of completed transmissions
+ */
+static void xdpif_complete(struct xdpif *xi)
+{
+  unsigned int n, i;
+  uint32_t idx;
+
+  n = xsk_ring_cons__peek(&xi->_cq, CONFIG_XDPIF_RING_SIZE, &idx);
+  if (!n)
+    return;
+  for (i = 0; i < n; ++i)
+    xdpif_frame_free(xi, *xsk_ring_cons__comp_addr(&xi->_cq, idx + i));
+  xsk_ring_cons__release(&xi->_cq, n);
+}
+
+/*
+ * Hands free frames to the kernel for reception
+ */
+static void xdpif_refill(struct xdpif *xi)
+{
+  unsigned int n, i;
+  uint32_t idx;
+
+  if (xi->_nb_free <= XDPIF_TX_RESERVE)
+    return;
+  n = xsk_prod_nb_free(&xi->_fq, xi->_nb_free - XDPIF_TX_RESERVE);
+  n = min(n, xi->_nb_free - XDPIF_TX_RESERVE);
+  if (n)
+    n = xsk_ring_prod__reserve(&xi->_fq, n, &idx);
+  if (n) {
+    for (i = 0; i < n; ++i)
+      *xsk_ring_prod__fill_addr(&xi->_fq, idx + i) = xdpif_frame_alloc(xi);
+    xsk_ring_prod__submit(&xi->_fq, n);
+  }
+
+  if (xsk_ring_prod__needs_wakeup(&xi->_fq)) {
+    recvfrom(xi->_fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    ++xi->_stats.rx_wakeups;
+  }
+}
+
+/*
+ * Starts transmission of all submitted TX descriptors.
+ * Errors (EAGAIN, EBUSY, ENOBUFS) are transient: the descriptors
+ * stay on the ring and are picked up by the next kick.
+ */
+static inline void xdpif_kick(struct xdpif *xi)
+{
+  if (xsk_ring_prod__needs_wakeup(&xi->_tx)) {
+    sendto(xi->_fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    ++xi->_stats.tx_kicks;
+  }
+  xi->_tx_pending = 0;
+}
+
+/**
+ * This function does the actual transmission of a packet. The packet is
+ * contained in the pbuf that is passed to the function. This pbuf
+ * can be chained. It is copied into a single UMEM frame.
+ *
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ * @param p
+ *  the packet to send (e.g. IP packet including MAC addresses and type)
+ * @return
+ *  ERR_OK when the packet could be sent; an err_t value otherwise
+ */
+static err_t xdpif_transmit(struct netif *netif, struct pbuf *p)
+{
+  struct xdpif *xi = netif->state;
+  struct xdp_desc *desc;
+  uint64_t addr;
+  uint32_t idx;
+  u16_t len = p->tot_len - ETH_PAD_SIZE;
+
+  LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_transmit: %c%c: "
+			    "Transmitting %u bytes\n",
+			    netif->name[0], netif->name[1],
+			    len));
+
+  if (unlikely(len > XDPIF_FRAME_SIZE)) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_transmit: frame too big, dropping packet\n"));
+    goto err_drop;
+  }
+
+  /* do we have a free frame and a TX descriptor? */
+  if (unlikely(!xi->_nb_free || xsk_ring_prod__reserve(&xi->_tx, 1, &idx) != 1)) {
+    /* push out pending descriptors and reclaim completed frames */
+    ++xi->_stats.tx_full;
+    xdpif_kick(xi);
+    xdpif_complete(xi);
+    if (unlikely(!xi->_nb_free || xsk_ring_prod__reserve(&xi->_tx, 1, &idx) != 1)) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_transmit: no TX frame left, dropping packet\n"));
+      goto err_drop;
+    }
+  }
+
+  addr = xdpif_frame_alloc(xi);
+  pbuf_copy_partial(p, xsk_umem__get_data(xi->_umem_area, addr), len, ETH_PAD_SIZE);
+  desc = xsk_ring_prod__tx_desc(&xi->_tx, idx);
+  desc->addr = addr;
+  desc->len  = len;
+  xsk_ring_prod__submit(&xi->_tx, 1);
+
+  /* the kernel is kicked once per poll (see xdpif_poll()) */
+  ++xi->_tx_pending;
+  ++xi->_stats.tx_pkts;
+  LINK_STATS_INC(link.xmit);
+  return ERR_OK;
+
+ err_drop:
+  ++xi->_stats.tx_drop;
+  LINK_STATS_INC(link.drop);
+  return ERR_MEM;
+}
+
+/**
+ * Passes a pbuf to the lwIP stack for further processing.
+ * The packet type is determined and checked before passing.
+ *
+ * @param p
+ *  the pointer to received packet data
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ */
+static inline void xdpif_input(struct pbuf *p, struct netif *netif)
+{
+  struct eth_hdr *ethhdr;
+  err_t err;
+
+  LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_input: %c%c: "
+			    "Received %u bytes\n",
+			    netif->name[0], netif->name[1],
+			    p->tot_len));
+
+  ethhdr = p->payload;
+  switch (ethhdr->type) {
+  /* IP or ARP packet? */
+  case PP_HTONS(ETHTYPE_IP):
+#if LWIP_IPV6
+  case PP_HTONS(ETHTYPE_IPV6):
+#endif
+  case PP_HTONS(ETHTYPE_ARP):
+#if PPPOE_SUPPORT
+  case PP_HTONS(ETHTYPE_PPPOEDISC):
+  case PP_HTONS(ETHTYPE_PPPOE):
+#endif
+    err = netif->input(p, netif);
+    if (unlikely(err != ERR_OK)) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_input: %c%c: ERROR %d: "
+				"Packet dropped\n",
+				netif->name[0], netif->name[1], err));
+      pbuf_free(p);
+    }
+    break;
+
+  default:
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_input: %c%c: ERROR: "
+			      "Dropped packet with unknown type 0x%04x\n",
+			      netif->name[0], netif->name[1],
+			      htons(ethhdr->type)));
+    pbuf_free(p);
+    break;
+  }
+}
+
+#ifdef XDPIF_RXREF
+/*
+ * Called by lwIP when a pbuf that references a UMEM frame is released:
+ * the frame becomes free again
+ */
+static void xdpif_rxpbuf_free(struct pbuf *p)
+{
+  struct xdpif_rxpbuf *rxp = (struct xdpif_rxpbuf *) p;
+  struct xdpif *xi = rxp->xi;
+
+  xdpif_frame_free(xi, rxp->addr);
+  --xi->_nb_rxref;
+}
+#endif /* XDPIF_RXREF */
+
+/*
+ * Copies a received frame into a pbuf of the pool
+ */
+static inline struct pbuf *xdpif_receive_copy(const void *data, u16_t len)
+{
+  struct pbuf *p;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t) (len + ETH_PAD_SIZE), PBUF_POOL);
+  if (unlikely(!p))
+    return NULL;
+#if ETH_PAD_SIZE
+  pbuf_header(p, -ETH_PAD_SIZE); /* drop the padding word */
+#endif
+  pbuf_take(p, data, len);
+#if ETH_PAD_SIZE
+  pbuf_header(p, ETH_PAD_SIZE); /* reclaim the padding word */
+#endif
+  return p;
+}
+
+/*
+ * Reclaims completed TX frames, receives up to CONFIG_XDPIF_RX_BATCH frames
+ * and passes them to xdpif_input(), refills the fill ring and finally kicks
+ * the transmission of all frames that were enqueued since the last poll
+ * (including the responses to the frames received here).
+ */
+void xdpif_poll(struct netif *netif)
+{
+  struct xdpif *xi = netif->state;
+  const struct xdp_desc *desc;
+  struct pbuf *p;
+  void *data;
+  unsigned int n, i;
+  uint32_t idx;
+#ifdef XDPIF_RXREF
+  struct xdpif_rxpbuf *rxp;
+#endif
+
+  xdpif_complete(xi);
+
+  n = xsk_ring_cons__peek(&xi->_rx, CONFIG_XDPIF_RX_BATCH, &idx);
+  for (i = 0; i < n; ++i) {
+    desc = xsk_ring_cons__rx_desc(&xi->_rx, idx + i);
+    data = xsk_umem__get_data(xi->_umem_area, desc->addr);
+    p = NULL;
+
+#ifdef XDPIF_RXREF
+    if (likely(xi->_nb_rxref < XDPIF_RX_MAXREF)) {
+      /* pass the UMEM frame itself to lwIP */
+      rxp = &xi->_rxpbufs[xdpif_frame_idx(desc->addr)];
+      rxp->addr = xdpif_frame_base(desc->addr);
+      p = pbuf_alloced_custom(PBUF_RAW, (u16_t) desc->len, PBUF_REF, &rxp->pc, data,
+			      (u16_t) (XDPIF_FRAME_SIZE - (desc->addr - rxp->addr)));
+      if (likely(p != NULL)) {
+	++xi->_nb_rxref;
+	++xi->_stats.rx_zcopy;
+      }
+    }
+    if (!p) {
+#endif /* XDPIF_RXREF */
+      p = xdpif_receive_copy(data, (u16_t) desc->len);
+      if (unlikely(!p)) {
+	LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_poll: %c%c: "
+				  "could not allocate pbuf, dropping packet\n",
+				  netif->name[0], netif->name[1]));
+	LINK_STATS_INC(link.memerr);
+	LINK_STATS_INC(link.drop);
+      } else {
+	++xi->_stats.rx_copied;
+      }
+      xdpif_frame_free(xi, desc->addr);
+#ifdef XDPIF_RXREF
+    }
+#endif /* XDPIF_RXREF */
+
+    if (likely(p != NULL)) {
+      ++xi->_stats.rx_pkts;
+      LINK_STATS_INC(link.recv);
+      xdpif_input(p, netif);
+    }
+  }
+  if (n)
+    xsk_ring_cons__release(&xi->_rx, n);
+
+  xdpif_refill(xi);
+  if (xi->_tx_pending)
+    xdpif_kick(xi);
+}
+
+/**
+ * Copies the statistics of an AF_XDP netif
+ *
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ * @return
+ *  0 on success, -1 if netif is not an AF_XDP device
+ */
+int xdpif_get_stats(struct netif *netif, struct xdpif_stats *out)
+{
+  struct xdpif *xi = netif->state;
+
+  if (netif->linkoutput != xdpif_transmit)
+    return -1;
+  memcpy(out, &xi->_stats, sizeof(*out));
+  return 0;
+}
+
+/**
+ * Returns the file descriptor of the AF_XDP socket
+ * (readable when frames were received)
+ *
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ * @return
+ *  number of stored file descriptors, -1 if netif is not an AF_XDP device
+ */
+int xdpif_get_fds(struct netif *netif, int *fds, unsigned int max)
+{
+  struct xdpif *xi = netif->state;
+
+  if (netif->linkoutput != xdpif_transmit)
+    return -1;
+  if (!max)
+    return 0;
+  fds[0] = xi->_fd;
+  return 1;
+}
+
+/*
+ * Allocates the UMEM area (huge pages if available)
+ * and registers it with the kernel
+ */
+static int xdpif_umem_init(struct xdpif *xi)
+{
+  struct xsk_umem_config cfg;
+  unsigned int i;
+  int ret;
+
+  xi->_umem_size = (size_t) CONFIG_XDPIF_NUM_FRAMES * XDPIF_FRAME_SIZE;
+  xi->_umem_area = mmap(NULL, xi->_umem_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (xi->_umem_area == MAP_FAILED)
+    xi->_umem_area = mmap(NULL, xi->_umem_size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (xi->_umem_area == MAP_FAILED) {
+    ret = -errno;
+    goto err_out;
+  }
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.fill_size = CONFIG_XDPIF_RING_SIZE;
+  cfg.comp_size = CONFIG_XDPIF_RING_SIZE;
+  cfg.frame_size = XDPIF_FRAME_SIZE;
+  cfg.frame_headroom = XSK_UMEM__DEFAULT_FRAME_HEADROOM;
+  ret = xsk_umem__create(&xi->_umem, xi->_umem_area, xi->_umem_size,
+			 &xi->_fq, &xi->_cq, &cfg);
+  if (ret < 0)
+    goto err_unmap;
+
+  xi->_frames = mem_malloc(CONFIG_XDPIF_NUM_FRAMES * sizeof(*xi->_frames));
+  xi->_rxpbufs = mem_calloc(CONFIG_XDPIF_NUM_FRAMES, sizeof(*xi->_rxpbufs));
+  if (!xi->_frames || !xi->_rxpbufs) {
+    ret = -ENOMEM;
+    goto err_free_frames;
+  }
+  for (i = 0; i < CONFIG_XDPIF_NUM_FRAMES; ++i) {
+    xi->_frames[i] = (uint64_t) (CONFIG_XDPIF_NUM_FRAMES - 1 - i) << XDPIF_FRAME_SHIFT;
+#ifdef XDPIF_RXREF
+    xi->_rxpbufs[i].pc.custom_free_function = xdpif_rxpbuf_free;
+    xi->_rxpbufs[i].xi = xi;
+#endif
+  }
+  xi->_nb_free = CONFIG_XDPIF_NUM_FRAMES;
+  xi->_nb_rxref = 0;
+  return 0;
+
+ err_free_frames:
+  if (xi->_frames)
+    mem_free(xi->_frames);
+  if (xi->_rxpbufs)
+    mem_free(xi->_rxpbufs);
+  xsk_umem__delete(xi->_umem);
+ err_unmap:
+  munmap(xi->_umem_area, xi->_umem_size);
+ err_out:
+  return ret;
+}
+
+static void xdpif_umem_exit(struct xdpif *xi)
+{
+  xsk_umem__delete(xi->_umem);
+  munmap(xi->_umem_area, xi->_umem_size);
+  mem_free(xi->_frames);
+  mem_free(xi->_rxpbufs);
+}
+
+/*
+ * Creates the AF_XDP socket: zero-copy mode is tried first,
+ * drivers without support for it (e.g., veth) are used in copy mode
+ */
+static int xdpif_socket_init(struct xdpif *xi)
+{
+  struct xsk_socket_config cfg;
+  int ret;
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.rx_size = CONFIG_XDPIF_RING_SIZE;
+  cfg.tx_size = CONFIG_XDPIF_RING_SIZE;
+  cfg.bind_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+  ret = xsk_socket__create(&xi->_xsk, xi->ifname, xi->queue, xi->_umem,
+			   &xi->_rx, &xi->_tx, &cfg);
+  if (ret == 0) {
+    xi->_stats.zerocopy = 1;
+  } else {
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: %s: zero-copy mode not available (%d), using copy mode\n",
+			      xi->ifname, ret));
+    cfg.bind_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+    ret = xsk_socket__create(&xi->_xsk, xi->ifname, xi->queue, xi->_umem,
+			     &xi->_rx, &xi->_tx, &cfg);
+    if (ret < 0)
+      return ret;
+    xi->_stats.zerocopy = 0;
+  }
+  xi->_fd = xsk_socket__fd(xi->_xsk);
+  return 0;
+}
+
+/**
+ * Initializes and sets up an AF_XDP interface for lwIP.
+ * This function should be passed as a parameter to netif_add().
+ *
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ * @return
+ *  ERR_OK if the interface was successfully initialized;
+ *  An err_t value otherwise
+ */
+err_t xdpif_init(struct netif *netif)
+{
+  struct xdpif *xi;
+  static uint8_t xdpif_id = 0;
+  int ret;
+
+  LWIP_ASSERT("netif != NULL", (netif != NULL));
+
+  if (!(netif->state)) {
+    xi = mem_calloc(1, sizeof(*xi));
+    if (!xi) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: "
+				"Could not allocate \n"));
+      goto err_out;
+    }
+    netif->state = xi;
+    xi->_state_is_private = 1;
+    xi->_hwaddr_is_private = 1;
+    strncpy(xi->ifname, CONFIG_XDPIF_IFNAME, sizeof(xi->ifname) - 1);
+    xi->queue = CONFIG_XDPIF_QUEUE;
+  } else {
+    xi = netif->state;
+    xi->_state_is_private = 0;
+    xi->_hwaddr_is_private = eth_addr_cmp(&xi->hwaddr, &ethzero);
+  }
+  memset(&xi->_stats, 0, sizeof(xi->_stats));
+  xi->_tx_pending = 0;
+
+  ret = xdpif_umem_init(xi);
+  if (ret < 0) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: %s: "
+			      "Could not create UMEM: %s\n", xi->ifname, strerror(-ret)));
+    goto err_free_xi;
+  }
+  ret = xdpif_socket_init(xi);
+  if (ret < 0) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: %s: "
+			      "Could not open AF_XDP socket on queue %u: %s\n",
+			      xi->ifname, xi->queue, strerror(-ret)));
+    goto err_exit_umem;
+  }
+  xdpif_refill(xi);
+  LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: %s: queue %u, %u frames, %s mode\n",
+			    xi->ifname, xi->queue, CONFIG_XDPIF_NUM_FRAMES,
+			    xi->_stats.zerocopy ? "zero-copy" : "copy"));
+
+  /* Interface identifier */
+  netif->name[0] = XDPIF_NPREFIX;
+  netif->name[1] = '0' + xdpif_id;
+  xdpif_id++;
+
+  /* MAC address */
+  if (xi->_hwaddr_is_private) {
+    if (_sys_get_hwaddr(xi->ifname, &xi->hwaddr) < 0) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_init: %c%c: failed to retrieve hardware address. Generating a random one\n",
+				netif->name[0], netif->name[1]));
+      _sys_gen_hwaddr(&xi->hwaddr);
+    }
+  }
+  SMEMCPY(&netif->hwaddr, &xi->hwaddr, ETHARP_HWADDR_LEN);
+  netif->hwaddr_len = ETHARP_HWADDR_LEN;
+
+  netif->output = etharp_output;
+  netif->linkoutput = xdpif_transmit;
+#if LWIP_NETIF_REMOVE_CALLBACK
+  netif->remove_callback = xdpif_exit;
+#endif /* LWIP_NETIF_REMOVE_CALLBACK */
+
+  NETIF_INIT_SNMP(netif, snmp_ifType_ethernet_csmacd, XDPIF_SPEED);
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  netif->mtu = XDPIF_MTU;
+  return ERR_OK;
+
+ err_exit_umem:
+  xdpif_umem_exit(xi);
+ err_free_xi:
+  if (xi->_state_is_private) {
+    mem_free(xi);
+    netif->state = NULL;
+  }
+ err_out:
+  return ERR_IF;
+}
+
+#if LWIP_NETIF_REMOVE_CALLBACK
+/**
+ * Closes a network interface.
+ * This function is called by lwIP on netif_remove().
+ *
+ * @param netif
+ *  the lwip network interface structure for this xdpif
+ */
+static void xdpif_exit(struct netif *netif)
+{
+  struct xdpif *xi = netif->state;
+
+  if (xi->_tx_pending)
+    xdpif_kick(xi);
+  xsk_socket__delete(xi->_xsk);
+
+  if (xi->_nb_rxref) {
+    /* pbufs that are still referencing UMEM frames will call
+     * xdpif_rxpbuf_free() later: keep the UMEM and the state */
+    LWIP_DEBUGF(NETIF_DEBUG, ("xdpif_exit: %u frames still in use\n", xi->_nb_rxref));
+    return;
+  }
+  xdpif_umem_exit(xi);
+  if (xi->_state_is_private) {
+    mem_free(xi);
+    netif->state = NULL;
+  }
+}
+#endif /* LWIP_NETIF_REMOVE_CALLBACK */
+
+/* Returns 0 on success and puts the hwaddress of an interface on addr_out
+ *  on errors, -1 is returned */
+static int
+_sys_get_hwaddr(const char *ifname,
+		struct eth_addr *out)
+{
+  struct ifreq ifr;
+  int fd;
+  int ret = 0;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    return -1;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0)
+    ret = -1;
+  else
+    memcpy(out->addr, ifr.ifr_hwaddr.sa_data, ETHARP_HWADDR_LEN);
+  close(fd);
+  return ret;
+}
+
+/* generate a private hardware address
+ *  x2-xx-xx-xx-xx-xx
+ *  x6-xx-xx-xx-xx-xx
+ *  xA-xx-xx-xx-xx-xx
+ *  xE-xx-xx-xx-xx-xx
+ * x := 0-F except for the first position (0-E)
+ */
+static void
+_sys_gen_hwaddr(struct eth_addr *out)
+{
+  unsigned int i;
+  /* generate random bytes */
+  for (i = 0; i < ETHARP_HWADDR_LEN; ++i)
+    out->addr[i] = (u8_t) rand();
+
+  /* modify first byte (make hwaddr private) */
+  out->addr[0] &= (out->addr[0] >= 0xF0) ? 0xEC : 0xFC;
+  out->addr[0] |= 0x02;
+}
@@ -38,16 +38,28 @@
 #include <stdio.h>
 #include <lwip/udp.h>
 #include <sys/time.h>
+#include <math.h>
 
 #include "shfs.h"
 #include "shfs_btable.h"
 #include "shfs_tools.h"
 #include "shfs_cache.h"
 #include "shfs_fio.h"
+#include "mtmempool.h"
+#include "mpring.h"
+#include "lathist.h"
+#include "http_parser.h"
+#ifdef HTTP_FASTPARSE
+#include "http_fastparse.h"
+#endif
 #include "shell.h"
 #ifdef HAVE_CTLDIR
 #include <target/ctldir.h>
 #endif
+#ifndef __MINIOS__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 /* copied from <sys/time.h> */
 #ifndef timerclear
@@ -495,6 +507,922 @@ static int shcmd_ocperf2(FILE *cio, int argc, char *argv[])
 	return ret;
 }
 
+/* random chunk reads with a fixed number of outstanding requests (queue depth)
+ * through the asynchronous cache interface; objects are picked uniformly
+ * (theta = 0) or Zipf(theta) distributed by their position in the list,
+ * the chunk within an object uniformly */
+#define IOPERF_RAND_MAXDEPTH 256
+#define IOPERF_RAND_MAXSTALLS 10000 /* retries without own requests in flight */
+struct _iorand_obj {
+	SHFS_FD f;
+	chk_t start;
+	chk_t nb_chks;
+};
+
+struct _iorand_req {
+	struct shfs_cache_entry *cce; /* NULL: slot is unused */
+	SHFS_AIO_TOKEN *t;
+	uint64_t ts_issue;
+};
+
+static inline uint64_t _iorand_rand(uint64_t *s)
+{
+	/* xorshift64 */
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static int shcmd_ioperf_rand(FILE *cio, int argc, char *argv[])
+{
+	struct htable_el *el;
+	struct _iorand_obj *obj;
+	struct _iorand_req *req;
+	double *cdf = NULL;
+	double theta = 0.0, sum, u;
+	struct lathist *hist;
+	uint64_t nb_reqs = 100000;
+	uint64_t issued, done, hits, errors;
+	unsigned int infly, stalls;
+	uint64_t seed, r, ts;
+	uint64_t usecs, nsecs, iops, bps;
+	unsigned int depth = 16;
+	unsigned int nb_obj, i, q, lo, hi;
+	struct timeval tm_start;
+	struct timeval tm_end;
+	struct timeval tm_duration;
+	struct shfs_cache_entry *cce;
+	SHFS_AIO_TOKEN *t;
+	chk_t addr;
+	int ret = 0;
+
+	if (argc >= 2) {
+		if (sscanf(argv[1], "%"SCNu64"", &nb_reqs) != 1 || nb_reqs == 0) {
+			fprintf(cio, "Usage: %s [[requests]] [[depth]] [[theta]] [[file]]...\n", argv[0]);
+			return -1;
+		}
+	}
+	if (argc >= 3) {
+		if (sscanf(argv[2], "%u", &depth) != 1 ||
+		    depth == 0 || depth > IOPERF_RAND_MAXDEPTH) {
+			fprintf(cio, "Invalid queue depth (1-%u)\n", IOPERF_RAND_MAXDEPTH);
+			return -1;
+		}
+	}
+	if (argc >= 4) {
+		if (sscanf(argv[3], "%lf", &theta) != 1 || theta < 0.0) {
+			fprintf(cio, "Could not parse theta\n");
+			return -1;
+		}
+	}
+	if (!shfs_mounted) {
+		fprintf(cio, "No SHFS volume mounted\n");
+		return -1;
+	}
+
+	/* object set: passed files or all files of the volume */
+	if (argc >= 5) {
+		nb_obj = (unsigned int) (argc - 4);
+	} else {
+		nb_obj = 0;
+		foreach_htable_el(shfs_vol.bt, el)
+			++nb_obj;
+	}
+	if (!nb_obj) {
+		fprintf(cio, "Volume is empty\n");
+		return -1;
+	}
+	obj = target_malloc(8, sizeof(*obj) * nb_obj);
+	req = target_malloc(8, sizeof(*req) * depth);
+	hist = target_malloc(8, sizeof(*hist));
+	if (!obj || !req || !hist) {
+		fprintf(cio, "Could not allocate memory: %s\n", strerror(errno));
+		ret = -1;
+		goto out_free;
+	}
+	memset(req, 0, sizeof(*req) * depth);
+	lathist_reset(hist);
+
+	i = 0;
+	if (argc >= 5) {
+		for (; i < nb_obj; ++i) {
+			obj[i].f = shfs_fio_open(argv[4 + i]);
+			if (!obj[i].f) {
+				fprintf(cio, "Could not open %s: %s\n", argv[4 + i], strerror(errno));
+				ret = -1;
+				goto out_close;
+			}
+			if (shfs_fio_islink(obj[i].f) || !shfs_fio_size_chks(obj[i].f)) {
+				fprintf(cio, "File %s is a link or empty\n", argv[4 + i]);
+				shfs_fio_close(obj[i].f);
+				ret = -1;
+				goto out_close;
+			}
+			obj[i].start = shfs_volchk_foff(obj[i].f, 0);
+			obj[i].nb_chks = shfs_fio_size_chks(obj[i].f);
+		}
+	} else {
+		/* skip links and empty files */
+		foreach_htable_el(shfs_vol.bt, el) {
+			obj[i].f = shfs_fio_openh(*el->h);
+			if (!obj[i].f)
+				continue;
+			if (shfs_fio_islink(obj[i].f) || !shfs_fio_size_chks(obj[i].f)) {
+				shfs_fio_close(obj[i].f);
+				continue;
+			}
+			obj[i].start = shfs_volchk_foff(obj[i].f, 0);
+			obj[i].nb_chks = shfs_fio_size_chks(obj[i].f);
+			++i;
+		}
+		nb_obj = i;
+		if (!nb_obj) {
+			fprintf(cio, "Volume has no readable files\n");
+			ret = -1;
+			goto out_free;
+		}
+	}
+
+	/* cumulative distribution function of object ranks */
+	if (theta > 0.0) {
+		cdf = target_malloc(8, sizeof(*cdf) * nb_obj);
+		if (!cdf) {
+			fprintf(cio, "Could not allocate memory: %s\n", strerror(errno));
+			ret = -1;
+			goto out_close;
+		}
+		sum = 0.0;
+		for (q = 0; q < nb_obj; ++q) {
+			sum += 1.0 / pow((double) (q + 1), theta);
+			cdf[q] = sum;
+		}
+		for (q = 0; q < nb_obj; ++q)
+			cdf[q] /= sum;
+	}
+
+	if (theta > 0.0)
+		fprintf(cio, "%s: %"PRIu64" requests, queue depth %u, %u objects, Zipf(%.2f)\n",
+			argv[0], nb_reqs, depth, nb_obj, theta);
+	else
+		fprintf(cio, "%s: %"PRIu64" requests, queue depth %u, %u objects, uniform\n",
+			argv[0], nb_reqs, depth, nb_obj);
+
+	seed = (uint64_t) target_now_ns() | 1;
+	issued = done = hits = errors = 0;
+	infly = stalls = 0;
+
+	gettimeofday(&tm_start, NULL);
+	barrier();
+	while (done < nb_reqs) {
+		/* refill queue */
+		for (q = 0; q < depth && issued < nb_reqs; ++q) {
+			if (req[q].cce)
+				continue;
+
+			r = _iorand_rand(&seed);
+			if (cdf) {
+				u = (double) (r >> 11) * (1.0 / 9007199254740992.0); /* [0, 1) */
+				lo = 0;
+				hi = nb_obj - 1;
+				while (lo < hi) {
+					i = lo + (hi - lo) / 2;
+					if (cdf[i] > u)
+						hi = i;
+					else
+						lo = i + 1;
+				}
+				i = lo;
+				r = _iorand_rand(&seed);
+			} else {
+				i = (unsigned int) (r % nb_obj);
+				r >>= 32;
+			}
+			addr = obj[i].start + (chk_t) (r % obj[i].nb_chks);
+
+			ts = target_now_ns();
+			ret = shfs_cache_aread(addr, NULL, NULL, NULL, &cce, &t);
+			if (ret == -EAGAIN) {
+				if (infly)
+					break; /* out of buffers/request slots: wait for completions */
+				/* buffers are held by someone else (e.g., HTTP
+				 * requests): give them a chance to release them */
+				if (unlikely(++stalls > IOPERF_RAND_MAXSTALLS)) {
+					fprintf(cio, "Could not get a cache buffer or AIO token\n");
+					ret = -1;
+					goto out_drain;
+				}
+				schedule();
+				break;
+			}
+			if (unlikely(ret < 0)) {
+				fprintf(cio, "Read error: %s\n", strerror(-ret));
+				ret = -1;
+				goto out_drain;
+			}
+			stalls = 0;
+			++issued;
+			if (ret == 0) {
+				/* cache hit */
+				lathist_add(hist, target_now_ns() - ts);
+				if (unlikely(cce->invalid))
+					++errors;
+				shfs_cache_release(cce);
+				++hits;
+				++done;
+				continue;
+			}
+			req[q].cce = cce;
+			req[q].t = t;
+			req[q].ts_issue = ts;
+			++infly;
+		}
+
+		/* reap completions */
+		shfs_poll_blkdevs();
+		ts = target_now_ns();
+		for (q = 0; q < depth; ++q) {
+			if (!req[q].cce || !shfs_aio_is_done(req[q].t))
+				continue;
+			if (unlikely(shfs_aio_finalize(req[q].t) < 0))
+				++errors;
+			lathist_add(hist, ts - req[q].ts_issue);
+			shfs_cache_release(req[q].cce);
+			req[q].cce = NULL;
+			--infly;
+			++done;
+		}
+	}
+	barrier();
+	gettimeofday(&tm_end, NULL);
+	timersub(&tm_end, &tm_start, &tm_duration);
+	ret = 0;
+
+	usecs = (tm_duration.tv_usec + (tm_duration.tv_sec * 1000000));
+	if (!usecs)
+		usecs = 1;
+	iops = (done * 1000000) / usecs;
+	bps = (done * shfs_vol.chunksize * 1000000) / usecs;
+	fprintf(cio, "%"PRIu64" requests done in %"PRIu64".%06"PRIu64" seconds (%"PRIu64" errors)\n",
+		done, usecs / 1000000, usecs % 1000000, errors);
+	fprintf(cio, " %"PRIu64" IOPS, %"PRIu64".%02"PRIu64" MB/s, hit ratio %"PRIu64".%02"PRIu64" %%\n",
+		iops, bps / 1000000, (bps / 10000) % 100,
+		(hits * 100) / done, ((hits * 10000) / done) % 100);
+	nsecs = lathist_pct(hist, 5000);
+	fprintf(cio, " latency p50 %"PRIu64".%03"PRIu64" us", nsecs / 1000, nsecs % 1000);
+	nsecs = lathist_pct(hist, 9900);
+	fprintf(cio, ", p99 %"PRIu64".%03"PRIu64" us", nsecs / 1000, nsecs % 1000);
+	nsecs = lathist_pct(hist, 9990);
+	fprintf(cio, ", p999 %"PRIu64".%03"PRIu64" us", nsecs / 1000, nsecs % 1000);
+	fprintf(cio, ", max %"PRIu64".%03"PRIu64" us\n", hist->max / 1000, hist->max % 1000);
+
+ out_drain:
+	for (q = 0; q < depth; ++q) {
+		if (!req[q].cce)
+			continue;
+		shfs_aio_wait_nosched(req[q].t);
+		shfs_aio_finalize(req[q].t);
+		shfs_cache_release(req[q].cce);
+	}
+	i = nb_obj;
+ out_close:
+	while (i)
+		shfs_fio_close(obj[--i].f);
+ out_free:
+	if (cdf)
+		target_free(cdf);
+	if (hist)
+		target_free(hist);
+	if (req)
+		target_free(req);
+	if (obj)
+		target_free(obj);
+	return ret;
+}
+
+/* bucket table lookup performance (single vs. batched lookups) */
+#define BTPERF_MAXBATCH 64
+
+static int shcmd_btperf(FILE *cio, int argc, char *argv[])
+{
+	struct htable_el *el;
+	struct shfs_bentry *bentries[BTPERF_MAXBATCH];
+	hash512_t *h;
+	hash512_t tmp;
+	uint64_t nb_h, i, j, r;
+	uint64_t times = 100;
+	unsigned int batch = 16, n;
+	uint64_t found[2] = { 0, 0 };
+	struct timeval tm_start;
+	struct timeval tm_end;
+	uint64_t usecs, ops;
+	int pass;
+	int ret = 0;
+
+	if (argc > 3) {
+		fprintf(cio, "Usage: %s [[times]] [[batch]]\n", argv[0]);
+		return -1;
+	}
+	if (argc >= 2) {
+		if (sscanf(argv[1], "%"SCNu64"", &times) != 1 || times == 0) {
+			fprintf(cio, "Could not parse times\n");
+			return -1;
+		}
+	}
+	if (argc >= 3) {
+		if (sscanf(argv[2], "%u", &batch) != 1 ||
+		    batch == 0 || batch > BTPERF_MAXBATCH) {
+			fprintf(cio, "Invalid batch size (1-%u)\n", BTPERF_MAXBATCH);
+			return -1;
+		}
+	}
+	if (!shfs_mounted) {
+		fprintf(cio, "No SHFS volume mounted\n");
+		return -1;
+	}
+
+	/* collect hash digests of all entries in random order */
+	nb_h = 0;
+	foreach_htable_el(shfs_vol.bt, el)
+		++nb_h;
+	if (!nb_h) {
+		fprintf(cio, "Volume is empty\n");
+		return -1;
+	}
+	h = target_malloc(8, sizeof(*h) * nb_h);
+	if (!h) {
+		fprintf(cio, "Could not allocate memory: %s\n", strerror(errno));
+		return -1;
+	}
+	i = 0;
+	foreach_htable_el(shfs_vol.bt, el)
+		hash_copy(h[i++], *el->h, shfs_vol.hlen);
+	for (i = nb_h - 1; i > 0; --i) {
+		r = (uint64_t) rand() % (i + 1);
+		hash_copy(tmp, h[i], shfs_vol.hlen);
+		hash_copy(h[i], h[r], shfs_vol.hlen);
+		hash_copy(h[r], tmp, shfs_vol.hlen);
+	}
+
+	for (pass = 0; pass < 2; ++pass) {
+		gettimeofday(&tm_start, NULL);
+		barrier();
+		for (j = 0; j < times; ++j) {
+			if (pass == 0) {
+				for (i = 0; i < nb_h; ++i)
+					if (shfs_btable_lookup(shfs_vol.bt, h[i]))
+						++found[pass];
+			} else {
+				for (i = 0; i < nb_h; i += n) {
+					n = min(nb_h - i, (uint64_t) batch);
+					found[pass] += shfs_btable_lookup_multiple(shfs_vol.bt, &h[i],
+										   bentries, n);
+				}
+			}
+		}
+		barrier();
+		gettimeofday(&tm_end, NULL);
+
+		if (tm_end.tv_usec < tm_start.tv_usec) {
+			tm_end.tv_usec += 1000000l;
+			--tm_end.tv_sec;
+		}
+		usecs = (tm_end.tv_usec - tm_start.tv_usec);
+		usecs += (tm_end.tv_sec - tm_start.tv_sec) * 1000000;
+		if (!usecs)
+			usecs = 1;
+		ops = nb_h * times;
+		if (pass == 0)
+			fprintf(cio, "single:     ");
+		else
+			fprintf(cio, "batch (%2u): ", batch);
+		fprintf(cio, "%"PRIu64" lookups in %"PRIu64".%06"PRIu64" seconds ",
+		        ops, usecs / 1000000, usecs % 1000000);
+		fprintf(cio, "(%"PRIu64" lookups/s)\n", (ops * 1000000 + usecs / 2) / usecs);
+	}
+	if (found[0] != nb_h * times || found[1] != found[0]) {
+		fprintf(cio, "Lookup mismatch: %"PRIu64" single, %"PRIu64" batched hits (expected %"PRIu64")\n",
+		        found[0], found[1], nb_h * times);
+		ret = -1;
+	}
+
+	target_free(h);
+	return ret;
+}
+
+/* multi-threaded mempool pick+put performance */
+#ifndef __MINIOS__
+#define MPPERF_MAXNB_THREADS 16
+#else
+#define MPPERF_MAXNB_THREADS 1 /* no SMP */
+#endif
+#define MPPERF_MAXBULK 64
+
+struct _mpperf_arg {
+	struct mtmempool *mp;
+	uint64_t times;
+	uint32_t bulk;
+	volatile int *go;
+	volatile uint32_t *ready;
+	int ret;
+};
+
+static void *_mpperf_thread(void *argp)
+{
+	struct _mpperf_arg *a = argp;
+	struct mtmempool_cache *c;
+	struct mempool_obj *objs[MPPERF_MAXBULK];
+	uint64_t i;
+
+	c = mtmempool_attach(a->mp);
+	if (!c) {
+		a->ret = -errno;
+		__atomic_add_fetch(a->ready, 1, __ATOMIC_RELEASE);
+		return NULL;
+	}
+	__atomic_add_fetch(a->ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(a->go, __ATOMIC_ACQUIRE));
+
+	a->ret = 0;
+	if (a->bulk == 1) {
+		for (i = 0; i < a->times; ++i) {
+			objs[0] = mtmempool_pick(c);
+			if (unlikely(!objs[0])) {
+				a->ret = -ENOBUFS;
+				break;
+			}
+			mtmempool_put(c, objs[0]);
+		}
+	} else {
+		for (i = 0; i < a->times; ++i) {
+			if (unlikely(mtmempool_pick_multiple(c, objs, a->bulk) < 0)) {
+				a->ret = -ENOBUFS;
+				break;
+			}
+			mtmempool_put_multiple(c, objs, a->bulk);
+		}
+	}
+	mtmempool_detach(c);
+	return NULL;
+}
+
+static int shcmd_mpperf(FILE *cio, int argc, char *argv[])
+{
+	struct mtmempool *mp;
+	struct _mpperf_arg args[MPPERF_MAXNB_THREADS];
+#ifndef __MINIOS__
+	pthread_t threads[MPPERF_MAXNB_THREADS];
+#endif
+	volatile int go;
+	volatile uint32_t ready;
+	unsigned int nb_threads, max_threads = MPPERF_MAXNB_THREADS;
+	unsigned int bulk = 8;
+	uint64_t times = 1000000;
+	unsigned int t;
+	struct timeval tm_start;
+	struct timeval tm_end;
+	uint64_t usecs, ops;
+	int ret = 0;
+
+	if (argc > 4) {
+		fprintf(cio, "Usage: %s [[max threads]] [[times]] [[bulk]]\n", argv[0]);
+		return -1;
+	}
+	if (argc >= 2) {
+		if (sscanf(argv[1], "%u", &max_threads) != 1 ||
+		    max_threads == 0 || max_threads > MPPERF_MAXNB_THREADS) {
+			fprintf(cio, "Invalid number of threads (1-%u)\n", MPPERF_MAXNB_THREADS);
+			return -1;
+		}
+	}
+	if (argc >= 3) {
+		if (sscanf(argv[2], "%"SCNu64"", &times) != 1 || times == 0) {
+			fprintf(cio, "Could not parse times\n");
+			return -1;
+		}
+	}
+	if (argc >= 4) {
+		if (sscanf(argv[3], "%u", &bulk) != 1 ||
+		    bulk == 0 || bulk > MPPERF_MAXBULK) {
+			fprintf(cio, "Invalid bulk size (1-%u)\n", MPPERF_MAXBULK);
+			return -1;
+		}
+	}
+
+	mp = alloc_simple_mtmempool(MPPERF_MAXNB_THREADS * (MTMEMPOOL_DEFAULT_MAG_SIZE * 4 + MPPERF_MAXBULK),
+	                            64, MPPERF_MAXNB_THREADS);
+	if (!mp) {
+		fprintf(cio, "Could not allocate memory pool: %s\n", strerror(errno));
+		return -1;
+	}
+
+	for (nb_threads = 1; nb_threads <= max_threads; nb_threads <<= 1) {
+		go = 0;
+		ready = 0;
+		for (t = 0; t < nb_threads; ++t) {
+			args[t].mp = mp;
+			args[t].times = times;
+			args[t].bulk = bulk;
+			args[t].go = &go;
+			args[t].ready = &ready;
+			args[t].ret = 0;
+#ifndef __MINIOS__
+			if (pthread_create(&threads[t], NULL, _mpperf_thread, &args[t]) != 0) {
+				fprintf(cio, "Could not create thread %u\n", t);
+				go = 1;
+				nb_threads = t;
+				ret = -1;
+				goto join;
+			}
+#endif
+		}
+#ifndef __MINIOS__
+		while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) < nb_threads);
+#endif
+
+		gettimeofday(&tm_start, NULL);
+		__atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+#ifdef __MINIOS__
+		_mpperf_thread(&args[0]);
+#else
+	join:
+		for (t = 0; t < nb_threads; ++t)
+			pthread_join(threads[t], NULL);
+		if (ret < 0)
+			break;
+#endif
+		gettimeofday(&tm_end, NULL);
+
+		for (t = 0; t < nb_threads; ++t) {
+			if (args[t].ret < 0) {
+				fprintf(cio, "Thread %u failed: %s\n", t, strerror(-args[t].ret));
+				ret = -1;
+			}
+		}
+		if (ret < 0)
+			break;
+
+		if (tm_end.tv_usec < tm_start.tv_usec) {
+			tm_end.tv_usec += 1000000l;
+			--tm_end.tv_sec;
+		}
+		usecs = (tm_end.tv_usec - tm_start.tv_usec);
+		usecs += (tm_end.tv_sec - tm_start.tv_sec) * 1000000;
+		if (!usecs)
+			usecs = 1;
+		ops = times * bulk * 2 * nb_threads; /* pick + put */
+		fprintf(cio, "%2u threads: %"PRIu64" ops in %"PRIu64".%06"PRIu64" seconds "
+		        "(%"PRIu64" ops/s, %"PRIu64" ops/s per thread)\n",
+		        nb_threads, ops, usecs / 1000000, usecs % 1000000,
+		        (ops * 1000000 + usecs / 2) / usecs,
+		        (ops * 1000000 + usecs / 2) / usecs / nb_threads);
+	}
+
+	free_mtmempool(mp);
+	return ret;
+}
+
+/* lock-free ring throughput */
+#define RINGPERF_MAXNB_THREADS 8
+#define RINGPERF_MAXBULK 64
+#define RINGPERF_SIZE 1024
+#ifndef __MINIOS__
+#define ringperf_backoff() sched_yield() /* threads might be oversubscribed */
+#else
+#define ringperf_backoff() mpring_relax()
+#endif
+
+struct _ringperf_arg {
+	struct mpring *r;
+	uint64_t times;
+	uint32_t bulk;
+	volatile uint64_t *left; /* elements left to dequeue (consumers) */
+	volatile int *go;
+	volatile uint32_t *ready;
+};
+
+static void *_ringperf_producer(void *argp)
+{
+	struct _ringperf_arg *a = argp;
+	void *e[RINGPERF_MAXBULK];
+	uint64_t i;
+	uint32_t j;
+
+	for (j = 0; j < a->bulk; ++j)
+		e[j] = (void *) (uintptr_t) (j + 1);
+	__atomic_add_fetch(a->ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(a->go, __ATOMIC_ACQUIRE));
+
+	for (i = 0; i < a->times; ++i)
+		while (mpring_enqueue_multiple(a->r, e, a->bulk) < 0)
+			ringperf_backoff();
+	return NULL;
+}
+
+static void *_ringperf_consumer(void *argp)
+{
+	struct _ringperf_arg *a = argp;
+	void *e[RINGPERF_MAXBULK];
+	uint32_t n;
+
+	__atomic_add_fetch(a->ready, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(a->go, __ATOMIC_ACQUIRE));
+
+	while (__atomic_load_n(a->left, __ATOMIC_RELAXED)) {
+		n = mpring_try_dequeue_multiple(a->r, e, a->bulk);
+		if (n)
+			__atomic_sub_fetch(a->left, n, __ATOMIC_RELAXED);
+		else
+			ringperf_backoff();
+	}
+	return NULL;
+}
+
+static int shcmd_ringperf(FILE *cio, int argc, char *argv[])
+{
+	struct mpring *r;
+	struct _ringperf_arg args[RINGPERF_MAXNB_THREADS * 2];
+#ifndef __MINIOS__
+	pthread_t threads[RINGPERF_MAXNB_THREADS * 2];
+#endif
+	volatile int go = 0;
+	volatile uint32_t ready = 0;
+	volatile uint64_t left;
+	unsigned int nb_prod = 1, nb_cons = 1;
+	unsigned int bulk = 8;
+	uint64_t times = 1000000;
+	unsigned int t, nb_threads;
+	int flags = 0;
+	struct timeval tm_start;
+	struct timeval tm_end;
+	uint64_t usecs, elems;
+	int ret = 0;
+
+	if (argc > 5) {
+		fprintf(cio, "Usage: %s [[producers]] [[consumers]] [[times]] [[bulk]]\n", argv[0]);
+		return -1;
+	}
+	if (argc >= 2) {
+		if (sscanf(argv[1], "%u", &nb_prod) != 1 ||
+		    nb_prod == 0 || nb_prod > RINGPERF_MAXNB_THREADS) {
+			fprintf(cio, "Invalid number of producers (1-%u)\n", RINGPERF_MAXNB_THREADS);
+			return -1;
+		}
+	}
+	if (argc >= 3) {
+		if (sscanf(argv[2], "%u", &nb_cons) != 1 ||
+		    nb_cons == 0 || nb_cons > RINGPERF_MAXNB_THREADS) {
+			fprintf(cio, "Invalid number of consumers (1-%u)\n", RINGPERF_MAXNB_THREADS);
+			return -1;
+		}
+	}
+	if (argc >= 4) {
+		if (sscanf(argv[3], "%"SCNu64"", &times) != 1 || times == 0) {
+			fprintf(cio, "Could not parse times\n");
+			return -1;
+		}
+	}
+	if (argc >= 5) {
+		if (sscanf(argv[4], "%u", &bulk) != 1 ||
+		    bulk == 0 || bulk > RINGPERF_MAXBULK) {
+			fprintf(cio, "Invalid bulk size (1-%u)\n", RINGPERF_MAXBULK);
+			return -1;
+		}
+	}
+#ifdef __MINIOS__
+	if (nb_prod != 1 || nb_cons != 1) {
+		fprintf(cio, "Only 1 producer and 1 consumer supported on this platform\n");
+		return -1;
+	}
+#endif
+
+	/* use single-producer/consumer variants when possible */
+	if (nb_prod == 1)
+		flags |= MPRING_F_SP_ENQ;
+	if (nb_cons == 1)
+		flags |= MPRING_F_SC_DEQ;
+	r = alloc_mpring(RINGPERF_SIZE, flags);
+	if (!r) {
+		fprintf(cio, "Could not allocate ring: %s\n", strerror(errno));
+		return -1;
+	}
+
+	left = times * bulk * nb_prod;
+	nb_threads = nb_prod + nb_cons;
+	for (t = 0; t < nb_threads; ++t) {
+		args[t].r = r;
+		args[t].times = times;
+		args[t].bulk = bulk;
+		args[t].left = &left;
+		args[t].go = &go;
+		args[t].ready = &ready;
+	}
+
+#ifndef __MINIOS__
+	for (t = 0; t < nb_threads; ++t) {
+		if (pthread_create(&threads[t], NULL,
+		                   t < nb_prod ? _ringperf_producer : _ringperf_consumer,
+		                   &args[t]) != 0) {
+			fprintf(cio, "Could not create thread %u\n", t);
+			/* let started threads terminate */
+			left = 0;
+			for (nb_threads = t, t = 0; t < nb_threads; ++t)
+				args[t].times = 0;
+			go = 1;
+			ret = -1;
+			goto join;
+		}
+	}
+	while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) < nb_threads);
+
+	gettimeofday(&tm_start, NULL);
+	__atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+ join:
+	for (t = 0; t < nb_threads; ++t)
+		pthread_join(threads[t], NULL);
+	gettimeofday(&tm_end, NULL);
+#else
+	/* interleaved single-threaded producer/consumer */
+	{
+		void *e[RINGPERF_MAXBULK];
+		uint64_t i;
+
+		memset(e, 0xA5, sizeof(e));
+		gettimeofday(&tm_start, NULL);
+		barrier();
+		for (i = 0; i < times; ++i) {
+			mpring_enqueue_multiple(r, e, bulk);
+			mpring_dequeue_multiple(r, e, bulk);
+		}
+		barrier();
+		gettimeofday(&tm_end, NULL);
+	}
+#endif
+
+	if (ret == 0) {
+		if (tm_end.tv_usec < tm_start.tv_usec) {
+			tm_end.tv_usec += 1000000l;
+			--tm_end.tv_sec;
+		}
+		usecs = (tm_end.tv_usec - tm_start.tv_usec);
+		usecs += (tm_end.tv_sec - tm_start.tv_sec) * 1000000;
+		if (!usecs)
+			usecs = 1;
+		elems = times * bulk * nb_prod;
+		fprintf(cio, "%uP/%uC (bulk %u): Transferred %"PRIu64" elements in %"PRIu64".%06"PRIu64" seconds ",
+		        nb_prod, nb_cons, bulk, elems, usecs / 1000000, usecs % 1000000);
+		fprintf(cio, "(%"PRIu64" elements/s)\n", (elems * 1000000 + usecs / 2) / usecs);
+	}
+
+	free_mpring(r);
+	return ret;
+}
+
+/*
+ * HTTP request parsing benchmark
+ *  Parses a corpus of captured client requests with http_parser and with
+ *  the GET fast path (if enabled)
+ */
+static const char *_parseperf_corpus[] = {
+	/* curl */
+	"GET /e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855 HTTP/1.1\r\n"
+	"Host: 192.168.128.124\r\n"
+	"User-Agent: curl/7.58.0\r\n"
+	"Accept: */*\r\n"
+	"\r\n",
+	/* wget */
+	"GET /video.ts HTTP/1.1\r\n"
+	"User-Agent: Wget/1.19.4 (linux-gnu)\r\n"
+	"Accept: */*\r\n"
+	"Accept-Encoding: identity\r\n"
+	"Host: 192.168.128.124\r\n"
+	"Connection: Keep-Alive\r\n"
+	"\r\n",
+	/* ab (HTTP/1.0 keep-alive) */
+	"GET /?e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855 HTTP/1.0\r\n"
+	"Connection: Keep-Alive\r\n"
+	"Host: 192.168.128.124\r\n"
+	"User-Agent: ApacheBench/2.3\r\n"
+	"Accept: */*\r\n"
+	"\r\n",
+	/* browser */
+	"GET /stream.mp3 HTTP/1.1\r\n"
+	"Host: 192.168.128.124\r\n"
+	"Connection: keep-alive\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/70.0.3538.77 Safari/537.36\r\n"
+	"Accept: */*\r\n"
+	"Referer: http://192.168.128.124/\r\n"
+	"Accept-Encoding: identity;q=1, *;q=0\r\n"
+	"Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+	"Range: bytes=0-\r\n"
+	"\r\n",
+	/* wrk */
+	"GET /index.html HTTP/1.1\r\n"
+	"Host: 192.168.128.124:80\r\n"
+	"\r\n",
+};
+#define PARSEPERF_CORPUS_LEN (sizeof(_parseperf_corpus) / sizeof(_parseperf_corpus[0]))
+
+static int _parseperf_cb_data(http_parser *parser, const char *at, size_t len)
+{
+	*((size_t *) parser->data) += len;
+	return 0;
+}
+
+static int _parseperf_cb(http_parser *parser)
+{
+	*((size_t *) parser->data) += 1;
+	return 0;
+}
+
+static const http_parser_settings _parseperf_settings = {
+	.on_url = _parseperf_cb_data,
+	.on_header_field = _parseperf_cb_data,
+	.on_header_value = _parseperf_cb_data,
+	.on_message_complete = _parseperf_cb,
+};
+
+static inline uint64_t _parseperf_usecs(struct timeval *tm_start, struct timeval *tm_end)
+{
+	struct timeval tm_diff;
+	uint64_t usecs;
+
+	timersub(tm_end, tm_start, &tm_diff);
+	usecs = tm_diff.tv_usec + tm_diff.tv_sec * 1000000;
+	return usecs ? usecs : 1;
+}
+
+static int shcmd_parseperf(FILE *cio, int argc, char *argv[])
+{
+	http_parser parser;
+#ifdef HTTP_FASTPARSE
+	struct http_fastparse_req freq;
+	unsigned int l;
+#endif
+	size_t rlen[PARSEPERF_CORPUS_LEN];
+	size_t bytes = 0, sum = 0;
+	uint64_t times = 1000000;
+	uint64_t i, usecs;
+	unsigned int c;
+	struct timeval tm_start;
+	struct timeval tm_end;
+
+	if (argc > 2) {
+		fprintf(cio, "Usage: %s [[times]]\n", argv[0]);
+		return -1;
+	}
+	if (argc == 2) {
+		if (sscanf(argv[1], "%"SCNu64"", &times) != 1 || times == 0) {
+			fprintf(cio, "Could not parse times\n");
+			return -1;
+		}
+	}
+	for (c = 0; c < PARSEPERF_CORPUS_LEN; ++c) {
+		rlen[c] = strlen(_parseperf_corpus[c]);
+		bytes += rlen[c];
+	}
+
+	/* http_parser */
+	parser.data = &sum;
+	gettimeofday(&tm_start, NULL);
+	for (i = 0; i < times; ++i) {
+		for (c = 0; c < PARSEPERF_CORPUS_LEN; ++c) {
+			http_parser_init(&parser, HTTP_REQUEST);
+			http_parser_execute(&parser, &_parseperf_settings,
+					    _parseperf_corpus[c], rlen[c]);
+		}
+	}
+	gettimeofday(&tm_end, NULL);
+	usecs = _parseperf_usecs(&tm_start, &tm_end);
+	fprintf(cio, "http_parser: %"PRIu64" requests in %"PRIu64".%06"PRIu64" seconds (%"PRIu64" requests/s, %"PRIu64" MiB/s)\n",
+	        times * PARSEPERF_CORPUS_LEN, usecs / 1000000, usecs % 1000000,
+	        (times * PARSEPERF_CORPUS_LEN * 1000000) / usecs,
+	        (times * bytes) / usecs * 1000000 / 1048576);
+
+#ifdef HTTP_FASTPARSE
+	/* fast path (results are consumed like the session callbacks do) */
+	gettimeofday(&tm_start, NULL);
+	for (i = 0; i < times; ++i) {
+		for (c = 0; c < PARSEPERF_CORPUS_LEN; ++c) {
+			if (!http_fastparse_req(_parseperf_corpus[c], rlen[c], &freq)) {
+				fprintf(cio, "Fast path rejected request %u of corpus\n", c);
+				return -1;
+			}
+			sum += freq.url_len;
+			for (l = 0; l < freq.nb_lines; ++l)
+				sum += freq.line[l].field_len + freq.line[l].value_len;
+		}
+	}
+	gettimeofday(&tm_end, NULL);
+	usecs = _parseperf_usecs(&tm_start, &tm_end);
+	fprintf(cio, "fast path:   %"PRIu64" requests in %"PRIu64".%06"PRIu64" seconds (%"PRIu64" requests/s, %"PRIu64" MiB/s)\n",
+	        times * PARSEPERF_CORPUS_LEN, usecs / 1000000, usecs % 1000000,
+	        (times * PARSEPERF_CORPUS_LEN * 1000000) / usecs,
+	        (times * bytes) / usecs * 1000000 / 1048576);
+#endif
+	return 0;
+}
+
 #ifdef HAVE_CTLDIR
 int register_testsuite(struct ctldir *cd)
 #else
@@ -507,8 +1435,13 @@ int register_testsuite(void)
 		ctldir_register_shcmd(cd, "blast", shcmd_blast);
 		ctldir_register_shcmd(cd, "ioperf", shcmd_ioperf);
 		ctldir_register_shcmd(cd, "ioperf2", shcmd_ioperf2);
+		ctldir_register_shcmd(cd, "ioperf-rand", shcmd_ioperf_rand);
 		ctldir_register_shcmd(cd, "ocperf", shcmd_ocperf);
 		ctldir_register_shcmd(cd, "ocperf2", shcmd_ocperf2);
+		ctldir_register_shcmd(cd, "btperf", shcmd_btperf);
+		ctldir_register_shcmd(cd, "mpperf", shcmd_mpperf);
+		ctldir_register_shcmd(cd, "ringperf", shcmd_ringperf);
+		ctldir_register_shcmd(cd, "parseperf", shcmd_parseperf);
 	}
 #endif
 
@@ -517,8 +1450,13 @@ int register_testsuite(void)
 	shell_register_cmd("blast", shcmd_blast);
 	shell_register_cmd("ioperf", shcmd_ioperf);
 	shell_register_cmd("ioperf2", shcmd_ioperf2);
+	shell_register_cmd("ioperf-rand", shcmd_ioperf_rand);
 	shell_register_cmd("ocperf", shcmd_ocperf);
 	shell_register_cmd("ocperf2", shcmd_ocperf2);
+	shell_register_cmd("btperf", shcmd_btperf);
+	shell_register_cmd("mpperf", shcmd_mpperf);
+	shell_register_cmd("ringperf", shcmd_ringperf);
+	shell_register_cmd("parseperf", shcmd_parseperf);
 #endif
 
 	return 0;
@@ -0,0 +1,241 @@
+/*
+ * Tracepoints with latency histograms
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+
+#include <target/sys.h>
+#include <string.h>
+#include <errno.h>
+
+#include "tracepoint.h"
+#ifdef HAVE_SHELL
+#include "shell.h"
+#endif
+
+#ifndef min
+#define min(a, b) \
+    ({ __typeof__ (a) __a = (a); \
+       __typeof__ (b) __b = (b); \
+       __a < __b ? __a : __b; })
+#endif
+
+static const char * const tp_name[TP_MAX] = {
+	[TP_HTTP_ACCEPT]       = "http-accept",
+	[TP_HTTP_PARSE]        = "http-parse",
+	[TP_HTTP_PREPARE_HDR]  = "http-prepare-hdr",
+	[TP_SHFS_LOOKUP]       = "shfs-lookup",
+	[TP_SHFS_AIO_SUBMIT]   = "shfs-aio-submit",
+	[TP_SHFS_AIO_COMPLETE] = "shfs-aio-complete",
+	[TP_HTTP_FIRSTBYTE]    = "http-firstbyte",
+	[TP_HTTP_LASTACK]      = "http-lastack",
+	[TP_HTTP_LINK_SETUP]   = "http-link-setup",
+};
+
+struct tp_hist tp_hist[TP_MAX];
+
+/* reference points for converting timestamp ticks to nanoseconds */
+static tp_ts_t tp_ref_ts;
+static uint64_t tp_ref_ns;
+
+void tp_reset(void)
+{
+	register unsigned int i;
+
+	memset(tp_hist, 0, sizeof(tp_hist));
+	for (i = 0; i < TP_MAX; ++i)
+		tp_hist[i].min = UINT64_MAX;
+}
+
+void init_tracepoints(void)
+{
+	tp_reset();
+	tp_ref_ns = target_now_ns();
+	tp_ref_ts = tp_now();
+}
+
+/* lower bound of a histogram bucket */
+static inline uint64_t _tp_hist_bkt_low(unsigned int i)
+{
+	register unsigned int shift;
+
+	if (i < TP_HIST_SUB_BKTS)
+		return i;
+	shift = (i >> TP_HIST_SUB_BITS) - 1;
+	return ((uint64_t) (TP_HIST_SUB_BKTS + (i & (TP_HIST_SUB_BKTS - 1)))) << shift;
+}
+
+/* upper bound of a histogram bucket */
+static inline uint64_t _tp_hist_bkt_high(unsigned int i)
+{
+	if (i < TP_HIST_SUB_BKTS)
+		return i;
+	return _tp_hist_bkt_low(i) + ((1ull << ((i >> TP_HIST_SUB_BITS) - 1)) - 1);
+}
+
+/*
+ * Returns the value below which pm per mille of the recorded values are
+ * (upper bound of the according bucket, limited to the maximum)
+ */
+static uint64_t _tp_hist_percentile(const struct tp_hist *h, unsigned int pm)
+{
+	uint64_t rank, seen = 0;
+	register unsigned int i;
+
+	rank = (h->count * pm + 999) / 1000;
+	if (!rank)
+		rank = 1;
+	for (i = 0; i < TP_HIST_NB_BKTS; ++i) {
+		seen += h->bkt[i];
+		if (seen >= rank)
+			return min(_tp_hist_bkt_high(i), h->max);
+	}
+	return h->max;
+}
+
+#if defined __x86_64__ || defined __i386__
+/*
+ * TSC ticks per microsecond, estimated from the time since
+ * init_tracepoints() (0 if not enough time elapsed yet)
+ */
+static uint64_t _tp_ticks_per_us(void)
+{
+	uint64_t ns = target_now_ns() - tp_ref_ns;
+	uint64_t ticks = tp_now() - tp_ref_ts;
+
+	if (ns < 1000000) /* 1ms */
+		return 0;
+	return ticks / (ns / 1000);
+}
+#endif
+
+static inline uint64_t _tp_to_ns(uint64_t v, uint64_t tpus)
+{
+	if (!tpus)
+		return v;
+	return (v / tpus) * 1000 + ((v % tpus) * 1000) / tpus;
+}
+
+static int shcmd_tp_dump(FILE *cio, int argc, char *argv[])
+{
+	const struct tp_hist *h;
+	uint64_t tpus = 0;
+	int verbose = 0;
+	int raw = 0;
+	unsigned int i, b;
+
+	for (i = 1; i < (unsigned int) argc; ++i) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = 1;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			raw = 1;
+		} else {
+			fprintf(cio, "Usage: %s [-v] [-c]\n", argv[0]);
+			fprintf(cio, "  -v  print non-empty histogram buckets\n");
+			fprintf(cio, "  -c  print raw timestamp ticks instead of nanoseconds\n");
+			return -1;
+		}
+	}
+
+#if defined __x86_64__ || defined __i386__
+	if (!raw) {
+		tpus = _tp_ticks_per_us();
+		if (!tpus) {
+			fprintf(cio, "TSC frequency not known yet: printing ticks\n");
+			raw = 1;
+		} else {
+			fprintf(cio, "TSC: %"PRIu64" ticks/us\n", tpus);
+		}
+	}
+#endif
+
+	fprintf(cio, "%-18s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+		"tracepoint", "count", "min", "avg", "p50", "p90", "p99", "p99.9", "max");
+	fprintf(cio, "%-18s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+		"", "", raw ? "[ticks]" : "[ns]", "", "", "", "", "", "");
+	for (i = 0; i < TP_MAX; ++i) {
+		h = &tp_hist[i];
+		if (!h->count) {
+			fprintf(cio, "%-18s %10"PRIu64"\n", tp_name[i], h->count);
+			continue;
+		}
+		fprintf(cio, "%-18s %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64"\n",
+			tp_name[i], h->count,
+			_tp_to_ns(h->min, tpus),
+			_tp_to_ns(h->sum / h->count, tpus),
+			_tp_to_ns(_tp_hist_percentile(h, 500), tpus),
+			_tp_to_ns(_tp_hist_percentile(h, 900), tpus),
+			_tp_to_ns(_tp_hist_percentile(h, 990), tpus),
+			_tp_to_ns(_tp_hist_percentile(h, 999), tpus),
+			_tp_to_ns(h->max, tpus));
+
+		if (verbose) {
+			for (b = 0; b < TP_HIST_NB_BKTS; ++b) {
+				if (!h->bkt[b])
+					continue;
+				fprintf(cio, "   [%10"PRIu64" - %10"PRIu64"]: %"PRIu64"\n",
+					_tp_to_ns(_tp_hist_bkt_low(b), tpus),
+					_tp_to_ns(_tp_hist_bkt_high(b), tpus),
+					h->bkt[b]);
+			}
+		}
+	}
+	return 0;
+}
+
+static int shcmd_tp_reset(FILE *cio, int argc, char *argv[])
+{
+	tp_reset();
+	return 0;
+}
+
+#ifdef HAVE_CTLDIR
+int register_tracepoints(struct ctldir *cd)
+{
+	/* ctldir entries (ignore errors) */
+	if (cd) {
+		ctldir_register_shcmd(cd, "tp-dump", shcmd_tp_dump);
+		ctldir_register_shcmd(cd, "tp-reset", shcmd_tp_reset);
+	}
+#else
+int register_tracepoints(void)
+{
+#endif
+
+#ifdef HAVE_SHELL
+	/* shell commands (ignore errors) */
+	shell_register_cmd("tp-dump", shcmd_tp_dump);
+	shell_register_cmd("tp-reset", shcmd_tp_reset);
+#endif
+	return 0;
+}
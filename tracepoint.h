@@ -0,0 +1,167 @@
+/*
+ * Tracepoints with latency histograms
+ *
+ * Authors: Simon Kuenzer <simon.kuenzer@neclab.eu>
+ *
+ *
+ * Copyright (c) 2013-2017, NEC Europe Ltd., NEC Corporation All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * THIS HEADER MAY NOT BE EXTRACTED OR MODIFIED IN ANY WAY.
+ */
+#ifndef _TRACEPOINT_H_
+#define _TRACEPOINT_H_
+
+/*
+ * Tracepoints record latencies of hot-path operations into per-site
+ * histograms with logarithmic buckets (HDR-style: each power of two is
+ * split into TP_HIST_SUB_BKTS linear sub-buckets, so the relative error of
+ * a recorded value is below 1/TP_HIST_SUB_BKTS). Timestamps are taken from
+ * the CPU's time-stamp counter on x86 (target_now_ns() on other
+ * architectures), recording is a handful of instructions and does not
+ * involve any locking: tracepoints are expected to be hit from the
+ * (single) network processing context only.
+ *
+ * When TRACEPOINTS is not defined, all tracepoint macros compile to nothing.
+ */
+
+#include <target/sys.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "likely.h"
+#ifdef HAVE_CTLDIR
+#include <target/ctldir.h>
+#endif
+
+enum tp_id {
+	TP_HTTP_ACCEPT = 0,   /* httpsess_accept() */
+	TP_HTTP_PARSE,        /* parsing of a received pbuf chain */
+	TP_HTTP_PREPARE_HDR,  /* httpreq_prepare_hdr() */
+	TP_SHFS_LOOKUP,       /* object lookup in the SHFS bucket table */
+	TP_SHFS_AIO_SUBMIT,   /* issuing a chunk read */
+	TP_SHFS_AIO_COMPLETE, /* chunk read: issued -> completed */
+	TP_HTTP_FIRSTBYTE,    /* request parsed -> first response byte sent */
+	TP_HTTP_LASTACK,      /* request parsed -> last response byte acked */
+	TP_HTTP_LINK_SETUP,   /* upstream link created -> origin response header received */
+	TP_MAX
+};
+
+#ifdef TRACEPOINTS
+#define TP_HIST_SUB_BITS 3
+#define TP_HIST_SUB_BKTS (1 << TP_HIST_SUB_BITS)
+#define TP_HIST_NB_BKTS  ((64 - TP_HIST_SUB_BITS + 1) * TP_HIST_SUB_BKTS)
+
+struct tp_hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t bkt[TP_HIST_NB_BKTS];
+};
+
+extern struct tp_hist tp_hist[TP_MAX];
+
+typedef uint64_t tp_ts_t;
+
+static inline tp_ts_t tp_now(void)
+{
+#if defined __x86_64__ || defined __i386__
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+#else
+	return target_now_ns();
+#endif
+}
+
+/*
+ * Histogram bucket of a value:
+ *  values < TP_HIST_SUB_BKTS get an own bucket, larger values are
+ *  classified by their most significant bit and the following
+ *  TP_HIST_SUB_BITS bits
+ */
+static inline unsigned int _tp_hist_bkt(uint64_t v)
+{
+	register unsigned int shift;
+
+	if (v < TP_HIST_SUB_BKTS)
+		return (unsigned int) v;
+	shift = (63 - __builtin_clzll(v)) - TP_HIST_SUB_BITS;
+	return ((shift + 1) << TP_HIST_SUB_BITS)
+		+ (unsigned int) ((v >> shift) & (TP_HIST_SUB_BKTS - 1));
+}
+
+static inline void tp_record(enum tp_id id, uint64_t v)
+{
+	struct tp_hist *h = &tp_hist[id];
+
+	++h->count;
+	h->sum += v;
+	if (unlikely(v < h->min))
+		h->min = v;
+	if (unlikely(v > h->max))
+		h->max = v;
+	++h->bkt[_tp_hist_bkt(v)];
+}
+
+/* declares a timestamp variable and takes the current time */
+#define tp_start(ts) \
+	tp_ts_t ts = tp_now()
+/* records the time since ts */
+#define tp_end(id, ts) \
+	tp_record((id), tp_now() - (ts))
+/* stores the current time to a timestamp field, e.g., of a request */
+#define tp_stamp(field) \
+	do { (field) = tp_now(); } while (0)
+
+void init_tracepoints(void);
+void tp_reset(void);
+#ifdef HAVE_CTLDIR
+int register_tracepoints(struct ctldir *cd);
+#else
+int register_tracepoints(void);
+#endif
+
+#else /* TRACEPOINTS */
+
+#define tp_start(ts) \
+	do {} while (0)
+#define tp_end(id, ts) \
+	do {} while (0)
+#define tp_stamp(field) \
+	do {} while (0)
+#define tp_record(id, v) \
+	do {} while (0)
+#define init_tracepoints() \
+	do {} while (0)
+#define tp_reset() \
+	do {} while (0)
+
+#endif /* TRACEPOINTS */
+
+#endif /* _TRACEPOINT_H_ */